@@ -17,6 +17,7 @@
 
 #include "src/ui/chatdockwidget.h"
 #include "src/ui/llmoptionspage.h"
+#include "src/core/tracer.h"
 
 using namespace Core;
 
@@ -85,6 +86,7 @@ public:
         // Save settings
         // Disconnect from signals that are not needed during shutdown
         // Hide UI (if you add UI that is not in the main window directly)
+        Tracer::instance().flush();
         return SynchronousShutdown;
     }
 
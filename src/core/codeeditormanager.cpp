@@ -1,5 +1,9 @@
 #include "codeeditormanager.h"
+#include "codesearch.h"
+#include "filecontentcache.h"
+#include "virtualfilesystem.h"
 
+#include <coreplugin/documentmanager.h>
 #include <coreplugin/editormanager/editormanager.h>
 #include <coreplugin/editormanager/ieditor.h>
 #include <texteditor/texteditor.h>
@@ -14,15 +18,105 @@
 #include <QFile>
 #include <QDir>
 #include <QStandardPaths>
+#include <QThread>
+
+#include <cstring>
+
+namespace {
+
+// The lines of data that a range asks for, cut after the last whole line that
+// fits in range.maxBytes. A single line longer than that is cut in the middle.
+CodeEditorManager::FileRange sliceLines(QByteArrayView data, const CodeEditorManager::ReadRange &range)
+{
+    CodeEditorManager::FileRange result;
+    result.totalBytes = data.size();
+    if (CodeSearch::isBinary(data)) {
+        result.binary = true;
+        return result;
+    }
+    const qsizetype size = data.size();
+    result.totalLines = int(data.count('\n')) + (size > 0 && data.back() != '\n' ? 1 : 0);
+
+    qsizetype begin = 0;
+    int line = 1;
+    if (range.startOffset >= 0) {
+        begin = qsizetype(qMin<qint64>(range.startOffset, size));
+        while (begin > 0 && begin < size && (uchar(data[begin]) & 0xc0) == 0x80)
+            --begin;   // Not inside a UTF-8 sequence.
+        line += int(data.first(begin).count('\n'));
+    } else {
+        for (; line < range.startLine && begin < size; ++line) {
+            const void *newline = std::memchr(data.data() + begin, '\n', size_t(size - begin));
+            begin = newline ? static_cast<const char *>(newline) - data.data() + 1 : size;
+        }
+        line = qMax(line, range.startLine);
+    }
+    result.startLine = line;
+
+    const int lastLine = range.endLine > 0 ? range.endLine : result.totalLines;
+    qsizetype end = begin;
+    while (line <= lastLine && end < size) {
+        const void *newline = std::memchr(data.data() + end, '\n', size_t(size - end));
+        const qsizetype lineEnd = newline ? static_cast<const char *>(newline) - data.data() + 1 : size;
+        if (lineEnd - begin > range.maxBytes)
+            break;
+        end = lineEnd;
+        ++line;
+    }
+    result.endLine = line - 1;
+    if (line <= lastLine && end < size) {
+        if (end == begin) {
+            // Not even the first line fits.
+            end = begin + qsizetype(range.maxBytes);
+            while (end > begin && (uchar(data[end]) & 0xc0) == 0x80)
+                --end;
+            result.endLine = line;
+        }
+        result.nextOffset = end;
+        result.nextLine = line;
+    }
+    if (end == begin)
+        result.endLine = 0;
+
+    // Like a file opened in text mode.
+    result.content = QString::fromUtf8(data.sliced(begin, end - begin));
+    result.content.replace(QLatin1StringView("\r\n"), QLatin1StringView("\n"));
+    return result;
+}
+
+} // namespace
 
 CodeEditorManager::CodeEditorManager(QObject *parent)
     : QObject(parent)
+    , m_fileSystem(new VirtualFileSystem(this))
 {
     setupEditorConnections();
 }
 
 void CodeEditorManager::setupEditorConnections()
 {
+    // Keeps the project path that worker threads see up to date.
+    if (auto projectManager = ProjectExplorer::ProjectManager::instance()) {
+        connect(projectManager, &ProjectExplorer::ProjectManager::startupProjectChanged,
+                this, [this]() {
+                    const QString previous = m_projectPath;
+                    if (getProjectPath() != previous)
+                        emit projectPathChanged(m_projectPath);
+                });
+    }
+    getProjectPath();
+
+    // Files saved from an editor, the watcher would notice them a little later.
+    if (auto documentManager = Core::DocumentManager::instance()) {
+        connect(documentManager, &Core::DocumentManager::filesChangedInternally,
+                this, [](const Utils::FilePaths &filePaths) {
+                    QStringList paths;
+                    for (const Utils::FilePath &filePath : filePaths)
+                        paths.append(filePath.toString());
+                    FileContentCache::instance().invalidate(paths);
+                });
+    }
+
     auto editorManager = Core::EditorManager::instance();
     // if (editorManager) {
     //     connect(editorManager, &Core::EditorManager::currentEditorChanged,
@@ -181,6 +275,12 @@ bool CodeEditorManager::createFile(const QString &filePath, const QString &conte
 
 bool CodeEditorManager::openFile(const QString &filePath)
 {
+    // Tools create files on a worker thread, the editor is opened on the GUI thread.
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, filePath]() { openFile(filePath); }, Qt::QueuedConnection);
+        return true;
+    }
+
     auto editorManager = Core::EditorManager::instance();
     if (!editorManager) {
         return false;
@@ -192,6 +292,15 @@ bool CodeEditorManager::openFile(const QString &filePath)
 
 bool CodeEditorManager::readFile(const QString &filePath, QString &content)
 {
+    if (m_fileSystem->read(filePath, &content))
+        return true;
+    if (QByteArray data; FileContentCache::instance().read(filePath, &data)) {
+        // Like a file opened in text mode.
+        content = QString::fromUtf8(data);
+        content.replace(QLatin1StringView("\r\n"), QLatin1StringView("\n"));
+        return true;
+    }
+
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
         return false;
@@ -202,8 +311,49 @@ bool CodeEditorManager::readFile(const QString &filePath, QString &content)
     return true;
 }
 
+bool CodeEditorManager::isOpen(const QString &filePath) const
+{
+    return m_fileSystem->isOpen(filePath);
+}
+
+bool CodeEditorManager::readFileRange(const QString &filePath, const ReadRange &range, FileRange *result)
+{
+    QString content;
+    if (m_fileSystem->read(filePath, &content)) {
+        *result = sliceLines(content.toUtf8(), range);
+        return true;
+    }
+    if (QByteArray data; FileContentCache::instance().read(filePath, &data)) {
+        *result = sliceLines(data, range);
+        return true;
+    }
+
+    QFile file(filePath);
+    if (file.open(QIODevice::ReadOnly) && file.size() > 0) {
+        if (const uchar *mapped = file.map(0, file.size())) {
+            *result = sliceLines(QByteArrayView(mapped, file.size()), range);
+            return true;
+        }
+    }
+
+    if (!readFile(filePath, content))
+        return false;
+    *result = sliceLines(content.toUtf8(), range);
+    return true;
+}
+
 bool CodeEditorManager::writeFile(const QString &filePath, const QString &content)
 {
+    switch (m_fileSystem->write(filePath, content)) {
+    case VirtualFileSystem::WriteResult::Written:
+        FileContentCache::instance().invalidate({filePath});
+        return true;
+    case VirtualFileSystem::WriteResult::Failed:
+        return false;
+    case VirtualFileSystem::WriteResult::NotOpen:
+        break;
+    }
+
     QFile file(filePath);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
         return false;
@@ -212,11 +362,13 @@ bool CodeEditorManager::writeFile(const QString &filePath, const QString &conten
     QTextStream out(&file);
     out << content;
     file.close();
+    FileContentCache::instance().invalidate({filePath});
     return true;
 }
 
 bool CodeEditorManager::deleteFile(const QString &filePath)
 {
+    FileContentCache::instance().invalidate({filePath});
     return QFile::remove(filePath);
 }
 
@@ -227,6 +379,15 @@ bool CodeEditorManager::fileExists(const QString &filePath) const
 
 QString CodeEditorManager::getProjectPath() const
 {
+    // Read-only tools run on worker threads, but the project manager may only be
+    // used on the GUI thread.
+    QMutexLocker locker(&m_projectPathMutex);
+    if (QThread::currentThread() != thread()) {
+        return m_projectPath;
+    }
+
+    m_projectPath.clear();
+
     auto projectManager = ProjectExplorer::ProjectManager::instance();
     if (!projectManager) {
         return QString();
@@ -245,7 +406,8 @@ QString CodeEditorManager::getProjectPath() const
         return QString();
     }
     
-    return currentProject->projectDirectory().toString();
+    m_projectPath = currentProject->projectDirectory().toString();
+    return m_projectPath;
 }
 
 QString CodeEditorManager::resolvePath(const QString &relativePath) const
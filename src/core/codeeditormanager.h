@@ -1,9 +1,12 @@
 #ifndef CODEEDITORMANAGER_H
 #define CODEEDITORMANAGER_H
 
+#include <QMutex>
 #include <QObject>
 #include <QString>
 
+class VirtualFileSystem;
+
 class CodeEditorManager : public QObject
 {
     Q_OBJECT
@@ -28,12 +31,43 @@ public:
     virtual bool insertTextAtPosition(const QString &text, int position);
     
     virtual bool createFile(const QString &filePath, const QString &content);
+    // Off the GUI thread the editor is opened asynchronously and true is returned.
     virtual bool openFile(const QString &filePath);
+    // Files open in an editor are read from and written to the editor's document,
+    // unsaved changes included, other files from and to disk through
+    // FileContentCache.
     virtual bool readFile(const QString &filePath, QString &content);
+    // Whether the file is open in an editor, so that off the GUI thread reading
+    // it waits for the GUI thread.
+    virtual bool isOpen(const QString &filePath) const;
+
+    // A window of lines of a file, for files too large to read whole.
+    struct ReadRange {
+        int startLine = 1;           // 1-based.
+        int endLine = 0;             // Inclusive, 0 for the end of the file.
+        qint64 maxBytes = 65536;     // Of UTF-8 content.
+        qint64 startOffset = -1;     // Byte offset to continue at, overrides startLine.
+    };
+    struct FileRange {
+        QString content;
+        int startLine = 0;
+        int endLine = 0;             // 0 when nothing was read.
+        int totalLines = 0;
+        qint64 totalBytes = 0;
+        // Where the next read continues when the range was cut short, -1 otherwise.
+        qint64 nextOffset = -1;
+        int nextLine = 0;
+        bool binary = false;
+    };
+    // Decodes only the lines asked for, from the open document, the content cache
+    // or, for files too large to cache, a memory map.
+    virtual bool readFileRange(const QString &filePath, const ReadRange &range, FileRange *result);
     virtual bool writeFile(const QString &filePath, const QString &content);
     virtual bool deleteFile(const QString &filePath);
     virtual bool fileExists(const QString &filePath) const;
     
+    // Safe to call from any thread. Off the GUI thread it returns the path seen
+    // by the last call on the GUI thread, or the last startup project change.
     virtual QString getProjectPath() const;
     virtual QString resolvePath(const QString &relativePath) const;
 
@@ -42,11 +76,16 @@ signals:
     void textInserted(const QString &text);
     void textReplaced(const QString &text);
     void fileCreated(const QString &filePath);
+    void projectPathChanged(const QString &projectPath);
 
 private:
     void setupEditorConnections();
     
     mutable EditorContext m_lastContext;
+    VirtualFileSystem *m_fileSystem = nullptr;
+
+    mutable QMutex m_projectPathMutex;
+    mutable QString m_projectPath;
 };
 
 #endif // CODEEDITORMANAGER_H
@@ -0,0 +1,459 @@
+#include "codesearch.h"
+#include "gitignore.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <optional>
+
+namespace {
+
+// Matches kept for ranking. Searching stops once this many are found.
+constexpr qsizetype MaxCollected = 5000;
+constexpr qsizetype MaxMatchesPerFile = 20;
+constexpr qsizetype MaxLineLength = 300;
+
+constexpr auto LowerAscii = []() {
+    std::array<uchar, 256> table{};
+    for (int c = 0; c < 256; ++c)
+        table[c] = (c >= 'A' && c <= 'Z') ? uchar(c - 'A' + 'a') : uchar(c);
+    return table;
+}();
+
+struct SearchState
+{
+    const CodeSearch::Options &options;
+    std::optional<SubstringMatcher> matcher;
+    QRegularExpression regex;
+
+    QMutex mutex;
+    QList<CodeSearch::Match> matches;
+    std::atomic<int> totalMatches = 0;
+    std::atomic<int> filesSearched = 0;
+    std::atomic<int> filesMatched = 0;
+    std::atomic<bool> truncated = false;
+
+    explicit SearchState(const CodeSearch::Options &options) : options(options) {}
+};
+
+bool isWordChar(char16_t c)
+{
+    return (c >= u'a' && c <= u'z') || (c >= u'A' && c <= u'Z') || (c >= u'0' && c <= u'9') || c == u'_' || c > 0x7f;
+}
+
+QString toLineString(QByteArrayView line)
+{
+    return QString::fromUtf8(line.first(qMin(line.size(), MaxLineLength)));
+}
+
+QString toLineString(QStringView line)
+{
+    return line.first(qMin(line.size(), MaxLineLength)).toString();
+}
+
+template<typename View>
+qsizetype lineEndAt(View text, qsizetype pos)
+{
+    while (pos < text.size() && text[pos] != u'\n')
+        ++pos;
+    return pos;
+}
+
+template<typename View>
+View lineAt(View text, qsizetype start, qsizetype end)
+{
+    if (end > start && text[end - 1] == u'\r')
+        --end;
+    return text.sliced(start, end - start);
+}
+
+// Definitions are more useful than uses, they rank first.
+bool looksLikeDefinition(const QString &line)
+{
+    static const char *const keywords[] = {"class ", "struct ", "enum ", "namespace ", "union ", "typedef ",
+                                           "using ", "#define ", "def ", "fn ", "function ", "interface "};
+    const QString trimmed = line.trimmed();
+    for (const char *keyword : keywords) {
+        if (trimmed.startsWith(QLatin1StringView(keyword)))
+            return true;
+    }
+    return false;
+}
+
+template<typename View>
+CodeSearch::Match makeMatch(const SearchState &state, const QString &filePath, const QString &fileName,
+                            View text, qsizetype lineStart, qsizetype lineEnd, int line,
+                            qsizetype matchStart, qsizetype matchLength)
+{
+    CodeSearch::Match match;
+    match.filePath = filePath;
+    match.line = line;
+    match.column = int(matchStart - lineStart) + 1;
+    match.text = toLineString(lineAt(text, lineStart, lineEnd));
+
+    qsizetype start = lineStart;
+    for (int i = 0; i < state.options.contextLines && start > 0; ++i) {
+        qsizetype previous = start - 1;
+        while (previous > 0 && text[previous - 1] != u'\n')
+            --previous;
+        match.before.prepend(toLineString(lineAt(text, previous, start - 1)));
+        start = previous;
+    }
+    qsizetype end = lineEnd;
+    for (int i = 0; i < state.options.contextLines && end < text.size(); ++i) {
+        if (end + 1 >= text.size())
+            break;
+        const qsizetype next = lineEndAt(text, end + 1);
+        match.after.append(toLineString(lineAt(text, end + 1, next)));
+        end = next;
+    }
+
+    const QString matched = toLineString(text.sliced(matchStart, matchLength));
+    const bool wordStart = matchStart == 0 || !isWordChar(char16_t(text[matchStart - 1]));
+    const bool wordEnd = matchStart + matchLength >= text.size()
+                         || !isWordChar(char16_t(text[matchStart + matchLength]));
+    if (wordStart && wordEnd)
+        match.score += 3;
+    if (!state.options.regex && matched == state.options.pattern)
+        match.score += 2;
+    if (fileName.contains(matched, Qt::CaseInsensitive))
+        match.score += 4;
+    if (looksLikeDefinition(match.text))
+        match.score += 3;
+    if (filePath.contains(QLatin1StringView("/3rdparty/")) || filePath.contains(QLatin1StringView("/third_party/"))
+        || filePath.contains(QLatin1StringView("/vendor/")))
+        match.score -= 2;
+    return match;
+}
+
+void scanFile(SearchState *state, const QString &filePath, const QString &fileName)
+{
+    if (state->truncated.load(std::memory_order_relaxed))
+        return;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    const qint64 size = file.size();
+    if (size <= 0)
+        return;
+
+    QByteArray buffer;
+    QByteArrayView data;
+    if (const uchar *mapped = file.map(0, size)) {
+        data = QByteArrayView(mapped, size);
+    } else {
+        buffer = file.readAll();
+        data = buffer;
+    }
+    if (CodeSearch::isBinary(data))
+        return;
+
+    state->filesSearched.fetch_add(1, std::memory_order_relaxed);
+
+    QList<CodeSearch::Match> local;
+    int found = 0;
+    // Lines are counted incrementally from the previous match.
+    qsizetype countedTo = 0;
+    int line = 1;
+
+    if (state->matcher) {
+        qsizetype pos = 0;
+        while ((pos = state->matcher->indexIn(data, pos)) >= 0) {
+            qsizetype lineStart = pos;
+            while (lineStart > countedTo && data[lineStart - 1] != '\n')
+                --lineStart;
+            line += int(std::count(data.begin() + countedTo, data.begin() + lineStart, '\n'));
+            countedTo = lineStart;
+            const qsizetype lineEnd = lineEndAt(data, pos);
+
+            ++found;
+            if (local.size() < MaxMatchesPerFile)
+                local.append(makeMatch(*state, filePath, fileName, data, lineStart, lineEnd, line,
+                                       pos, state->matcher->size()));
+            // One match per line.
+            pos = lineEnd + 1;
+        }
+    } else {
+        const QString text = QString::fromUtf8(data);
+        const QStringView view(text);
+        auto it = state->regex.globalMatch(text);
+        qsizetype nextLine = 0;
+        while (it.hasNext()) {
+            const QRegularExpressionMatch m = it.next();
+            const qsizetype pos = m.capturedStart();
+            if (pos < nextLine || m.capturedLength() == 0)
+                continue;
+            qsizetype lineStart = pos;
+            while (lineStart > countedTo && view[lineStart - 1] != u'\n')
+                --lineStart;
+            line += int(std::count(view.begin() + countedTo, view.begin() + lineStart, u'\n'));
+            countedTo = lineStart;
+            const qsizetype lineEnd = lineEndAt(view, pos);
+
+            ++found;
+            if (local.size() < MaxMatchesPerFile)
+                local.append(makeMatch(*state, filePath, fileName, view, lineStart, lineEnd, line,
+                                       pos, qMin(m.capturedLength(), lineEnd - pos)));
+            nextLine = lineEnd + 1;
+        }
+    }
+
+    if (found == 0)
+        return;
+
+    state->totalMatches.fetch_add(found, std::memory_order_relaxed);
+    state->filesMatched.fetch_add(1, std::memory_order_relaxed);
+
+    QMutexLocker locker(&state->mutex);
+    state->matches.append(local);
+    if (state->matches.size() >= MaxCollected)
+        state->truncated = true;
+}
+
+struct WalkState
+{
+    const CodeSearch::Options &options;
+    const CodeSearch::FileVisitor &visitFile;
+    const CodeSearch::DirectoryVisitor &visitDirectory;
+    QThreadPool pool;
+    std::atomic<bool> stopped = false;
+
+    WalkState(const CodeSearch::Options &options, const CodeSearch::FileVisitor &visitFile,
+              const CodeSearch::DirectoryVisitor &visitDirectory)
+        : options(options), visitFile(visitFile), visitDirectory(visitDirectory) {}
+};
+
+void walkDirectory(WalkState *state, const QString &directory, const QString &relativeDir,
+                   std::shared_ptr<const GitIgnore> ignore)
+{
+    if (state->stopped.load(std::memory_order_relaxed))
+        return;
+
+    ignore = GitIgnore::forDirectory(ignore, directory, relativeDir);
+    if (state->visitDirectory)
+        state->visitDirectory(directory, relativeDir);
+
+    QList<QFileInfo> files;
+    QDirIterator it(directory, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        const QString name = info.fileName();
+        const QString relativePath = relativeDir.isEmpty() ? name : relativeDir + '/' + name;
+
+        if (info.isDir()) {
+            // Symlinked directories may form cycles.
+            if (CodeSearch::isSkippedDirectory(name) || info.isSymLink())
+                continue;
+            if (ignore && ignore->isIgnored(relativePath, true))
+                continue;
+            const QString path = info.filePath();
+            state->pool.start([state, path, relativePath, ignore]() {
+                walkDirectory(state, path, relativePath, ignore);
+            });
+            continue;
+        }
+
+        if (ignore && ignore->isIgnored(relativePath, false))
+            continue;
+        if (!CodeSearch::acceptsFile(state->options, info))
+            continue;
+        files.append(info);
+    }
+
+    for (const QFileInfo &info : std::as_const(files)) {
+        const QString relativePath = relativeDir.isEmpty() ? info.fileName() : relativeDir + '/' + info.fileName();
+        if (!state->visitFile(info, relativePath)) {
+            state->stopped = true;
+            return;
+        }
+    }
+}
+
+} // namespace
+
+SubstringMatcher::SubstringMatcher(const QByteArray &needle, bool caseSensitive)
+    : m_needle(needle), m_caseSensitive(caseSensitive)
+{
+    if (!m_caseSensitive) {
+        for (char &c : m_needle)
+            c = char(LowerAscii[uchar(c)]);
+    }
+
+    const qsizetype length = m_needle.size();
+    std::fill(std::begin(m_skip), std::end(m_skip), qMax<qsizetype>(length, 1));
+    for (qsizetype i = 0; i + 1 < length; ++i) {
+        const uchar c = uchar(m_needle[i]);
+        m_skip[c] = length - 1 - i;
+        // The haystack is not folded, so upper case bytes need the same shift.
+        if (!m_caseSensitive && c >= 'a' && c <= 'z')
+            m_skip[c - 'a' + 'A'] = length - 1 - i;
+    }
+}
+
+qsizetype SubstringMatcher::indexIn(QByteArrayView haystack, qsizetype from) const
+{
+    const qsizetype length = m_needle.size();
+    if (length == 0)
+        return from <= haystack.size() ? from : -1;
+
+    const auto *text = reinterpret_cast<const uchar *>(haystack.data());
+    const auto *needle = reinterpret_cast<const uchar *>(m_needle.constData());
+    const uchar last = needle[length - 1];
+    qsizetype pos = from;
+    const qsizetype end = haystack.size() - length;
+
+    if (m_caseSensitive) {
+        while (pos <= end) {
+            const uchar c = text[pos + length - 1];
+            if (c == last && std::memcmp(text + pos, needle, size_t(length - 1)) == 0)
+                return pos;
+            pos += m_skip[c];
+        }
+        return -1;
+    }
+
+    while (pos <= end) {
+        const uchar c = text[pos + length - 1];
+        if (LowerAscii[c] == last) {
+            qsizetype i = 0;
+            while (i < length - 1 && LowerAscii[text[pos + i]] == needle[i])
+                ++i;
+            if (i == length - 1)
+                return pos;
+        }
+        pos += m_skip[c];
+    }
+    return -1;
+}
+
+bool CodeSearch::isSkippedDirectory(const QString &name)
+{
+    return name == QLatin1StringView(".git") || name == QLatin1StringView(".qtagent");
+}
+
+bool CodeSearch::isInSkippedDirectory(const QString &relativePath)
+{
+    const QStringList parts = relativePath.split(u'/');
+    for (qsizetype i = 0; i + 1 < parts.size(); ++i) {
+        if (isSkippedDirectory(parts[i]))
+            return true;
+    }
+    return false;
+}
+
+QString CodeSearch::parentDirectory(const QString &relativePath)
+{
+    const qsizetype slash = relativePath.lastIndexOf(u'/');
+    return slash < 0 ? QString() : relativePath.left(slash);
+}
+
+std::optional<QString> CodeSearch::relativeTreePath(const QDir &root, const QString &filePath)
+{
+    const QString relativePath = root.relativeFilePath(QDir::cleanPath(filePath));
+    if (relativePath.startsWith(QLatin1StringView("../")) || QDir::isAbsolutePath(relativePath)
+        || isInSkippedDirectory(relativePath))
+        return std::nullopt;
+    return relativePath;
+}
+
+bool CodeSearch::isBinary(QByteArrayView data)
+{
+    return !data.isEmpty() && std::memchr(data.data(), 0, size_t(qMin(data.size(), BinaryProbeSize)));
+}
+
+bool CodeSearch::acceptsFile(const Options &options, const QFileInfo &file)
+{
+    if (!options.fileGlob.isEmpty() && !GitIgnore::globMatch(options.fileGlob, file.fileName()))
+        return false;
+    return file.size() <= options.maxFileSize;
+}
+
+void CodeSearch::forEachFile(const QString &rootPath, const Options &options, const FileVisitor &visitFile,
+                             const DirectoryVisitor &visitDirectory)
+{
+    WalkState state(options, visitFile, visitDirectory);
+    state.pool.setMaxThreadCount(QThread::idealThreadCount());
+    const QString root = QDir::cleanPath(rootPath);
+    const auto ignore = GitIgnore::repositoryExcludes(root);
+    state.pool.start([&state, root, ignore]() { walkDirectory(&state, root, QString(), ignore); });
+    state.pool.waitForDone();
+}
+
+CodeSearch::Result CodeSearch::search(const QString &rootPath, const Options &options,
+                                      const std::optional<QStringList> &candidateFiles)
+{
+    Result result;
+    if (options.pattern.isEmpty()) {
+        result.errorString = "Empty search pattern";
+        return result;
+    }
+    if (!QFileInfo(rootPath).isDir()) {
+        result.errorString = "Directory not found: " + rootPath;
+        return result;
+    }
+
+    SearchState state(options);
+    if (options.regex) {
+        QRegularExpression::PatternOptions patternOptions = QRegularExpression::MultilineOption;
+        if (!options.caseSensitive)
+            patternOptions |= QRegularExpression::CaseInsensitiveOption;
+        state.regex = QRegularExpression(options.pattern, patternOptions);
+        if (!state.regex.isValid()) {
+            result.errorString = "Invalid regular expression: " + state.regex.errorString();
+            return result;
+        }
+        state.regex.optimize();
+    } else {
+        state.matcher.emplace(options.pattern.toUtf8(), options.caseSensitive);
+    }
+
+    if (candidateFiles) {
+        // The index already did the walk, only verify its candidates below the root.
+        const QString prefix = QDir::cleanPath(rootPath) + '/';
+        QThreadPool pool;
+        pool.setMaxThreadCount(QThread::idealThreadCount());
+        for (const QString &filePath : *candidateFiles) {
+            if (!filePath.startsWith(prefix))
+                continue;
+            pool.start([&state, &options, filePath]() {
+                const QFileInfo info(filePath);
+                if (info.isFile() && acceptsFile(options, info))
+                    scanFile(&state, filePath, info.fileName());
+            });
+        }
+        pool.waitForDone();
+    } else {
+        forEachFile(rootPath, options, [&state](const QFileInfo &file, const QString &) {
+            scanFile(&state, file.filePath(), file.fileName());
+            return !state.truncated.load(std::memory_order_relaxed);
+        });
+    }
+    std::sort(state.matches.begin(), state.matches.end(), [](const Match &a, const Match &b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        if (a.filePath != b.filePath)
+            return a.filePath < b.filePath;
+        return a.line < b.line;
+    });
+    if (state.matches.size() > options.maxResults)
+        state.matches.resize(qMax(options.maxResults, 0));
+
+    result.matches = std::move(state.matches);
+    result.totalMatches = state.totalMatches;
+    result.filesSearched = state.filesSearched;
+    result.filesMatched = state.filesMatched;
+    result.truncated = state.truncated;
+    return result;
+}
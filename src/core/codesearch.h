@@ -0,0 +1,99 @@
+#ifndef CODESEARCH_H
+#define CODESEARCH_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QDir>
+#include <QFileInfo>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+#include <optional>
+
+// Text search over a directory tree, used by the search_code tool.
+//
+// Directories are walked in parallel on a thread pool, honoring .gitignore files
+// and skipping .git, .qtagent, binary files (NUL byte in the first 8 KiB) and files above
+// maxFileSize. Files are memory-mapped and scanned with a Horspool substring
+// matcher; regular expressions run line by line on files that are decoded only
+// when needed. Results are ranked and capped at maxResults.
+class CodeSearch
+{
+public:
+    struct Options {
+        QString pattern;
+        bool regex = false;
+        bool caseSensitive = false;
+        int maxResults = 50;
+        int contextLines = 2;
+        // Only files whose name matches this glob, e.g. "*.cpp". Empty for all.
+        QString fileGlob;
+        qint64 maxFileSize = 4 * 1024 * 1024;
+    };
+
+    struct Match {
+        QString filePath;     // Absolute.
+        int line = 0;         // 1-based.
+        int column = 0;       // 1-based, in bytes for plain text, characters for regular expressions.
+        QString text;
+        QStringList before;
+        QStringList after;
+        int score = 0;
+    };
+
+    struct Result {
+        QList<Match> matches;
+        int totalMatches = 0;     // Including the ones beyond maxResults.
+        int filesSearched = 0;
+        int filesMatched = 0;
+        bool truncated = false;   // Collection stopped early, totalMatches is a lower bound.
+        QString errorString;
+    };
+
+    // With candidateFiles (absolute paths, e.g. from a TrigramIndex) only those
+    // below rootPath are searched instead of walking the tree.
+    static Result search(const QString &rootPath, const Options &options,
+                         const std::optional<QStringList> &candidateFiles = std::nullopt);
+
+    // Called for every file that a search looks at, from several threads at once.
+    // relativePath uses '/' separators. Returning false stops the walk.
+    using FileVisitor = std::function<bool(const QFileInfo &file, const QString &relativePath)>;
+    using DirectoryVisitor = std::function<void(const QString &directory, const QString &relativeDir)>;
+    static void forEachFile(const QString &rootPath, const Options &options, const FileVisitor &visitFile,
+                            const DirectoryVisitor &visitDirectory = {});
+
+    // Directories that are never searched, like .git.
+    static bool isSkippedDirectory(const QString &name);
+    // Whether a directory of relativePath is one of them.
+    static bool isInSkippedDirectory(const QString &relativePath);
+    // The part of relativePath before the last '/', empty for files at the top.
+    static QString parentDirectory(const QString &relativePath);
+    // filePath relative to root, or nullopt when it lies outside the tree or in a
+    // skipped directory. For the changed files that the indexes are told about.
+    static std::optional<QString> relativeTreePath(const QDir &root, const QString &filePath);
+    // A NUL byte in the first BinaryProbeSize bytes.
+    static constexpr qsizetype BinaryProbeSize = 8192;
+    static bool isBinary(QByteArrayView data);
+    // File name glob and size limits of options.
+    static bool acceptsFile(const Options &options, const QFileInfo &file);
+};
+
+// Horspool substring search over bytes, optionally ASCII case-insensitive.
+class SubstringMatcher
+{
+public:
+    SubstringMatcher(const QByteArray &needle, bool caseSensitive);
+
+    // Position of the first occurrence at or after from, or -1.
+    qsizetype indexIn(QByteArrayView haystack, qsizetype from = 0) const;
+    qsizetype size() const { return m_needle.size(); }
+
+private:
+    QByteArray m_needle;   // Lower-cased when case-insensitive.
+    bool m_caseSensitive;
+    qsizetype m_skip[256];
+};
+
+#endif // CODESEARCH_H
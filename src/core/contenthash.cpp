@@ -0,0 +1,106 @@
+#include "contenthash.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr quint64 Prime1 = 0x9E3779B185EBCA87ULL;
+constexpr quint64 Prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr quint64 Prime3 = 0x165667B19E3779F9ULL;
+constexpr quint64 Prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr quint64 Prime5 = 0x27D4EB2F165667C5ULL;
+
+inline quint64 rotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little-endian loads, whatever the host.
+inline quint64 read64(const uchar *p)
+{
+    quint64 value = 0;
+    for (int i = 7; i >= 0; --i)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+inline quint32 read32(const uchar *p)
+{
+    return quint32(p[0]) | quint32(p[1]) << 8 | quint32(p[2]) << 16 | quint32(p[3]) << 24;
+}
+
+inline quint64 round(quint64 accumulator, quint64 input)
+{
+    accumulator += input * Prime2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * Prime1;
+}
+
+inline quint64 mergeRound(quint64 accumulator, quint64 value)
+{
+    accumulator ^= round(0, value);
+    return accumulator * Prime1 + Prime4;
+}
+
+} // namespace
+
+namespace ContentHash {
+
+quint64 xxh64(QByteArrayView data, quint64 seed)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data.data());
+    const uchar *const end = p + data.size();
+    quint64 hash;
+
+    if (data.size() >= 32) {
+        quint64 v1 = seed + Prime1 + Prime2;
+        quint64 v2 = seed + Prime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - Prime1;
+        const uchar *const limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    } else {
+        hash = seed + Prime5;
+    }
+    hash += quint64(data.size());
+
+    for (; p + 8 <= end; p += 8) {
+        hash ^= round(0, read64(p));
+        hash = rotateLeft(hash, 27) * Prime1 + Prime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= quint64(read32(p)) * Prime1;
+        hash = rotateLeft(hash, 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= quint64(*p) * Prime5;
+        hash = rotateLeft(hash, 11) * Prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= Prime2;
+    hash ^= hash >> 29;
+    hash *= Prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+quint64 xxh64(const QString &text, quint64 seed)
+{
+    return xxh64(text.toUtf8(), seed);
+}
+
+} // namespace ContentHash
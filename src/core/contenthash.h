@@ -0,0 +1,18 @@
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <QByteArrayView>
+#include <QString>
+
+// Fast non-cryptographic content hashes, stable across runs and hosts, for keys
+// that are persisted (unlike qHash, which is seeded per process).
+namespace ContentHash {
+
+// XXH64 by Yann Collet, compatible with the reference implementation.
+quint64 xxh64(QByteArrayView data, quint64 seed = 0);
+// XXH64 of the UTF-8 encoding.
+quint64 xxh64(const QString &text, quint64 seed = 0);
+
+} // namespace ContentHash
+
+#endif // CONTENTHASH_H
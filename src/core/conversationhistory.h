@@ -5,8 +5,11 @@
 #include <QList>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QJsonDocument>
 #include <QDateTime>
 
+#include <functional>
+
 struct Message {
     enum Role {
         System,
@@ -59,16 +62,52 @@ struct Message {
         
         return obj;
     }
+
+    // Basic token estimation (characters / 4 as a rough proxy if no tokenizer available)
+    int estimatedTokens() const {
+        return content.length() / 4 + 10; // +10 for metadata overhead
+    }
+
+    // Compact UTF-8 JSON of toJson(), computed once. Messages are immutable once
+    // they are in a ConversationHistory, so the cache never goes stale there.
+    const QByteArray &toJsonBytes() const {
+        if (jsonCache.isEmpty())
+            jsonCache = QJsonDocument(toJson()).toJson(QJsonDocument::Compact);
+        return jsonCache;
+    }
+
+    int tokenCount = -1; // Set by ConversationHistory when the message is added.
+    mutable QByteArray jsonCache;
 };
 
 class ConversationHistory {
 public:
+    using TokenCounter = std::function<int(const QString &text)>;
+
+    // Counts tokens with the model's tokenizer instead of the characters / 4
+    // estimate. Recounts the messages already in the history.
+    void setTokenCounter(TokenCounter counter) {
+        m_tokenCounter = std::move(counter);
+        m_tokenCount = 0;
+        for (auto &msg : m_messages) {
+            msg.tokenCount = countTokens(msg);
+            m_tokenCount += msg.tokenCount;
+        }
+    }
+
+    bool hasTokenCounter() const {
+        return bool(m_tokenCounter);
+    }
+
     void addMessage(Message::Role role, const QString &content, const QString &toolCallId = QString(), const QJsonArray &toolCalls = QJsonArray()) {
-        m_messages.append({role, content, toolCallId, toolCalls, QDateTime::currentDateTime()});
+        addMessage({role, content, toolCallId, toolCalls, QDateTime::currentDateTime()});
     }
 
     void addMessage(const Message &msg) {
         m_messages.append(msg);
+        Message &added = m_messages.last();
+        added.tokenCount = countTokens(added);
+        m_tokenCount += added.tokenCount;
     }
 
     const QList<Message>& messages() const {
@@ -77,6 +116,8 @@ public:
 
     void clear() {
         m_messages.clear();
+        m_tokenCount = 0;
+        invalidateJsonCache();
     }
 
     QJsonArray toJsonArray() const {
@@ -87,32 +128,98 @@ public:
         return arr;
     }
 
+    // The messages array as serialized JSON, built by concatenating the cached
+    // bytes of each message. Appending messages only serializes the new ones.
+    QByteArray toJsonBytes(bool includeSystem = true) const {
+        JsonCache &cache = m_jsonCache[includeSystem ? 1 : 0];
+        if (cache.bytes.isEmpty())
+            cache.bytes = "[";
+        for (; cache.messageCount < m_messages.size(); ++cache.messageCount) {
+            const Message &msg = m_messages.at(cache.messageCount);
+            if (!includeSystem && msg.role == Message::System)
+                continue;
+            if (cache.bytes.size() > 1)
+                cache.bytes += ',';
+            cache.bytes += msg.toJsonBytes();
+        }
+        return cache.bytes + ']';
+    }
+
+    // Whether the result of the given tool call is still in the history, trim()
+    // may have dropped it.
+    bool containsToolResult(const QString &toolCallId) const {
+        for (auto it = m_messages.crbegin(); it != m_messages.crend(); ++it) {
+            if (it->role == Message::Tool && it->toolCallId == toolCallId)
+                return true;
+        }
+        return false;
+    }
+
     int messageCount() const {
         return m_messages.size();
     }
 
-    // Basic token estimation (characters / 4 as a rough proxy if no tokenizer available)
+    // Kept up to date on every change, so this is O(1).
     int estimateTokenCount() const {
-        int count = 0;
-        for (const auto &msg : m_messages) {
-            count += msg.content.length() / 4 + 10; // +10 for metadata overhead
-        }
-        return count;
+        return m_tokenCount;
     }
 
+    // Drops the oldest messages until the estimate fits into maxTokens. A leading
+    // system message is kept as long as one other message remains after it.
     void trim(int maxTokens) {
-        while (estimateTokenCount() > maxTokens && m_messages.size() > 1) {
-            // Keep system message if it's the first one
-            if (m_messages.first().role == Message::System && m_messages.size() > 2) {
-                m_messages.removeAt(1);
-            } else {
-                m_messages.removeFirst();
-            }
+        const qsizetype size = m_messages.size();
+        if (m_tokenCount <= maxTokens || size <= 1)
+            return;
+
+        const bool pinSystem = m_messages.first().role == Message::System;
+        qsizetype from = pinSystem ? 1 : 0;
+        qsizetype count = 0;
+        int tokens = m_tokenCount;
+        while (tokens > maxTokens && size - count > (pinSystem ? 2 : 1)) {
+            tokens -= m_messages.at(from + count).tokenCount;
+            ++count;
+        }
+        if (pinSystem && tokens > maxTokens) {
+            // Only the system message and the latest message are left, and they
+            // still do not fit: the system message goes as well.
+            tokens -= m_messages.first().tokenCount;
+            from = 0;
+            ++count;
         }
+
+        // One range erase: Qt 6 QList moves the shorter side, here the system message.
+        m_messages.remove(from, count);
+        m_tokenCount = tokens;
+        invalidateJsonCache();
     }
 
 private:
+    // Chat templates add a few tokens per message for the role and separators.
+    static constexpr int MessageOverheadTokens = 4;
+
+    int countTokens(const Message &msg) const {
+        if (!m_tokenCounter)
+            return msg.estimatedTokens();
+        int tokens = MessageOverheadTokens + m_tokenCounter(msg.content);
+        if (!msg.toolCalls.isEmpty())
+            tokens += m_tokenCounter(QString::fromUtf8(QJsonDocument(msg.toolCalls).toJson(QJsonDocument::Compact)));
+        return tokens;
+    }
+
+    struct JsonCache {
+        QByteArray bytes; // Without the closing bracket.
+        qsizetype messageCount = 0;
+    };
+
+    void invalidateJsonCache() {
+        m_jsonCache[0] = JsonCache();
+        m_jsonCache[1] = JsonCache();
+    }
+
     QList<Message> m_messages;
+    int m_tokenCount = 0;
+    TokenCounter m_tokenCounter;
+    mutable JsonCache m_jsonCache[2]; // Without and with system messages.
 };
 
 #endif // CONVERSATIONHISTORY_H
@@ -0,0 +1,181 @@
+#include "cppmodelsymbols.h"
+
+#include <cplusplus/CppDocument.h>
+#include <cplusplus/LookupContext.h>
+#include <cplusplus/Overview.h>
+#include <cplusplus/Symbols.h>
+#include <cppeditor/cppmodelmanager.h>
+
+#include <functional>
+
+namespace {
+
+constexpr int MaxSignatureLength = 200;
+
+using Visitor = std::function<void(CPlusPlus::Symbol *symbol, const QString &filePath)>;
+
+CPlusPlus::Symbol *unwrapTemplate(CPlusPlus::Symbol *symbol)
+{
+    if (CPlusPlus::Template *templ = symbol->asTemplate(); templ && templ->declaration())
+        return templ->declaration();
+    return symbol;
+}
+
+void visitScope(CPlusPlus::Scope *scope, const QString &filePath, const Visitor &visit)
+{
+    for (int i = 0; i < scope->memberCount(); ++i) {
+        CPlusPlus::Symbol *symbol = unwrapTemplate(scope->memberAt(i));
+        if (!symbol->name() || symbol->isGenerated())
+            continue;
+        visit(symbol, filePath);
+        if (symbol->asNamespace() || symbol->asClass())
+            visitScope(symbol->asScope(), filePath, visit);
+    }
+}
+
+// Visits the documents below the project directory, false when there are none.
+bool visitProject(const QString &projectPath, const Visitor &visit)
+{
+    const CPlusPlus::Snapshot snapshot = CppEditor::CppModelManager::snapshot();
+    bool found = false;
+    for (auto it = snapshot.begin(); it != snapshot.end(); ++it) {
+        const QString filePath = it.key().toString();
+        if (!filePath.startsWith(projectPath + '/') || !it.value())
+            continue;
+        found = true;
+        visitScope(it.value()->globalNamespace(), filePath, visit);
+    }
+    return found;
+}
+
+std::optional<SymbolIndex::Symbol> toSymbol(CPlusPlus::Symbol *symbol, const QString &filePath)
+{
+    CPlusPlus::Overview overview;
+    overview.showReturnTypes = true;
+    overview.showArgumentNames = true;
+
+    // Out-of-line definitions are named Foo::bar.
+    const CPlusPlus::Name *name = symbol->name();
+    if (const CPlusPlus::QualifiedNameId *qualified = name->asQualifiedNameId())
+        name = qualified->name();
+
+    SymbolIndex::Symbol result;
+    result.name = overview.prettyName(name);
+    result.filePath = filePath;
+    result.line = symbol->line();
+    result.isDefinition = true;
+    const QString qualifiedName = overview.prettyName(CPlusPlus::LookupContext::fullyQualifiedName(symbol));
+    if (qualifiedName.endsWith("::" + result.name))
+        result.scope = qualifiedName.chopped(result.name.size() + 2);
+
+    const bool inClass = symbol->enclosingScope() && symbol->enclosingScope()->asClass();
+    if (symbol->asNamespace()) {
+        result.kind = SymbolIndex::Namespace;
+    } else if (CPlusPlus::Class *klass = symbol->asClass()) {
+        result.kind = klass->isUnion() ? SymbolIndex::Union
+                      : klass->isStruct() ? SymbolIndex::Struct
+                                          : SymbolIndex::Class;
+        for (int i = 0; i < klass->baseClassCount(); ++i)
+            result.bases.append(overview.prettyName(klass->baseClassAt(i)->name()));
+        result.signature = SymbolIndex::kindName(result.kind) + ' ' + result.name;
+        if (!result.bases.isEmpty())
+            result.signature += " : " + result.bases.join(", ");
+    } else if (symbol->asEnum()) {
+        result.kind = SymbolIndex::Enum;
+    } else if (symbol->asFunction()) {
+        result.kind = inClass || symbol->name()->asQualifiedNameId() ? SymbolIndex::Method : SymbolIndex::Function;
+    } else if (symbol->asDeclaration()) {
+        if (symbol->isTypedef()) {
+            result.kind = SymbolIndex::Typedef;
+        } else if (symbol->type()->asFunctionType()) {
+            result.kind = inClass ? SymbolIndex::Method : SymbolIndex::Function;
+            result.isDefinition = false;
+        } else {
+            result.kind = inClass ? SymbolIndex::Field : SymbolIndex::Variable;
+            result.isDefinition = !symbol->isExtern();
+        }
+    } else {
+        return std::nullopt;
+    }
+
+    if (result.signature.isEmpty()) {
+        result.signature = symbol->asNamespace() || symbol->asEnum()
+                               ? SymbolIndex::kindName(result.kind) + ' ' + result.name
+                               : overview.prettyType(symbol->type(), symbol->name());
+    }
+    if (result.signature.size() > MaxSignatureLength)
+        result.signature = result.signature.left(MaxSignatureLength - 3) + "...";
+    return result;
+}
+
+bool matchesName(const SymbolIndex::Symbol &symbol, const QStringList &parts)
+{
+    if (symbol.name != parts.last())
+        return false;
+    const QString qualifiedName = parts.join("::");
+    return parts.size() == 1 || symbol.qualifiedName() == qualifiedName
+           || symbol.qualifiedName().endsWith("::" + qualifiedName);
+}
+
+} // namespace
+
+namespace CppModelSymbols {
+
+std::optional<QList<SymbolIndex::Symbol>> find(const QString &projectPath, const QString &name, int maxResults)
+{
+    const QStringList parts = name.trimmed().split(QLatin1StringView("::"), Qt::SkipEmptyParts);
+    if (projectPath.isEmpty() || parts.isEmpty())
+        return std::nullopt;
+
+    QList<SymbolIndex::Symbol> symbols;
+    const bool found = visitProject(projectPath, [&](CPlusPlus::Symbol *symbol, const QString &filePath) {
+        // Cheap identifier check before any pretty-printing.
+        const CPlusPlus::Identifier *identifier = symbol->identifier();
+        if (identifier && QLatin1StringView(identifier->chars(), identifier->size()) != parts.last())
+            return;
+        if (const auto result = toSymbol(symbol, filePath); result && matchesName(*result, parts))
+            symbols.append(*result);
+    });
+    if (!found)
+        return std::nullopt;
+
+    SymbolIndex::sortByRelevance(&symbols);
+    if (symbols.size() > maxResults)
+        symbols.resize(qMax(maxResults, 0));
+    return symbols;
+}
+
+std::optional<QList<SymbolIndex::Symbol>> classOutline(const QString &projectPath, const QString &className,
+                                                      SymbolIndex::Symbol *classSymbol)
+{
+    const QStringList parts = className.trimmed().split(QLatin1StringView("::"), Qt::SkipEmptyParts);
+    if (projectPath.isEmpty() || parts.isEmpty())
+        return std::nullopt;
+
+    CPlusPlus::Class *klass = nullptr;
+    SymbolIndex::Symbol found;
+    visitProject(projectPath, [&](CPlusPlus::Symbol *symbol, const QString &filePath) {
+        if (klass || !symbol->asClass())
+            return;
+        if (const auto result = toSymbol(symbol, filePath); result && matchesName(*result, parts)) {
+            klass = symbol->asClass();
+            found = *result;
+        }
+    });
+    if (!klass)
+        return std::nullopt;
+
+    QList<SymbolIndex::Symbol> members;
+    for (int i = 0; i < klass->memberCount(); ++i) {
+        CPlusPlus::Symbol *member = unwrapTemplate(klass->memberAt(i));
+        if (!member->name() || member->isGenerated())
+            continue;
+        if (const auto result = toSymbol(member, found.filePath))
+            members.append(*result);
+    }
+    if (classSymbol)
+        *classSymbol = found;
+    return members;
+}
+
+} // namespace CppModelSymbols
@@ -0,0 +1,23 @@
+#ifndef CPPMODELSYMBOLS_H
+#define CPPMODELSYMBOLS_H
+
+#include "symbolindex.h"
+
+#include <optional>
+
+// Symbol lookups in Qt Creator's C++ code model, which the IDE keeps parsed and
+// up to date for the open project. The symbol tools prefer it over SymbolIndex.
+// Only built when the CppEditor plugin is available (QLP_WITH_CPPEDITOR).
+namespace CppModelSymbols {
+
+// Symbols in the project's documents, ranked like SymbolIndex::find(), or
+// nullopt while the code model has no documents for the project.
+std::optional<QList<SymbolIndex::Symbol>> find(const QString &projectPath, const QString &name, int maxResults);
+
+// Like SymbolIndex::classOutline(), nullopt when the code model does not know the class.
+std::optional<QList<SymbolIndex::Symbol>> classOutline(const QString &projectPath, const QString &className,
+                                                      SymbolIndex::Symbol *classSymbol);
+
+} // namespace CppModelSymbols
+
+#endif // CPPMODELSYMBOLS_H
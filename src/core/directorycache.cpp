@@ -0,0 +1,100 @@
+#include "directorycache.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+namespace {
+
+// The listings of unwatched directories would go stale, they are not kept.
+constexpr int MaxWatchedDirectories = 4000;
+
+} // namespace
+
+DirectoryCache::DirectoryCache(QObject *parent)
+    : QObject(parent)
+{
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &DirectoryCache::directoryChanged);
+}
+
+DirectoryCache::Listing DirectoryCache::entries(const QString &directory)
+{
+    const QString path = QDir::cleanPath(QDir(directory).absolutePath());
+    {
+        QReadLocker locker(&m_lock);
+        if (const Listing listing = m_listings.value(path)) {
+            ++m_hits;
+            return listing;
+        }
+    }
+    ++m_misses;
+
+    const QDir dir(path);
+    if (!dir.exists())
+        return nullptr;
+    const qint64 listedAt = QDateTime::currentMSecsSinceEpoch();
+    auto entries = std::make_shared<QList<Entry>>();
+    const QFileInfoList infos = dir.entryInfoList(QDir::NoDotAndDotDot | QDir::AllEntries | QDir::Hidden,
+                                                  QDir::Name);
+    entries->reserve(infos.size());
+    for (const QFileInfo &info : infos) {
+        entries->append(Entry{info.fileName(), info.isDir(), info.isDir() ? 0 : info.size(),
+                              info.lastModified().toMSecsSinceEpoch()});
+    }
+
+    Listing listing = std::move(entries);
+    {
+        QWriteLocker locker(&m_lock);
+        m_listings.insert(path, listing);
+    }
+    watch(path, listedAt);
+    return listing;
+}
+
+void DirectoryCache::watch(const QString &directory, qint64 listedAt)
+{
+    QMetaObject::invokeMethod(this, [this, directory, listedAt]() {
+        if (m_watcher.directories().contains(directory))
+            return;
+        // A change after the listing but before the watch would go unnoticed.
+        if (m_watcher.directories().size() >= MaxWatchedDirectories || !m_watcher.addPath(directory)
+            || QFileInfo(directory).lastModified().toMSecsSinceEpoch() > listedAt) {
+            QWriteLocker locker(&m_lock);
+            m_listings.remove(directory);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void DirectoryCache::directoryChanged(const QString &directory)
+{
+    QWriteLocker locker(&m_lock);
+    m_listings.remove(QDir::cleanPath(directory));
+}
+
+void DirectoryCache::invalidate(const QStringList &paths)
+{
+    QWriteLocker locker(&m_lock);
+    for (const QString &filePath : paths) {
+        const QString path = QDir::cleanPath(QFileInfo(filePath).absoluteFilePath());
+        m_listings.remove(path);
+        m_listings.remove(QFileInfo(path).absolutePath());
+    }
+}
+
+void DirectoryCache::clear()
+{
+    {
+        QWriteLocker locker(&m_lock);
+        m_listings.clear();
+    }
+    QMetaObject::invokeMethod(this, [this]() {
+        if (!m_watcher.directories().isEmpty())
+            m_watcher.removePaths(m_watcher.directories());
+    }, Qt::QueuedConnection);
+}
+
+qsizetype DirectoryCache::size() const
+{
+    QReadLocker locker(&m_lock);
+    return m_listings.size();
+}
@@ -0,0 +1,63 @@
+#ifndef DIRECTORYCACHE_H
+#define DIRECTORYCACHE_H
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <memory>
+
+// Listings of directories for list_directory, kept until a QFileSystemWatcher
+// reports a change in the directory or invalidate() is called, so walking a
+// tree again costs no disk access.
+//
+// Sizes and times are those of the listing: a file edited in place does not
+// change its directory, only writes reported through invalidate() refresh it.
+// Thread-safe. The watcher lives on the thread that created the cache.
+class DirectoryCache : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry {
+        QString name;
+        bool isDirectory = false;
+        qint64 size = 0;
+        qint64 modified = 0;   // Milliseconds since the epoch.
+    };
+    using Listing = std::shared_ptr<const QList<Entry>>;
+
+    struct Stats {
+        qint64 hits = 0;
+        qint64 misses = 0;
+    };
+
+    explicit DirectoryCache(QObject *parent = nullptr);
+
+    // The entries of a directory, hidden ones included, sorted by name.
+    // nullptr when it does not exist.
+    Listing entries(const QString &directory);
+
+    // Drops the listings of the given files or directories and of their parents.
+    void invalidate(const QStringList &paths);
+    void clear();
+
+    Stats stats() const { return Stats{m_hits.load(), m_misses.load()}; }
+    qsizetype size() const;
+
+private:
+    void watch(const QString &directory, qint64 listedAt);
+    void directoryChanged(const QString &directory);
+
+    mutable QReadWriteLock m_lock;
+    QHash<QString, Listing> m_listings;   // By cleaned absolute path.
+    QFileSystemWatcher m_watcher;
+    std::atomic<qint64> m_hits = 0;
+    std::atomic<qint64> m_misses = 0;
+};
+
+#endif // DIRECTORYCACHE_H
@@ -0,0 +1,127 @@
+#include "filecontentcache.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+
+namespace {
+
+// The entries of unwatched files could miss a change, they are not kept.
+constexpr int MaxWatchedFiles = 2000;
+
+} // namespace
+
+FileContentCache &FileContentCache::instance()
+{
+    // Never destroyed, tools may still read while the plugin shuts down.
+    static FileContentCache *cache = [] {
+        auto cache = new FileContentCache;
+        if (auto application = QCoreApplication::instance(); application && application->thread() != cache->thread())
+            cache->moveToThread(application->thread());
+        return cache;
+    }();
+    return *cache;
+}
+
+FileContentCache::FileContentCache(qint64 maxBytes, QObject *parent)
+    : QObject(parent)
+    , m_maxBytes(maxBytes)
+    , m_entries(maxBytes)
+{
+}
+
+bool FileContentCache::read(const QString &filePath, QByteArray *content)
+{
+    const QFileInfo info(filePath);
+    if (!info.isFile() || info.size() > maxFileBytes())
+        return false;
+    const QString path = QDir::cleanPath(info.absoluteFilePath());
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    const qint64 size = info.size();
+    {
+        QMutexLocker locker(&m_mutex);
+        if (const Entry *entry = m_entries.object(path); entry && entry->modified == modified && entry->size == size) {
+            ++m_hits;
+            *content = entry->data;
+            return true;
+        }
+    }
+    ++m_misses;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    *content = file.readAll();
+    if (content->size() != size)
+        return true;   // Changed while it was read, the next read sees it settled.
+
+    {
+        QMutexLocker locker(&m_mutex);
+        const qsizetype count = m_entries.count() + (m_entries.contains(path) ? 0 : 1);
+        m_entries.insert(path, new Entry{*content, modified, size}, qMax<qsizetype>(content->size(), 1));
+        m_evictions += count - m_entries.count();
+    }
+    watch(path, modified);
+    return true;
+}
+
+void FileContentCache::watch(const QString &path, qint64 modified)
+{
+    QMetaObject::invokeMethod(this, [this, path, modified]() {
+        if (!m_watcher) {
+            m_watcher = new QFileSystemWatcher(this);
+            connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &FileContentCache::fileChanged);
+        }
+        QStringList files = m_watcher->files();
+        if (files.contains(path))
+            return;
+        if (files.size() >= MaxWatchedFiles) {
+            // Make room by no longer watching files that were evicted.
+            QStringList evicted;
+            {
+                QMutexLocker locker(&m_mutex);
+                for (const QString &file : std::as_const(files)) {
+                    if (!m_entries.contains(file))
+                        evicted.append(file);
+                }
+            }
+            if (!evicted.isEmpty())
+                m_watcher->removePaths(evicted);
+            files = m_watcher->files();
+        }
+        // A change after the read but before the watch would go unnoticed.
+        if (files.size() >= MaxWatchedFiles || !m_watcher->addPath(path)
+            || QFileInfo(path).lastModified().toMSecsSinceEpoch() != modified) {
+            QMutexLocker locker(&m_mutex);
+            m_entries.remove(path);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void FileContentCache::fileChanged(const QString &path)
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.remove(QDir::cleanPath(path));
+}
+
+void FileContentCache::invalidate(const QStringList &paths)
+{
+    QMutexLocker locker(&m_mutex);
+    for (const QString &path : paths)
+        m_entries.remove(QDir::cleanPath(QFileInfo(path).absoluteFilePath()));
+}
+
+void FileContentCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+}
+
+FileContentCache::Stats FileContentCache::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return Stats{m_hits.load(), m_misses.load(), m_evictions.load(), m_entries.totalCost(), m_entries.count()};
+}
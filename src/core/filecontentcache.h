@@ -0,0 +1,70 @@
+#ifndef FILECONTENTCACHE_H
+#define FILECONTENTCACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QFileSystemWatcher>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+// The bytes of recently read files, shared by every reader in the process. An
+// entry is used while the file has the modification time and size it was read
+// with, and dropped when a QFileSystemWatcher reports a change or invalidate()
+// is called. The least recently used files go first once the cache holds more
+// than maxBytes.
+//
+// Thread-safe. The watcher lives on the thread of the cache, the GUI thread for
+// instance().
+class FileContentCache : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats {
+        qint64 hits = 0;
+        qint64 misses = 0;
+        qint64 evictions = 0;
+        qint64 bytes = 0;
+        qsizetype files = 0;
+    };
+
+    static constexpr qint64 DefaultMaxBytes = 64 * 1024 * 1024;
+
+    static FileContentCache &instance();
+
+    explicit FileContentCache(qint64 maxBytes = DefaultMaxBytes, QObject *parent = nullptr);
+
+    // false when the file cannot be read or is larger than maxFileBytes(), which
+    // callers read on their own rather than push everything else out.
+    bool read(const QString &filePath, QByteArray *content);
+    qint64 maxFileBytes() const { return m_maxBytes / 8; }
+
+    // Drops the given files.
+    void invalidate(const QStringList &paths);
+    void clear();
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        QByteArray data;
+        qint64 modified = 0;   // Milliseconds since the epoch.
+        qint64 size = 0;
+    };
+
+    void watch(const QString &path, qint64 modified);
+    void fileChanged(const QString &path);
+
+    const qint64 m_maxBytes;
+    mutable QMutex m_mutex;
+    QCache<QString, Entry> m_entries;   // By cleaned absolute path, costs in bytes.
+    QFileSystemWatcher *m_watcher = nullptr;   // Created on first use, on the cache's thread.
+    std::atomic<qint64> m_hits = 0;
+    std::atomic<qint64> m_misses = 0;
+    std::atomic<qint64> m_evictions = 0;
+};
+
+#endif // FILECONTENTCACHE_H
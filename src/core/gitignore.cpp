@@ -0,0 +1,222 @@
+#include "gitignore.h"
+
+#include <QFile>
+
+namespace {
+
+// Matches a '[...]' class starting at p[0] == '['. Returns the length of the class
+// in the pattern, or 0 when it is not closed and '[' is a literal.
+qsizetype matchClass(QStringView p, QChar c, bool *matched)
+{
+    qsizetype i = 1;
+    const bool negated = i < p.size() && (p[i] == u'!' || p[i] == u'^');
+    if (negated)
+        ++i;
+    bool found = false;
+    bool first = true;
+    for (; i < p.size(); ++i) {
+        if (p[i] == u']' && !first) {
+            *matched = found != negated;
+            return i + 1;
+        }
+        first = false;
+        QChar from = p[i];
+        if (from == u'\\' && i + 1 < p.size())
+            from = p[++i];
+        if (i + 2 < p.size() && p[i + 1] == u'-' && p[i + 2] != u']') {
+            const QChar to = p[i + 2];
+            found = found || (c >= from && c <= to);
+            i += 2;
+        } else {
+            found = found || c == from;
+        }
+    }
+    return 0;
+}
+
+bool globMatchAt(QStringView p, QStringView t)
+{
+    while (!p.isEmpty()) {
+        const QChar pc = p.front();
+        if (pc == u'*') {
+            if (p.size() > 1 && p[1] == u'*') {
+                p = p.sliced(2);
+                if (p.isEmpty())
+                    return true;
+                // "**/" matches zero or more whole directories.
+                if (p.front() == u'/') {
+                    p = p.sliced(1);
+                    if (globMatchAt(p, t))
+                        return true;
+                    for (qsizetype i = 0; i < t.size(); ++i) {
+                        if (t[i] == u'/' && globMatchAt(p, t.sliced(i + 1)))
+                            return true;
+                    }
+                    return false;
+                }
+                for (qsizetype i = 0; i <= t.size(); ++i) {
+                    if (globMatchAt(p, t.sliced(i)))
+                        return true;
+                }
+                return false;
+            }
+            // A single '*' stops at directory separators.
+            p = p.sliced(1);
+            for (qsizetype i = 0; i <= t.size(); ++i) {
+                if (globMatchAt(p, t.sliced(i)))
+                    return true;
+                if (i < t.size() && t[i] == u'/')
+                    return false;
+            }
+            return false;
+        }
+
+        if (t.isEmpty())
+            return false;
+
+        if (pc == u'?') {
+            if (t.front() == u'/')
+                return false;
+            p = p.sliced(1);
+        } else if (pc == u'[') {
+            bool matched = false;
+            const qsizetype length = matchClass(p, t.front(), &matched);
+            if (length == 0) {
+                if (t.front() != u'[')
+                    return false;
+                p = p.sliced(1);
+            } else {
+                if (!matched || t.front() == u'/')
+                    return false;
+                p = p.sliced(length);
+            }
+        } else {
+            QChar literal = pc;
+            if (pc == u'\\' && p.size() > 1) {
+                literal = p[1];
+                p = p.sliced(1);
+            }
+            if (literal != t.front())
+                return false;
+            p = p.sliced(1);
+        }
+        t = t.sliced(1);
+    }
+    return t.isEmpty();
+}
+
+} // namespace
+
+GitIgnore::GitIgnore(std::shared_ptr<const GitIgnore> parent, const QString &baseDir)
+    : m_parent(std::move(parent)), m_baseDir(baseDir)
+{
+}
+
+void GitIgnore::addPatterns(const QByteArray &content)
+{
+    for (const QByteArray &rawLine : content.split('\n')) {
+        QString line = QString::fromUtf8(rawLine);
+        if (line.endsWith(u'\r'))
+            line.chop(1);
+        // Trailing spaces are ignored unless escaped.
+        while (line.endsWith(u' ') && !line.endsWith(QStringLiteral("\\ ")))
+            line.chop(1);
+        if (line.isEmpty() || line.startsWith(u'#'))
+            continue;
+
+        Rule rule;
+        if (line.startsWith(u'!')) {
+            rule.negated = true;
+            line.remove(0, 1);
+        } else if (line.startsWith(QStringLiteral("\\!")) || line.startsWith(QStringLiteral("\\#"))) {
+            line.remove(0, 1);
+        }
+        if (line.endsWith(u'/')) {
+            rule.directoryOnly = true;
+            line.chop(1);
+        }
+        rule.anchored = line.contains(u'/');
+        if (line.startsWith(u'/'))
+            line.remove(0, 1);
+        if (line.isEmpty())
+            continue;
+        rule.pattern = line;
+        m_rules.append(rule);
+    }
+}
+
+std::shared_ptr<const GitIgnore> GitIgnore::forDirectory(const std::shared_ptr<const GitIgnore> &parent,
+                                                         const QString &directory,
+                                                         const QString &relativeDir)
+{
+    QFile file(directory + "/.gitignore");
+    if (!file.open(QIODevice::ReadOnly))
+        return parent;
+
+    auto ignore = std::make_shared<GitIgnore>(parent, relativeDir);
+    ignore->addPatterns(file.readAll());
+    if (ignore->isEmpty())
+        return parent;
+    return ignore;
+}
+
+std::shared_ptr<const GitIgnore> GitIgnore::repositoryExcludes(const QString &rootPath)
+{
+    QFile file(rootPath + "/.git/info/exclude");
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    auto excludes = std::make_shared<GitIgnore>();
+    excludes->addPatterns(file.readAll());
+    if (excludes->isEmpty())
+        return nullptr;
+    return excludes;
+}
+
+std::shared_ptr<const GitIgnore> GitIgnore::forTree(const QString &rootPath, const QString &relativeDir)
+{
+    auto ignore = forDirectory(repositoryExcludes(rootPath), rootPath, QString());
+    QString relative;
+    for (const QString &part : relativeDir.split(u'/', Qt::SkipEmptyParts)) {
+        relative = relative.isEmpty() ? part : relative + '/' + part;
+        ignore = forDirectory(ignore, rootPath + '/' + relative, relative);
+    }
+    return ignore;
+}
+
+bool GitIgnore::isIgnored(const QString &relativePath, bool isDirectory) const
+{
+    // Deeper files take precedence, the last matching rule of a file wins.
+    for (const GitIgnore *ignore = this; ignore; ignore = ignore->m_parent.get()) {
+        const int result = ignore->match(relativePath, isDirectory);
+        if (result >= 0)
+            return result == 1;
+    }
+    return false;
+}
+
+bool GitIgnore::globMatch(QStringView pattern, QStringView text)
+{
+    return globMatchAt(pattern, text);
+}
+
+int GitIgnore::match(const QString &relativePath, bool isDirectory) const
+{
+    QStringView path(relativePath);
+    if (!m_baseDir.isEmpty()) {
+        if (!path.startsWith(m_baseDir) || path.size() <= m_baseDir.size() || path[m_baseDir.size()] != u'/')
+            return -1;
+        path = path.sliced(m_baseDir.size() + 1);
+    }
+    const qsizetype slash = path.lastIndexOf(u'/');
+    const QStringView fileName = slash < 0 ? path : path.sliced(slash + 1);
+
+    for (qsizetype i = m_rules.size() - 1; i >= 0; --i) {
+        const Rule &rule = m_rules[i];
+        if (rule.directoryOnly && !isDirectory)
+            continue;
+        if (globMatchAt(rule.pattern, rule.anchored ? path : fileName))
+            return rule.negated ? 0 : 1;
+    }
+    return -1;
+}
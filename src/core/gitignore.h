@@ -0,0 +1,55 @@
+#ifndef GITIGNORE_H
+#define GITIGNORE_H
+
+#include <QList>
+#include <QString>
+
+#include <memory>
+
+// Patterns of one .gitignore file, chained to the files of the parent directories.
+// Supports the gitignore syntax: negation with '!', directory-only patterns with a
+// trailing '/', anchoring by a '/' anywhere but at the end, and the '*', '?', '[...]'
+// and '**' wildcards. Immutable once built, so it can be shared between threads.
+class GitIgnore
+{
+public:
+    GitIgnore() = default;
+    // baseDir is the directory of the .gitignore file, relative to the walk root
+    // ("" for the root itself).
+    GitIgnore(std::shared_ptr<const GitIgnore> parent, const QString &baseDir);
+
+    void addPatterns(const QByteArray &content);
+    // Reads <directory>/.gitignore and returns a matcher for that directory, or
+    // parent itself when there is no such file.
+    static std::shared_ptr<const GitIgnore> forDirectory(const std::shared_ptr<const GitIgnore> &parent,
+                                                         const QString &directory,
+                                                         const QString &relativeDir);
+    // The repository's .git/info/exclude, nullptr when there is none.
+    static std::shared_ptr<const GitIgnore> repositoryExcludes(const QString &rootPath);
+    // Everything that applies inside relativeDir: the excludes and the .gitignore
+    // files of the root and of every directory down to relativeDir.
+    static std::shared_ptr<const GitIgnore> forTree(const QString &rootPath, const QString &relativeDir);
+
+    // relativePath is relative to the walk root, with '/' separators.
+    bool isIgnored(const QString &relativePath, bool isDirectory) const;
+    bool isEmpty() const { return m_rules.isEmpty(); }
+
+    static bool globMatch(QStringView pattern, QStringView text);
+
+private:
+    struct Rule {
+        QString pattern;
+        bool negated = false;
+        bool directoryOnly = false;
+        bool anchored = false;
+    };
+
+    // 1 ignored, 0 re-included, -1 no rule of this file matches.
+    int match(const QString &relativePath, bool isDirectory) const;
+
+    std::shared_ptr<const GitIgnore> m_parent;
+    QString m_baseDir;
+    QList<Rule> m_rules;
+};
+
+#endif // GITIGNORE_H
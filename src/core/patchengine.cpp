@@ -0,0 +1,387 @@
+#include "patchengine.h"
+
+#include <QRegularExpression>
+
+namespace {
+
+constexpr int MaxQuotedLength = 120;
+constexpr int MaxReportedLines = 5;
+
+QStringList splitLines(const QString &text, bool *trailingNewline = nullptr)
+{
+    if (text.isEmpty()) {
+        if (trailingNewline)
+            *trailingNewline = false;
+        return {};
+    }
+    QStringList lines = text.split('\n');
+    const bool trailing = lines.last().isEmpty();
+    if (trailing)
+        lines.removeLast();
+    if (trailingNewline)
+        *trailingNewline = trailing;
+    return lines;
+}
+
+QString joinLines(const QStringList &lines, bool trailingNewline)
+{
+    QString text = lines.join('\n');
+    if (trailingNewline && !lines.isEmpty())
+        text += '\n';
+    return text;
+}
+
+QString quoted(const QString &line)
+{
+    QString text = line.trimmed();
+    if (text.size() > MaxQuotedLength)
+        text = text.left(MaxQuotedLength) + "...";
+    return '"' + text + '"';
+}
+
+QString leadingWhitespace(const QString &line)
+{
+    qsizetype i = 0;
+    while (i < line.size() && (line[i] == ' ' || line[i] == '\t'))
+        ++i;
+    return line.left(i);
+}
+
+// 1-based numbers of the lines where text occurs, at most MaxReportedLines of them.
+QString lineNumbers(const QString &content, const QString &text)
+{
+    QStringList numbers;
+    for (qsizetype at = content.indexOf(text); at >= 0 && numbers.size() < MaxReportedLines;
+         at = content.indexOf(text, at + 1))
+        numbers.append(QString::number(content.left(at).count('\n') + 1));
+    return numbers.join(", ");
+}
+
+} // namespace
+
+bool PatchEngine::linesEqual(const QString &a, const QString &b, Match match)
+{
+    switch (match) {
+    case Match::Exact:
+        return a == b;
+    case Match::TrailingWhitespace: {
+        QStringView left(a), right(b);
+        while (!left.isEmpty() && left.back().isSpace())
+            left.chop(1);
+        while (!right.isEmpty() && right.back().isSpace())
+            right.chop(1);
+        return left == right;
+    }
+    case Match::Indentation:
+        return QStringView(a).trimmed() == QStringView(b).trimmed();
+    }
+    return false;
+}
+
+int PatchEngine::findLines(const QStringList &text, const QStringList &lines, int from, int preferred,
+                           Match match, int *count)
+{
+    int best = -1;
+    int found = 0;
+    if (!lines.isEmpty()) {
+        for (int start = qMax(from, 0); start + lines.size() <= text.size(); ++start) {
+            if (!linesEqual(text[start], lines[0], match))
+                continue;
+            bool equal = true;
+            for (qsizetype i = 1; i < lines.size() && equal; ++i)
+                equal = linesEqual(text[start + i], lines[i], match);
+            if (!equal)
+                continue;
+            ++found;
+            if (best < 0 || qAbs(start - preferred) < qAbs(best - preferred))
+                best = start;
+        }
+    }
+    if (count)
+        *count = found;
+    return best;
+}
+
+QString PatchEngine::describeClosest(const QStringList &text, const QStringList &lines)
+{
+    // The position where most lines agree, ignoring whitespace.
+    int bestStart = -1;
+    int bestEqual = 0;
+    for (int start = 0; start < text.size(); ++start) {
+        int equal = 0;
+        for (qsizetype i = 0; i < lines.size() && start + i < text.size(); ++i)
+            equal += linesEqual(text[start + i], lines[i], Match::Indentation);
+        if (equal > bestEqual) {
+            bestEqual = equal;
+            bestStart = start;
+        }
+    }
+    if (bestStart < 0 || (bestEqual == 1 && lines.size() > 2))
+        return "None of its lines occur in the file, read the file again.";
+
+    QString description = QString("The closest match is at lines %1-%2, where %3 of %4 lines are equal.")
+                              .arg(bestStart + 1)
+                              .arg(qMin(bestStart + lines.size(), text.size()))
+                              .arg(bestEqual)
+                              .arg(lines.size());
+    for (qsizetype i = 0; i < lines.size(); ++i) {
+        if (bestStart + i >= text.size()) {
+            description += QString(" The file ends before %1.").arg(quoted(lines[i]));
+            break;
+        }
+        if (!linesEqual(text[bestStart + i], lines[i], Match::Indentation)) {
+            description += QString(" Line %1 is %2, not %3.")
+                               .arg(bestStart + i + 1)
+                               .arg(quoted(text[bestStart + i]), quoted(lines[i]));
+            break;
+        }
+    }
+    return description;
+}
+
+QStringList PatchEngine::reindent(const QStringList &lines, const QStringList &searched, const QStringList &found)
+{
+    // The indentation of the first non-blank line tells how far off the edit was.
+    for (qsizetype i = 0; i < searched.size() && i < found.size(); ++i) {
+        if (searched[i].trimmed().isEmpty())
+            continue;
+        const QString from = leadingWhitespace(searched[i]);
+        const QString to = leadingWhitespace(found[i]);
+        QStringList result;
+        for (const QString &line : lines) {
+            if (line.trimmed().isEmpty() || !line.startsWith(from))
+                result.append(line);
+            else
+                result.append(to + line.mid(from.size()));
+        }
+        return result;
+    }
+    return lines;
+}
+
+PatchEngine::Result PatchEngine::applyEdits(const QString &content, const QList<Edit> &edits)
+{
+    Result result;
+    QString text = content;
+    for (qsizetype e = 0; e < edits.size(); ++e) {
+        const Edit &edit = edits[e];
+        const int number = int(e) + 1;
+        if (edit.search.isEmpty()) {
+            if (!text.isEmpty()) {
+                result.errorString = QString("Edit %1: the search text is empty, quote the lines to replace.").arg(number);
+                return result;
+            }
+            text = edit.replace;
+            ++result.applied;
+            continue;
+        }
+
+        const qsizetype first = text.indexOf(edit.search);
+        if (first >= 0) {
+            if (text.indexOf(edit.search, first + 1) >= 0) {
+                result.errorString = QString("Edit %1: the search text occurs %2 times, at lines %3. "
+                                             "Add surrounding lines to make it unique.")
+                                         .arg(number)
+                                         .arg(text.count(edit.search))
+                                         .arg(lineNumbers(text, edit.search));
+                return result;
+            }
+            text.replace(first, edit.search.size(), edit.replace);
+            ++result.applied;
+            continue;
+        }
+
+        // Line by line, with less and less attention to whitespace.
+        bool trailingNewline = false;
+        QStringList lines = splitLines(text, &trailingNewline);
+        const QStringList searched = splitLines(edit.search);
+        bool applied = false;
+        for (const Match match : {Match::TrailingWhitespace, Match::Indentation}) {
+            int count = 0;
+            const int start = findLines(lines, searched, 0, 0, match, &count);
+            if (count > 1) {
+                result.errorString = QString("Edit %1: the search text matches %2 places when whitespace is "
+                                             "ignored. Add surrounding lines to make it unique.")
+                                         .arg(number)
+                                         .arg(count);
+                return result;
+            }
+            if (start < 0)
+                continue;
+
+            QStringList replacement = splitLines(edit.replace);
+            if (match == Match::Indentation)
+                replacement = reindent(replacement, searched, lines.mid(start, searched.size()));
+            result.notes.append(QString("Edit %1 matched lines %2-%3 ignoring %4")
+                                    .arg(number)
+                                    .arg(start + 1)
+                                    .arg(start + searched.size())
+                                    .arg(match == Match::Indentation ? "indentation" : "trailing whitespace"));
+            lines = lines.mid(0, start) + replacement + lines.mid(start + searched.size());
+            text = joinLines(lines, trailingNewline);
+            applied = true;
+            break;
+        }
+        if (!applied) {
+            result.errorString = QString("Edit %1: the search text was not found. %2")
+                                     .arg(number)
+                                     .arg(describeClosest(lines, searched));
+            return result;
+        }
+        ++result.applied;
+    }
+    result.success = true;
+    result.content = text;
+    return result;
+}
+
+bool PatchEngine::parseUnifiedDiff(const QString &diff, QList<Hunk> *hunks, QString *errorString)
+{
+    static const QRegularExpression header(R"(^@@ -(\d+)(?:,(\d+))? \+(\d+)(?:,(\d+))? @@)");
+    const QStringList lines = splitLines(diff);
+    QString kinds;   // Of the lines of the current hunk: ' ', '-' or '+'.
+    const auto finishHunk = [&]() {
+        if (hunks->isEmpty())
+            return;
+        Hunk &hunk = hunks->last();
+        const qsizetype firstChange = kinds.indexOf(QRegularExpression("[-+]"));
+        const qsizetype lastChange = kinds.lastIndexOf(QRegularExpression("[-+]"));
+        hunk.context[0] = firstChange < 0 ? int(kinds.size()) : int(firstChange);
+        hunk.context[1] = firstChange < 0 ? 0 : int(kinds.size() - 1 - lastChange);
+        kinds.clear();
+    };
+
+    for (qsizetype i = 0; i < lines.size(); ++i) {
+        QString line = lines[i];
+        if (line.endsWith('\r'))
+            line.chop(1);
+        if (line.startsWith("@@")) {
+            finishHunk();
+            Hunk hunk;
+            const QRegularExpressionMatch match = header.match(line);
+            if (match.hasMatch())
+                hunk.oldStart = match.captured(1).toInt();
+            hunks->append(hunk);
+            continue;
+        }
+        if (hunks->isEmpty() || (line.startsWith("--- ") && i + 1 < lines.size() && lines[i + 1].startsWith("+++ "))) {
+            // Headers before the first hunk, like "diff --git", "---" and "+++".
+            if (!hunks->isEmpty()) {
+                *errorString = "The diff changes more than one file, pass one file per call.";
+                return false;
+            }
+            continue;
+        }
+
+        Hunk &hunk = hunks->last();
+        const QChar kind = line.isEmpty() ? QChar(' ') : line[0];   // Blank context lines often lose their space.
+        const QString text = line.mid(1);
+        if (kind == ' ') {
+            hunk.oldLines.append(text);
+            hunk.newLines.append(text);
+        } else if (kind == '-') {
+            hunk.oldLines.append(text);
+        } else if (kind == '+') {
+            hunk.newLines.append(text);
+        } else if (kind == '\\') {
+            continue;   // "\ No newline at end of file"
+        } else {
+            *errorString = QString("Line %1 of the diff is not part of a hunk: %2").arg(i + 1).arg(quoted(line));
+            return false;
+        }
+        kinds.append(kind);
+    }
+    finishHunk();
+    if (hunks->isEmpty()) {
+        *errorString = "The diff has no hunks, they start with a line like \"@@ -10,4 +10,5 @@\".";
+        return false;
+    }
+    return true;
+}
+
+PatchEngine::Result PatchEngine::applyUnifiedDiff(const QString &content, const QString &diff)
+{
+    Result result;
+    QList<Hunk> hunks;
+    if (!parseUnifiedDiff(diff, &hunks, &result.errorString))
+        return result;
+
+    bool trailingNewline = false;
+    QStringList lines = splitLines(content, &trailingNewline);
+    if (lines.isEmpty())
+        trailingNewline = true;
+    int offset = 0;   // Where the file is now, against the line numbers of the diff.
+    int from = 0;     // Hunks apply in order, after the previous one.
+    for (qsizetype h = 0; h < hunks.size(); ++h) {
+        const Hunk &hunk = hunks[h];
+        const int number = int(h) + 1;
+        if (hunk.oldLines.isEmpty()) {
+            // A pure insertion: the line number is all there is to go by.
+            const int at = hunk.oldStart >= 0 ? qBound(from, hunk.oldStart + offset, int(lines.size())) : from;
+            lines = lines.mid(0, at) + hunk.newLines + lines.mid(at);
+            offset += hunk.newLines.size();
+            from = at + int(hunk.newLines.size());
+            ++result.applied;
+            continue;
+        }
+
+        const int preferred = hunk.oldStart > 0 ? hunk.oldStart - 1 + offset : from;
+        bool applied = false;
+        for (int fuzz = 0; fuzz <= MaxFuzz && !applied; ++fuzz) {
+            const int front = qMin(fuzz, hunk.context[0]);
+            const int back = qMin(fuzz, hunk.context[1]);
+            if (fuzz > 0 && front < fuzz && back < fuzz)
+                break;   // No context left to drop.
+            if (front + back >= hunk.oldLines.size())
+                break;
+            const QStringList oldLines = hunk.oldLines.mid(front, hunk.oldLines.size() - front - back);
+            QStringList newLines = hunk.newLines.mid(front, hunk.newLines.size() - front - back);
+
+            for (const Match match : {Match::Exact, Match::TrailingWhitespace, Match::Indentation}) {
+                int count = 0;
+                const int start = findLines(lines, oldLines, from, preferred + front, match, &count);
+                if (start < 0)
+                    continue;
+                if (hunk.oldStart < 0 && count > 1) {
+                    result.errorString = QString("Hunk %1 has no line numbers and matches %2 places. "
+                                                 "Give its header line numbers or more context.")
+                                             .arg(number)
+                                             .arg(count);
+                    return result;
+                }
+                if (match == Match::Indentation)
+                    newLines = reindent(newLines, oldLines, lines.mid(start, oldLines.size()));
+
+                QStringList how;
+                if (hunk.oldStart > 0 && start != preferred + front)
+                    how.append(QString("offset %1 lines").arg(start - preferred - front));
+                if (fuzz > 0)
+                    how.append(QString("fuzz %1").arg(fuzz));
+                if (match != Match::Exact)
+                    how.append(match == Match::Indentation ? "ignoring indentation" : "ignoring trailing whitespace");
+                if (!how.isEmpty())
+                    result.notes.append(QString("Hunk %1 applied at line %2 (%3)").arg(number).arg(start + 1).arg(how.join(", ")));
+
+                lines = lines.mid(0, start) + newLines + lines.mid(start + oldLines.size());
+                if (hunk.oldStart > 0)
+                    offset = start - front - (hunk.oldStart - 1);
+                offset += int(newLines.size() - oldLines.size());
+                from = start + int(newLines.size());
+                applied = true;
+                break;
+            }
+        }
+        if (!applied) {
+            result.errorString = QString("Hunk %1%2 does not apply. %3")
+                                     .arg(number)
+                                     .arg(hunk.oldStart > 0 ? QString(" (at line %1)").arg(hunk.oldStart) : QString())
+                                     .arg(describeClosest(lines, hunk.oldLines));
+            return result;
+        }
+        ++result.applied;
+    }
+
+    result.success = true;
+    result.content = joinLines(lines, trailingNewline);
+    return result;
+}
@@ -0,0 +1,64 @@
+#ifndef PATCHENGINE_H
+#define PATCHENGINE_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// Applies the edits of the edit_file tool to the text of a file: search/replace
+// blocks or a unified diff.
+//
+// A block is looked up as exact text first, then line by line ignoring trailing
+// whitespace, then ignoring indentation, in which case the replacement is
+// re-indented like the file. Hunks of a diff are looked up at the line they
+// name, then at the closest other position, with the same whitespace
+// tolerance and up to MaxFuzz context lines dropped from either end, like
+// patch's fuzz factor. "\ No newline at end of file" markers are ignored, the
+// file keeps its final newline. Either everything applies or nothing does, and
+// a failure says which edit failed, where the closest match was and which line
+// differed.
+class PatchEngine
+{
+public:
+    struct Edit {
+        QString search;
+        QString replace;
+    };
+
+    struct Result {
+        bool success = false;
+        QString content;
+        int applied = 0;
+        // How edits that did not match exactly were placed, one line each.
+        QStringList notes;
+        QString errorString;
+    };
+
+    static constexpr int MaxFuzz = 2;
+
+    static Result applyEdits(const QString &content, const QList<Edit> &edits);
+    static Result applyUnifiedDiff(const QString &content, const QString &diff);
+
+private:
+    struct Hunk {
+        // 1-based, -1 when the header had no line numbers. For insertions the
+        // line after which the new lines go.
+        int oldStart = -1;
+        QStringList oldLines;
+        QStringList newLines;
+        int context[2] = {0, 0};   // Context lines before and after the change.
+    };
+
+    enum class Match { Exact, TrailingWhitespace, Indentation };
+
+    static bool parseUnifiedDiff(const QString &diff, QList<Hunk> *hunks, QString *errorString);
+    static bool linesEqual(const QString &a, const QString &b, Match match);
+    // Where lines occur in text at or after from, closest to the preferred
+    // position, or -1. count gets the number of places.
+    static int findLines(const QStringList &text, const QStringList &lines, int from, int preferred, Match match,
+                         int *count = nullptr);
+    static QString describeClosest(const QStringList &text, const QStringList &lines);
+    static QStringList reindent(const QStringList &lines, const QStringList &searched, const QStringList &found);
+};
+
+#endif // PATCHENGINE_H
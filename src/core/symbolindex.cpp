@@ -0,0 +1,1147 @@
+#include "symbolindex.h"
+#include "codesearch.h"
+#include "filecontentcache.h"
+#include "gitignore.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSet>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Larger files are generated code or amalgamations, not worth scanning.
+constexpr qint64 MaxFileSize = 2 * 1024 * 1024;
+constexpr int MaxSignatureLength = 200;
+
+bool isIdentifierStart(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || uchar(c) >= 0x80;
+}
+
+bool isIdentifierChar(char c)
+{
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+struct Define {
+    qsizetype directive = 0;   // Offset of the '#'.
+    qsizetype name = 0;
+    qsizetype nameLength = 0;
+    qsizetype lineEnd = 0;     // End of the first line.
+    bool hasBody = false;
+};
+
+// Parses "# define NAME body" at offset (the '#'), end is the end of the directive.
+void parseDefine(QByteArrayView source, qsizetype offset, qsizetype end, QList<Define> *defines)
+{
+    qsizetype i = offset + 1;
+    while (i < end && isSpace(source[i]))
+        ++i;
+    if (source.sliced(i, qMin<qsizetype>(6, end - i)) != QByteArrayView("define"))
+        return;
+    i += 6;
+    while (i < end && isSpace(source[i]))
+        ++i;
+    Define define;
+    define.directive = offset;
+    define.name = i;
+    while (i < end && isIdentifierChar(source[i]))
+        ++i;
+    define.nameLength = i - define.name;
+    if (define.nameLength == 0)
+        return;
+    define.lineEnd = i;
+    while (define.lineEnd < end && source[define.lineEnd] != '\n')
+        ++define.lineEnd;
+    for (qsizetype k = i; k < end && !define.hasBody; ++k)
+        define.hasBody = !isSpace(source[k]) && source[k] != '\n' && source[k] != '\\';
+    defines->append(define);
+}
+
+// A copy of the source with comments, string and character literals and
+// preprocessor directives blanked out. Newlines are kept, so offsets and line
+// numbers still match the source.
+QByteArray blankNonCode(QByteArrayView source, QList<Define> *defines)
+{
+    QByteArray code = source.toByteArray();
+    char *out = code.data();
+    const qsizetype n = source.size();
+    const auto blank = [out](qsizetype from, qsizetype to) {
+        for (qsizetype k = from; k < to; ++k) {
+            if (out[k] != '\n')
+                out[k] = ' ';
+        }
+    };
+
+    bool lineStart = true;
+    qsizetype i = 0;
+    while (i < n) {
+        const char c = source[i];
+        if (c == '\n') {
+            lineStart = true;
+            ++i;
+            continue;
+        }
+        if (isSpace(c)) {
+            ++i;
+            continue;
+        }
+        if (lineStart && c == '#') {
+            // Up to the first newline that is not escaped.
+            qsizetype end = i;
+            while (end < n) {
+                if (source[end] == '\n') {
+                    qsizetype last = end - 1;
+                    if (last > i && source[last] == '\r')
+                        --last;
+                    if (source[last] != '\\')
+                        break;
+                }
+                ++end;
+            }
+            parseDefine(source, i, end, defines);
+            blank(i, end);
+            i = end;
+            continue;
+        }
+        lineStart = false;
+
+        const char next = i + 1 < n ? source[i + 1] : '\0';
+        if (c == '/' && next == '/') {
+            qsizetype end = i;
+            while (end < n && source[end] != '\n')
+                ++end;
+            blank(i, end);
+            i = end;
+        } else if (c == '/' && next == '*') {
+            const qsizetype close = source.indexOf(QByteArrayView("*/"), i + 2);
+            const qsizetype end = close < 0 ? n : close + 2;
+            blank(i, end);
+            i = end;
+        } else if (c == '"' && i > 0 && source[i - 1] == 'R') {
+            // Raw string, R"delimiter( ... )delimiter", optionally with an encoding prefix.
+            qsizetype prefix = i - 1;
+            while (prefix > 0 && isIdentifierChar(source[prefix - 1]))
+                --prefix;
+            const QByteArrayView encoding = source.sliced(prefix, i - 1 - prefix);
+            const qsizetype open = source.indexOf('(', i);
+            if ((encoding.isEmpty() || encoding == QByteArrayView("u8") || encoding == QByteArrayView("u")
+                 || encoding == QByteArrayView("U") || encoding == QByteArrayView("L"))
+                && open > 0 && open - i <= 17) {
+                const QByteArray terminator = ')' + source.sliced(i + 1, open - i - 1).toByteArray() + '"';
+                const qsizetype close = source.indexOf(terminator, open);
+                const qsizetype end = close < 0 ? n : close + terminator.size();
+                blank(i + 1, end - 1);
+                i = end;
+                continue;
+            }
+            ++i;
+        } else if (c == '"' || c == '\'') {
+            if (c == '\'') {
+                // Digit separator, as in 1'000'000.
+                qsizetype start = i;
+                while (start > 0 && isIdentifierChar(source[start - 1]))
+                    --start;
+                if (start < i && source[start] >= '0' && source[start] <= '9') {
+                    ++i;
+                    continue;
+                }
+            }
+            qsizetype end = i + 1;
+            while (end < n && source[end] != c && source[end] != '\n')
+                end += source[end] == '\\' ? 2 : 1;
+            end = qMin(end, n);
+            blank(i + 1, end);
+            i = end + 1;
+        } else {
+            ++i;
+        }
+    }
+    return code;
+}
+
+struct Token {
+    enum Type { Identifier, Number, Scope, Punctuation };
+    Type type = Punctuation;
+    qsizetype offset = 0;
+    qsizetype length = 0;
+
+    qsizetype end() const { return offset + length; }
+};
+
+// Reads C++ declarations from the tokens of blanked code, statement by
+// statement. Namespace and class bodies are descended into, function bodies,
+// enum bodies and initializers are skipped by counting braces.
+class Scanner
+{
+public:
+    explicit Scanner(QByteArrayView source)
+        : m_source(source)
+    {
+        m_code = blankNonCode(source, &m_defines);
+        m_lineStarts.push_back(0);
+        for (qsizetype i = 0; i < m_code.size(); ++i) {
+            if (m_code[i] == '\n')
+                m_lineStarts.push_back(i + 1);
+        }
+        tokenize();
+    }
+
+    QList<SymbolIndex::Symbol> run();
+
+private:
+    enum Action { EnterScope, SkipBody, SkipInitializer };
+    struct Scope {
+        bool isClass = false;
+        QString name;   // Empty for anonymous and transparent scopes.
+    };
+    struct FunctionName {
+        QString name;
+        QStringList qualifier;
+        qsizetype nameIndex = 0;
+        qsizetype firstNameIndex = 0;   // Start of the qualified name.
+        qsizetype openParen = 0;
+    };
+    using Tokens = QList<Token>;
+
+    void tokenize();
+    Action openBrace(const Tokens &head, const Token &brace);
+    void statement(const Tokens &head, const Token &semicolon);
+    std::optional<FunctionName> functionName(const Tokens &head, qsizetype begin) const;
+    bool isFunction(qsizetype begin, const FunctionName &function) const;
+    qsizetype declarationStart(const Tokens &head) const;
+    qsizetype skipBalanced(const Tokens &head, qsizetype open, char openChar, char closeChar) const;
+    bool isMacroInvocation(const Tokens &head) const;
+    void addSymbol(SymbolIndex::Kind kind, const QString &name, const QStringList &qualifier,
+                   const Token &nameToken, qsizetype signatureStart, qsizetype signatureEnd,
+                   bool isDefinition, const QStringList &bases = {});
+
+    QByteArrayView text(const Token &token) const { return QByteArrayView(m_code).sliced(token.offset, token.length); }
+    QString string(const Token &token) const { return QString::fromUtf8(text(token)); }
+    bool is(const Token &token, const char *word) const { return text(token) == QByteArrayView(word); }
+    bool isPunctuation(const Token &token, char c) const
+    {
+        return token.type == Token::Punctuation && m_code[token.offset] == c;
+    }
+    int lineOf(qsizetype offset) const
+    {
+        return int(std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), offset) - m_lineStarts.begin());
+    }
+    QString currentScope() const;
+    bool inClass() const { return !m_scopes.isEmpty() && m_scopes.last().isClass; }
+
+    QByteArrayView m_source;
+    QByteArray m_code;
+    QList<Define> m_defines;
+    std::vector<qsizetype> m_lineStarts;
+    Tokens m_tokens;
+    QList<Scope> m_scopes;
+    QList<SymbolIndex::Symbol> m_symbols;
+};
+
+void Scanner::tokenize()
+{
+    const qsizetype n = m_code.size();
+    qsizetype i = 0;
+    while (i < n) {
+        const char c = m_code[i];
+        if (isSpace(c) || c == '\n' || c == '"' || c == '\'') {
+            ++i;
+            continue;
+        }
+        Token token;
+        token.offset = i;
+        if (isIdentifierStart(c)) {
+            token.type = Token::Identifier;
+            while (i < n && isIdentifierChar(m_code[i]))
+                ++i;
+        } else if (c >= '0' && c <= '9') {
+            token.type = Token::Number;
+            while (i < n && (isIdentifierChar(m_code[i]) || m_code[i] == '.'))
+                ++i;
+        } else if (c == ':' && i + 1 < n && m_code[i + 1] == ':') {
+            token.type = Token::Scope;
+            i += 2;
+        } else {
+            ++i;
+        }
+        token.length = i - token.offset;
+        m_tokens.append(token);
+    }
+}
+
+QString Scanner::currentScope() const
+{
+    QStringList names;
+    for (const Scope &scope : m_scopes) {
+        if (!scope.name.isEmpty())
+            names.append(scope.name);
+    }
+    return names.join("::");
+}
+
+void Scanner::addSymbol(SymbolIndex::Kind kind, const QString &name, const QStringList &qualifier,
+                        const Token &nameToken, qsizetype signatureStart, qsizetype signatureEnd,
+                        bool isDefinition, const QStringList &bases)
+{
+    if (name.isEmpty())
+        return;
+    SymbolIndex::Symbol symbol;
+    symbol.name = name;
+    QStringList scope;
+    if (const QString enclosing = currentScope(); !enclosing.isEmpty())
+        scope.append(enclosing);
+    scope.append(qualifier);
+    symbol.scope = scope.join("::");
+    symbol.kind = kind;
+    symbol.line = lineOf(nameToken.offset);
+    symbol.isDefinition = isDefinition;
+    symbol.bases = bases;
+    symbol.signatureOffset = int(signatureStart);
+    symbol.signatureLength = int(signatureEnd - signatureStart);
+    m_symbols.append(symbol);
+}
+
+qsizetype Scanner::skipBalanced(const Tokens &head, qsizetype open, char openChar, char closeChar) const
+{
+    int depth = 0;
+    for (qsizetype i = open; i < head.size(); ++i) {
+        if (isPunctuation(head[i], openChar))
+            ++depth;
+        else if (isPunctuation(head[i], closeChar) && --depth == 0)
+            return i + 1;
+    }
+    return head.size();
+}
+
+// Skips template parameter lists, attributes and "export" in front of a declaration.
+qsizetype Scanner::declarationStart(const Tokens &head) const
+{
+    qsizetype begin = 0;
+    while (begin < head.size()) {
+        if (is(head[begin], "template") && begin + 1 < head.size() && isPunctuation(head[begin + 1], '<'))
+            begin = skipBalanced(head, begin + 1, '<', '>');
+        else if (isPunctuation(head[begin], '[') && begin + 1 < head.size() && isPunctuation(head[begin + 1], '['))
+            begin = skipBalanced(head, begin, '[', ']');
+        else if (is(head[begin], "export"))
+            ++begin;
+        else
+            break;
+    }
+    return begin;
+}
+
+// A lone ALL_CAPS identifier, optionally with arguments, like Q_OBJECT or
+// Q_PROPERTY(...), which needs no semicolon.
+bool Scanner::isMacroInvocation(const Tokens &head) const
+{
+    const QByteArrayView name = text(head.first());
+    if (head.first().type != Token::Identifier || name.size() < 2)
+        return false;
+    bool hasLetter = false;
+    for (const char c : name) {
+        if (c >= 'a' && c <= 'z')
+            return false;
+        hasLetter = hasLetter || (c >= 'A' && c <= 'Z');
+    }
+    if (!hasLetter)
+        return false;
+    if (head.size() == 1)
+        return true;
+    return isPunctuation(head[1], '(') && skipBalanced(head, 1, '(', ')') == head.size();
+}
+
+std::optional<Scanner::FunctionName> Scanner::functionName(const Tokens &head, qsizetype begin) const
+{
+    static const QSet<QByteArray> notFunctions = {
+        "if", "for", "while", "switch", "catch", "return", "sizeof", "alignof", "typeid",
+        "static_assert", "new", "delete", "throw", "case", "do", "else", "noexcept"
+    };
+
+    int angle = 0;
+    for (qsizetype i = begin; i < head.size(); ++i) {
+        const Token &token = head[i];
+        if (isPunctuation(token, '=') && angle == 0)
+            return std::nullopt;
+        if (is(token, "decltype") || is(token, "alignas") || is(token, "__attribute__") || is(token, "__declspec")) {
+            if (i + 1 < head.size() && isPunctuation(head[i + 1], '('))
+                i = skipBalanced(head, i + 1, '(', ')') - 1;
+            continue;
+        }
+
+        FunctionName function;
+        qsizetype nameIndex = -1;
+        if (is(token, "operator")) {
+            // operator(), operator==, operator new[], operator bool.
+            qsizetype paren = i + 1;
+            if (paren + 1 < head.size() && isPunctuation(head[paren], '(') && isPunctuation(head[paren + 1], ')'))
+                paren += 2;
+            while (paren < head.size() && !isPunctuation(head[paren], '('))
+                ++paren;
+            if (paren >= head.size())
+                return std::nullopt;
+            function.name = "operator";
+            for (qsizetype k = i + 1; k < paren; ++k) {
+                if (head[k].type == Token::Identifier && head[k - 1].type == Token::Identifier)
+                    function.name += ' ';
+                function.name += string(head[k]);
+            }
+            nameIndex = i;
+            function.openParen = paren;
+        } else if (isPunctuation(token, '<') && i > begin && head[i - 1].type == Token::Identifier) {
+            ++angle;
+            continue;
+        } else if (isPunctuation(token, '>') && angle > 0) {
+            --angle;
+            continue;
+        } else if (isPunctuation(token, '(') && angle == 0) {
+            qsizetype n = i - 1;
+            if (n >= begin && isPunctuation(head[n], '>')) {
+                // foo<T>(...), an explicit specialization.
+                int depth = 0;
+                for (; n >= begin; --n) {
+                    if (isPunctuation(head[n], '>'))
+                        ++depth;
+                    else if (isPunctuation(head[n], '<') && --depth == 0)
+                        break;
+                }
+                --n;
+            }
+            if (n < begin || head[n].type != Token::Identifier || notFunctions.contains(text(head[n]).toByteArray()))
+                return std::nullopt;
+            function.name = string(head[n]);
+            if (n > begin && isPunctuation(head[n - 1], '~')) {
+                function.name.prepend(u'~');
+                --n;
+            }
+            nameIndex = n;
+            function.openParen = i;
+        } else {
+            continue;
+        }
+
+        // Qualifiers, as in Foo<T>::Bar::baz.
+        qsizetype first = nameIndex;
+        while (first - 2 >= begin && head[first - 1].type == Token::Scope) {
+            qsizetype q = first - 2;
+            if (isPunctuation(head[q], '>')) {
+                int depth = 0;
+                for (; q >= begin; --q) {
+                    if (isPunctuation(head[q], '>'))
+                        ++depth;
+                    else if (isPunctuation(head[q], '<') && --depth == 0)
+                        break;
+                }
+                --q;
+            }
+            if (q < begin || head[q].type != Token::Identifier)
+                break;
+            function.qualifier.prepend(string(head[q]));
+            first = q;
+        }
+        function.nameIndex = nameIndex;
+        function.firstNameIndex = first;
+        return function;
+    }
+    return std::nullopt;
+}
+
+// Functions have a return type, unless they are constructors, destructors or
+// conversion operators. This keeps out macro invocations like TEST(a, b).
+bool Scanner::isFunction(qsizetype begin, const FunctionName &function) const
+{
+    if (function.firstNameIndex > begin || function.name.startsWith(u'~')
+        || function.name.startsWith(QLatin1StringView("operator")))
+        return true;
+    if (!function.qualifier.isEmpty())
+        return function.qualifier.last() == function.name;
+    return inClass() && m_scopes.last().name.section(QLatin1StringView("::"), -1) == function.name;
+}
+
+Scanner::Action Scanner::openBrace(const Tokens &head, const Token &brace)
+{
+    const qsizetype begin = declarationStart(head);
+    const qsizetype end = head.size();
+    if (begin >= end)
+        return SkipBody;
+    const Token &first = head[begin];
+
+    // namespace a::b {, inline namespace v1 {
+    const qsizetype namespaceIndex = is(first, "namespace") ? begin
+                                     : (is(first, "inline") && begin + 1 < end && is(head[begin + 1], "namespace"))
+                                         ? begin + 1 : -1;
+    if (namespaceIndex >= 0) {
+        QStringList names;
+        for (qsizetype i = namespaceIndex + 1; i < end; ++i) {
+            if (head[i].type == Token::Identifier && !is(head[i], "inline"))
+                names.append(string(head[i]));
+        }
+        if (!names.isEmpty()) {
+            const QString name = names.takeLast();
+            addSymbol(SymbolIndex::Namespace, name, names, head[end - 1], head.first().offset, brace.offset, true);
+            names.append(name);
+        }
+        m_scopes.append(Scope{false, names.join("::")});
+        return EnterScope;
+    }
+    // extern "C" {
+    if (is(first, "extern") && end - begin == 1) {
+        m_scopes.append(Scope{false, QString()});
+        return EnterScope;
+    }
+
+    // class, struct, union or enum, possibly after typedef or an export macro.
+    for (qsizetype k = begin; k < end; ++k) {
+        const Token &token = head[k];
+        if (isPunctuation(token, '(') || isPunctuation(token, '=') || isPunctuation(token, '<'))
+            break;
+        if (is(token, "enum")) {
+            qsizetype i = k + 1;
+            if (i < end && (is(head[i], "class") || is(head[i], "struct")))
+                ++i;
+            if (i < end && head[i].type == Token::Identifier)
+                addSymbol(SymbolIndex::Enum, string(head[i]), {}, head[i], head.first().offset, brace.offset, true);
+            return SkipBody;
+        }
+        if (!is(token, "class") && !is(token, "struct") && !is(token, "union"))
+            continue;
+
+        const SymbolIndex::Kind kind = is(token, "class") ? SymbolIndex::Class
+                                       : is(token, "struct") ? SymbolIndex::Struct
+                                                             : SymbolIndex::Union;
+        QStringList names;
+        qsizetype nameIndex = k;
+        qsizetype i = k + 1;
+        bool isDefinition = true;
+        for (; i < end && isDefinition; ++i) {
+            const Token &t = head[i];
+            if (isPunctuation(t, ':'))
+                break;
+            if (isPunctuation(t, '(')) {
+                // alignas(8) or an export macro with arguments, otherwise this is
+                // a function returning the class, struct foo *make(void) {.
+                isDefinition = is(head[i - 1], "alignas") || is(head[i - 1], "__attribute__")
+                               || is(head[i - 1], "__declspec") || isMacroInvocation({head[i - 1]});
+                i = skipBalanced(head, i, '(', ')') - 1;
+            } else if (isPunctuation(t, '=')) {
+                isDefinition = false;
+            } else if (isPunctuation(t, '<')) {
+                i = skipBalanced(head, i, '<', '>') - 1;
+            } else if (t.type == Token::Identifier && !is(t, "final")) {
+                if (i > k + 1 && head[i - 1].type == Token::Scope)
+                    names.append(string(t));
+                else
+                    names = QStringList{string(t)};
+                nameIndex = i;
+            }
+        }
+        if (!isDefinition)
+            break;
+        QStringList bases;
+        int angle = 0;
+        qsizetype baseStart = -1;
+        for (qsizetype b = i + 1; b <= end; ++b) {
+            if (b < end) {
+                if (isPunctuation(head[b], '<'))
+                    ++angle;
+                else if (isPunctuation(head[b], '>'))
+                    --angle;
+                if (!(isPunctuation(head[b], ',') && angle == 0)) {
+                    if (baseStart < 0 && !is(head[b], "public") && !is(head[b], "protected")
+                        && !is(head[b], "private") && !is(head[b], "virtual"))
+                        baseStart = b;
+                    continue;
+                }
+            }
+            if (baseStart >= 0) {
+                const Token &last = head[b - 1];
+                bases.append(QString::fromUtf8(QByteArrayView(m_code).sliced(head[baseStart].offset,
+                                                                             last.end() - head[baseStart].offset))
+                                 .simplified());
+            }
+            baseStart = -1;
+        }
+
+        const QString name = names.isEmpty() ? QString() : names.takeLast();
+        addSymbol(kind, name, names, head[nameIndex], head.first().offset, brace.offset, true, bases);
+        names.append(name);
+        m_scopes.append(Scope{true, name.isEmpty() ? QString() : names.join("::")});
+        return EnterScope;
+    }
+
+    if (const auto function = functionName(head, begin)) {
+        // A braced member initializer in a constructor's initializer list.
+        const qsizetype close = skipBalanced(head, function->openParen, '(', ')');
+        bool initializerList = false;
+        for (qsizetype i = close; i < end && !initializerList; ++i)
+            initializerList = isPunctuation(head[i], ':');
+        const Token &last = head.last();
+        if (initializerList && (last.type == Token::Identifier || isPunctuation(last, '>')))
+            return SkipInitializer;
+
+        if (isFunction(begin, *function)) {
+            const bool isMethod = inClass() || !function->qualifier.isEmpty();
+            addSymbol(isMethod ? SymbolIndex::Method : SymbolIndex::Function, function->name, function->qualifier,
+                      head[function->nameIndex], head.first().offset, brace.offset, true);
+            return SkipBody;
+        }
+    }
+
+    // Initializers, int x{1} or = {...}, keep the statement going. Anything
+    // else, like a macro with a body, ends it.
+    bool hasAssignment = false;
+    for (qsizetype i = begin; i < end && !hasAssignment; ++i)
+        hasAssignment = isPunctuation(head[i], '=');
+    if (hasAssignment || head.last().type == Token::Identifier || isPunctuation(head.last(), '>'))
+        return SkipInitializer;
+    return SkipBody;
+}
+
+void Scanner::statement(const Tokens &head, const Token &semicolon)
+{
+    const qsizetype begin = declarationStart(head);
+    const qsizetype end = head.size();
+    if (end - begin < 2)
+        return;
+    const Token &first = head[begin];
+    const qsizetype signatureStart = head.first().offset;
+
+    static const QSet<QByteArray> skipped = {
+        "friend", "return", "static_assert", "namespace", "goto", "break", "continue", "throw", "delete"
+    };
+    if (skipped.contains(text(first).toByteArray()))
+        return;
+
+    if (is(first, "using")) {
+        // using Name = Type;
+        if (end - begin > 2 && head[begin + 1].type == Token::Identifier && isPunctuation(head[begin + 2], '='))
+            addSymbol(SymbolIndex::Typedef, string(head[begin + 1]), {}, head[begin + 1], signatureStart,
+                      semicolon.offset, true);
+        return;
+    }
+
+    if (is(first, "typedef")) {
+        // typedef void (*Name)(int); or typedef Type Name[N];
+        for (qsizetype i = begin; i + 2 < end; ++i) {
+            if (isPunctuation(head[i], '(') && isPunctuation(head[i + 1], '*')
+                && head[i + 2].type == Token::Identifier) {
+                addSymbol(SymbolIndex::Typedef, string(head[i + 2]), {}, head[i + 2], signatureStart,
+                          semicolon.offset, true);
+                return;
+            }
+        }
+        for (qsizetype i = end - 1; i > begin; --i) {
+            if (isPunctuation(head[i], '['))
+                continue;
+            if (head[i].type == Token::Identifier && (i + 1 == end || isPunctuation(head[i + 1], '['))) {
+                addSymbol(SymbolIndex::Typedef, string(head[i]), {}, head[i], signatureStart, semicolon.offset, true);
+                return;
+            }
+        }
+        return;
+    }
+
+    bool hasParen = false;
+    bool hasAssignment = false;
+    for (qsizetype i = begin; i < end; ++i) {
+        hasParen = hasParen || isPunctuation(head[i], '(');
+        hasAssignment = hasAssignment || isPunctuation(head[i], '=');
+    }
+    // Forward declarations, class Foo;
+    if ((is(first, "class") || is(first, "struct") || is(first, "union") || is(first, "enum"))
+        && !hasParen && !hasAssignment && end - begin <= 3)
+        return;
+
+    if (const auto function = functionName(head, begin)) {
+        if (isFunction(begin, *function)) {
+            addSymbol(inClass() ? SymbolIndex::Method : SymbolIndex::Function, function->name, function->qualifier,
+                      head[function->nameIndex], signatureStart, semicolon.offset, false);
+        }
+        return;
+    }
+
+    // Variables and fields, possibly several: int a = 1, b[2];
+    bool isExtern = false;
+    int angle = 0;
+    int nesting = 0;
+    qsizetype nameIndex = -1;
+    bool stopped = false;
+    bool firstDeclarator = true;
+    for (qsizetype i = begin; i <= end; ++i) {
+        if (i < end) {
+            const Token &token = head[i];
+            isExtern = isExtern || is(token, "extern");
+            if (isPunctuation(token, '<') && i > begin && head[i - 1].type == Token::Identifier)
+                ++angle;
+            else if (isPunctuation(token, '>') && angle > 0)
+                --angle;
+            else if (isPunctuation(token, '(') || isPunctuation(token, '['))
+                ++nesting;
+            else if (isPunctuation(token, ')') || isPunctuation(token, ']'))
+                --nesting;
+            if (!(isPunctuation(token, ',') && angle == 0 && nesting == 0)) {
+                if (isPunctuation(token, '=') || isPunctuation(token, '[') || isPunctuation(token, ':')
+                    || isPunctuation(token, '}'))
+                    stopped = true;
+                else if (!stopped && angle == 0 && nesting == 0 && token.type == Token::Identifier)
+                    nameIndex = i;
+                continue;
+            }
+        }
+        // A declarator needs a type in front of it, the first one explicitly.
+        if (nameIndex >= 0 && (!firstDeclarator || nameIndex > begin)) {
+            addSymbol(inClass() ? SymbolIndex::Field : SymbolIndex::Variable, string(head[nameIndex]), {},
+                      head[nameIndex], signatureStart, semicolon.offset, !isExtern);
+        }
+        firstDeclarator = false;
+        nameIndex = -1;
+        stopped = false;
+    }
+}
+
+QList<SymbolIndex::Symbol> Scanner::run()
+{
+    for (const Define &define : std::as_const(m_defines)) {
+        const QByteArrayView name = m_source.sliced(define.name, define.nameLength);
+        // Include guards.
+        if (!define.hasBody && (name.endsWith("_H") || name.endsWith("_H_") || name.endsWith("_HPP")
+                                || name.endsWith("_INCLUDED")))
+            continue;
+        SymbolIndex::Symbol symbol;
+        symbol.name = QString::fromUtf8(name);
+        symbol.kind = SymbolIndex::Macro;
+        symbol.line = lineOf(define.name);
+        symbol.isDefinition = true;
+        symbol.signatureOffset = int(define.directive);
+        symbol.signatureLength = int(define.lineEnd - define.directive);
+        m_symbols.append(symbol);
+    }
+
+    static const QSet<QByteArray> accessSpecifiers = {
+        "public", "protected", "private", "signals", "slots", "Q_SIGNALS", "Q_SLOTS"
+    };
+
+    Tokens head;
+    int skipDepth = 0;
+    bool keepHead = false;
+    for (const Token &token : std::as_const(m_tokens)) {
+        const bool isBrace = token.type == Token::Punctuation && (m_code[token.offset] == '{'
+                                                                  || m_code[token.offset] == '}');
+        if (skipDepth > 0) {
+            if (isPunctuation(token, '{')) {
+                ++skipDepth;
+            } else if (isPunctuation(token, '}') && --skipDepth == 0) {
+                if (keepHead)
+                    head.append(token);
+                else
+                    head.clear();
+            }
+            continue;
+        }
+        if (isBrace && m_code[token.offset] == '{') {
+            switch (openBrace(head, token)) {
+            case EnterScope:
+                head.clear();
+                break;
+            case SkipBody:
+                skipDepth = 1;
+                keepHead = false;
+                break;
+            case SkipInitializer:
+                skipDepth = 1;
+                keepHead = true;
+                break;
+            }
+            continue;
+        }
+        if (isBrace) {
+            if (!m_scopes.isEmpty())
+                m_scopes.removeLast();
+            head.clear();
+            continue;
+        }
+        if (isPunctuation(token, ';')) {
+            statement(head, token);
+            head.clear();
+            continue;
+        }
+        // public:, public slots:
+        if (isPunctuation(token, ':') && !head.isEmpty() && head.size() <= 2
+            && accessSpecifiers.contains(text(head.first()).toByteArray())) {
+            head.clear();
+            continue;
+        }
+        // Q_OBJECT, Q_PROPERTY(...) and similar macros end at the line break.
+        if (!head.isEmpty() && lineOf(token.offset) > lineOf(head.last().offset) && isMacroInvocation(head))
+            head.clear();
+        head.append(token);
+    }
+    return m_symbols;
+}
+
+// Types first, then definitions, then declarations; namespaces are opened in
+// many files and say little, they come last.
+int rank(const SymbolIndex::Symbol &symbol)
+{
+    switch (symbol.kind) {
+    case SymbolIndex::Namespace:
+        return 4;
+    case SymbolIndex::Class:
+    case SymbolIndex::Struct:
+    case SymbolIndex::Union:
+    case SymbolIndex::Enum:
+    case SymbolIndex::Typedef:
+        return symbol.isDefinition ? 0 : 3;
+    default:
+        return symbol.isDefinition ? 1 : 2;
+    }
+}
+
+} // namespace
+
+SymbolIndex::SymbolIndex(QObject *parent)
+    : QObject(parent)
+{
+    // One background thread: builds and updates of a project are ordered. The
+    // build itself scans files on CodeSearch's walker threads.
+    m_pool.setMaxThreadCount(1);
+}
+
+SymbolIndex::~SymbolIndex()
+{
+    ++m_generation;
+    m_pool.waitForDone();
+}
+
+void SymbolIndex::setProjectPath(const QString &projectPath)
+{
+    const QString root = projectPath.isEmpty() ? QString() : QDir::cleanPath(projectPath);
+    if (root == this->projectPath())
+        return;
+
+    const quint64 generation = ++m_generation;
+    {
+        QWriteLocker locker(&m_lock);
+        m_root = root;
+        m_ready = false;
+        m_files.clear();
+        m_filesByName.clear();
+    }
+    if (!root.isEmpty())
+        m_pool.start([this, generation, root]() { build(generation, root); });
+}
+
+QString SymbolIndex::projectPath() const
+{
+    QReadLocker locker(&m_lock);
+    return m_root;
+}
+
+bool SymbolIndex::isReady() const
+{
+    QReadLocker locker(&m_lock);
+    return m_ready;
+}
+
+void SymbolIndex::sortByRelevance(QList<Symbol> *symbols)
+{
+    std::sort(symbols->begin(), symbols->end(), [](const Symbol &a, const Symbol &b) {
+        if (rank(a) != rank(b))
+            return rank(a) < rank(b);
+        if (a.filePath != b.filePath)
+            return a.filePath < b.filePath;
+        return a.line < b.line;
+    });
+}
+
+bool SymbolIndex::isCppFile(const QString &fileName)
+{
+    static const QSet<QString> suffixes = {
+        "h", "hh", "hpp", "hxx", "h++", "c", "cc", "cpp", "cxx", "c++", "ipp", "inl", "tpp", "m", "mm"
+    };
+    const qsizetype dot = fileName.lastIndexOf(u'.');
+    return dot >= 0 && suffixes.contains(fileName.mid(dot + 1).toLower());
+}
+
+QString SymbolIndex::kindName(Kind kind)
+{
+    switch (kind) {
+    case Namespace: return "namespace";
+    case Class: return "class";
+    case Struct: return "struct";
+    case Union: return "union";
+    case Enum: return "enum";
+    case Function: return "function";
+    case Method: return "method";
+    case Field: return "field";
+    case Variable: return "variable";
+    case Typedef: return "typedef";
+    case Macro: return "macro";
+    }
+    return {};
+}
+
+QList<SymbolIndex::Symbol> SymbolIndex::scan(QByteArrayView source)
+{
+    return Scanner(source).run();
+}
+
+std::optional<SymbolIndex::FileSymbols> SymbolIndex::scanFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() > MaxFileSize)
+        return std::nullopt;
+    const QByteArray content = file.readAll();
+    if (CodeSearch::isBinary(content))
+        return std::nullopt;
+
+    FileSymbols symbols;
+    symbols.size = content.size();
+    symbols.modified = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+    symbols.symbols = scan(content);
+    return symbols;
+}
+
+void SymbolIndex::build(quint64 generation, const QString &root)
+{
+    QMutex mutex;
+    QHash<QString, FileSymbols> files;
+    CodeSearch::Options options;
+    options.maxFileSize = MaxFileSize;
+    CodeSearch::forEachFile(root, options, [&](const QFileInfo &info, const QString &relativePath) {
+        if (isStale(generation))
+            return false;
+        if (!isCppFile(info.fileName()))
+            return true;
+        if (auto symbols = scanFile(info.filePath())) {
+            QMutexLocker locker(&mutex);
+            files.insert(relativePath, std::move(*symbols));
+        }
+        return true;
+    });
+
+    QHash<QString, QList<QString>> filesByName;
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        for (const Symbol &symbol : it->symbols) {
+            QList<QString> &paths = filesByName[symbol.name];
+            if (paths.isEmpty() || paths.last() != it.key())
+                paths.append(it.key());
+        }
+    }
+
+    QWriteLocker locker(&m_lock);
+    if (isStale(generation))
+        return;
+    m_files = std::move(files);
+    m_filesByName = std::move(filesByName);
+    m_ready = true;
+}
+
+void SymbolIndex::setFileSymbols(const QString &relativePath, std::optional<FileSymbols> file)
+{
+    QWriteLocker locker(&m_lock);
+    if (const auto old = m_files.constFind(relativePath); old != m_files.cend()) {
+        for (const Symbol &symbol : old->symbols) {
+            auto paths = m_filesByName.find(symbol.name);
+            if (paths == m_filesByName.end())
+                continue;
+            paths->removeAll(relativePath);
+            if (paths->isEmpty())
+                m_filesByName.erase(paths);
+        }
+        m_files.remove(relativePath);
+    }
+    if (!file)
+        return;
+    for (const Symbol &symbol : std::as_const(file->symbols)) {
+        QList<QString> &paths = m_filesByName[symbol.name];
+        if (!paths.contains(relativePath))
+            paths.append(relativePath);
+    }
+    m_files.insert(relativePath, std::move(*file));
+}
+
+void SymbolIndex::updateFiles(const QStringList &filePaths)
+{
+    const quint64 generation = m_generation;
+    const QString root = projectPath();
+    if (root.isEmpty())
+        return;
+
+    QStringList relativePaths;
+    const QDir rootDir(root);
+    for (const QString &filePath : filePaths) {
+        const auto relativePath = CodeSearch::relativeTreePath(rootDir, filePath);
+        if (relativePath && isCppFile(*relativePath))
+            relativePaths.append(*relativePath);
+    }
+    if (relativePaths.isEmpty())
+        return;
+
+    m_pool.start([this, generation, root, relativePaths]() {
+        for (const QString &relativePath : relativePaths) {
+            const auto ignore = GitIgnore::forTree(root, CodeSearch::parentDirectory(relativePath));
+            if (ignore && ignore->isIgnored(relativePath, false))
+                continue;
+            auto symbols = scanFile(root + '/' + relativePath);
+            if (isStale(generation))
+                return;
+            setFileSymbols(relativePath, std::move(symbols));
+        }
+    });
+}
+
+QList<SymbolIndex::Symbol> SymbolIndex::collect(const QString &name,
+                                                const std::function<bool(const Symbol &)> &accept)
+{
+    const auto lookup = [this, &name, &accept](QHash<QString, FileSymbols> *files) {
+        QList<Symbol> symbols;
+        QReadLocker locker(&m_lock);
+        for (const QString &relativePath : m_filesByName.value(name)) {
+            const auto file = m_files.constFind(relativePath);
+            if (file == m_files.cend())
+                continue;
+            files->insert(relativePath, FileSymbols{file->size, file->modified, {}});
+            for (const Symbol &symbol : file->symbols) {
+                if (symbol.name == name && accept(symbol)) {
+                    symbols.append(symbol);
+                    symbols.last().filePath = relativePath;
+                }
+            }
+        }
+        return symbols;
+    };
+
+    QHash<QString, FileSymbols> files;
+    QList<Symbol> symbols = lookup(&files);
+
+    // Files edited outside of the tools since they were scanned.
+    const QString root = projectPath();
+    bool rescanned = false;
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        const QFileInfo info(root + '/' + it.key());
+        if (info.exists() && info.size() == it->size && info.lastModified().toMSecsSinceEpoch() == it->modified)
+            continue;
+        setFileSymbols(it.key(), scanFile(info.filePath()));
+        rescanned = true;
+    }
+    if (rescanned) {
+        files.clear();
+        symbols = lookup(&files);
+    }
+    return symbols;
+}
+
+// Fills in absolute paths and the signature text, reading each file once.
+QList<SymbolIndex::Symbol> SymbolIndex::finish(QList<Symbol> symbols)
+{
+    const QString root = projectPath();
+    QHash<QString, QByteArray> contents;
+    for (Symbol &symbol : symbols) {
+        auto content = contents.find(symbol.filePath);
+        if (content == contents.end()) {
+            // The files a lookup names are often read next, through the same cache.
+            QByteArray data;
+            if (!FileContentCache::instance().read(root + '/' + symbol.filePath, &data)) {
+                QFile file(root + '/' + symbol.filePath);
+                if (file.open(QIODevice::ReadOnly))
+                    data = file.read(MaxFileSize);
+            }
+            content = contents.insert(symbol.filePath, data);
+        }
+        if (symbol.signatureOffset + symbol.signatureLength <= content->size()) {
+            // Comments inside the declaration would only cost tokens.
+            QList<Define> defines;
+            QByteArray text = content->mid(symbol.signatureOffset, symbol.signatureLength);
+            if (symbol.kind != Macro)
+                text = blankNonCode(text, &defines);
+            symbol.signature = QString::fromUtf8(text).simplified();
+            if (symbol.signature.size() > MaxSignatureLength)
+                symbol.signature = symbol.signature.left(MaxSignatureLength - 3) + "...";
+        }
+        symbol.filePath = root + '/' + symbol.filePath;
+    }
+    return symbols;
+}
+
+QList<SymbolIndex::Symbol> SymbolIndex::find(const QString &name, int maxResults)
+{
+    const QStringList parts = name.trimmed().split(QLatin1StringView("::"), Qt::SkipEmptyParts);
+    if (parts.isEmpty())
+        return {};
+    const QString qualifiedName = parts.join("::");
+    QList<Symbol> symbols = collect(parts.last(), [&](const Symbol &symbol) {
+        if (parts.size() == 1)
+            return true;
+        const QString candidate = symbol.qualifiedName();
+        return candidate == qualifiedName || candidate.endsWith("::" + qualifiedName);
+    });
+    sortByRelevance(&symbols);
+    if (symbols.size() > maxResults)
+        symbols.resize(qMax(maxResults, 0));
+    return finish(symbols);
+}
+
+QList<SymbolIndex::Symbol> SymbolIndex::classOutline(const QString &className, Symbol *classSymbol)
+{
+    const QStringList parts = className.trimmed().split(QLatin1StringView("::"), Qt::SkipEmptyParts);
+    if (parts.isEmpty())
+        return {};
+    const QString qualifiedName = parts.join("::");
+    QList<Symbol> classes = collect(parts.last(), [&](const Symbol &symbol) {
+        if ((symbol.kind != Class && symbol.kind != Struct && symbol.kind != Union) || !symbol.isDefinition)
+            return false;
+        const QString candidate = symbol.qualifiedName();
+        return candidate == qualifiedName || candidate.endsWith("::" + qualifiedName);
+    });
+    if (classes.isEmpty())
+        return {};
+    // Headers define the classes others use, sources mostly private helpers.
+    std::sort(classes.begin(), classes.end(), [](const Symbol &a, const Symbol &b) {
+        const bool aHeader = a.filePath.contains(QLatin1StringView(".h"));
+        const bool bHeader = b.filePath.contains(QLatin1StringView(".h"));
+        if (aHeader != bHeader)
+            return aHeader;
+        return a.filePath < b.filePath;
+    });
+    const Symbol found = classes.first();
+    const QString scope = found.qualifiedName();
+
+    QList<Symbol> members;
+    {
+        QReadLocker locker(&m_lock);
+        const auto file = m_files.constFind(found.filePath);
+        if (file != m_files.cend()) {
+            // Methods defined after the class in the same header were declared in it.
+            QSet<QString> declared;
+            for (const Symbol &symbol : file->symbols) {
+                if (symbol.scope == scope && symbol.kind == Method && !symbol.isDefinition)
+                    declared.insert(symbol.name);
+            }
+            for (const Symbol &symbol : file->symbols) {
+                if (symbol.scope != scope || symbol.line < found.line)
+                    continue;
+                if (symbol.kind == Method && symbol.isDefinition && symbol.line > found.line
+                    && declared.contains(symbol.name))
+                    continue;
+                members.append(symbol);
+                members.last().filePath = found.filePath;
+            }
+        }
+    }
+    if (classSymbol)
+        *classSymbol = finish({found}).first();
+    return finish(members);
+}
@@ -0,0 +1,107 @@
+#ifndef SYMBOLINDEX_H
+#define SYMBOLINDEX_H
+
+#include <QByteArrayView>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+#include <functional>
+#include <optional>
+
+// Declarations of the C and C++ files of a project, for the symbol tools.
+//
+// The project is scanned once in the background by a lightweight declaration
+// scanner (no preprocessor, no semantic analysis) and kept in memory. Files
+// written by the tools are rescanned through updateFiles(), and files whose
+// modification time changed are rescanned when a lookup returns symbols from them.
+class SymbolIndex : public QObject
+{
+    Q_OBJECT
+public:
+    enum Kind {
+        Namespace,
+        Class,
+        Struct,
+        Union,
+        Enum,
+        Function,
+        Method,
+        Field,
+        Variable,
+        Typedef,
+        Macro
+    };
+
+    struct Symbol {
+        QString name;
+        QString scope;          // Enclosing namespaces and classes, "a::B".
+        QString filePath;       // Absolute in lookup results.
+        Kind kind = Function;
+        int line = 0;           // 1-based.
+        bool isDefinition = false;
+        QString signature;      // Filled in by lookups, the declaration up to its body.
+        QStringList bases;      // Classes only.
+
+        // Where the signature is, kept instead of the text itself.
+        int signatureOffset = 0;
+        int signatureLength = 0;
+
+        QString qualifiedName() const { return scope.isEmpty() ? name : scope + "::" + name; }
+    };
+
+    explicit SymbolIndex(QObject *parent = nullptr);
+    ~SymbolIndex() override;
+
+    // Scans the C and C++ files of the project in the background. Empty to unload.
+    void setProjectPath(const QString &projectPath);
+    QString projectPath() const;
+    bool isReady() const;
+
+    // Symbols named name, or whose qualified name ends with it ("Foo::bar").
+    // Definitions come first. Thread-safe.
+    QList<Symbol> find(const QString &name, int maxResults = 20);
+    // The members declared in the body of the class, which is returned through
+    // classSymbol. Empty when there is no such class. Thread-safe.
+    QList<Symbol> classOutline(const QString &className, Symbol *classSymbol);
+
+    // Rescans the given files (absolute paths) in the background. Thread-safe.
+    void updateFiles(const QStringList &filePaths);
+
+    // Types first, then definitions, then declarations, then by location.
+    static void sortByRelevance(QList<Symbol> *symbols);
+    static bool isCppFile(const QString &fileName);
+    static QString kindName(Kind kind);
+    // Declarations in C++ source, without signature text and file path.
+    static QList<Symbol> scan(QByteArrayView source);
+
+private:
+    struct FileSymbols {
+        qint64 size = 0;
+        qint64 modified = 0;
+        QList<Symbol> symbols;
+    };
+
+    void build(quint64 generation, const QString &root);
+    // nullopt removes the file.
+    void setFileSymbols(const QString &relativePath, std::optional<FileSymbols> file);
+    static std::optional<FileSymbols> scanFile(const QString &filePath);
+    QList<Symbol> collect(const QString &name, const std::function<bool(const Symbol &)> &accept);
+    QList<Symbol> finish(QList<Symbol> symbols);
+    bool isStale(quint64 generation) const { return generation != m_generation.load(); }
+
+    mutable QReadWriteLock m_lock;
+    QString m_root;
+    bool m_ready = false;
+    QHash<QString, FileSymbols> m_files;              // By relative path.
+    QHash<QString, QList<QString>> m_filesByName;     // Symbol name -> relative paths.
+
+    std::atomic<quint64> m_generation = 0;
+    QThreadPool m_pool;
+};
+
+#endif // SYMBOLINDEX_H
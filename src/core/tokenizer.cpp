@@ -0,0 +1,508 @@
+#include "tokenizer.h"
+
+#include <QFile>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <queue>
+#include <vector>
+
+namespace {
+
+enum CharClass { Letter, Number, Space, Newline, Other };
+
+struct CodePoint {
+    char32_t value;
+    int length;
+};
+
+// Classes of the ASCII range, which is nearly all of the text in source code.
+constexpr auto AsciiClasses = []() {
+    std::array<CharClass, 128> table{};
+    for (int c = 0; c < 128; ++c) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            table[c] = Letter;
+        else if (c >= '0' && c <= '9')
+            table[c] = Number;
+        else if (c == '\r' || c == '\n')
+            table[c] = Newline;
+        else if (c == ' ' || c == '\t' || c == '\v' || c == '\f')
+            table[c] = Space;
+        else
+            table[c] = Other;
+    }
+    return table;
+}();
+
+// Decodes the UTF-8 sequence at i. Invalid bytes decode as U+FFFD of length 1.
+CodePoint decodeAt(QByteArrayView s, qsizetype i)
+{
+    const auto b0 = uchar(s[i]);
+    if (b0 < 0x80)
+        return {b0, 1};
+
+    int length = 0;
+    char32_t value = 0;
+    if ((b0 & 0xE0) == 0xC0) { length = 2; value = b0 & 0x1F; }
+    else if ((b0 & 0xF0) == 0xE0) { length = 3; value = b0 & 0x0F; }
+    else if ((b0 & 0xF8) == 0xF0) { length = 4; value = b0 & 0x07; }
+    else return {0xFFFD, 1};
+
+    if (i + length > s.size())
+        return {0xFFFD, 1};
+    for (int k = 1; k < length; ++k) {
+        const auto b = uchar(s[i + k]);
+        if ((b & 0xC0) != 0x80)
+            return {0xFFFD, 1};
+        value = (value << 6) | (b & 0x3F);
+    }
+    return {value, length};
+}
+
+CharClass classify(char32_t c)
+{
+    if (c < 128)
+        return AsciiClasses[c];
+    if (QChar::isLetter(c))
+        return Letter;
+    if (QChar::isNumber(c))
+        return Number;
+    if (QChar::isSpace(c))
+        return Space;
+    return Other;
+}
+
+// Length of the contraction after an apostrophe: 's 't 'm 'd 're 've 'll.
+int contractionLength(QByteArrayView s, qsizetype i)
+{
+    if (i >= s.size())
+        return 0;
+    const char c = char(s[i] | 0x20);
+    if (c == 's' || c == 't' || c == 'm' || c == 'd')
+        return 1;
+    if (i + 1 < s.size()) {
+        const char d = char(s[i + 1] | 0x20);
+        if ((c == 'r' && d == 'e') || (c == 'v' && d == 'e') || (c == 'l' && d == 'l'))
+            return 2;
+    }
+    return 0;
+}
+
+// "▁", which SentencePiece uses in place of spaces.
+const QByteArray SpaceMarker("\xE2\x96\x81");
+
+QList<QByteArrayView> splitLines(QByteArrayView data)
+{
+    QList<QByteArrayView> lines;
+    qsizetype from = 0;
+    while (from < data.size()) {
+        qsizetype end = data.indexOf('\n', from);
+        if (end < 0) end = data.size();
+        lines.append(data.sliced(from, end - from));
+        from = end + 1;
+    }
+    return lines;
+}
+
+} // namespace
+
+Tokenizer::Tokenizer()
+{
+    clear();
+}
+
+bool Tokenizer::load(const QString &path, QString *errorString)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString) *errorString = QString("Cannot open %1: %2").arg(path, file.errorString());
+        return false;
+    }
+    const QByteArray data = file.readAll();
+
+    const qsizetype lineEnd = data.indexOf('\n');
+    const QByteArrayView firstLine = QByteArrayView(data).first(lineEnd < 0 ? data.size() : lineEnd);
+    if (firstLine.contains('\t'))
+        return loadSentencePiece(data, errorString);
+    return loadTiktoken(data, errorString);
+}
+
+void Tokenizer::clear()
+{
+    m_vocab.clear();
+    m_tokens.clear();
+    m_scores.clear();
+    std::fill(std::begin(m_byteTokens), std::end(m_byteTokens), -1);
+    m_unknownId = -1;
+}
+
+bool Tokenizer::loadTiktoken(const QByteArray &data, QString *errorString)
+{
+    clear();
+    m_format = Tiktoken;
+
+    int lineNumber = 0;
+    for (const QByteArrayView line : splitLines(data)) {
+        ++lineNumber;
+        const QByteArrayView trimmed = line.trimmed();
+        if (trimmed.isEmpty())
+            continue;
+
+        const qsizetype space = trimmed.indexOf(' ');
+        bool ok = false;
+        const int rank = space > 0 ? trimmed.sliced(space + 1).toInt(&ok) : -1;
+        const auto token = QByteArray::fromBase64Encoding(trimmed.first(qMax<qsizetype>(space, 0)).toByteArray(),
+                                                          QByteArray::AbortOnBase64DecodingErrors);
+        if (!ok || rank < 0 || !token || token.decoded.isEmpty()) {
+            if (errorString) *errorString = QString("Invalid tiktoken entry on line %1").arg(lineNumber);
+            clear();
+            return false;
+        }
+
+        m_vocab.insert(token.decoded, rank);
+        if (rank >= m_tokens.size())
+            m_tokens.resize(rank + 1);
+        m_tokens[rank] = token.decoded;
+    }
+
+    if (m_vocab.isEmpty() && errorString)
+        *errorString = "Empty vocabulary";
+    return isValid();
+}
+
+bool Tokenizer::loadSentencePiece(const QByteArray &data, QString *errorString)
+{
+    clear();
+    m_format = SentencePiece;
+
+    int id = 0;
+    for (const QByteArrayView line : splitLines(data)) {
+        if (line.isEmpty())
+            continue;
+
+        const qsizetype tab = line.indexOf('\t');
+        bool ok = false;
+        const float score = tab >= 0 ? line.sliced(tab + 1).trimmed().toFloat(&ok) : 0.0f;
+        if (tab <= 0 || !ok) {
+            if (errorString) *errorString = QString("Invalid SentencePiece entry on line %1").arg(id + 1);
+            clear();
+            return false;
+        }
+
+        const QByteArray piece = line.first(tab).toByteArray();
+        m_tokens.append(piece);
+        m_scores.append(score);
+
+        bool isByte = false;
+        const int byte = piece.size() == 6 && piece.startsWith("<0x") && piece.endsWith('>')
+                             ? piece.mid(3, 2).toInt(&isByte, 16) : -1;
+        if (isByte) {
+            m_byteTokens[byte] = id;
+            m_tokens.last() = QByteArray(1, char(byte));
+        } else if (piece == "<unk>") {
+            m_unknownId = id;
+        } else if (piece == "<s>" || piece == "</s>" || piece == "<pad>") {
+            m_tokens.last().clear();
+        } else {
+            m_vocab.insert(piece, id);
+        }
+        ++id;
+    }
+
+    if (m_vocab.isEmpty() && errorString)
+        *errorString = "Empty vocabulary";
+    return isValid();
+}
+
+QList<int> Tokenizer::encode(const QString &text) const
+{
+    QList<int> ids;
+    if (!isValid() || text.isEmpty())
+        return ids;
+
+    if (m_format == SentencePiece) {
+        encodeSentencePiece(text, &ids);
+        return ids;
+    }
+
+    const QByteArray utf8 = text.toUtf8();
+    for (const QByteArrayView piece : preTokenize(utf8))
+        encodeTiktokenPiece(piece, &ids);
+    return ids;
+}
+
+int Tokenizer::countTokens(const QString &text) const
+{
+    if (!isValid() || text.isEmpty())
+        return 0;
+
+    if (m_format == SentencePiece)
+        return encodeSentencePiece(text, nullptr);
+
+    const QByteArray utf8 = text.toUtf8();
+    int count = 0;
+    for (const QByteArrayView piece : preTokenize(utf8))
+        count += encodeTiktokenPiece(piece, nullptr);
+    return count;
+}
+
+QByteArray Tokenizer::decode(const QList<int> &ids) const
+{
+    QByteArray result;
+    for (int id : ids) {
+        if (id >= 0 && id < m_tokens.size())
+            result += m_tokens.at(id);
+    }
+    if (m_format == SentencePiece) {
+        result.replace(SpaceMarker, " ");
+        if (result.startsWith(' '))
+            result.remove(0, 1);
+    }
+    return result;
+}
+
+QList<QByteArrayView> Tokenizer::preTokenize(QByteArrayView s)
+{
+    // The cl100k_base pattern, one alternative after the other:
+    //   (?i:'s|'t|'re|'ve|'m|'ll|'d) | [^\r\n\p{L}\p{N}]?\p{L}+ | \p{N}{1,3}
+    //   | ?[^\s\p{L}\p{N}]+[\r\n]* | \s*[\r\n]+ | \s+(?!\S) | \s+
+    QList<QByteArrayView> pieces;
+    pieces.reserve(s.size() / 4);
+
+    const qsizetype n = s.size();
+    qsizetype i = 0;
+    while (i < n) {
+        const qsizetype start = i;
+        const CodePoint c = decodeAt(s, i);
+        const CharClass cls = classify(c.value);
+
+        if (c.value == '\'') {
+            if (const int length = contractionLength(s, i + 1)) {
+                i += 1 + length;
+                pieces.append(s.sliced(start, i - start));
+                continue;
+            }
+        }
+
+        // Letters, optionally preceded by one character that is neither a newline nor a number.
+        if (cls == Letter
+            || ((cls == Space || cls == Other) && i + c.length < n
+                && classify(decodeAt(s, i + c.length).value) == Letter)) {
+            i += c.length;
+            while (i < n) {
+                const CodePoint d = decodeAt(s, i);
+                if (classify(d.value) != Letter) break;
+                i += d.length;
+            }
+            pieces.append(s.sliced(start, i - start));
+            continue;
+        }
+
+        if (cls == Number) {
+            for (int digits = 0; i < n && digits < 3; ++digits) {
+                const CodePoint d = decodeAt(s, i);
+                if (classify(d.value) != Number) break;
+                i += d.length;
+            }
+            pieces.append(s.sliced(start, i - start));
+            continue;
+        }
+
+        // Punctuation, optionally preceded by a space, with trailing newlines.
+        qsizetype j = c.value == ' ' ? i + 1 : i;
+        qsizetype k = j;
+        while (k < n) {
+            const CodePoint d = decodeAt(s, k);
+            if (classify(d.value) != Other) break;
+            k += d.length;
+        }
+        if (k > j) {
+            while (k < n && (s[k] == '\r' || s[k] == '\n'))
+                ++k;
+            i = k;
+            pieces.append(s.sliced(start, i - start));
+            continue;
+        }
+
+        // Whitespace run.
+        qsizetype end = i;
+        qsizetype lastStart = i;
+        qsizetype afterLastNewline = -1;
+        while (end < n) {
+            const CodePoint d = decodeAt(s, end);
+            const CharClass dcls = classify(d.value);
+            if (dcls != Space && dcls != Newline) break;
+            lastStart = end;
+            end += d.length;
+            if (dcls == Newline)
+                afterLastNewline = end;
+        }
+
+        if (afterLastNewline > 0)
+            i = afterLastNewline;   // \s*[\r\n]+
+        else if (end == n || lastStart == start)
+            i = end;                // \s+ at the end of text, or a single whitespace character
+        else
+            i = lastStart;          // \s+(?!\S): leaves the last one to prefix the next word
+        pieces.append(s.sliced(start, i - start));
+    }
+    return pieces;
+}
+
+int Tokenizer::rank(QByteArrayView bytes) const
+{
+    const auto it = m_vocab.constFind(QByteArray::fromRawData(bytes.data(), bytes.size()));
+    return it == m_vocab.constEnd() ? INT_MAX : it.value();
+}
+
+int Tokenizer::encodeTiktokenPiece(QByteArrayView piece, QList<int> *out) const
+{
+    // Most pieces are a single token.
+    const int whole = rank(piece);
+    if (whole != INT_MAX) {
+        if (out) out->append(whole);
+        return 1;
+    }
+
+    // tiktoken's byte pair merge: repeatedly merge the adjacent pair with the lowest rank.
+    struct Part {
+        qsizetype start;
+        int rank;
+    };
+    QVarLengthArray<Part, 64> parts;
+    const qsizetype n = piece.size();
+    for (qsizetype i = 0; i + 1 < n; ++i)
+        parts.append({i, rank(piece.sliced(i, 2))});
+    parts.append({n - 1, INT_MAX});
+    parts.append({n, INT_MAX});
+
+    // Rank of the token that merging parts i and i + 1 would produce, given that
+    // i + 1 is about to be merged into i.
+    auto mergedRank = [&](qsizetype i) {
+        if (i + 3 < parts.size())
+            return rank(piece.sliced(parts[i].start, parts[i + 3].start - parts[i].start));
+        return INT_MAX;
+    };
+
+    for (;;) {
+        qsizetype best = -1;
+        int bestRank = INT_MAX;
+        for (qsizetype i = 0; i + 1 < parts.size(); ++i) {
+            if (parts[i].rank < bestRank) {
+                bestRank = parts[i].rank;
+                best = i;
+            }
+        }
+        if (best < 0)
+            break;
+
+        if (best > 0)
+            parts[best - 1].rank = mergedRank(best - 1);
+        parts[best].rank = mergedRank(best);
+        parts.remove(best + 1);
+    }
+
+    const int count = int(parts.size() - 1);
+    if (out) {
+        for (qsizetype i = 0; i + 1 < parts.size(); ++i) {
+            const int id = rank(piece.sliced(parts[i].start, parts[i + 1].start - parts[i].start));
+            // Only possible with a vocabulary that lacks some single bytes.
+            out->append(id == INT_MAX ? -1 : id);
+        }
+    }
+    return count;
+}
+
+int Tokenizer::encodeSentencePiece(const QString &text, QList<int> *out) const
+{
+    QByteArray normalized = text.toUtf8();
+    normalized.replace(' ', SpaceMarker);
+    normalized.prepend(SpaceMarker);
+
+    // Symbols form a linked list over the UTF-8 characters of the text.
+    struct Symbol {
+        qsizetype start;
+        qsizetype length;
+        int prev;
+        int next;
+    };
+    std::vector<Symbol> symbols;
+    symbols.reserve(normalized.size());
+    for (qsizetype i = 0; i < normalized.size();) {
+        const int length = decodeAt(normalized, i).length;
+        const int index = int(symbols.size());
+        symbols.push_back({i, length, index - 1, index + 1});
+        i += length;
+    }
+    symbols.back().next = -1;
+
+    struct Bigram {
+        float score;
+        int left;
+        qsizetype length;
+        bool operator<(const Bigram &other) const
+        {
+            // Highest score first, leftmost on ties.
+            return score < other.score || (score == other.score && left > other.left);
+        }
+    };
+    std::priority_queue<Bigram> queue;
+    auto tryAdd = [&](int left, int right) {
+        if (left < 0 || right < 0)
+            return;
+        const qsizetype length = symbols[left].length + symbols[right].length;
+        const auto it = m_vocab.constFind(QByteArray::fromRawData(normalized.constData() + symbols[left].start, length));
+        if (it != m_vocab.constEnd())
+            queue.push({m_scores.at(it.value()), left, length});
+    };
+
+    for (int i = 1; i < int(symbols.size()); ++i)
+        tryAdd(i - 1, i);
+
+    while (!queue.empty()) {
+        const Bigram bigram = queue.top();
+        queue.pop();
+
+        Symbol &left = symbols[bigram.left];
+        if (left.length == 0 || left.next < 0)
+            continue;
+        Symbol &right = symbols[left.next];
+        // Stale entry: one side was merged into something else since it was queued.
+        if (left.length + right.length != bigram.length)
+            continue;
+
+        left.length += right.length;
+        right.length = 0;
+        left.next = right.next;
+        if (right.next >= 0)
+            symbols[right.next].prev = bigram.left;
+
+        tryAdd(left.prev, bigram.left);
+        tryAdd(bigram.left, left.next);
+    }
+
+    int count = 0;
+    for (int i = 0; i >= 0; i = symbols[i].next) {
+        const Symbol &symbol = symbols[i];
+        const auto it = m_vocab.constFind(QByteArray::fromRawData(normalized.constData() + symbol.start, symbol.length));
+        if (it != m_vocab.constEnd()) {
+            if (out) out->append(it.value());
+            ++count;
+            continue;
+        }
+        // Byte fallback, or one unknown token for the whole character.
+        for (qsizetype b = 0; b < symbol.length; ++b) {
+            const int id = m_byteTokens[uchar(normalized[symbol.start + b])];
+            if (id < 0) {
+                if (out) out->append(m_unknownId);
+                ++count;
+                break;
+            }
+            if (out) out->append(id);
+            ++count;
+        }
+    }
+    return count;
+}
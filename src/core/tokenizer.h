@@ -0,0 +1,60 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Byte-pair encoding tokenizer compatible with the two vocabulary formats that
+// cover most chat models:
+//  - tiktoken rank files ("<base64 token> <rank>" per line, e.g. cl100k_base.tiktoken,
+//    o200k_base.tiktoken), encoded like tiktoken with a cl100k-style pre-tokenizer;
+//  - SentencePiece vocab files ("<piece>\t<score>" per line, as written next to a
+//    .model by spm_train), encoded like llama's SPM BPE tokenizer with byte fallback.
+// Special tokens are not matched in the input, they are counted as plain text.
+//
+// All encoding methods are const and safe to call from several threads.
+class Tokenizer
+{
+public:
+    enum Format {
+        Tiktoken,
+        SentencePiece
+    };
+
+    Tokenizer();
+
+    // Detects the format from the first line of the file.
+    bool load(const QString &path, QString *errorString = nullptr);
+    bool loadTiktoken(const QByteArray &data, QString *errorString = nullptr);
+    bool loadSentencePiece(const QByteArray &data, QString *errorString = nullptr);
+
+    bool isValid() const { return !m_vocab.isEmpty(); }
+    Format format() const { return m_format; }
+    int vocabularySize() const { return m_tokens.size(); }
+
+    QList<int> encode(const QString &text) const;
+    int countTokens(const QString &text) const;
+    QByteArray decode(const QList<int> &ids) const;
+
+    // Splits UTF-8 text into the pieces that tiktoken merges independently. Same
+    // result as the cl100k_base regular expression, without a regex engine.
+    static QList<QByteArrayView> preTokenize(QByteArrayView utf8);
+
+private:
+    void clear();
+    int rank(QByteArrayView bytes) const;
+    int encodeTiktokenPiece(QByteArrayView piece, QList<int> *out) const;
+    int encodeSentencePiece(const QString &text, QList<int> *out) const;
+
+    Format m_format = Tiktoken;
+    QHash<QByteArray, int> m_vocab;   // Mergeable token bytes -> rank or id.
+    QList<QByteArray> m_tokens;       // Id -> token bytes.
+    QList<float> m_scores;            // SentencePiece merge scores by id.
+    int m_byteTokens[256];            // SentencePiece <0xXX> byte fallback ids.
+    int m_unknownId = -1;
+};
+
+#endif // TOKENIZER_H
@@ -0,0 +1,197 @@
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QThread>
+
+namespace {
+// Bounds memory when tracing is left on in a long session, ~100 MB of JSON.
+constexpr qsizetype MaxEvents = 500000;
+}
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer()
+{
+    m_clock.start();
+    setOutputFile(qEnvironmentVariable("QLP_TRACE_FILE"));
+}
+
+Tracer::~Tracer()
+{
+    // In case the plugin did not get to shut down cleanly.
+    flush();
+}
+
+QString Tracer::outputFile() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_outputFile;
+}
+
+void Tracer::setOutputFile(const QString &path)
+{
+    QMutexLocker locker(&m_mutex);
+    m_outputFile = path;
+    m_enabled = !path.isEmpty();
+}
+
+qint64 Tracer::nowUs() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+void Tracer::complete(const QString &name, const QString &category, qint64 startUs, qint64 durationUs,
+                      const QJsonObject &args)
+{
+    if (!m_enabled) return;
+
+    QJsonObject event{{"name", name}, {"cat", category}, {"ph", "X"},
+                      {"ts", startUs}, {"dur", durationUs}};
+    if (!args.isEmpty()) event["args"] = args;
+    record(event);
+}
+
+void Tracer::asyncBegin(const QString &name, const QString &category, quint64 id, const QJsonObject &args)
+{
+    if (!m_enabled) return;
+
+    QJsonObject event{{"name", name}, {"cat", category}, {"ph", "b"},
+                      {"id", QString::number(id)}, {"ts", nowUs()}};
+    if (!args.isEmpty()) event["args"] = args;
+    record(event);
+}
+
+void Tracer::asyncEnd(const QString &name, const QString &category, quint64 id, const QJsonObject &args)
+{
+    if (!m_enabled) return;
+
+    QJsonObject event{{"name", name}, {"cat", category}, {"ph", "e"},
+                      {"id", QString::number(id)}, {"ts", nowUs()}};
+    if (!args.isEmpty()) event["args"] = args;
+    record(event);
+}
+
+void Tracer::instant(const QString &name, const QString &category, const QJsonObject &args)
+{
+    if (!m_enabled) return;
+
+    QJsonObject event{{"name", name}, {"cat", category}, {"ph", "i"}, {"s", "t"}, {"ts", nowUs()}};
+    if (!args.isEmpty()) event["args"] = args;
+    record(event);
+}
+
+QJsonArray Tracer::events() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_events;
+}
+
+void Tracer::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_events = QJsonArray();
+    m_threadIds.clear();
+    m_droppedEvents = 0;
+}
+
+bool Tracer::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_outputFile.isEmpty() || m_events.isEmpty()) return false;
+
+    QJsonObject root;
+    root["traceEvents"] = m_events;
+    root["displayTimeUnit"] = "ms";
+    if (m_droppedEvents > 0)
+        root["otherData"] = QJsonObject{{"droppedEvents", m_droppedEvents}};
+
+    QFile file(m_outputFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Tracer: cannot write" << m_outputFile << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return true;
+}
+
+void Tracer::record(QJsonObject event)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_events.size() >= MaxEvents) {
+        ++m_droppedEvents;
+        return;
+    }
+    event["pid"] = QCoreApplication::applicationPid();
+    event["tid"] = currentThreadId();
+    m_events.append(event);
+}
+
+int Tracer::currentThreadId()
+{
+    // Called with m_mutex held. Threads get small ids and a name on first use,
+    // which keeps the tracks in the viewer readable.
+    const auto key = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    auto it = m_threadIds.constFind(key);
+    if (it != m_threadIds.constEnd())
+        return it.value();
+
+    const int tid = m_threadIds.size() + 1;
+    m_threadIds.insert(key, tid);
+
+    QString threadName = QThread::currentThread()->objectName();
+    if (threadName.isEmpty())
+        threadName = QCoreApplication::instance() && QCoreApplication::instance()->thread() == QThread::currentThread()
+                         ? QStringLiteral("main")
+                         : QString("thread %1").arg(tid);
+    m_events.append(QJsonObject{{"name", "thread_name"}, {"ph", "M"},
+                                {"pid", QCoreApplication::applicationPid()}, {"tid", tid},
+                                {"args", QJsonObject{{"name", threadName}}}});
+    return tid;
+}
+
+TraceSpan::TraceSpan(const char *name, const char *category)
+{
+    Tracer &tracer = Tracer::instance();
+    if (!tracer.isEnabled()) return;
+
+    m_name = QLatin1StringView(name);
+    m_category = QLatin1StringView(category);
+    m_startUs = tracer.nowUs();
+}
+
+TraceSpan::TraceSpan(const QString &name, const char *category)
+{
+    Tracer &tracer = Tracer::instance();
+    if (!tracer.isEnabled()) return;
+
+    m_name = name;
+    m_category = QLatin1StringView(category);
+    m_startUs = tracer.nowUs();
+}
+
+TraceSpan::~TraceSpan()
+{
+    end();
+}
+
+void TraceSpan::setArg(const char *key, const QJsonValue &value)
+{
+    if (m_startUs >= 0)
+        m_args[QLatin1StringView(key)] = value;
+}
+
+void TraceSpan::end()
+{
+    if (m_startUs < 0) return;
+
+    Tracer &tracer = Tracer::instance();
+    tracer.complete(m_name, m_category, m_startUs, tracer.nowUs() - m_startUs, m_args);
+    m_startUs = -1;
+}
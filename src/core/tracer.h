@@ -0,0 +1,90 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+
+// Records spans of an agent turn as Chrome trace-event JSON, which can be opened
+// in Perfetto (ui.perfetto.dev) or chrome://tracing.
+//
+// Tracing is off unless QLP_TRACE_FILE names an output file (or setOutputFile()
+// is called). When it is off, every call returns after a single flag check; the
+// QStrings and QJsonObjects passed to it are still built by the caller, so hot
+// paths use TraceSpan or check isEnabled() first.
+class Tracer
+{
+public:
+    static Tracer &instance();
+
+    bool isEnabled() const { return m_enabled; }
+    QString outputFile() const;
+    // Enables tracing into the given file, an empty path disables it.
+    void setOutputFile(const QString &path);
+
+    // Microseconds since the tracer was created, the time base of all events.
+    qint64 nowUs() const;
+
+    // A span on the calling thread.
+    void complete(const QString &name, const QString &category, qint64 startUs, qint64 durationUs,
+                  const QJsonObject &args = QJsonObject());
+    // Spans that start and end in different callbacks, e.g. a streamed request.
+    // Spans with the same category and id nest into one track.
+    void asyncBegin(const QString &name, const QString &category, quint64 id,
+                    const QJsonObject &args = QJsonObject());
+    void asyncEnd(const QString &name, const QString &category, quint64 id,
+                  const QJsonObject &args = QJsonObject());
+    void instant(const QString &name, const QString &category, const QJsonObject &args = QJsonObject());
+
+    QJsonArray events() const;
+    void clear();
+
+    // Writes all events recorded so far to the output file.
+    bool flush();
+
+private:
+    Tracer();
+    ~Tracer();
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    void record(QJsonObject event);
+    int currentThreadId();
+
+    std::atomic<bool> m_enabled{false};
+    QString m_outputFile;
+    QElapsedTimer m_clock;
+
+    mutable QMutex m_mutex;
+    QJsonArray m_events;
+    QHash<quintptr, int> m_threadIds;
+    int m_droppedEvents = 0;
+};
+
+// Records the time from construction to end() or destruction as one span.
+// Names, categories and keys are Latin-1 literals, turned into strings only
+// when tracing is enabled.
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name, const char *category = "qlp");
+    // For names built at run time.
+    explicit TraceSpan(const QString &name, const char *category = "qlp");
+    ~TraceSpan();
+
+    void setArg(const char *key, const QJsonValue &value);
+    void end();
+
+private:
+    QString m_name;
+    QString m_category;
+    QJsonObject m_args;
+    qint64 m_startUs = -1;
+};
+
+#endif // TRACER_H
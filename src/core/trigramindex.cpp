@@ -0,0 +1,856 @@
+#include "trigramindex.h"
+#include "codesearch.h"
+#include "gitignore.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr char Magic[8] = {'Q', 'L', 'P', 'T', 'R', 'I', 'G', 'M'};
+constexpr quint32 FormatVersion = 1;
+// magic, version, file count, trigram count, reserved, 4 section offsets.
+constexpr qsizetype HeaderSize = 8 + 4 * 4 + 4 * 8;
+// size, modification time (ms), path offset, path length.
+constexpr qsizetype FileEntrySize = 8 + 8 + 4 + 4;
+// trigram, posting count, posting offset.
+constexpr qsizetype TrigramEntrySize = 4 + 4 + 8;
+
+// Above this many changed files the overlay is folded into a rebuilt index.
+constexpr qsizetype RebuildThreshold = 2000;
+// Stays clear of the default inotify limit of 8192 watches per user.
+constexpr int MaxWatchedDirectories = 4000;
+constexpr int RefreshDelayMs = 300;
+// How often queries start a walk of a tree that is not watched completely.
+constexpr qint64 FullRefreshIntervalMs = 60 * 1000;
+
+uchar foldCase(uchar c)
+{
+    return (c >= 'A' && c <= 'Z') ? uchar(c - 'A' + 'a') : c;
+}
+
+quint32 trigramAt(const uchar *p)
+{
+    return (quint32(foldCase(p[0])) << 16) | (quint32(foldCase(p[1])) << 8) | foldCase(p[2]);
+}
+
+void appendTrigrams(QByteArrayView bytes, std::vector<quint32> *out)
+{
+    const auto *p = reinterpret_cast<const uchar *>(bytes.data());
+    for (qsizetype i = 0; i + 3 <= bytes.size(); ++i)
+        out->push_back(trigramAt(p + i));
+}
+
+void sortUnique(std::vector<quint32> *trigrams)
+{
+    std::sort(trigrams->begin(), trigrams->end());
+    trigrams->erase(std::unique(trigrams->begin(), trigrams->end()), trigrams->end());
+}
+
+void appendVarint(QByteArray *out, quint32 value)
+{
+    while (value >= 0x80) {
+        out->append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->append(char(value));
+}
+
+template<typename T>
+void appendLittleEndian(QByteArray *out, T value)
+{
+    const T le = qToLittleEndian(value);
+    out->append(reinterpret_cast<const char *>(&le), sizeof(T));
+}
+
+template<typename T>
+T readLittleEndian(const uchar *p)
+{
+    return qFromLittleEndian<T>(p);
+}
+
+struct Posting {
+    QByteArray ids;   // Delta-encoded varints.
+    quint32 last = 0;
+    quint32 count = 0;
+};
+
+} // namespace
+
+// A loaded index file: header fields, the memory-mapped (or, when the project is
+// read-only, in-memory) bytes, and the path -> id table. Immutable.
+struct TrigramIndex::Snapshot
+{
+    QFile file;
+    QByteArray buffer;
+    const uchar *data = nullptr;
+    qint64 size = 0;
+
+    quint32 fileCount = 0;
+    quint32 trigramCount = 0;
+    quint64 filesOffset = 0;
+    quint64 pathsOffset = 0;
+    quint64 trigramsOffset = 0;
+    quint64 postingsOffset = 0;
+
+    QHash<QString, quint32> ids;
+    QSet<QString> directories;   // Relative, of every indexed file.
+
+    bool parse();
+
+    QString path(quint32 id) const
+    {
+        const uchar *entry = data + filesOffset + id * FileEntrySize;
+        const quint32 offset = readLittleEndian<quint32>(entry + 16);
+        const quint32 length = readLittleEndian<quint32>(entry + 20);
+        return QString::fromUtf8(reinterpret_cast<const char *>(data + pathsOffset + offset), length);
+    }
+    qint64 fileSize(quint32 id) const { return readLittleEndian<qint64>(data + filesOffset + id * FileEntrySize); }
+    qint64 modified(quint32 id) const { return readLittleEndian<qint64>(data + filesOffset + id * FileEntrySize + 8); }
+
+    std::vector<quint32> postings(quint32 trigram) const;
+};
+
+bool TrigramIndex::Snapshot::parse()
+{
+    if (size < HeaderSize || std::memcmp(data, Magic, sizeof(Magic)) != 0)
+        return false;
+    if (readLittleEndian<quint32>(data + 8) != FormatVersion)
+        return false;
+    fileCount = readLittleEndian<quint32>(data + 12);
+    trigramCount = readLittleEndian<quint32>(data + 16);
+    filesOffset = readLittleEndian<quint64>(data + 24);
+    pathsOffset = readLittleEndian<quint64>(data + 32);
+    trigramsOffset = readLittleEndian<quint64>(data + 40);
+    postingsOffset = readLittleEndian<quint64>(data + 48);
+
+    const auto fits = [this](quint64 offset, quint64 length) {
+        return offset <= quint64(size) && length <= quint64(size) - offset;
+    };
+    if (!fits(filesOffset, quint64(fileCount) * FileEntrySize)
+        || !fits(trigramsOffset, quint64(trigramCount) * TrigramEntrySize)
+        || pathsOffset > quint64(size) || postingsOffset > quint64(size))
+        return false;
+
+    ids.reserve(fileCount);
+    for (quint32 id = 0; id < fileCount; ++id) {
+        const uchar *entry = data + filesOffset + id * FileEntrySize;
+        if (!fits(pathsOffset + readLittleEndian<quint32>(entry + 16), readLittleEndian<quint32>(entry + 20)))
+            return false;
+        const QString relativePath = path(id);
+        ids.insert(relativePath, id);
+        directories.insert(CodeSearch::parentDirectory(relativePath));
+    }
+    return true;
+}
+
+std::vector<quint32> TrigramIndex::Snapshot::postings(quint32 trigram) const
+{
+    // The trigram table is sorted, binary search it.
+    quint32 low = 0;
+    quint32 high = trigramCount;
+    while (low < high) {
+        const quint32 middle = low + (high - low) / 2;
+        const quint32 value = readLittleEndian<quint32>(data + trigramsOffset + middle * TrigramEntrySize);
+        if (value < trigram)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    std::vector<quint32> result;
+    const uchar *entry = data + trigramsOffset + low * TrigramEntrySize;
+    if (low >= trigramCount || readLittleEndian<quint32>(entry) != trigram)
+        return result;
+
+    const quint32 count = readLittleEndian<quint32>(entry + 4);
+    const uchar *p = data + postingsOffset + readLittleEndian<quint64>(entry + 8);
+    const uchar *end = data + size;
+    result.reserve(count);
+    quint32 id = 0;
+    for (quint32 i = 0; i < count && p < end; ++i) {
+        quint32 delta = 0;
+        int shift = 0;
+        while (p < end && (*p & 0x80)) {
+            delta |= quint32(*p++ & 0x7f) << shift;
+            shift += 7;
+        }
+        if (p < end)
+            delta |= quint32(*p++) << shift;
+        id += delta;
+        if (id < fileCount)
+            result.push_back(id);
+    }
+    return result;
+}
+
+TrigramIndex::TrigramIndex(QObject *parent)
+    : QObject(parent)
+{
+    // One background thread: builds and refreshes of a project are ordered.
+    m_pool.setMaxThreadCount(1);
+
+    m_refreshTimer.setSingleShot(true);
+    m_refreshTimer.setInterval(RefreshDelayMs);
+    connect(&m_refreshTimer, &QTimer::timeout, this, [this]() {
+        const QStringList directories(m_pendingDirectories.cbegin(), m_pendingDirectories.cend());
+        m_pendingDirectories.clear();
+        const quint64 generation = m_generation;
+        const QString root = projectPath();
+        m_pool.start([this, generation, root, directories]() {
+            refreshDirectories(generation, root, directories);
+        });
+    });
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &TrigramIndex::scheduleRefresh);
+}
+
+TrigramIndex::~TrigramIndex()
+{
+    ++m_generation;
+    m_pool.waitForDone();
+}
+
+QString TrigramIndex::indexFilePath(const QString &projectPath)
+{
+    return projectPath + "/.qtagent/trigram.idx";
+}
+
+void TrigramIndex::setProjectPath(const QString &projectPath)
+{
+    const QString root = projectPath.isEmpty() ? QString() : QDir::cleanPath(projectPath);
+    if (root == this->projectPath())
+        return;
+
+    const quint64 generation = ++m_generation;
+    {
+        QWriteLocker locker(&m_lock);
+        m_root = root;
+        m_snapshot.reset();
+        m_overlay.clear();
+    }
+    m_rebuildScheduled = false;
+    m_partlyWatched = false;
+    m_pendingDirectories.clear();
+    m_refreshTimer.stop();
+    if (!m_watcher.directories().isEmpty())
+        m_watcher.removePaths(m_watcher.directories());
+
+    if (root.isEmpty())
+        return;
+
+    m_pool.start([this, generation, root]() {
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->file.setFileName(indexFilePath(root));
+        if (snapshot->file.open(QIODevice::ReadOnly)) {
+            snapshot->size = snapshot->file.size();
+            snapshot->data = snapshot->file.map(0, snapshot->size);
+        }
+        if (!snapshot->data || !snapshot->parse()) {
+            build(generation, root);
+            return;
+        }
+
+        QStringList directories;
+        for (const QString &directory : std::as_const(snapshot->directories))
+            directories.append(directory.isEmpty() ? root : root + '/' + directory);
+        install(generation, snapshot, 0, directories);
+        // Catches up with what changed while the project was closed.
+        refreshAll(generation, root);
+    });
+}
+
+QString TrigramIndex::projectPath() const
+{
+    QReadLocker locker(&m_lock);
+    return m_root;
+}
+
+bool TrigramIndex::isReady() const
+{
+    QReadLocker locker(&m_lock);
+    return m_snapshot != nullptr;
+}
+
+std::optional<QStringList> TrigramIndex::candidates(const QString &pattern, bool regex)
+{
+    const std::vector<quint32> trigrams = requiredTrigrams(pattern, regex);
+    if (trigrams.empty())
+        return std::nullopt;
+
+    QReadLocker locker(&m_lock);
+    if (!m_snapshot)
+        return std::nullopt;
+
+    // Intersect the posting lists, shortest first.
+    std::vector<std::vector<quint32>> lists;
+    lists.reserve(trigrams.size());
+    for (const quint32 trigram : trigrams)
+        lists.push_back(m_snapshot->postings(trigram));
+    std::sort(lists.begin(), lists.end(), [](const auto &a, const auto &b) { return a.size() < b.size(); });
+
+    std::vector<quint32> ids = lists.front();
+    std::vector<quint32> intersection;
+    for (size_t i = 1; i < lists.size() && !ids.empty(); ++i) {
+        intersection.clear();
+        std::set_intersection(ids.begin(), ids.end(), lists[i].begin(), lists[i].end(),
+                              std::back_inserter(intersection));
+        ids.swap(intersection);
+    }
+
+    QStringList files;
+    files.reserve(qsizetype(ids.size()));
+    for (const quint32 id : ids) {
+        const QString relativePath = m_snapshot->path(id);
+        if (!m_overlay.contains(relativePath))
+            files.append(m_root + '/' + relativePath);
+    }
+    for (auto it = m_overlay.cbegin(); it != m_overlay.cend(); ++it) {
+        const OverlayEntry &entry = it.value();
+        if (!entry.removed && std::includes(entry.trigrams.begin(), entry.trigrams.end(),
+                                            trigrams.begin(), trigrams.end()))
+            files.append(m_root + '/' + it.key());
+    }
+
+    // What the index read of every file, checked against the disk below.
+    QList<FileState> indexed;
+    indexed.reserve(m_snapshot->ids.size() + m_overlay.size());
+    for (auto it = m_snapshot->ids.cbegin(); it != m_snapshot->ids.cend(); ++it) {
+        if (!m_overlay.contains(it.key()))
+            indexed.append(FileState{it.key(), m_snapshot->fileSize(it.value()), m_snapshot->modified(it.value()), {}});
+    }
+    for (auto it = m_overlay.cbegin(); it != m_overlay.cend(); ++it) {
+        if (!it->removed)
+            indexed.append(FileState{it.key(), it->size, it->modified, {}});
+    }
+    const QString root = m_root;
+    locker.unlock();
+
+    // Directory watches do not report files written in place, and not every
+    // directory is watched. Files that changed may match whatever their
+    // trigrams were, CodeSearch reads them anyway.
+    QStringList changed;
+    for (const FileState &file : std::as_const(indexed)) {
+        const QFileInfo info(root + '/' + file.relativePath);
+        if (info.size() != file.size || info.lastModified().toMSecsSinceEpoch() != file.modified || !info.isFile())
+            changed.append(info.filePath());
+    }
+    if (!changed.isEmpty()) {
+        const QSet<QString> listed(files.cbegin(), files.cend());
+        for (const QString &file : std::as_const(changed)) {
+            if (!listed.contains(file) && QFileInfo(file).isFile())
+                files.append(file);
+        }
+        updateFiles(changed);
+    }
+
+    // New files in directories that are not watched.
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 lastFullRefresh = m_lastFullRefreshMs;
+    if (m_partlyWatched && now - lastFullRefresh > FullRefreshIntervalMs
+        && m_lastFullRefreshMs.compare_exchange_strong(lastFullRefresh, now)) {
+        const quint64 generation = m_generation;
+        m_pool.start([this, generation, root]() { refreshAll(generation, root); });
+    }
+    return files;
+}
+
+void TrigramIndex::updateFiles(const QStringList &filePaths)
+{
+    const quint64 generation = m_generation;
+    const QString root = projectPath();
+    if (root.isEmpty())
+        return;
+
+    QStringList relativePaths;
+    const QDir rootDir(root);
+    for (const QString &filePath : filePaths) {
+        if (const auto relativePath = CodeSearch::relativeTreePath(rootDir, filePath))
+            relativePaths.append(*relativePath);
+    }
+    if (relativePaths.isEmpty())
+        return;
+
+    m_pool.start([this, generation, root, relativePaths]() {
+        QList<FileState> changes;
+        for (const QString &relativePath : relativePaths) {
+            const auto ignore = GitIgnore::forTree(root, CodeSearch::parentDirectory(relativePath));
+            if (ignore && ignore->isIgnored(relativePath, false))
+                continue;
+            changes.append(readFile(root, relativePath));
+        }
+        applyChanges(generation, changes);
+    });
+}
+
+std::vector<quint32> TrigramIndex::requiredTrigrams(const QString &pattern, bool regex)
+{
+    std::vector<quint32> trigrams;
+    if (!regex) {
+        appendTrigrams(pattern.toUtf8(), &trigrams);
+        sortUnique(&trigrams);
+        return trigrams;
+    }
+
+    // Collects the runs of literal characters outside of groups and classes. A
+    // quantifier that allows zero repetitions drops the character before it.
+    QByteArray run;
+    const auto flush = [&]() {
+        appendTrigrams(run, &trigrams);
+        run.clear();
+    };
+    // The index of the last character of what starts at from: up to the
+    // closing character, or the characters that match.
+    const auto skipTo = [&pattern](qsizetype from, QChar close) {
+        const qsizetype end = pattern.indexOf(close, from);
+        return end < 0 ? pattern.size() - 1 : end;
+    };
+    const auto skipWhile = [&pattern](qsizetype from, qsizetype maxCount, auto predicate) {
+        qsizetype i = from;
+        while (i < pattern.size() && i - from < maxCount && predicate(pattern[i]))
+            ++i;
+        return i - 1;
+    };
+    const auto isHexDigit = [](QChar c) { return c.isDigit() || (c.toLower() >= u'a' && c.toLower() <= u'f'); };
+    const auto isDigit = [](QChar c) { return c.isDigit(); };
+
+    int depth = 0;
+    bool inClass = false;
+    for (qsizetype i = 0; i < pattern.size(); ++i) {
+        const QChar c = pattern[i];
+        if (inClass) {
+            if (c == u'\\')
+                ++i;
+            else if (c == u']')
+                inClass = false;
+            continue;
+        }
+
+        QChar literal = c;
+        if (c == u'\\') {
+            if (i + 1 >= pattern.size() || pattern[i + 1].isLetterOrNumber()) {
+                // \w, \d, \b, back references, ... and their arguments, which
+                // are not literal text either.
+                flush();
+                const QChar escape = ++i < pattern.size() ? pattern[i] : QChar();
+                if (escape == u'Q') {
+                    i = skipTo(i, u'\\') + 1;   // To \E.
+                } else if (i + 1 < pattern.size() && pattern[i + 1] == u'{') {
+                    i = skipTo(i + 1, u'}');   // \x{41}, \p{L}, \g{1}, \N{U+41}, ...
+                } else if (escape == u'x') {
+                    i = skipWhile(i + 1, 2, isHexDigit);
+                } else if (escape == u'u') {
+                    i = skipWhile(i + 1, 4, isHexDigit);
+                } else if (escape == u'p' || escape == u'P' || escape == u'c') {
+                    ++i;
+                } else if (escape == u'k' || escape == u'g') {
+                    if (i + 1 < pattern.size() && (pattern[i + 1] == u'<' || pattern[i + 1] == u'\''))
+                        i = skipTo(i + 2, pattern[i + 1] == u'<' ? u'>' : u'\'');
+                    else
+                        i = skipWhile(i + 1, pattern.size(), [](QChar d) { return d.isDigit() || d == u'-' || d == u'+'; });
+                } else if (escape.isDigit()) {
+                    i = skipWhile(i + 1, pattern.size(), isDigit);
+                }
+                continue;
+            }
+            literal = pattern[++i];
+        } else if (c == u'[') {
+            flush();
+            inClass = true;
+            continue;
+        } else if (c == u'(') {
+            flush();
+            ++depth;
+            continue;
+        } else if (c == u')') {
+            flush();
+            --depth;
+            continue;
+        } else if (c == u'|') {
+            if (depth == 0)
+                return {};
+            continue;
+        } else if (c == u'*' || c == u'?' || c == u'{') {
+            if (depth == 0)
+                run.chop(1);
+            flush();
+            // The bounds of a counted quantifier, {2} or {1,3}, are not literal text.
+            if (c == u'{')
+                i = skipTo(i, u'}');
+            continue;
+        } else if (c == u'.' || c == u'^' || c == u'$' || c == u'+') {
+            flush();
+            continue;
+        }
+
+        if (depth > 0)
+            continue;
+        // Only ASCII is case-folded the same way by the index and the regex engine.
+        if (literal.unicode() > 0x7f) {
+            flush();
+            continue;
+        }
+        run.append(char(literal.unicode()));
+    }
+    flush();
+    sortUnique(&trigrams);
+    return trigrams;
+}
+
+TrigramIndex::FileState TrigramIndex::readFile(const QString &root, const QString &relativePath)
+{
+    FileState state;
+    state.relativePath = relativePath;
+
+    QFile file(root + '/' + relativePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return state;
+    const QFileInfo info(file);
+    state.size = info.size();
+    state.modified = info.lastModified().toMSecsSinceEpoch();
+    if (state.size > CodeSearch::Options().maxFileSize)
+        return state;
+
+    QByteArray buffer;
+    QByteArrayView data;
+    if (state.size > 0) {
+        if (const uchar *mapped = file.map(0, state.size)) {
+            data = QByteArrayView(mapped, state.size);
+        } else {
+            buffer = file.readAll();
+            data = buffer;
+        }
+    }
+    // Binary files are not searched, they do not need trigrams.
+    if (CodeSearch::isBinary(data))
+        return state;
+
+    std::vector<quint32> trigrams;
+    trigrams.reserve(size_t(data.size()));
+    appendTrigrams(data, &trigrams);
+    sortUnique(&trigrams);
+    state.trigrams = std::move(trigrams);
+    return state;
+}
+
+void TrigramIndex::build(quint64 generation, const QString &root)
+{
+    quint64 sequence;
+    {
+        QReadLocker locker(&m_lock);
+        sequence = m_sequence;
+    }
+
+    QMutex mutex;
+    QList<FileState> files;
+    QHash<quint32, Posting> postings;
+    QStringList directories;
+    CodeSearch::forEachFile(root, CodeSearch::Options(), [&](const QFileInfo &, const QString &relativePath) {
+        if (isStale(generation))
+            return false;
+        FileState state = readFile(root, relativePath);
+        if (!state.trigrams)
+            return true;
+
+        QMutexLocker locker(&mutex);
+        const auto id = quint32(files.size());
+        for (const quint32 trigram : *state.trigrams) {
+            Posting &posting = postings[trigram];
+            appendVarint(&posting.ids, id - posting.last);
+            posting.last = id;
+            ++posting.count;
+        }
+        state.trigrams.reset();
+        files.append(std::move(state));
+        return true;
+    }, [&](const QString &directory, const QString &) {
+        QMutexLocker locker(&mutex);
+        directories.append(directory);
+    });
+    if (isStale(generation))
+        return;
+
+    QList<quint32> trigrams = postings.keys();
+    std::sort(trigrams.begin(), trigrams.end());
+
+    QByteArray paths;
+    QByteArray fileTable;
+    for (const FileState &file : std::as_const(files)) {
+        const QByteArray path = file.relativePath.toUtf8();
+        appendLittleEndian<qint64>(&fileTable, file.size);
+        appendLittleEndian<qint64>(&fileTable, file.modified);
+        appendLittleEndian<quint32>(&fileTable, quint32(paths.size()));
+        appendLittleEndian<quint32>(&fileTable, quint32(path.size()));
+        paths += path;
+    }
+    QByteArray trigramTable;
+    quint64 postingsSize = 0;
+    for (const quint32 trigram : std::as_const(trigrams)) {
+        const Posting &posting = postings[trigram];
+        appendLittleEndian<quint32>(&trigramTable, trigram);
+        appendLittleEndian<quint32>(&trigramTable, posting.count);
+        appendLittleEndian<quint64>(&trigramTable, postingsSize);
+        postingsSize += quint64(posting.ids.size());
+    }
+
+    const quint64 filesOffset = HeaderSize;
+    const quint64 pathsOffset = filesOffset + quint64(fileTable.size());
+    const quint64 trigramsOffset = pathsOffset + quint64(paths.size());
+    const quint64 postingsOffset = trigramsOffset + quint64(trigramTable.size());
+
+    QByteArray bytes;
+    bytes.reserve(qsizetype(postingsOffset + postingsSize));
+    bytes.append(Magic, sizeof(Magic));
+    appendLittleEndian<quint32>(&bytes, FormatVersion);
+    appendLittleEndian<quint32>(&bytes, quint32(files.size()));
+    appendLittleEndian<quint32>(&bytes, quint32(trigrams.size()));
+    appendLittleEndian<quint32>(&bytes, 0);
+    appendLittleEndian<quint64>(&bytes, filesOffset);
+    appendLittleEndian<quint64>(&bytes, pathsOffset);
+    appendLittleEndian<quint64>(&bytes, trigramsOffset);
+    appendLittleEndian<quint64>(&bytes, postingsOffset);
+    bytes += fileTable;
+    bytes += paths;
+    bytes += trigramTable;
+    for (const quint32 trigram : std::as_const(trigrams))
+        bytes += postings[trigram].ids;
+    postings.clear();
+
+    // Written next to the project, so that the next session starts with it.
+    auto snapshot = std::make_shared<Snapshot>();
+    const QString indexPath = indexFilePath(root);
+    QDir().mkpath(QFileInfo(indexPath).absolutePath());
+    QFile gitignore(QFileInfo(indexPath).absolutePath() + "/.gitignore");
+    if (!gitignore.exists() && gitignore.open(QIODevice::WriteOnly))
+        gitignore.write("*\n");
+    QSaveFile file(indexPath);
+    if (file.open(QIODevice::WriteOnly) && file.write(bytes) == bytes.size() && file.commit()) {
+        snapshot->file.setFileName(indexPath);
+        if (snapshot->file.open(QIODevice::ReadOnly)) {
+            snapshot->size = snapshot->file.size();
+            snapshot->data = snapshot->file.map(0, snapshot->size);
+        }
+    }
+    if (!snapshot->data) {
+        // Read-only project: keep the index in memory for this session.
+        snapshot->buffer = bytes;
+        snapshot->data = reinterpret_cast<const uchar *>(snapshot->buffer.constData());
+        snapshot->size = snapshot->buffer.size();
+    }
+    if (!snapshot->parse())
+        return;
+
+    install(generation, snapshot, sequence, directories);
+}
+
+void TrigramIndex::install(quint64 generation, std::shared_ptr<const Snapshot> snapshot, quint64 sequence,
+                           const QStringList &directories)
+{
+    {
+        QWriteLocker locker(&m_lock);
+        if (isStale(generation))
+            return;
+        m_snapshot = std::move(snapshot);
+        // Changes seen before the build started are part of it now.
+        m_overlay.removeIf([sequence](QHash<QString, OverlayEntry>::iterator it) {
+            return it.value().sequence <= sequence;
+        });
+    }
+    m_rebuildScheduled = false;
+    watchDirectories(generation, directories);
+}
+
+void TrigramIndex::refreshAll(quint64 generation, const QString &root)
+{
+    std::shared_ptr<const Snapshot> snapshot;
+    QHash<QString, OverlayEntry> overlay;
+    {
+        QReadLocker locker(&m_lock);
+        snapshot = m_snapshot;
+        overlay = m_overlay;
+    }
+    if (!snapshot || isStale(generation))
+        return;
+    m_lastFullRefreshMs = QDateTime::currentMSecsSinceEpoch();
+
+    // Only stats files, the ones whose size or time changed are read again.
+    QMutex mutex;
+    QStringList changed;
+    QStringList directories;
+    std::vector<char> seen(snapshot->fileCount, 0);
+    CodeSearch::forEachFile(root, CodeSearch::Options(), [&](const QFileInfo &info, const QString &relativePath) {
+        if (isStale(generation))
+            return false;
+        const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        const auto entry = overlay.constFind(relativePath);
+        const auto id = snapshot->ids.constFind(relativePath);
+        if (id != snapshot->ids.cend())
+            seen[id.value()] = 1;
+
+        bool upToDate = false;
+        if (entry != overlay.cend())
+            upToDate = !entry->removed && entry->size == info.size() && entry->modified == modified;
+        else if (id != snapshot->ids.cend())
+            upToDate = snapshot->fileSize(id.value()) == info.size() && snapshot->modified(id.value()) == modified;
+        if (!upToDate) {
+            QMutexLocker locker(&mutex);
+            changed.append(relativePath);
+        }
+        return true;
+    }, [&](const QString &directory, const QString &) {
+        QMutexLocker locker(&mutex);
+        directories.append(directory);
+    });
+    if (isStale(generation))
+        return;
+
+    QList<FileState> changes;
+    for (const QString &relativePath : std::as_const(changed))
+        changes.append(readFile(root, relativePath));
+    for (quint32 id = 0; id < snapshot->fileCount; ++id) {
+        if (!seen[id]) {
+            FileState removed;
+            removed.relativePath = snapshot->path(id);
+            changes.append(removed);
+        }
+    }
+    applyChanges(generation, changes);
+    watchDirectories(generation, directories);
+}
+
+void TrigramIndex::refreshDirectories(quint64 generation, const QString &root, const QStringList &directories)
+{
+    std::shared_ptr<const Snapshot> snapshot;
+    QSet<QString> known;
+    {
+        QReadLocker locker(&m_lock);
+        snapshot = m_snapshot;
+        if (!snapshot)
+            return;
+        known = snapshot->directories;
+        for (auto it = m_overlay.cbegin(); it != m_overlay.cend(); ++it)
+            known.insert(CodeSearch::parentDirectory(it.key()));
+    }
+
+    const QDir rootDir(root);
+    QList<FileState> changes;
+    for (const QString &directory : directories) {
+        const QString relativeDir = directory == root ? QString() : rootDir.relativeFilePath(directory);
+        if (!QFileInfo(directory).isDir()) {
+            refreshAll(generation, root);
+            return;
+        }
+
+        const auto ignore = GitIgnore::forTree(root, relativeDir);
+        QSet<QString> present;
+        QDirIterator it(directory, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden);
+        while (it.hasNext()) {
+            it.next();
+            const QFileInfo info = it.fileInfo();
+            const QString relativePath = relativeDir.isEmpty() ? info.fileName() : relativeDir + '/' + info.fileName();
+            if (ignore && ignore->isIgnored(relativePath, info.isDir()))
+                continue;
+            if (info.isDir()) {
+                // A new directory needs a walk of its own.
+                if (!CodeSearch::isSkippedDirectory(info.fileName()) && !info.isSymLink() && !known.contains(relativePath)) {
+                    refreshAll(generation, root);
+                    return;
+                }
+                continue;
+            }
+            if (!CodeSearch::acceptsFile(CodeSearch::Options(), info))
+                continue;
+            present.insert(relativePath);
+
+            const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+            const auto id = snapshot->ids.constFind(relativePath);
+            QReadLocker locker(&m_lock);
+            const auto entry = m_overlay.constFind(relativePath);
+            bool upToDate = false;
+            if (entry != m_overlay.cend())
+                upToDate = !entry->removed && entry->size == info.size() && entry->modified == modified;
+            else if (id != snapshot->ids.cend())
+                upToDate = snapshot->fileSize(id.value()) == info.size() && snapshot->modified(id.value()) == modified;
+            locker.unlock();
+            if (!upToDate)
+                changes.append(readFile(root, relativePath));
+        }
+
+        // Files of this directory that are gone.
+        for (auto it = snapshot->ids.cbegin(); it != snapshot->ids.cend(); ++it) {
+            if (CodeSearch::parentDirectory(it.key()) == relativeDir && !present.contains(it.key())) {
+                FileState removed;
+                removed.relativePath = it.key();
+                changes.append(removed);
+            }
+        }
+    }
+    applyChanges(generation, changes);
+}
+
+void TrigramIndex::applyChanges(quint64 generation, const QList<FileState> &changes)
+{
+    if (changes.isEmpty())
+        return;
+
+    qsizetype overlaySize;
+    QString root;
+    {
+        QWriteLocker locker(&m_lock);
+        if (isStale(generation))
+            return;
+        for (const FileState &change : changes) {
+            OverlayEntry entry;
+            entry.removed = !change.trigrams;
+            entry.size = change.size;
+            entry.modified = change.modified;
+            entry.sequence = ++m_sequence;
+            if (change.trigrams)
+                entry.trigrams = *change.trigrams;
+            m_overlay.insert(change.relativePath, std::move(entry));
+        }
+        overlaySize = m_overlay.size();
+        root = m_root;
+    }
+
+    if (overlaySize > RebuildThreshold && !m_rebuildScheduled.exchange(true)) {
+        m_pool.start([this, generation, root]() { build(generation, root); });
+        return;
+    }
+    QMetaObject::invokeMethod(this, &TrigramIndex::updated, Qt::QueuedConnection);
+}
+
+void TrigramIndex::watchDirectories(quint64 generation, const QStringList &directories)
+{
+    QMetaObject::invokeMethod(this, [this, generation, directories]() {
+        if (isStale(generation))
+            return;
+        const QStringList watchedList = m_watcher.directories();
+        const QSet<QString> watched(watchedList.cbegin(), watchedList.cend());
+        QStringList added;
+        for (const QString &directory : directories) {
+            if (watched.size() + added.size() >= MaxWatchedDirectories) {
+                m_partlyWatched = true;
+                break;
+            }
+            if (!watched.contains(directory))
+                added.append(directory);
+        }
+        if (!added.isEmpty())
+            m_watcher.addPaths(added);
+        emit updated();
+    }, Qt::QueuedConnection);
+}
+
+void TrigramIndex::scheduleRefresh(const QString &directory)
+{
+    m_pendingDirectories.insert(directory);
+    m_refreshTimer.start();
+}
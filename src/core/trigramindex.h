@@ -0,0 +1,108 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Trigram inverted index over the files of a project, in the style of Google's
+// codesearch and Zoekt. It narrows a search down to the files that contain every
+// trigram of the pattern, CodeSearch then verifies those.
+//
+// The index lives in <project>/.qtagent/trigram.idx and is memory-mapped when
+// loaded. It is built, refreshed and rebuilt on a background thread. Changes
+// after the build are kept in an in-memory overlay: files reported through
+// updateFiles(), directories reported by a QFileSystemWatcher, and the files
+// that changed on disk while the index was not loaded, found when it is loaded.
+// Directory watches miss files changed in place, so each query also checks the
+// size and modification time of every indexed file.
+// Trigrams are ASCII case-folded, so one index serves case-insensitive searches
+// too.
+class TrigramIndex : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TrigramIndex(QObject *parent = nullptr);
+    ~TrigramIndex() override;
+
+    // Loads the index of the project, or starts building it. Empty to unload.
+    void setProjectPath(const QString &projectPath);
+    QString projectPath() const;
+    bool isReady() const;
+
+    // Absolute paths of the files that may contain a match, or nullopt when the
+    // index cannot narrow the search: not ready yet, or the pattern has no
+    // trigram every match must contain. Files that changed since they were
+    // indexed are candidates too, and read again in the background. Thread-safe.
+    std::optional<QStringList> candidates(const QString &pattern, bool regex);
+
+    // Re-reads the given files (absolute paths) in the background, e.g. after a
+    // tool wrote them. Files that no longer exist are dropped. Thread-safe.
+    void updateFiles(const QStringList &filePaths);
+
+    static QString indexFilePath(const QString &projectPath);
+    // Case-folded trigrams contained in every match of the pattern. For regular
+    // expressions these come from the literal runs outside of groups, none when
+    // there is a top-level alternation.
+    static std::vector<quint32> requiredTrigrams(const QString &pattern, bool regex);
+
+signals:
+    // Emitted on the index's thread whenever a build or refresh got installed.
+    void updated();
+
+private:
+    struct Snapshot;
+    struct OverlayEntry {
+        bool removed = false;
+        qint64 size = 0;
+        qint64 modified = 0;
+        quint64 sequence = 0;
+        std::vector<quint32> trigrams;   // Sorted.
+    };
+    struct FileState {
+        QString relativePath;
+        qint64 size = 0;
+        qint64 modified = 0;
+        std::optional<std::vector<quint32>> trigrams;   // nullopt when removed.
+    };
+
+    void build(quint64 generation, const QString &root);
+    void refreshAll(quint64 generation, const QString &root);
+    void refreshDirectories(quint64 generation, const QString &root, const QStringList &directories);
+    void applyChanges(quint64 generation, const QList<FileState> &changes);
+    void install(quint64 generation, std::shared_ptr<const Snapshot> snapshot, quint64 sequence,
+                 const QStringList &directories);
+    void watchDirectories(quint64 generation, const QStringList &directories);
+    void scheduleRefresh(const QString &directory);
+    bool isStale(quint64 generation) const { return generation != m_generation.load(); }
+    static FileState readFile(const QString &root, const QString &relativePath);
+
+    mutable QReadWriteLock m_lock;
+    QString m_root;
+    std::shared_ptr<const Snapshot> m_snapshot;
+    QHash<QString, OverlayEntry> m_overlay;
+    quint64 m_sequence = 0;
+
+    std::atomic<quint64> m_generation = 0;
+    std::atomic<bool> m_rebuildScheduled = false;
+    // Directories past MaxWatchedDirectories report no new files, queries walk
+    // the tree again now and then when there are any.
+    std::atomic<bool> m_partlyWatched = false;
+    std::atomic<qint64> m_lastFullRefreshMs = 0;
+    QThreadPool m_pool;
+    QFileSystemWatcher m_watcher;
+    QSet<QString> m_pendingDirectories;
+    QTimer m_refreshTimer;
+};
+
+#endif // TRIGRAMINDEX_H
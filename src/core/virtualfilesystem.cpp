@@ -0,0 +1,208 @@
+#include "virtualfilesystem.h"
+
+#include <coreplugin/documentmanager.h>
+#include <coreplugin/editormanager/documentmodel.h>
+#include <coreplugin/editormanager/editormanager.h>
+#include <texteditor/textdocument.h>
+#include <utils/filepath.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSemaphore>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QThread>
+
+#include <atomic>
+#include <memory>
+
+namespace {
+
+// How long a tool thread waits for the GUI thread, which may be busy or, while
+// the plugin shuts down, waiting for the tool thread.
+constexpr int OwnerThreadTimeoutMs = 5000;
+
+// Replaces only the part of the document that changes, so that the undo step,
+// the cursor and the marks of the rest of the file stay as they were.
+void replaceText(QTextDocument *document, const QString &text)
+{
+    const QString old = document->toPlainText();
+    const qsizetype common = qMin(old.size(), text.size());
+    qsizetype prefix = 0;
+    while (prefix < common && old[prefix] == text[prefix])
+        ++prefix;
+    qsizetype suffix = 0;
+    while (suffix < common - prefix && old[old.size() - 1 - suffix] == text[text.size() - 1 - suffix])
+        ++suffix;
+    if (prefix == old.size() && prefix == text.size())
+        return;
+
+    QTextCursor cursor(document);
+    cursor.beginEditBlock();
+    cursor.setPosition(int(prefix));
+    cursor.setPosition(int(old.size() - suffix), QTextCursor::KeepAnchor);
+    cursor.insertText(text.mid(prefix, text.size() - prefix - suffix));
+    cursor.endEditBlock();
+}
+
+} // namespace
+
+VirtualFileSystem::VirtualFileSystem(QObject *parent)
+    : QObject(parent)
+{
+    auto editorManager = Core::EditorManager::instance();
+    if (!editorManager)
+        return;
+    connect(editorManager, &Core::EditorManager::documentOpened, this, &VirtualFileSystem::documentOpened);
+    connect(editorManager, &Core::EditorManager::documentClosed, this, &VirtualFileSystem::documentClosed);
+    for (Core::IDocument *document : Core::DocumentModel::openedDocuments())
+        documentOpened(document);
+}
+
+QString VirtualFileSystem::key(const QString &filePath)
+{
+    return QDir::cleanPath(QFileInfo(filePath).absoluteFilePath());
+}
+
+void VirtualFileSystem::documentOpened(Core::IDocument *document)
+{
+    auto textDocument = qobject_cast<TextEditor::TextDocument *>(document);
+    if (!textDocument || textDocument->filePath().isEmpty())
+        return;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_buffers.insert(key(textDocument->filePath().toString()), Buffer{textDocument, QString(), true});
+    }
+
+    connect(textDocument->document(), &QTextDocument::contentsChanged, this, [this, textDocument]() {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_buffers.find(key(textDocument->filePath().toString()));
+        if (it != m_buffers.end())
+            it->stale = true;
+    });
+    connect(textDocument, &Core::IDocument::filePathChanged, this,
+            [this](const Utils::FilePath &oldPath, const Utils::FilePath &newPath) {
+                QMutexLocker locker(&m_mutex);
+                Buffer buffer = m_buffers.take(key(oldPath.toString()));
+                if (buffer.document)
+                    m_buffers.insert(key(newPath.toString()), buffer);
+            });
+}
+
+void VirtualFileSystem::documentClosed(Core::IDocument *document)
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_buffers.begin(); it != m_buffers.end();) {
+        if (!it->document || it->document == document)
+            it = m_buffers.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool VirtualFileSystem::isOpen(const QString &filePath) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_buffers.contains(key(filePath));
+}
+
+void VirtualFileSystem::takeSnapshot(Buffer *buffer)
+{
+    if (auto document = qobject_cast<TextEditor::TextDocument *>(buffer->document.data())) {
+        buffer->text = document->plainText();
+        buffer->stale = false;
+    }
+}
+
+bool VirtualFileSystem::read(const QString &filePath, QString *content)
+{
+    const QString path = key(filePath);
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_buffers.constFind(path);
+        if (it == m_buffers.cend())
+            return false;
+        if (!it->stale) {
+            *content = it->text;
+            return true;
+        }
+    }
+
+    // Only the GUI thread may look at the document. Should it not get to it, the
+    // last snapshot is still closer to the editor than the disk.
+    runOnOwnerThread([this, &path]() {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_buffers.find(path);
+        if (it != m_buffers.end() && it->stale)
+            takeSnapshot(&*it);
+    });
+    QMutexLocker locker(&m_mutex);
+    const auto it = m_buffers.constFind(path);
+    if (it == m_buffers.cend() || (it->stale && it->text.isNull()))
+        return false;
+    *content = it->text;
+    return true;
+}
+
+VirtualFileSystem::WriteResult VirtualFileSystem::write(const QString &filePath, const QString &content)
+{
+    const QString path = key(filePath);
+    if (!isOpen(path))
+        return WriteResult::NotOpen;
+    WriteResult result = WriteResult::Failed;
+    runOnOwnerThread([this, &path, &content, &result]() { result = writeDocument(path, content); });
+    return result;
+}
+
+VirtualFileSystem::WriteResult VirtualFileSystem::writeDocument(const QString &path, const QString &content)
+{
+    TextEditor::TextDocument *document = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        document = qobject_cast<TextEditor::TextDocument *>(m_buffers.value(path).document.data());
+    }
+    if (!document)
+        return WriteResult::NotOpen;
+
+    // The document keeps its own line endings and writes them when it is saved.
+    QString text = content;
+    text.replace(QLatin1StringView("\r\n"), QLatin1StringView("\n"));
+    replaceText(document->document(), text);
+    if (!Core::DocumentManager::saveDocument(document))
+        return WriteResult::Failed;
+
+    QMutexLocker locker(&m_mutex);
+    const auto it = m_buffers.find(path);
+    if (it != m_buffers.end())
+        takeSnapshot(&*it);
+    return WriteResult::Written;
+}
+
+bool VirtualFileSystem::runOnOwnerThread(const std::function<void()> &function)
+{
+    if (QThread::currentThread() == thread()) {
+        function();
+        return true;
+    }
+
+    // Whoever sets claimed first decides: the GUI thread runs the function, or
+    // the caller gave up and it never runs.
+    struct State {
+        std::atomic<bool> claimed = false;
+        QSemaphore done;
+    };
+    auto state = std::make_shared<State>();
+    QMetaObject::invokeMethod(this, [state, function]() {
+        if (state->claimed.exchange(true))
+            return;
+        function();
+        state->done.release();
+    }, Qt::QueuedConnection);
+
+    if (state->done.tryAcquire(1, OwnerThreadTimeoutMs))
+        return true;
+    if (!state->claimed.exchange(true))
+        return false;
+    state->done.acquire();
+    return true;
+}
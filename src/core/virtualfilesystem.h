@@ -0,0 +1,56 @@
+#ifndef VIRTUALFILESYSTEM_H
+#define VIRTUALFILESYSTEM_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+#include <functional>
+
+namespace Core { class IDocument; }
+
+// The files that are open in text editors, as the editor has them: reads see
+// unsaved changes, writes go into the document and save it, so the editor
+// neither loses its changes nor reloads the file from disk. Files that are not
+// open are left to the caller.
+//
+// Reads share a snapshot of the document's text, taken on the GUI thread when
+// the document changed since the last one. Thread-safe; the object must live
+// on the GUI thread.
+class VirtualFileSystem : public QObject
+{
+    Q_OBJECT
+public:
+    enum class WriteResult { NotOpen, Written, Failed };
+
+    explicit VirtualFileSystem(QObject *parent = nullptr);
+
+    bool isOpen(const QString &filePath) const;
+    // false when the file is not open in an editor.
+    bool read(const QString &filePath, QString *content);
+    WriteResult write(const QString &filePath, const QString &content);
+
+private:
+    struct Buffer {
+        QPointer<QObject> document;   // The TextEditor::TextDocument.
+        QString text;
+        bool stale = true;            // The document changed after text was taken.
+    };
+
+    static QString key(const QString &filePath);
+    void documentOpened(Core::IDocument *document);
+    void documentClosed(Core::IDocument *document);
+    // On the GUI thread.
+    void takeSnapshot(Buffer *buffer);
+    WriteResult writeDocument(const QString &path, const QString &content);
+    // Runs function on the GUI thread and waits for it, unless it did not start
+    // within a few seconds. Returns whether it ran.
+    bool runOnOwnerThread(const std::function<void()> &function);
+
+    mutable QMutex m_mutex;
+    QHash<QString, Buffer> m_buffers;   // By cleaned absolute path.
+};
+
+#endif // VIRTUALFILESYSTEM_H
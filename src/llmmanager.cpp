@@ -1,27 +1,53 @@
 #include "llmmanager.h"
+#include "src/core/contenthash.h"
+#include "src/core/tokenizer.h"
+#include "src/core/tracer.h"
 
-LLMManager::LLMManager(QObject *parent) : QObject(parent) {}
+namespace {
+
+// Results shorter than this are repeated, a reference would hardly be shorter.
+constexpr qsizetype MinReferencedResultSize = 256;
+
+} // namespace
+
+LLMManager::LLMManager(QObject *parent) : QObject(parent)
+{
+}
 
 void LLMManager::setProvider(LLMProvider *provider)
 {
-    if (current)
+    if (current == provider)
+        return;
+
+    if (current) {
+        current->cancel(m_activeRequest);
         disconnect(current, nullptr, this, nullptr);
+    }
+    setActiveRequest(0);
 
     current = provider;
 
     if (current) {
-        connect(current, &LLMProvider::responseReady, this, [this](const QString &text) {
+        // Only the active request is heard. A cancelled or superseded one may
+        // still be draining and would mix into the reply otherwise.
+        connect(current, &LLMProvider::responseReady, this, [this](const QString &text, LLMProvider::RequestId id) {
+            if (id != m_activeRequest)
+                return;
             m_history.addMessage(Message::Assistant, text);
             emit responseReady(text);
         });
 
-        connect(current, &LLMProvider::partialResponse, this, [this](const QString &delta) {
+        connect(current, &LLMProvider::partialResponse, this, [this](const QString &delta, LLMProvider::RequestId id) {
+            if (id != m_activeRequest)
+                return;
             // If we get a partial response, it means we are receiving content from the assistant.
             m_currentAssistantResponse += delta;
             emit partialResponse(delta);
         });
 
-        connect(current, &LLMProvider::streamFinished, this, [this]() {
+        connect(current, &LLMProvider::streamFinished, this, [this](LLMProvider::RequestId id) {
+            if (id != m_activeRequest)
+                return;
             if (!m_currentAssistantResponse.isEmpty()) {
                 m_history.addMessage(Message::Assistant, m_currentAssistantResponse);
                 emit responseReady(m_currentAssistantResponse);
@@ -30,7 +56,9 @@ void LLMManager::setProvider(LLMProvider *provider)
             emit streamFinished();
         });
 
-        connect(current, &LLMProvider::toolCallsReceived, this, [this](const QJsonArray &toolCalls) {
+        connect(current, &LLMProvider::toolCallsReceived, this, [this](const QJsonArray &toolCalls, LLMProvider::RequestId id) {
+            if (id != m_activeRequest)
+                return;
             // Check if there's actual content or just tool calls
             QString content = m_currentAssistantResponse;
             
@@ -44,7 +72,20 @@ void LLMManager::setProvider(LLMProvider *provider)
             handleToolCalls(toolCalls);
         });
 
-        connect(current, &LLMProvider::errorOccurred, this, &LLMManager::errorOccurred);
+        connect(current, &LLMProvider::errorOccurred, this, [this](const QString &error, LLMProvider::RequestId id) {
+            if (id == m_activeRequest)
+                emit errorOccurred(error);
+        });
+        connect(current, &LLMProvider::requestMetrics, this, [this](const RequestMetrics &metrics, LLMProvider::RequestId id) {
+            if (id == m_activeRequest)
+                emit metricsAvailable(metrics);
+        });
+
+        connect(current, &LLMProvider::requestFinished, this, [this](LLMProvider::RequestId id) {
+            // A tool-call turn finishes after the follow-up request has already been sent.
+            if (id == m_activeRequest)
+                setActiveRequest(0);
+        });
     }
 }
 
@@ -59,6 +100,17 @@ void LLMManager::setMCPServer(MCPServer *server)
     m_mcpServer = server;
 }
 
+void LLMManager::setTokenizer(const std::shared_ptr<const Tokenizer> &tokenizer)
+{
+    if (tokenizer && tokenizer->isValid()) {
+        m_history.setTokenCounter([tokenizer](const QString &text) {
+            return tokenizer->countTokens(text);
+        });
+    } else {
+        m_history.setTokenCounter({});
+    }
+}
+
 void LLMManager::sendChatRequest(const QString &prompt)
 {
     if (!current) {
@@ -66,58 +118,100 @@ void LLMManager::sendChatRequest(const QString &prompt)
         return;
     }
 
+    if (!isBusy()) {
+        ++m_turn;
+        if (Tracer::instance().isEnabled())
+            Tracer::instance().asyncBegin("agentTurn", "agent", m_turn, {{"promptChars", prompt.size()}});
+    }
+
     // Add automatic context if history is empty or starting new interaction
     if (m_history.messageCount() == 0) {
-        QString systemPrompt = "You are an AI assistant integrated into Qt Creator. "
-                               "You have access to the project files and editor through tools. "
-                               "When you need to read, write, or list files, ALWAYS use the provided tools. "
-                               "Do NOT guess or assume the content of files you have not read yet. "
-                               "Wait for the tool output before providing information based on a file.";
-        
-        if (m_mcpServer) {
-            QString projectPath;
-            auto projectContext = m_mcpServer->readResource("file://project");
-            QJsonArray projectContents = projectContext["contents"].toArray();
-            if (!projectContents.isEmpty()) {
-                projectPath = projectContents[0].toObject()["text"].toString();
-                if (!projectPath.isEmpty()) {
-                    systemPrompt += "\n\nProject root: " + projectPath;
-                    
-                    // List top-level directory to give the AI an idea of the project structure
-                    QJsonObject listResult = m_mcpServer->callTool("list_directory", {{"path", projectPath}});
-                    if (listResult.contains("files")) {
-                        systemPrompt += "\n\nProject structure (root):\n";
-                        QJsonArray files = listResult["files"].toArray();
-                        for (const auto &fileVal : files) {
-                            QJsonObject fileObj = fileVal.toObject();
-                            systemPrompt += "- " + fileObj["name"].toString() + " (" + fileObj["type"].toString() + ")\n";
-                        }
-                    }
-                }
-            }
+        buildSystemPrompt(prompt);
+        return;
+    }
+    sendUserPrompt(prompt);
+}
 
-            auto context = m_mcpServer->readResource("file://current");
-            QJsonArray contents = context["contents"].toArray();
-            if (!contents.isEmpty()) {
-                QString currentFile = contents[0].toObject()["text"].toString();
-                QString uri = contents[0].toObject()["uri"].toString();
-                // ONLY add current file context if it's NOT empty. 
-                // In some tests, we might want to start with a clean slate.
-                if (!currentFile.isEmpty()) {
-                    systemPrompt += "\n\nCurrently open file (" + uri + "):\n" + currentFile;
-                }
-            }
-        }
-        
+void LLMManager::buildSystemPrompt(const QString &prompt)
+{
+    TraceSpan span("agent.systemPrompt", "agent");
+    QString systemPrompt = "You are an AI assistant integrated into Qt Creator. "
+                           "You have access to the project files and editor through tools. "
+                           "When you need to read, write, or list files, ALWAYS use the provided tools. "
+                           "Do NOT guess or assume the content of files you have not read yet. "
+                           "Wait for the tool output before providing information based on a file.";
+    if (!m_mcpServer) {
         m_history.addMessage(Message::System, systemPrompt);
+        sendUserPrompt(prompt);
+        return;
+    }
+
+    QString projectPath;
+    auto projectContext = m_mcpServer->readResource("file://project");
+    QJsonArray projectContents = projectContext["contents"].toArray();
+    if (!projectContents.isEmpty())
+        projectPath = projectContents[0].toObject()["text"].toString();
+
+    QString currentFileContext;
+    auto context = m_mcpServer->readResource("file://current");
+    QJsonArray contents = context["contents"].toArray();
+    if (!contents.isEmpty()) {
+        QString currentFile = contents[0].toObject()["text"].toString();
+        QString uri = contents[0].toObject()["uri"].toString();
+        // ONLY add current file context if it's NOT empty. 
+        // In some tests, we might want to start with a clean slate.
+        if (!currentFile.isEmpty()) {
+            currentFileContext = "\n\nCurrently open file (" + uri + "):\n" + currentFile;
+        }
+    }
+
+    if (projectPath.isEmpty()) {
+        m_history.addMessage(Message::System, systemPrompt + currentFileContext);
+        sendUserPrompt(prompt);
+        return;
     }
 
+    systemPrompt += "\n\nProject root: " + projectPath;
+
+    // List top-level directory to give the AI an idea of the project structure.
+    // The listing runs off the GUI thread, the turn counts as busy meanwhile.
+    const quint64 generation = ++m_toolGeneration;
+    setRunningTools(true);
+    auto future = m_mcpServer->callToolAsync("list_directory", {{"path", projectPath}});
+    m_toolFutures.append(future);
+    future.then(this, [this, generation, prompt, systemPrompt, currentFileContext](const QJsonObject &listResult) {
+        if (generation != m_toolGeneration)
+            return;
+        m_toolFutures.clear();
+
+        QString fullPrompt = systemPrompt;
+        if (listResult.contains("files")) {
+            fullPrompt += "\n\nProject structure (root):\n";
+            QJsonArray files = listResult["files"].toArray();
+            for (const auto &fileVal : files) {
+                QJsonObject fileObj = fileVal.toObject();
+                fullPrompt += "- " + fileObj["name"].toString() + " (" + fileObj["type"].toString() + ")\n";
+            }
+        }
+        m_history.addMessage(Message::System, fullPrompt + currentFileContext);
+        sendUserPrompt(prompt);
+        // The reply may already have started tools of its own.
+        if (generation == m_toolGeneration)
+            setRunningTools(false);
+    });
+}
+
+void LLMManager::sendUserPrompt(const QString &prompt)
+{
     if (!prompt.isEmpty()) {
         m_history.addMessage(Message::User, prompt);
     }
     
     // Simple token management - keep it under 32k estimated tokens
-    m_history.trim(32000);
+    {
+        TraceSpan span("history.trim", "agent");
+        m_history.trim(32000);
+    }
 
     m_currentAssistantResponse.clear();
     
@@ -126,13 +220,85 @@ void LLMManager::sendChatRequest(const QString &prompt)
         tools = m_mcpServer->listTools();
     }
     
-    current->sendChatRequest(m_history.toJsonArray(), true, tools);
+    dispatch(tools);
+}
+
+void LLMManager::cancel()
+{
+    if (!isBusy())
+        return;
+
+    if (current && m_activeRequest != 0)
+        current->cancel(m_activeRequest);
+
+    if (m_runningTools) {
+        ++m_toolGeneration;
+        for (auto &future : m_toolFutures)
+            future.cancel();
+        m_toolFutures.clear();
+        // Every tool call needs a result, or the next request is rejected.
+        for (qsizetype i = m_completedTools; i < m_pendingTools.size(); ++i) {
+            m_history.addMessage(Message::Tool, "{\"error\":\"Cancelled by the user\"}", m_pendingTools[i].id);
+        }
+        m_pendingTools.clear();
+    }
+
+    const bool wasBusy = isBusy();
+    m_activeRequest = 0;
+    m_runningTools = false;
+    busyStateChanged(wasBusy);
+
+    if (!m_currentAssistantResponse.isEmpty()) {
+        m_history.addMessage(Message::Assistant, m_currentAssistantResponse);
+        m_currentAssistantResponse.clear();
+    }
+    emit generationCancelled();
+}
+
+void LLMManager::warmUp()
+{
+    if (current)
+        current->warmUp();
+}
+
+void LLMManager::dispatch(const QJsonArray &tools)
+{
+    TraceSpan span("agent.dispatch", "agent");
+    span.setArg("messages", m_history.messageCount());
+    setActiveRequest(current->sendConversation(m_history, true, tools));
+}
+
+void LLMManager::setActiveRequest(LLMProvider::RequestId id)
+{
+    const bool wasBusy = isBusy();
+    m_activeRequest = id;
+    busyStateChanged(wasBusy);
+}
+
+void LLMManager::setRunningTools(bool running)
+{
+    const bool wasBusy = isBusy();
+    m_runningTools = running;
+    busyStateChanged(wasBusy);
+}
+
+void LLMManager::busyStateChanged(bool wasBusy)
+{
+    if (wasBusy == isBusy())
+        return;
+    if (!isBusy() && Tracer::instance().isEnabled())
+        Tracer::instance().asyncEnd("agentTurn", "agent", m_turn);
+    emit busyChanged(isBusy());
 }
 
 void LLMManager::handleToolCalls(const QJsonArray &toolCalls)
 {
     if (!m_mcpServer) return;
 
+    ++m_toolGeneration;
+    m_pendingTools.clear();
+    m_completedTools = 0;
+
     for (const auto &callVal : toolCalls) {
         QJsonObject call = callVal.toObject();
         
@@ -153,23 +319,94 @@ void LLMManager::handleToolCalls(const QJsonArray &toolCalls)
 
         if (name.isEmpty()) continue;
 
-        emit toolCallStarted(name);
-        
-        QJsonObject result = m_mcpServer->callTool(name, args);
-        QString resultStr = QString::fromUtf8(QJsonDocument(result).toJson(QJsonDocument::Compact));
-        
-        emit toolCallFinished(name, resultStr);
-        
-        m_history.addMessage(Message::Tool, resultStr, id);
+        m_pendingTools.append({id, name, args, QJsonObject()});
     }
 
-    // After all tool calls, request next response from LLM
-    // We clear currentAssistantResponse to ensure we don't carry over content from the tool-deciding turn
-    m_currentAssistantResponse.clear();
-    current->sendChatRequest(m_history.toJsonArray(), true);
+    setRunningTools(true);
+    runToolBatch(0);
+}
+
+void LLMManager::runToolBatch(qsizetype from)
+{
+    if (from >= m_pendingTools.size()) {
+        // After all tool calls, request next response from LLM
+        // We clear currentAssistantResponse to ensure we don't carry over content from the tool-deciding turn
+        m_pendingTools.clear();
+        m_currentAssistantResponse.clear();
+        const quint64 generation = m_toolGeneration;
+        dispatch();
+        // The reply may already have started the next round of tools.
+        if (generation == m_toolGeneration)
+            setRunningTools(false);
+        return;
+    }
+
+    // A run of read-only calls executes concurrently. Anything that may modify
+    // files runs alone, which orders it against the reads before and after it.
+    qsizetype to = from + 1;
+    if (MCPServer::isReadOnlyTool(m_pendingTools[from].name)) {
+        while (to < m_pendingTools.size() && MCPServer::isReadOnlyTool(m_pendingTools[to].name))
+            ++to;
+    }
+
+    const quint64 generation = m_toolGeneration;
+    auto remaining = std::make_shared<qsizetype>(to - from);
+    for (qsizetype i = from; i < to; ++i) {
+        const PendingToolCall &call = m_pendingTools[i];
+        emit toolCallStarted(call.name);
+
+        auto future = m_mcpServer->callToolAsync(call.name, call.arguments);
+        m_toolFutures.append(future);
+        future.then(this, [this, generation, i, from, to, remaining](const QJsonObject &result) {
+            if (generation != m_toolGeneration)
+                return;
+            m_pendingTools[i].result = result;
+            if (--*remaining > 0)
+                return;
+            m_toolFutures.clear();
+            // Results go into the history in the order of the calls.
+            for (qsizetype j = from; j < to; ++j)
+                completeToolCall(j);
+            runToolBatch(to);
+        });
+    }
+}
+
+void LLMManager::completeToolCall(qsizetype index)
+{
+    const PendingToolCall &call = m_pendingTools[index];
+    QString resultStr = QString::fromUtf8(QJsonDocument(call.result).toJson(QJsonDocument::Compact));
+    
+    emit toolCallFinished(call.name, resultStr);
+
+    ++m_toolCallCount;
+    if (MCPServer::isFileModifyingTool(call.name)) {
+        m_toolResults.clear();
+    } else if (MCPServer::isReadOnlyTool(call.name) && !call.result.contains("error")
+               && resultStr.size() >= MinReferencedResultSize) {
+        // The same call with the same result as one still in the history: the
+        // model gets a reference instead of the content once more.
+        const QString key = call.name + '\n' + QString::fromUtf8(QJsonDocument(call.arguments).toJson(QJsonDocument::Compact));
+        const quint64 hash = ContentHash::xxh64(resultStr);
+        const auto previous = m_toolResults.constFind(key);
+        if (previous != m_toolResults.cend() && previous->hash == hash && m_history.containsToolResult(previous->id)) {
+            resultStr = QString::fromUtf8(QJsonDocument(QJsonObject{
+                {"unchanged", true},
+                {"note", QString("Same result as tool call #%1 (id %2), unchanged since").arg(previous->number).arg(previous->id)}
+            }).toJson(QJsonDocument::Compact));
+        } else {
+            m_toolResults.insert(key, ToolResult{m_toolCallCount, call.id, hash});
+        }
+    }
+
+    m_history.addMessage(Message::Tool, resultStr, call.id);
+    m_completedTools = index + 1;
 }
 
 void LLMManager::clearHistory()
 {
+    cancel();
     m_history.clear();
+    m_toolResults.clear();
+    m_toolCallCount = 0;
 }
@@ -1,11 +1,18 @@
 #ifndef LLMMANAGER_H
 #define LLMMANAGER_H
 
+#include <QFuture>
+#include <QHash>
 #include <QObject>
+
+#include <memory>
+
 #include "src/providers/base/llmprovider.h"
 #include "src/core/conversationhistory.h"
 #include "src/mcp/mcpserver.h"
 
+class Tokenizer;
+
 class LLMManager : public QObject
 {
     Q_OBJECT
@@ -14,9 +21,18 @@ public:
 
     void setProvider(LLMProvider *provider);
     void setMCPServer(MCPServer *server);
+    // Used for context budgeting, nullptr falls back to the character estimate.
+    void setTokenizer(const std::shared_ptr<const Tokenizer> &tokenizer);
     void sendPrompt(const QString &prompt);
     void sendChatRequest(const QString &prompt);
 
+    // Stops the running generation, if any. Content streamed so far is kept in the history.
+    void cancel();
+    bool isBusy() const { return m_activeRequest != 0 || m_runningTools; }
+
+    // Pre-connects to the provider's endpoint, call when a request is likely soon.
+    void warmUp();
+
     ConversationHistory& history() { return m_history; }
     void clearHistory();
 
@@ -27,13 +43,52 @@ signals:
     void errorOccurred(const QString &error);
     void toolCallStarted(const QString &name);
     void toolCallFinished(const QString &name, const QString &result);
+    void generationCancelled();
+    void busyChanged(bool busy);
+    void metricsAvailable(const RequestMetrics &metrics);
 
 private:
+    struct PendingToolCall {
+        QString id;
+        QString name;
+        QJsonObject arguments;
+        QJsonObject result;
+    };
+
+    // A result of a read-only tool in the history, for repeated calls.
+    struct ToolResult {
+        int number = 0;    // Of the call in the conversation, 1-based.
+        QString id;
+        quint64 hash = 0;  // Of the result JSON.
+    };
+
+    void buildSystemPrompt(const QString &prompt);
+    void sendUserPrompt(const QString &prompt);
     void handleToolCalls(const QJsonArray &toolCalls);
+    void runToolBatch(qsizetype from);
+    void completeToolCall(qsizetype index);
+    void dispatch(const QJsonArray &tools = QJsonArray());
+    void setActiveRequest(LLMProvider::RequestId id);
+    void setRunningTools(bool running);
+    void busyStateChanged(bool wasBusy);
 
     LLMProvider *current = nullptr;
     MCPServer *m_mcpServer = nullptr;
     ConversationHistory m_history;
     QString m_currentAssistantResponse;
+    LLMProvider::RequestId m_activeRequest = 0;
+    quint64 m_turn = 0; // Trace id of the current agent turn.
+
+    // Tool calls of the current turn, in the order the model made them.
+    QList<PendingToolCall> m_pendingTools;
+    qsizetype m_completedTools = 0;
+    bool m_runningTools = false;
+    // Bumped on cancel, so that results of abandoned tool calls are dropped.
+    quint64 m_toolGeneration = 0;
+    // Tool calls in flight, cancelled so that queued ones do not run at all.
+    QList<QFuture<QJsonObject>> m_toolFutures;
+    // By tool name and arguments. Emptied when a tool modifies files.
+    QHash<QString, ToolResult> m_toolResults;
+    int m_toolCallCount = 0;
 };
 #endif // LLMMANAGER_H
@@ -1,16 +1,133 @@
 #include "mcpserver.h"
 #include "src/core/codeeditormanager.h"
+#include "src/core/codesearch.h"
+#include "src/core/filecontentcache.h"
+#include "src/core/gitignore.h"
+#include "src/core/patchengine.h"
+#include "src/core/tracer.h"
+#ifdef QLP_WITH_CPPEDITOR
+#include "src/core/cppmodelsymbols.h"
+#endif
 
 #include <QJsonDocument>
+#include <QPromise>
+#include <QRegularExpression>
+#include <QSemaphore>
 #include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
 
 #include <QDir>
 
+namespace {
+// Result of an asynchronous tool call, completed exactly once by whichever of the
+// tool, the timeout or a cancellation gets there first.
+struct AsyncToolCall
+{
+    QPromise<QJsonObject> promise;
+    std::atomic<bool> finished = false;
+
+    void finish(const QJsonObject &result)
+    {
+        if (finished.exchange(true))
+            return;
+        promise.addResult(result);
+        promise.finish();
+    }
+};
+
+constexpr int MaxUsageLineLength = 200;
+// read_file pages, and the size of any tool result as JSON. A 5 MB file in one
+// result would push everything else out of the conversation.
+constexpr qint64 DefaultReadBytes = 64 * 1024;
+constexpr qint64 MinReadBytes = 1024;
+constexpr qint64 MaxReadBytes = 128 * 1024;
+constexpr qsizetype MaxResultBytes = 256 * 1024;
+// read_files shares one budget between its files, counted as JSON like the
+// result, leaving room for the rest of it.
+constexpr qint64 DefaultBatchBytes = 128 * 1024;
+constexpr qint64 MaxBatchBytes = 192 * 1024;
+constexpr int MaxBatchFiles = 32;
+constexpr int MaxListDepth = 32;
+constexpr int DefaultListEntries = 500;
+constexpr int MaxListEntries = 5000;
+
+// "*.cpp, *.h" -> {"*.cpp", "*.h"}
+QStringList globList(const QString &globs)
+{
+    QStringList result;
+    for (const QString &glob : globs.split(',', Qt::SkipEmptyParts)) {
+        if (!glob.trimmed().isEmpty())
+            result.append(glob.trimmed());
+    }
+    return result;
+}
+
+bool matchesAny(const QStringList &globs, const QString &name, const QString &relativePath)
+{
+    for (const QString &glob : globs) {
+        if (GitIgnore::globMatch(glob, name) || GitIgnore::globMatch(glob, relativePath))
+            return true;
+    }
+    return false;
+}
+
+QJsonObject symbolToJson(const SymbolIndex::Symbol &symbol, const QDir &projectDir)
+{
+    QJsonObject json{
+        {"name", symbol.name},
+        {"kind", SymbolIndex::kindName(symbol.kind)},
+        {"path", projectDir.relativeFilePath(symbol.filePath)},
+        {"line", symbol.line},
+        {"signature", symbol.signature}
+    };
+    if (!symbol.scope.isEmpty())
+        json["qualified_name"] = symbol.qualifiedName();
+    if (!symbol.isDefinition)
+        json["declaration"] = true;
+    if (!symbol.bases.isEmpty())
+        json["bases"] = QJsonArray::fromStringList(symbol.bases);
+    return json;
+}
+}
+
 MCPServer::MCPServer(CodeEditorManager *editorManager, QObject *parent)
     : QObject(parent), m_editorManager(editorManager)
 {
     initializeResources();
     initializeTools();
+
+    // Read-only tools are I/O bound, a few more threads than cores is fine.
+    m_readPool.setMaxThreadCount(qBound(4, QThread::idealThreadCount(), 8));
+    m_writePool.setMaxThreadCount(1);
+    m_fileReadPool.setMaxThreadCount(qBound(4, QThread::idealThreadCount(), 8));
+
+    if (m_editorManager) {
+        connect(m_editorManager, &CodeEditorManager::projectPathChanged,
+                &m_searchIndex, &TrigramIndex::setProjectPath);
+        m_searchIndex.setProjectPath(m_editorManager->getProjectPath());
+        connect(m_editorManager, &CodeEditorManager::projectPathChanged,
+                &m_symbolIndex, &SymbolIndex::setProjectPath);
+        m_symbolIndex.setProjectPath(m_editorManager->getProjectPath());
+        connect(m_editorManager, &CodeEditorManager::projectPathChanged,
+                &m_semanticIndex, &SemanticIndexer::setProjectPath);
+        m_semanticIndex.setProjectPath(m_editorManager->getProjectPath());
+        connect(m_editorManager, &CodeEditorManager::projectPathChanged,
+                &m_directoryCache, &DirectoryCache::clear);
+    }
+}
+
+MCPServer::~MCPServer()
+{
+    // Before any member goes away. Tools whose timeout fired may still be running.
+    m_readPool.clear();
+    m_writePool.clear();
+    m_readPool.waitForDone();
+    m_writePool.waitForDone();
+    m_fileReadPool.waitForDone();
 }
 
 void MCPServer::initializeResources()
@@ -40,14 +157,39 @@ void MCPServer::initializeTools()
     
     // Read file tool
     QJsonArray readFileParams = QJsonArray{
-        QJsonObject{{"type", "string"}, {"name", "path"}, {"description", "File path to read"}, {"required", true}}
+        QJsonObject{{"type", "string"}, {"name", "path"}, {"description", "File path to read"}, {"required", true}},
+        QJsonObject{{"type", "integer"}, {"name", "start_line"}, {"description", "First line to read, 1-based, 1 by default"}, {"required", false}},
+        QJsonObject{{"type", "integer"}, {"name", "end_line"}, {"description", "Last line to read, the end of the file by default"}, {"required", false}},
+        QJsonObject{{"type", "integer"}, {"name", "max_bytes"}, {"description", "Maximum bytes of content to return, 65536 by default, at most 131072"}, {"required", false}},
+        QJsonObject{{"type", "string"}, {"name", "cursor"}, {"description", "next_cursor of the previous result, to continue where it stopped"}, {"required", false}}
     };
     m_availableTools.append(createTool(
         "read_file",
-        "Read the contents of a file",
+        "Read the contents of a file, or a range of its lines. Large files come in pages: pass next_cursor back as cursor to continue",
         readFileParams
     ));
     
+    // Read files tool
+    const QJsonObject readFilesItem{
+        {"type", "object"},
+        {"properties", QJsonObject{
+            {"path", QJsonObject{{"type", "string"}, {"description", "File path to read"}}},
+            {"start_line", QJsonObject{{"type", "integer"}, {"description", "First line to read, 1-based, 1 by default"}}},
+            {"end_line", QJsonObject{{"type", "integer"}, {"description", "Last line to read, the end of the file by default"}}},
+            {"cursor", QJsonObject{{"type", "string"}, {"description", "next_cursor of a previous result for this file"}}}
+        }},
+        {"required", QJsonArray{"path"}}
+    };
+    QJsonArray readFilesParams = QJsonArray{
+        QJsonObject{{"type", "array"}, {"name", "files"}, {"description", QString("Files to read, at most %1").arg(MaxBatchFiles)}, {"items", readFilesItem}, {"required", true}},
+        QJsonObject{{"type", "integer"}, {"name", "max_bytes"}, {"description", "Maximum bytes of all files together as JSON, 131072 by default, at most 196608"}, {"required", false}}
+    };
+    m_availableTools.append(createTool(
+        "read_files",
+        "Read several files, or line ranges of them, in one call. Prefer it to several read_file calls. Files are served in the order given until max_bytes is used up; the rest come truncated or skipped",
+        readFilesParams
+    ));
+
     // Write file tool
     QJsonArray writeFileParams = QJsonArray{
         QJsonObject{{"type", "string"}, {"name", "path"}, {"description", "File path to write"}, {"required", true}},
@@ -55,10 +197,32 @@ void MCPServer::initializeTools()
     };
     m_availableTools.append(createTool(
         "write_file", 
-        "Write content to a file",
+        "Write the whole content of a file. To change part of an existing file use edit_file",
         writeFileParams
     ));
     
+    // Edit file tool, so that a small change does not cost the whole file
+    const QJsonObject editItem{
+        {"type", "object"},
+        {"properties", QJsonObject{
+            {"search", QJsonObject{{"type", "string"}, {"description", "Exact lines to replace, with enough context to be unique"}}},
+            {"replace", QJsonObject{{"type", "string"}, {"description", "Lines to put in their place"}}}
+        }},
+        {"required", QJsonArray{"search", "replace"}}
+    };
+    QJsonArray editFileParams = QJsonArray{
+        QJsonObject{{"type", "string"}, {"name", "path"}, {"description", "File path to edit"}, {"required", true}},
+        QJsonObject{{"type", "string"}, {"name", "search"}, {"description", "Exact lines to replace, with enough context to be unique"}, {"required", false}},
+        QJsonObject{{"type", "string"}, {"name", "replace"}, {"description", "Lines to put in place of search"}, {"required", false}},
+        QJsonObject{{"type", "array"}, {"name", "edits"}, {"description", "Several search/replace edits, applied in order"}, {"items", editItem}, {"required", false}},
+        QJsonObject{{"type", "string"}, {"name", "diff"}, {"description", "A unified diff of the file instead of search/replace edits"}, {"required", false}}
+    };
+    m_availableTools.append(createTool(
+        "edit_file",
+        "Change part of a file without rewriting it: give search and replace, a list of edits, or a unified diff. Prefer it to write_file for existing files. Nothing is written unless every edit applies",
+        editFileParams
+    ));
+
     // Create file tool
     QJsonArray createFileParams = QJsonArray{
         QJsonObject{{"type", "string"}, {"name", "path"}, {"description", "File path to create"}, {"required", true}},
@@ -72,11 +236,16 @@ void MCPServer::initializeTools()
     
     // List directory tool
     QJsonArray listDirParams = QJsonArray{
-        QJsonObject{{"type", "string"}, {"name", "path"}, {"description", "Directory path to list"}, {"required", false}}
+        QJsonObject{{"type", "string"}, {"name", "path"}, {"description", "Directory path to list"}, {"required", false}},
+        QJsonObject{{"type", "integer"}, {"name", "max_depth"}, {"description", "Levels of subdirectories to descend, 1 (only the directory itself) by default"}, {"required", false}},
+        QJsonObject{{"type", "string"}, {"name", "include"}, {"description", "Only list files whose name or path matches one of these comma-separated globs, e.g. *.cpp,*.h"}, {"required", false}},
+        QJsonObject{{"type", "string"}, {"name", "exclude"}, {"description", "Skip files and directories whose name or path matches one of these comma-separated globs, e.g. tests,*.png"}, {"required", false}},
+        QJsonObject{{"type", "boolean"}, {"name", "respect_gitignore"}, {"description", "Skip what .gitignore files ignore, true by default"}, {"required", false}},
+        QJsonObject{{"type", "integer"}, {"name", "max_entries"}, {"description", "Maximum number of entries to return, 500 by default"}, {"required", false}}
     };
     m_availableTools.append(createTool(
         "list_directory",
-        "List files in a directory",
+        "List the files in a directory, optionally its whole tree in one call. Paths are relative to the directory, closest levels first",
         listDirParams
     ));
 
@@ -92,14 +261,86 @@ void MCPServer::initializeTools()
 
     // Search code tool
     QJsonArray searchParams = QJsonArray{
-        QJsonObject{{"type", "string"}, {"name", "query"}, {"description", "Search query"}, {"required", true}},
-        QJsonObject{{"type", "string"}, {"name", "path"}, {"description", "Directory to search in"}, {"required", false}}
+        QJsonObject{{"type", "string"}, {"name", "query"}, {"description", "Text or regular expression to search for"}, {"required", true}},
+        QJsonObject{{"type", "string"}, {"name", "path"}, {"description", "Directory to search in, the project root by default"}, {"required", false}},
+        QJsonObject{{"type", "boolean"}, {"name", "regex"}, {"description", "Treat the query as a regular expression"}, {"required", false}},
+        QJsonObject{{"type", "boolean"}, {"name", "case_sensitive"}, {"description", "Match case, false by default"}, {"required", false}},
+        QJsonObject{{"type", "string"}, {"name", "file_pattern"}, {"description", "Only search files whose name matches this glob, e.g. *.cpp"}, {"required", false}},
+        QJsonObject{{"type", "integer"}, {"name", "max_results"}, {"description", "Maximum number of matches to return, 50 by default"}, {"required", false}}
     };
     m_availableTools.append(createTool(
         "search_code",
-        "Search for text in the project",
+        "Search the project files for text, skipping ignored and binary files. Returns the best matches with surrounding lines",
         searchParams
     ));
+
+    // Symbol tools, answered from an index instead of reading files
+    QJsonArray symbolInfoParams = QJsonArray{
+        QJsonObject{{"type", "string"}, {"name", "name"}, {"description", "Symbol name, optionally qualified like Foo::bar"}, {"required", true}},
+        QJsonObject{{"type", "string"}, {"name", "kind"}, {"description", "Only symbols of this kind: class, struct, enum, function, method, field, variable, typedef, macro, namespace"}, {"required", false}}
+    };
+    m_availableTools.append(createTool(
+        "get_symbol_info",
+        "Find where a C++ symbol is defined and declared. Returns its kind, location and signature",
+        symbolInfoParams
+    ));
+
+    QJsonArray usagesParams = QJsonArray{
+        QJsonObject{{"type", "string"}, {"name", "name"}, {"description", "Symbol name, optionally qualified like Foo::bar"}, {"required", true}},
+        QJsonObject{{"type", "string"}, {"name", "file_pattern"}, {"description", "Only search files whose name matches this glob, e.g. *.cpp"}, {"required", false}},
+        QJsonObject{{"type", "integer"}, {"name", "max_results"}, {"description", "Maximum number of usages to return, 50 by default"}, {"required", false}}
+    };
+    m_availableTools.append(createTool(
+        "find_usages",
+        "Find the lines that use a C++ symbol, as whole-word matches of its name",
+        usagesParams
+    ));
+
+    QJsonArray outlineParams = QJsonArray{
+        QJsonObject{{"type", "string"}, {"name", "name"}, {"description", "Class name, optionally qualified like ns::Foo"}, {"required", true}}
+    };
+    m_availableTools.append(createTool(
+        "get_class_outline",
+        "List the bases and members of a C++ class with their signatures, without reading the file",
+        outlineParams
+    ));
+
+    QJsonArray semanticParams = QJsonArray{
+        QJsonObject{{"type", "string"}, {"name", "query"}, {"description", "What the code does, in natural language, e.g. \"where are settings saved\""}, {"required", true}},
+        QJsonObject{{"type", "integer"}, {"name", "max_results"}, {"description", "Maximum number of code chunks to return, 8 by default"}, {"required", false}}
+    };
+    m_availableTools.append(createTool(
+        "semantic_search",
+        "Find the code that is closest in meaning to a description, from an embedding index of the project. Use search_code for exact names",
+        semanticParams
+    ));
+}
+
+QList<SymbolIndex::Symbol> MCPServer::findSymbols(const QString &name, int maxResults)
+{
+#ifdef QLP_WITH_CPPEDITOR
+    if (const auto symbols = CppModelSymbols::find(m_symbolIndex.projectPath(), name, maxResults))
+        return *symbols;
+#endif
+    return m_symbolIndex.find(name, maxResults);
+}
+
+QList<SymbolIndex::Symbol> MCPServer::classOutline(const QString &className, SymbolIndex::Symbol *classSymbol)
+{
+#ifdef QLP_WITH_CPPEDITOR
+    if (const auto members = CppModelSymbols::classOutline(m_symbolIndex.projectPath(), className, classSymbol))
+        return *members;
+#endif
+    return m_symbolIndex.classOutline(className, classSymbol);
+}
+
+void MCPServer::filesChanged(const QStringList &filePaths)
+{
+    m_searchIndex.updateFiles(filePaths);
+    m_symbolIndex.updateFiles(filePaths);
+    m_semanticIndex.updateFiles(filePaths);
+    m_directoryCache.invalidate(filePaths);
+    FileContentCache::instance().invalidate(filePaths);
 }
 
 QJsonObject MCPServer::createResource(const QString &uri, const QString &name,
@@ -125,6 +366,8 @@ QJsonObject MCPServer::createTool(const QString &name, const QString &descriptio
         QJsonObject prop;
         prop["type"] = param["type"];
         prop["description"] = param["description"];
+        if (param.contains("items"))
+            prop["items"] = param["items"];
         properties[paramName] = prop;
         if (param["required"].toBool()) {
             required.append(paramName);
@@ -243,6 +486,90 @@ QJsonArray MCPServer::listTools() const
     return m_availableTools;
 }
 
+bool MCPServer::isReadOnlyTool(const QString &name)
+{
+    // get_editor_context is read-only as well, but it touches editor widgets.
+    return name == "read_file" || name == "read_files" || name == "list_directory" || name == "search_code"
+           || name == "get_symbol_info" || name == "find_usages" || name == "get_class_outline"
+           || name == "semantic_search";
+}
+
+bool MCPServer::isFileModifyingTool(const QString &name)
+{
+    return name == "write_file" || name == "edit_file" || name == "create_file" || name == "delete_file";
+}
+
+int MCPServer::defaultTimeoutMs(const QString &name)
+{
+    // Searches walk the whole project, everything else touches a single path.
+    return name == "search_code" || name == "find_usages" ? 60000 : 30000;
+}
+
+QFuture<QJsonObject> MCPServer::callToolAsync(const QString &name, const QJsonObject &arguments, int timeoutMs)
+{
+    auto call = std::make_shared<AsyncToolCall>();
+    call->promise.start();
+    QFuture<QJsonObject> future = call->promise.future();
+
+    auto run = [this, call, name, arguments]() {
+        if (call->promise.isCanceled()) {
+            call->finish(QJsonObject{{"error", "Cancelled"}});
+            return;
+        }
+        TraceSpan span("tool." + name, "tool");
+        call->finish(callTool(name, arguments));
+    };
+
+    if (isReadOnlyTool(name))
+        m_readPool.start(run);
+    else if (isFileModifyingTool(name))
+        m_writePool.start(run);
+    else
+        QMetaObject::invokeMethod(this, run, Qt::QueuedConnection);
+
+    if (timeoutMs < 0)
+        timeoutMs = defaultTimeoutMs(name);
+    if (timeoutMs > 0) {
+        QTimer::singleShot(timeoutMs, this, [call, name, timeoutMs]() {
+            call->finish(QJsonObject{{"error", QString("Tool %1 timed out after %2 ms").arg(name).arg(timeoutMs)}});
+        });
+    }
+    return future;
+}
+
+QJsonObject MCPServer::readFileRange(const QJsonObject &arguments, qint64 maxBytes)
+{
+    QJsonObject result;
+    const QString path = m_editorManager->resolvePath(arguments["path"].toString());
+    CodeEditorManager::ReadRange range;
+    range.startLine = qMax(1, arguments["start_line"].toInt(1));
+    range.endLine = qMax(0, arguments["end_line"].toInt(0));
+    range.maxBytes = maxBytes;
+    bool validCursor = true;
+    if (const QString cursor = arguments["cursor"].toString(); !cursor.isEmpty())
+        range.startOffset = cursor.toLongLong(&validCursor);
+
+    CodeEditorManager::FileRange file;
+    if (!validCursor || range.startOffset < -1) {
+        result["error"] = QString("Invalid cursor, pass next_cursor of the previous read_file result");
+    } else if (!m_editorManager->readFileRange(path, range, &file)) {
+        result["error"] = QString("Failed to read file: " + path);
+    } else if (file.binary) {
+        result["error"] = QString("Not a text file: %1 (%2 bytes)").arg(path).arg(file.totalBytes);
+    } else {
+        result["content"] = file.content;
+        result["start_line"] = file.startLine;
+        result["end_line"] = file.endLine;
+        result["total_lines"] = file.totalLines;
+        if (file.nextOffset >= 0) {
+            result["truncated"] = true;
+            result["next_cursor"] = QString::number(file.nextOffset);
+            result["next_line"] = file.nextLine;
+        }
+    }
+    return result;
+}
+
 QJsonObject MCPServer::callTool(const QString &name, const QJsonObject &arguments)
 {
     QJsonObject result;
@@ -253,28 +580,120 @@ QJsonObject MCPServer::callTool(const QString &name, const QJsonObject &argument
     }
     
     if (name == "read_file") {
-        QString path = arguments["path"].toString();
-        path = m_editorManager->resolvePath(path);
-        QString content;
-        if (m_editorManager->readFile(path, content)) {
-            result["content"] = content;
+        result = readFileRange(arguments, qBound(MinReadBytes, arguments["max_bytes"].toInteger(DefaultReadBytes), MaxReadBytes));
+    } else if (name == "read_files") {
+        const QJsonArray files = arguments["files"].toArray();
+        const qint64 budget = qBound(MinReadBytes, arguments["max_bytes"].toInteger(DefaultBatchBytes), MaxBatchBytes);
+        if (files.isEmpty()) {
+            result["error"] = QString("Pass the files to read");
+        } else if (files.size() > MaxBatchFiles) {
+            result["error"] = QString("At most %1 files can be read at once").arg(MaxBatchFiles);
         } else {
-            result["error"] = QString("Failed to read file: " + path);
+            // All files are read in parallel, each as if it had the budget to itself...
+            std::vector<QJsonObject> fileArguments;
+            for (const auto &file : files)
+                fileArguments.push_back(file.isString() ? QJsonObject{{"path", file}} : file.toObject());
+            std::vector<QJsonObject> reads(fileArguments.size());
+            // Open documents are read on this thread: on the GUI thread, a worker
+            // would wait for it while it waits for the worker.
+            std::vector<bool> open(fileArguments.size());
+            QSemaphore done;
+            int started = 0;
+            for (size_t i = 0; i < reads.size(); ++i) {
+                open[i] = m_editorManager->isOpen(m_editorManager->resolvePath(fileArguments[i]["path"].toString()));
+                if (open[i])
+                    continue;
+                ++started;
+                m_fileReadPool.start([this, &fileArguments, &reads, &done, i, budget]() {
+                    reads[i] = readFileRange(fileArguments[i], qMin(budget, MaxReadBytes));
+                    done.release();
+                });
+            }
+            for (size_t i = 0; i < reads.size(); ++i) {
+                if (open[i])
+                    reads[i] = readFileRange(fileArguments[i], qMin(budget, MaxReadBytes));
+            }
+            done.acquire(started);
+
+            // ...then the budget goes to them in order. It counts escaped JSON, as
+            // the cap on the result does: quotes, backslashes and control characters
+            // grow on the way. The file that no longer fits is read again up to what
+            // is left, so that its cursor is right.
+            const auto jsonSize = [](const QJsonObject &object) {
+                return qint64(QJsonDocument(object).toJson(QJsonDocument::Compact).size());
+            };
+            qint64 remaining = budget;
+            bool truncated = false;
+            QJsonArray results;
+            for (size_t i = 0; i < reads.size(); ++i) {
+                QJsonObject file = reads[i];
+                file["path"] = fileArguments[i]["path"];
+                qint64 size = jsonSize(file);
+                while (size > remaining) {
+                    // Fewer bytes of content by the share that is too much.
+                    const qint64 contentBytes = file["content"].toString().toUtf8().size();
+                    const qint64 maxBytes = qMin(contentBytes - 1, contentBytes * remaining / size);
+                    file = maxBytes >= MinReadBytes ? readFileRange(fileArguments[i], maxBytes)
+                                                    : QJsonObject{{"skipped", true}};
+                    file["path"] = fileArguments[i]["path"];
+                    size = file["skipped"].toBool() ? 0 : jsonSize(file);
+                }
+                remaining -= size;
+                truncated = truncated || file["truncated"].toBool() || file["skipped"].toBool();
+                results.append(file);
+            }
+            result["files"] = results;
+            if (truncated)
+                result["truncated"] = true;
         }
     } else if (name == "write_file") {
         QString path = arguments["path"].toString();
         path = m_editorManager->resolvePath(path);
         QString content = arguments["content"].toString();
         if (m_editorManager->writeFile(path, content)) {
+            filesChanged({path});
             result["success"] = true;
         } else {
             result["error"] = QString("Failed to write file: " + path);
         }
+    } else if (name == "edit_file") {
+        QString path = arguments["path"].toString();
+        path = m_editorManager->resolvePath(path);
+
+        QList<PatchEngine::Edit> edits;
+        if (arguments.contains("search"))
+            edits.append(PatchEngine::Edit{arguments["search"].toString(), arguments["replace"].toString()});
+        for (const auto &edit : arguments["edits"].toArray())
+            edits.append(PatchEngine::Edit{edit.toObject()["search"].toString(), edit.toObject()["replace"].toString()});
+        const QString diff = arguments["diff"].toString();
+
+        QString content;
+        if (edits.isEmpty() == diff.isEmpty()) {
+            result["error"] = QString("Pass either search and replace, edits, or diff");
+        } else if (!m_editorManager->readFile(path, content)) {
+            result["error"] = QString("Failed to read file: " + path);
+        } else {
+            const PatchEngine::Result patch = diff.isEmpty() ? PatchEngine::applyEdits(content, edits)
+                                                             : PatchEngine::applyUnifiedDiff(content, diff);
+            if (!patch.success) {
+                result["error"] = QString("No change was made. " + patch.errorString);
+            } else if (patch.content != content && !m_editorManager->writeFile(path, patch.content)) {
+                result["error"] = QString("Failed to write file: " + path);
+            } else {
+                if (patch.content != content)
+                    filesChanged({path});
+                result["success"] = true;
+                result["applied"] = patch.applied;
+                if (!patch.notes.isEmpty())
+                    result["notes"] = QJsonArray::fromStringList(patch.notes);
+            }
+        }
     } else if (name == "create_file") {
         QString path = arguments["path"].toString();
         path = m_editorManager->resolvePath(path);
         QString content = arguments["content"].toString();
         if (m_editorManager->createFile(path, content)) {
+            filesChanged({path});
             result["success"] = true;
         } else {
             result["error"] = QString("Failed to create file: " + path);
@@ -299,6 +718,7 @@ QJsonObject MCPServer::callTool(const QString &name, const QJsonObject &argument
         QString path = arguments["path"].toString();
         path = m_editorManager->resolvePath(path);
         if (m_editorManager->deleteFile(path)) {
+            filesChanged({path});
             result["success"] = true;
         } else {
             result["error"] = QString("Failed to delete file: " + path);
@@ -307,29 +727,269 @@ QJsonObject MCPServer::callTool(const QString &name, const QJsonObject &argument
         QString path = arguments["path"].toString();
         path = m_editorManager->resolvePath(path);
         if (path.isEmpty()) path = m_editorManager->getProjectPath();
-        
-        QDir dir(path);
-        if (dir.exists()) {
-            QJsonArray files;
-            for (const auto &info : dir.entryInfoList(QDir::NoDotAndDotDot | QDir::AllEntries)) {
-                QJsonObject fileInfo;
-                fileInfo["name"] = info.fileName();
-                fileInfo["type"] = info.isDir() ? "directory" : "file";
-                fileInfo["size"] = info.size();
-                files.append(fileInfo);
+
+        const QString root = QDir::cleanPath(QDir(path).absolutePath());
+        const int maxDepth = qBound(1, arguments["max_depth"].toInt(1), MaxListDepth);
+        const int maxEntries = qBound(1, arguments["max_entries"].toInt(DefaultListEntries), MaxListEntries);
+        const QStringList include = globList(arguments["include"].toString());
+        const QStringList exclude = globList(arguments["exclude"].toString());
+        const bool respectGitIgnore = arguments["respect_gitignore"].toBool(true);
+
+        // .gitignore files apply from the project root down, outside of the project
+        // from the listed directory down.
+        const QString projectPath = QDir::cleanPath(m_editorManager->getProjectPath());
+        const bool inProject = !m_editorManager->getProjectPath().isEmpty()
+                               && (root == projectPath || root.startsWith(projectPath + '/'));
+        const QString ignoreRoot = inProject ? projectPath : root;
+        const QString rootInIgnoreRoot = root == ignoreRoot ? QString() : root.mid(ignoreRoot.size() + 1);
+
+        struct Pending {
+            QString path;
+            QString relativePath;   // To root, empty for root itself.
+            std::shared_ptr<const GitIgnore> ignore;
+            int depth;
+        };
+        QList<Pending> queue;
+        queue.append(Pending{root, QString(),
+                             respectGitIgnore ? GitIgnore::forTree(ignoreRoot, rootInIgnoreRoot) : nullptr, 1});
+
+        // Breadth first, so a capped listing still shows the top of the tree.
+        QJsonArray files;
+        bool truncated = false;
+        for (qsizetype next = 0; next < queue.size() && !truncated; ++next) {
+            const Pending directory = queue[next];
+            const DirectoryCache::Listing listing = m_directoryCache.entries(directory.path);
+            if (!listing) {
+                if (next == 0)
+                    result["error"] = QString("Directory not found: " + path);
+                continue;
             }
+            // The root's own .gitignore came with forTree(), the cached listing
+            // tells whether a subdirectory has one without trying to open it.
+            std::shared_ptr<const GitIgnore> ignore = directory.ignore;
+            if (respectGitIgnore && next > 0
+                && std::any_of(listing->cbegin(), listing->cend(), [](const DirectoryCache::Entry &entry) {
+                       return entry.name == QLatin1StringView(".gitignore");
+                   })) {
+                const QString ignoreDir = rootInIgnoreRoot.isEmpty() ? directory.relativePath
+                                                                     : rootInIgnoreRoot + '/' + directory.relativePath;
+                ignore = GitIgnore::forDirectory(ignore, directory.path, ignoreDir);
+            }
+            for (const DirectoryCache::Entry &entry : *listing) {
+                if (entry.isDirectory && CodeSearch::isSkippedDirectory(entry.name))
+                    continue;
+                const QString relativePath = directory.relativePath.isEmpty() ? entry.name
+                                                                              : directory.relativePath + '/' + entry.name;
+                const QString ignorePath = rootInIgnoreRoot.isEmpty() ? relativePath
+                                                                      : rootInIgnoreRoot + '/' + relativePath;
+                if ((ignore && ignore->isIgnored(ignorePath, entry.isDirectory))
+                    || matchesAny(exclude, entry.name, relativePath))
+                    continue;
+
+                // With include globs, directories are descended but not listed.
+                const bool listed = entry.isDirectory ? include.isEmpty()
+                                                      : include.isEmpty() || matchesAny(include, entry.name, relativePath);
+                if (listed) {
+                    if (files.size() >= maxEntries) {
+                        truncated = true;
+                        break;
+                    }
+                    QJsonObject fileInfo;
+                    fileInfo["name"] = relativePath;
+                    fileInfo["type"] = entry.isDirectory ? "directory" : "file";
+                    if (!entry.isDirectory)
+                        fileInfo["size"] = entry.size;
+                    files.append(fileInfo);
+                }
+                if (entry.isDirectory && directory.depth < maxDepth)
+                    queue.append(Pending{directory.path + '/' + entry.name, relativePath, ignore, directory.depth + 1});
+            }
+        }
+        if (!result.contains("error")) {
             result["files"] = files;
-        } else {
-            result["error"] = QString("Directory not found: " + path);
+            if (truncated)
+                result["truncated"] = true;
         }
     } else if (name == "search_code") {
-        // Simple implementation for now, should ideally use Qt Creator's search
-        QString query = arguments["query"].toString();
-        result["message"] = "Search not fully implemented, but I'll try to find it in the project files.";
-        result["query"] = query;
+        const QString projectPath = m_editorManager->getProjectPath();
+        QString path = arguments["path"].toString();
+        path = path.isEmpty() ? projectPath : m_editorManager->resolvePath(path);
+
+        CodeSearch::Options options;
+        options.pattern = arguments["query"].toString();
+        options.regex = arguments["regex"].toBool();
+        options.caseSensitive = arguments["case_sensitive"].toBool();
+        options.fileGlob = arguments["file_pattern"].toString();
+        options.maxResults = qBound(1, arguments["max_results"].toInt(50), 500);
+
+        // The index covers the project, it narrows searches anywhere inside it.
+        std::optional<QStringList> candidates;
+        const QString indexRoot = m_searchIndex.projectPath();
+        const QString searchRoot = QDir::cleanPath(path);
+        if (!indexRoot.isEmpty() && (searchRoot == indexRoot || searchRoot.startsWith(indexRoot + '/')))
+            candidates = m_searchIndex.candidates(options.pattern, options.regex);
+
+        const CodeSearch::Result search = CodeSearch::search(path, options, candidates);
+        if (!search.errorString.isEmpty()) {
+            result["error"] = search.errorString;
+        } else {
+            // Project-relative paths can be passed straight to read_file.
+            const QDir projectDir(projectPath.isEmpty() ? path : projectPath);
+            QJsonArray matches;
+            for (const auto &match : search.matches) {
+                QJsonObject matchJson{
+                    {"path", projectDir.relativeFilePath(match.filePath)},
+                    {"line", match.line},
+                    {"column", match.column},
+                    {"text", match.text}
+                };
+                if (!match.before.isEmpty())
+                    matchJson["before"] = QJsonArray::fromStringList(match.before);
+                if (!match.after.isEmpty())
+                    matchJson["after"] = QJsonArray::fromStringList(match.after);
+                matches.append(matchJson);
+            }
+            result["query"] = options.pattern;
+            result["matches"] = matches;
+            result["total_matches"] = search.totalMatches;
+            result["files_searched"] = search.filesSearched;
+            result["files_matched"] = search.filesMatched;
+            if (search.truncated || search.totalMatches > matches.size())
+                result["truncated"] = true;
+        }
+    } else if (name == "get_symbol_info") {
+        const QString symbolName = arguments["name"].toString();
+        const QString kind = arguments["kind"].toString();
+        QList<SymbolIndex::Symbol> symbols = findSymbols(symbolName, kind.isEmpty() ? 20 : 200);
+        if (!kind.isEmpty()) {
+            symbols.removeIf([&kind](const SymbolIndex::Symbol &symbol) {
+                return SymbolIndex::kindName(symbol.kind) != kind;
+            });
+            if (symbols.size() > 20)
+                symbols.resize(20);
+        }
+
+        if (symbols.isEmpty()) {
+            result["error"] = m_symbolIndex.isReady()
+                                  ? QString("Symbol not found: " + symbolName)
+                                  : QString("The symbol index is still being built, use search_code for now");
+        } else {
+            const QDir projectDir(m_editorManager->getProjectPath());
+            QJsonArray symbolsJson;
+            for (const auto &symbol : std::as_const(symbols))
+                symbolsJson.append(symbolToJson(symbol, projectDir));
+            result["symbols"] = symbolsJson;
+        }
+    } else if (name == "find_usages") {
+        const QString projectPath = m_editorManager->getProjectPath();
+        const QString symbolName = arguments["name"].toString();
+        const QStringList parts = symbolName.split(QLatin1StringView("::"), Qt::SkipEmptyParts);
+
+        // Whole-word matches of the unqualified name, the index narrows the files.
+        CodeSearch::Options options;
+        options.pattern = parts.isEmpty() ? QString()
+                                          : "\\b" + QRegularExpression::escape(parts.last()) + "\\b";
+        options.regex = true;
+        options.caseSensitive = true;
+        options.contextLines = 0;
+        options.fileGlob = arguments["file_pattern"].toString();
+        options.maxResults = qBound(1, arguments["max_results"].toInt(50), 500);
+        const auto candidates = parts.isEmpty() ? std::nullopt : m_searchIndex.candidates(parts.last(), false);
+
+        const CodeSearch::Result search = CodeSearch::search(projectPath, options, candidates);
+        if (!search.errorString.isEmpty()) {
+            result["error"] = search.errorString;
+        } else {
+            // Tells definitions and declarations apart from plain uses.
+            QHash<QString, bool> declarations;
+            for (const auto &symbol : findSymbols(symbolName, 50))
+                declarations.insert(symbol.filePath + ':' + QString::number(symbol.line), symbol.isDefinition);
+
+            const QDir projectDir(projectPath);
+            QJsonArray usages;
+            for (const auto &match : search.matches) {
+                QString text = match.text.trimmed();
+                if (text.size() > MaxUsageLineLength)
+                    text = text.left(MaxUsageLineLength - 3) + "...";
+                QJsonObject usage{
+                    {"path", projectDir.relativeFilePath(match.filePath)},
+                    {"line", match.line},
+                    {"text", text}
+                };
+                const auto declaration = declarations.constFind(match.filePath + ':' + QString::number(match.line));
+                if (declaration != declarations.cend())
+                    usage["kind"] = declaration.value() ? "definition" : "declaration";
+                usages.append(usage);
+            }
+            result["name"] = symbolName;
+            result["usages"] = usages;
+            result["total_usages"] = search.totalMatches;
+            if (search.truncated || search.totalMatches > usages.size())
+                result["truncated"] = true;
+        }
+    } else if (name == "get_class_outline") {
+        const QString className = arguments["name"].toString();
+        SymbolIndex::Symbol classSymbol;
+        const QList<SymbolIndex::Symbol> members = classOutline(className, &classSymbol);
+        if (classSymbol.name.isEmpty()) {
+            result["error"] = m_symbolIndex.isReady()
+                                  ? QString("Class not found: " + className)
+                                  : QString("The symbol index is still being built, use search_code for now");
+        } else {
+            const QDir projectDir(m_editorManager->getProjectPath());
+            QJsonArray membersJson;
+            for (const auto &member : members) {
+                QJsonObject memberJson{
+                    {"name", member.name},
+                    {"kind", SymbolIndex::kindName(member.kind)},
+                    {"line", member.line},
+                    {"signature", member.signature}
+                };
+                membersJson.append(memberJson);
+            }
+            result["class"] = symbolToJson(classSymbol, projectDir);
+            result["members"] = membersJson;
+        }
+    } else if (name == "semantic_search") {
+        const QString query = arguments["query"].toString();
+        const int maxResults = qBound(1, arguments["max_results"].toInt(8), 50);
+        QString errorString;
+        QList<SemanticIndexer::Result> hits;
+        if (!query.trimmed().isEmpty())
+            hits = m_semanticIndex.search(query, maxResults, &errorString);
+
+        if (query.trimmed().isEmpty()) {
+            result["error"] = QString("Query is empty");
+        } else if (hits.isEmpty() && !errorString.isEmpty()) {
+            result["error"] = errorString;
+        } else {
+            const QDir projectDir(m_semanticIndex.projectPath());
+            QJsonArray chunks;
+            for (const auto &hit : hits) {
+                chunks.append(QJsonObject{
+                    {"path", projectDir.relativeFilePath(hit.filePath)},
+                    {"start_line", hit.startLine},
+                    {"end_line", hit.endLine},
+                    {"score", qRound(hit.score * 1000) / 1000.0},
+                    {"text", hit.text}
+                });
+            }
+            result["results"] = chunks;
+            if (!m_semanticIndex.isReady())
+                result["note"] = QString("The index is still being built, results may be incomplete");
+        }
     } else {
         result["error"] = QString("Unknown tool: " + name);
     }
-    
+
+    // Whatever the tool, nothing huge lands in the conversation history.
+    const qsizetype size = QJsonDocument(result).toJson(QJsonDocument::Compact).size();
+    if (size > MaxResultBytes) {
+        return QJsonObject{{"error", QString("The result of %1 is %2 KiB, more than the limit of %3 KiB. "
+                                             "Ask for less, e.g. a line range of a file")
+                                         .arg(name)
+                                         .arg(size / 1024)
+                                         .arg(MaxResultBytes / 1024)}};
+    }
     return result;
 }
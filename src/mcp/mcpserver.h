@@ -2,13 +2,19 @@
 #define MCPSERVER_H
 
 #include <QObject>
+#include <QFuture>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QThreadPool>
 
 // class CodeEditorManager;
 
 #include "src/core/codeeditormanager.h"
+#include "src/core/directorycache.h"
+#include "src/core/symbolindex.h"
+#include "src/core/trigramindex.h"
+#include "src/rag/semanticindexer.h"
 
 class MCPServer : public QObject
 {
@@ -16,6 +22,9 @@ class MCPServer : public QObject
 
 public:
     explicit MCPServer(CodeEditorManager *editorManager, QObject *parent = nullptr);
+    // Drops queued tool calls and waits for the running ones, which use the
+    // indexes and the editor manager.
+    ~MCPServer() override;
     
     struct MCPRequest {
         QString method;
@@ -39,8 +48,27 @@ public:
     
     // MCP Tool methods  
     QJsonArray listTools() const;
+    // Thread-safe for file tools, get_editor_context must be called on the GUI thread.
     QJsonObject callTool(const QString &name, const QJsonObject &arguments);
 
+    // Runs the tool without blocking the caller and delivers the result through
+    // the future. Read-only tools run concurrently on a thread pool, file-modifying
+    // tools one at a time on a background thread and editor tools on the GUI
+    // thread. After timeoutMs (negative for defaultTimeoutMs(), 0 for none) the
+    // future gets an error result; the tool itself cannot be interrupted, its late
+    // result is dropped.
+    // Cancelling the future skips the tool if it has not started yet.
+    QFuture<QJsonObject> callToolAsync(const QString &name, const QJsonObject &arguments, int timeoutMs = -1);
+
+    // Tools that only read from disk and may run concurrently on worker threads.
+    static bool isReadOnlyTool(const QString &name);
+    // Tools that modify files, they are serialized against each other.
+    static bool isFileModifyingTool(const QString &name);
+    static int defaultTimeoutMs(const QString &name);
+
+    // Backs semantic_search, configured with the embedding model by the owner.
+    SemanticIndexer *semanticIndexer() { return &m_semanticIndex; }
+
 private:
     void initializeResources();
     void initializeTools();
@@ -49,10 +77,27 @@ private:
                               const QString &mimeType, const QString &description) const;
     QJsonObject createTool(const QString &name, const QString &description,
                           const QJsonArray &inputSchema) const;
+
+    // Symbol lookups, from Qt Creator's code model when it is available.
+    QList<SymbolIndex::Symbol> findSymbols(const QString &name, int maxResults);
+    QList<SymbolIndex::Symbol> classOutline(const QString &className, SymbolIndex::Symbol *classSymbol);
+    void filesChanged(const QStringList &filePaths);
+    // read_file of one file, from the arguments path, start_line, end_line and cursor.
+    QJsonObject readFileRange(const QJsonObject &arguments, qint64 maxBytes);
     
     CodeEditorManager *m_editorManager;
     QJsonArray m_availableResources;
     QJsonArray m_availableTools;
+
+    // For read_files, whose caller may hold an m_readPool thread. Declared first,
+    // so it outlives the tools that wait for it.
+    QThreadPool m_fileReadPool;
+    QThreadPool m_readPool;
+    QThreadPool m_writePool;
+    TrigramIndex m_searchIndex;
+    SymbolIndex m_symbolIndex;
+    SemanticIndexer m_semanticIndex;
+    DirectoryCache m_directoryCache;
 };
 
 #endif // MCPSERVER_H
@@ -1 +1,141 @@
 #include "llmprovider.h"
+#include "requestcontext.h"
+#include "streamdecoder.h"
+#include "src/core/conversationhistory.h"
+#include "src/core/tracer.h"
+
+#include <QJsonDocument>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSslConfiguration>
+
+namespace {
+// Qt keeps idle connections for 120 s, a warm-up younger than this is still usable.
+constexpr qint64 WarmUpIntervalMs = 60 * 1000;
+}
+
+LLMProvider::RequestId LLMProvider::sendConversation(const ConversationHistory &history, bool stream, const QJsonArray &tools)
+{
+    return sendChatRequest(history.toJsonArray(), stream, tools);
+}
+
+QByteArray LLMProvider::buildRequestBody(const QJsonObject &fields, const QByteArray &messagesJson)
+{
+    const QByteArray head = QJsonDocument(fields).toJson(QJsonDocument::Compact);
+
+    QByteArray body;
+    body.reserve(head.size() + messagesJson.size() + 16);
+    body += "{\"messages\":";
+    body += messagesJson;
+    if (head.size() > 2) {
+        // head is "{...}", continue after its opening brace.
+        body += ',';
+        body += QByteArrayView(head).sliced(1);
+    } else {
+        body += '}';
+    }
+    return body;
+}
+
+void LLMProvider::cancel(RequestId id)
+{
+    const auto context = m_activeRequests.take(id);
+    if (!context) return;
+
+    context->cancelled = true;
+    context->toolCalls.clear();
+    if (context->reply) {
+        // Closing the connection is what frees the slot on local inference servers.
+        context->reply->abort();
+    }
+}
+
+void LLMProvider::cancelAll()
+{
+    const auto ids = m_activeRequests.keys();
+    for (RequestId id : ids) {
+        cancel(id);
+    }
+}
+
+LLMProvider::RequestId LLMProvider::beginRequest(QNetworkReply *reply, const std::shared_ptr<RequestContext> &context)
+{
+    context->id = ++m_lastRequestId;
+    context->reply = reply;
+    m_activeRequests.insert(context->id, context);
+
+    ++m_connectionStats.requests;
+    if (Tracer::instance().isEnabled())
+        Tracer::instance().asyncBegin("request", "network", context->id, {{"provider", name()}});
+    // Only emitted when the reply could not reuse a cached connection.
+    connect(reply, &QNetworkReply::socketStartedConnecting, this, [this]() {
+        ++m_connectionStats.newConnections;
+    });
+    connect(reply, &QNetworkReply::encrypted, this, [this]() {
+        ++m_connectionStats.tlsHandshakes;
+    });
+
+    return context->id;
+}
+
+void LLMProvider::endRequest(RequestContext &context, bool succeeded)
+{
+    m_activeRequests.remove(context.id);
+    context.markFinished(succeeded);
+    // The arguments are built only when they are going to be recorded.
+    const bool tracing = Tracer::instance().isEnabled();
+    if (!context.cancelled) {
+        RequestMetrics metrics = context.metrics();
+        metrics.provider = name();
+        if (tracing) {
+            Tracer::instance().asyncEnd("request", "network", context.id,
+                                        {{"firstTokenMs", metrics.firstTokenMs},
+                                         {"completionTokens", metrics.completionTokens},
+                                         {"tokensPerSecond", metrics.tokensPerSecond},
+                                         {"succeeded", metrics.succeeded}});
+        }
+        emit requestMetrics(metrics, context.id);
+    } else if (tracing) {
+        Tracer::instance().asyncEnd("request", "network", context.id, {{"cancelled", true}});
+    }
+    emit requestFinished(context.id);
+}
+
+void LLMProvider::warmUpConnection(QNetworkAccessManager &nam, const QUrl &url)
+{
+    if (!url.isValid() || url.host().isEmpty()) return;
+
+    const QUrl origin = url.adjusted(QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment | QUrl::RemoveUserInfo);
+    if (origin == m_warmedUpOrigin && m_warmUpTimer.isValid() && m_warmUpTimer.elapsed() < WarmUpIntervalMs)
+        return;
+    m_warmedUpOrigin = origin;
+    m_warmUpTimer.start();
+
+    if (url.scheme() == "https") {
+        QSslConfiguration ssl = QSslConfiguration::defaultConfiguration();
+        ssl.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP2, QSslConfiguration::NextProtocolHttp1_1});
+        nam.connectToHostEncrypted(url.host(), url.port(443), ssl);
+    } else {
+        nam.connectToHost(url.host(), url.port(80));
+    }
+}
+
+void LLMProvider::prepareRequest(QNetworkRequest &request)
+{
+    // Negotiated via ALPN where the server supports it, so concurrent tool-loop
+    // turns and background requests share a single connection.
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+}
+
+void LLMProvider::reportUnrecognizedStreamData(RequestContext &context)
+{
+    const QByteArray raw = context.decoder.takeUnrecognized().trimmed();
+    if (raw.isEmpty() || context.decoder.hasSeenEvents()) return;
+
+    // If we got data but none of it looked like a stream event, it might be a raw
+    // error message even if the status code was 200.
+    if (raw.contains("Unexpected endpoint") || raw.contains("error")) {
+        emit partialResponse("\n**System Notification:** " + QString::fromUtf8(raw) + "\n", context.id);
+    }
+}
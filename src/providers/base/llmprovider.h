@@ -3,20 +3,52 @@
 
 #include <QObject>
 #include <QString>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QUrl>
 #include <QJsonArray>
 #include <QJsonObject>
 
+#include <memory>
+
+#include "src/providers/base/requestmetrics.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QNetworkRequest;
+struct RequestContext;
+class ConversationHistory;
+
 class LLMProvider : public QObject
 {
     Q_OBJECT
 public:
+    // Handle for one in-flight request, 0 means "no request".
+    using RequestId = quint64;
+
+    // How often requests could ride on an already open (keep-alive / TLS) connection.
+    struct ConnectionStats {
+        int requests = 0;
+        int newConnections = 0;
+        int tlsHandshakes = 0;
+
+        int reusedConnections() const { return requests - newConnections; }
+    };
+
     explicit LLMProvider(QObject *parent = nullptr) : QObject(parent) {}
     virtual ~LLMProvider() = default;
 
     virtual QString name() const = 0;
 
     // Standardized interface for chat completions
-    virtual void sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) = 0;
+    virtual RequestId sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) = 0;
+
+    // Same as sendChatRequest with history.toJsonArray(). Providers override it to
+    // reuse the history's serialized messages instead of re-encoding them.
+    virtual RequestId sendConversation(const ConversationHistory &history, bool stream = true, const QJsonArray &tools = QJsonArray());
+
+    // Serializes fields and adds "messages" from already encoded JSON.
+    static QByteArray buildRequestBody(const QJsonObject &fields, const QByteArray &messagesJson);
 
     // Legacy method, can be implemented in terms of sendChatRequest if needed
     virtual void sendPrompt(const QString &prompt) {
@@ -28,12 +60,54 @@ public:
         sendChatRequest(messages, false);
     }
 
+    // Aborts the request: the reply is closed (which makes the server stop
+    // generating), pending tool calls are dropped and no further signals are
+    // emitted for it except requestFinished.
+    virtual void cancel(RequestId id);
+    void cancelAll();
+    bool isActive(RequestId id) const { return m_activeRequests.contains(id); }
+
+    ConnectionStats connectionStats() const { return m_connectionStats; }
+
+    // Opens (and for https, handshakes) the connection to the endpoint ahead of
+    // the first request, so DNS/TCP/TLS setup is off the critical path.
+    virtual void warmUp() {}
+
+protected:
+    // Registers a sent request so that it can be cancelled. Returns its handle.
+    RequestId beginRequest(QNetworkReply *reply, const std::shared_ptr<RequestContext> &context);
+    // Must be called once the reply has finished, whatever the outcome.
+    void endRequest(RequestContext &context, bool succeeded = true);
+
+    // Pre-connects nam to url unless that was done recently. For https the
+    // connection negotiates HTTP/2 via ALPN, so later requests are multiplexed on it.
+    void warmUpConnection(QNetworkAccessManager &nam, const QUrl &url);
+    // Common request attributes (HTTP/2, keep-alive) for all providers.
+    static void prepareRequest(QNetworkRequest &request);
+
+    // Surfaces text that was not part of the stream format (e.g. a plain error
+    // body sent with status 200) as a notification in the chat.
+    void reportUnrecognizedStreamData(RequestContext &context);
+
 signals:
-    void responseReady(const QString &text);
-    void partialResponse(const QString &delta);
-    void streamFinished();
-    void errorOccurred(const QString &error);
-    void toolCallsReceived(const QJsonArray &toolCalls);
+    // Every signal but requestFinished carries the request last, so that slots
+    // which do not care about it can leave it out.
+    void responseReady(const QString &text, LLMProvider::RequestId id);
+    void partialResponse(const QString &delta, LLMProvider::RequestId id);
+    void streamFinished(LLMProvider::RequestId id);
+    void errorOccurred(const QString &error, LLMProvider::RequestId id);
+    void toolCallsReceived(const QJsonArray &toolCalls, LLMProvider::RequestId id);
+    // Timing of every request that was not cancelled, emitted before requestFinished.
+    void requestMetrics(const RequestMetrics &metrics, LLMProvider::RequestId id);
+    // Emitted last for every request, including failed and cancelled ones.
+    void requestFinished(LLMProvider::RequestId id);
+
+private:
+    QHash<RequestId, std::shared_ptr<RequestContext>> m_activeRequests;
+    RequestId m_lastRequestId = 0;
+    ConnectionStats m_connectionStats;
+    QUrl m_warmedUpOrigin;
+    QElapsedTimer m_warmUpTimer;
 };
 
 #endif // LLMPROVIDER_H
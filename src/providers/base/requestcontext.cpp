@@ -0,0 +1,119 @@
+#include "requestcontext.h"
+
+RequestContext::RequestContext(StreamDecoder::Format format)
+    : decoder(format)
+{
+    timer.start();
+}
+
+void RequestContext::markRequestBuilt()
+{
+    requestBuiltMs = timer.elapsed();
+}
+
+void RequestContext::markFirstByte()
+{
+    if (firstByteMs < 0)
+        firstByteMs = timer.elapsed();
+}
+
+void RequestContext::appendContent(const QString &delta)
+{
+    if (delta.isEmpty())
+        return;
+    if (firstTokenMs < 0)
+        firstTokenMs = timer.elapsed();
+    ++contentChunks;
+    content += delta;
+}
+
+void RequestContext::setReportedCompletionTokens(int tokens)
+{
+    if (tokens > 0)
+        reportedCompletionTokens = tokens;
+}
+
+void RequestContext::markFinished(bool ok)
+{
+    if (finishedMs < 0)
+        finishedMs = timer.elapsed();
+    succeeded = ok;
+}
+
+RequestMetrics RequestContext::metrics() const
+{
+    RequestMetrics m;
+    m.requestId = id;
+    m.buildMs = requestBuiltMs;
+    m.firstByteMs = firstByteMs;
+    m.firstTokenMs = firstTokenMs;
+    m.totalMs = finishedMs >= 0 ? finishedMs : timer.elapsed();
+    if (firstToolCallMs >= 0 && toolCallsAssembledMs >= 0)
+        m.toolCallAssemblyMs = toolCallsAssembledMs - firstToolCallMs;
+
+    m.tokensReportedByServer = reportedCompletionTokens > 0;
+    // Each streamed delta carries roughly one token.
+    m.completionTokens = m.tokensReportedByServer ? reportedCompletionTokens : contentChunks;
+
+    // Generation speed is measured after the first token, so that prompt
+    // processing does not count against it.
+    const qint64 generationStart = firstTokenMs >= 0 ? firstTokenMs : firstToolCallMs;
+    const qint64 generationMs = generationStart >= 0 ? m.totalMs - generationStart : 0;
+    if (generationMs > 0 && m.completionTokens > 1)
+        m.tokensPerSecond = (m.completionTokens - 1) * 1000.0 / generationMs;
+
+    m.succeeded = succeeded;
+    return m;
+}
+
+void RequestContext::mergeToolCallDelta(const QJsonObject &tc)
+{
+    if (firstToolCallMs < 0)
+        firstToolCallMs = timer.elapsed();
+    ++contentChunks;
+
+    const int index = tc.contains("index") ? tc["index"].toInt() : 0;
+
+    if (!toolCalls.contains(index)) {
+        toolCalls[index] = tc;
+        return;
+    }
+
+    QJsonObject existing = toolCalls[index];
+    if (tc.contains("function")) {
+        QJsonObject existingFunc = existing["function"].toObject();
+        QJsonObject newFunc = tc["function"].toObject();
+
+        if (newFunc.contains("arguments")) {
+            QString args = existingFunc["arguments"].toString();
+            args += newFunc["arguments"].toString();
+            existingFunc["arguments"] = args;
+        }
+        if (newFunc.contains("name")) {
+            QString name = existingFunc["name"].toString();
+            name += newFunc["name"].toString();
+            existingFunc["name"] = name;
+        }
+        existing["function"] = existingFunc;
+    }
+    if (tc.contains("id")) {
+        existing["id"] = tc["id"];
+    }
+    if (tc.contains("type")) {
+        existing["type"] = tc["type"];
+    }
+    toolCalls[index] = existing;
+}
+
+QJsonArray RequestContext::takeToolCalls()
+{
+    if (toolCallsAssembledMs < 0)
+        toolCallsAssembledMs = timer.elapsed();
+
+    // QMap iterates in key order, which is the tool call index.
+    QJsonArray result;
+    for (const auto &call : std::as_const(toolCalls))
+        result.append(call);
+    toolCalls.clear();
+    return result;
+}
@@ -0,0 +1,59 @@
+#ifndef REQUESTCONTEXT_H
+#define REQUESTCONTEXT_H
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMap>
+#include <QPointer>
+#include <QString>
+
+#include "src/providers/base/requestmetrics.h"
+#include "src/providers/base/streamdecoder.h"
+
+class QNetworkReply;
+
+// State of a single in-flight request. Every QNetworkReply gets its own context,
+// so one provider instance can run several overlapping streams without their
+// deltas or tool-call fragments getting mixed up.
+struct RequestContext
+{
+    explicit RequestContext(StreamDecoder::Format format = StreamDecoder::ServerSentEvents);
+
+    // Records the progress of the request for timing.
+    void markRequestBuilt();
+    void markFirstByte();
+    void appendContent(const QString &delta);
+    // Token count from the server's usage report, preferred over counted chunks.
+    void setReportedCompletionTokens(int tokens);
+    void markFinished(bool succeeded);
+
+    RequestMetrics metrics() const;
+
+    // Merges a streamed OpenAI-style tool_calls[] fragment into the call at its index.
+    void mergeToolCallDelta(const QJsonObject &toolCall);
+    bool hasToolCalls() const { return !toolCalls.isEmpty(); }
+    // Returns the assembled calls ordered by index and clears them.
+    QJsonArray takeToolCalls();
+
+    quint64 id = 0;
+    QPointer<QNetworkReply> reply;
+    bool cancelled = false;
+
+    StreamDecoder decoder;
+    QString content;
+    QMap<int, QJsonObject> toolCalls;
+
+    QElapsedTimer timer;
+    qint64 requestBuiltMs = -1;
+    qint64 firstByteMs = -1;
+    qint64 firstTokenMs = -1;
+    qint64 firstToolCallMs = -1;
+    qint64 toolCallsAssembledMs = -1;
+    qint64 finishedMs = -1;
+    int contentChunks = 0;
+    int reportedCompletionTokens = -1;
+    bool succeeded = false;
+};
+
+#endif // REQUESTCONTEXT_H
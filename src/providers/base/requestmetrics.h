@@ -0,0 +1,29 @@
+#ifndef REQUESTMETRICS_H
+#define REQUESTMETRICS_H
+
+#include <QMetaType>
+#include <QString>
+
+// Timings of one provider request, all in milliseconds since the request was
+// started. -1 means the stage was never reached.
+struct RequestMetrics
+{
+    QString provider;
+    quint64 requestId = 0;
+
+    qint64 buildMs = -1;       // Request body serialized
+    qint64 firstByteMs = -1;   // First response bytes
+    qint64 firstTokenMs = -1;  // First content token (time-to-first-token)
+    qint64 totalMs = -1;       // Reply finished
+    qint64 toolCallAssemblyMs = -1; // First tool-call fragment until all calls assembled
+
+    int completionTokens = 0;
+    bool tokensReportedByServer = false; // Otherwise counted as streamed chunks
+    double tokensPerSecond = 0.0;        // Over the generation phase, after the first token
+
+    bool succeeded = true;
+};
+
+Q_DECLARE_METATYPE(RequestMetrics)
+
+#endif // REQUESTMETRICS_H
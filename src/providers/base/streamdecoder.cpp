@@ -0,0 +1,133 @@
+#include "streamdecoder.h"
+
+#include <cstring>
+
+StreamDecoder::StreamDecoder(Format format)
+    : m_format(format)
+{
+}
+
+QList<StreamDecoder::Event> StreamDecoder::feed(const QByteArray &chunk)
+{
+    QList<Event> events;
+    if (chunk.isEmpty())
+        return events;
+
+    m_bytesConsumed += chunk.size();
+
+    // Fast path: with nothing carried over, scan the chunk in place and only copy
+    // the unterminated tail.
+    const bool carried = !m_buffer.isEmpty();
+    if (carried)
+        m_buffer.append(chunk);
+
+    const char *data = carried ? m_buffer.constData() : chunk.constData();
+    const char *end = data + (carried ? m_buffer.size() : chunk.size());
+    const char *lineStart = data;
+    const char *cursor = data + (carried ? m_scanFrom : 0);
+
+    while (cursor < end) {
+        const auto newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+        if (!newline)
+            break;
+        processLine(lineStart, newline, events);
+        lineStart = newline + 1;
+        cursor = lineStart;
+    }
+
+    if (carried)
+        m_buffer.remove(0, lineStart - data);
+    else
+        m_buffer = QByteArray(lineStart, end - lineStart);
+
+    // Bytes left in the buffer contain no newline, don't scan them again.
+    m_scanFrom = m_buffer.size();
+    return events;
+}
+
+QList<StreamDecoder::Event> StreamDecoder::finish()
+{
+    QList<Event> events;
+    if (!m_buffer.isEmpty()) {
+        const QByteArray rest = m_buffer;
+        m_buffer.clear();
+        m_scanFrom = 0;
+        processLine(rest.constData(), rest.constData() + rest.size(), events);
+    }
+    dispatch(events);
+    return events;
+}
+
+QByteArray StreamDecoder::takeUnrecognized()
+{
+    QByteArray result;
+    result.swap(m_unrecognized);
+    return result;
+}
+
+void StreamDecoder::reset()
+{
+    m_buffer.clear();
+    m_scanFrom = 0;
+    m_pending = Event();
+    m_hasPendingData = false;
+    m_seenEvents = false;
+    m_bytesConsumed = 0;
+    m_unrecognized.clear();
+}
+
+void StreamDecoder::processLine(const char *begin, const char *end, QList<Event> &events)
+{
+    if (end > begin && end[-1] == '\r')
+        --end;
+
+    if (m_format == NewlineDelimitedJson) {
+        while (begin < end && (*begin == ' ' || *begin == '\t'))
+            ++begin;
+        if (begin == end)
+            return;
+        m_seenEvents = true;
+        events.append({QByteArray(), QByteArray(begin, end - begin)});
+        return;
+    }
+
+    // An empty line terminates the current event.
+    if (begin == end) {
+        dispatch(events);
+        return;
+    }
+
+    // Comment / keep-alive line.
+    if (*begin == ':')
+        return;
+
+    const auto colon = static_cast<const char *>(std::memchr(begin, ':', end - begin));
+    const char *fieldEnd = colon ? colon : end;
+    const char *value = colon ? colon + 1 : end;
+    if (value < end && *value == ' ')
+        ++value;
+
+    const QByteArrayView field(begin, fieldEnd - begin);
+    if (field == "data") {
+        if (m_hasPendingData)
+            m_pending.data.append('\n');
+        m_pending.data.append(value, end - value);
+        m_hasPendingData = true;
+        m_seenEvents = true;
+    } else if (field == "event") {
+        m_pending.name = QByteArray(value, end - value);
+    } else if (field == "id" || field == "retry") {
+        // Not used by any provider.
+    } else {
+        m_unrecognized.append(begin, end - begin);
+        m_unrecognized.append('\n');
+    }
+}
+
+void StreamDecoder::dispatch(QList<Event> &events)
+{
+    if (m_hasPendingData)
+        events.append(m_pending);
+    m_pending = Event();
+    m_hasPendingData = false;
+}
@@ -0,0 +1,58 @@
+#ifndef STREAMDECODER_H
+#define STREAMDECODER_H
+
+#include <QByteArray>
+#include <QList>
+
+// Incremental decoder for streamed LLM responses.
+//
+// Network chunks are fed in as they arrive from readyRead. Bytes after the last
+// newline are carried over to the next feed(), so an event split across two TCP
+// chunks is reassembled and a multibyte UTF-8 sequence is never decoded half-way.
+class StreamDecoder
+{
+public:
+    enum Format {
+        ServerSentEvents,     // text/event-stream ("data: ..." lines, blank line ends an event)
+        NewlineDelimitedJson  // one JSON document per line (Ollama /api/chat)
+    };
+
+    struct Event {
+        QByteArray name; // SSE "event:" field, empty for NDJSON
+        QByteArray data; // Payload, multiple SSE data lines joined with '\n'
+    };
+
+    explicit StreamDecoder(Format format = ServerSentEvents);
+
+    Format format() const { return m_format; }
+
+    // Consumes a chunk and returns all events completed by it.
+    QList<Event> feed(const QByteArray &chunk);
+
+    // Flushes a trailing event that was not terminated by a newline or blank line.
+    QList<Event> finish();
+
+    // Lines that were not part of the stream format (e.g. a plain-text error body
+    // returned with status 200). Cleared on each call.
+    QByteArray takeUnrecognized();
+
+    bool hasSeenEvents() const { return m_seenEvents; }
+    qint64 bytesConsumed() const { return m_bytesConsumed; }
+
+    void reset();
+
+private:
+    void processLine(const char *begin, const char *end, QList<Event> &events);
+    void dispatch(QList<Event> &events);
+
+    Format m_format;
+    QByteArray m_buffer;
+    qsizetype m_scanFrom = 0;
+    Event m_pending;
+    bool m_hasPendingData = false;
+    bool m_seenEvents = false;
+    qint64 m_bytesConsumed = 0;
+    QByteArray m_unrecognized;
+};
+
+#endif // STREAMDECODER_H
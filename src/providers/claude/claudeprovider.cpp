@@ -4,6 +4,10 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include "src/core/conversationhistory.h"
+#include "src/core/tracer.h"
+
+#include <memory>
 
 ClaudeProvider::ClaudeProvider(QObject *parent)
     : LLMProvider(parent)
@@ -14,22 +18,23 @@ void ClaudeProvider::setBaseUrl(const QString &url) { baseUrl = url; }
 void ClaudeProvider::setModel(const QString &m) { model = m; }
 void ClaudeProvider::setApiKey(const QString &key) { apiKey = key; }
 
-void ClaudeProvider::sendChatRequest(const QJsonArray &messages, bool stream, const QJsonArray &tools)
+void ClaudeProvider::warmUp()
+{
+    warmUpConnection(nam, endpointUrl());
+}
+
+QUrl ClaudeProvider::endpointUrl() const
 {
     QString fullUrl = baseUrl;
     if (!fullUrl.endsWith("/messages")) {
         if (!fullUrl.endsWith("/")) fullUrl += "/";
         fullUrl += "messages";
     }
-    QUrl url(fullUrl);
-    QNetworkRequest req(url);
-    req.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-    req.setRawHeader("x-api-key", apiKey.toUtf8());
-    req.setRawHeader("anthropic-version", "2023-06-01");
+    return QUrl(fullUrl);
+}
 
-    QJsonObject root;
-    root["model"] = model;
-    
+LLMProvider::RequestId ClaudeProvider::sendChatRequest(const QJsonArray &messages, bool stream, const QJsonArray &tools)
+{
     // Anthropic handles system prompt separately
     QJsonArray anthropicMessages;
     QString systemPrompt;
@@ -41,11 +46,38 @@ void ClaudeProvider::sendChatRequest(const QJsonArray &messages, bool stream, co
             anthropicMessages.append(m);
         }
     }
+
+    return postChatRequest(QJsonDocument(anthropicMessages).toJson(QJsonDocument::Compact), systemPrompt, stream, tools);
+}
+
+LLMProvider::RequestId ClaudeProvider::sendConversation(const ConversationHistory &history, bool stream, const QJsonArray &tools)
+{
+    QString systemPrompt;
+    for (const auto &msg : history.messages()) {
+        if (msg.role == Message::System)
+            systemPrompt = msg.content;
+    }
+
+    return postChatRequest(history.toJsonBytes(false), systemPrompt, stream, tools);
+}
+
+LLMProvider::RequestId ClaudeProvider::postChatRequest(const QByteArray &messagesJson, const QString &systemPrompt,
+                                                       bool stream, const QJsonArray &tools)
+{
+    auto context = std::make_shared<RequestContext>(StreamDecoder::ServerSentEvents);
+
+    QNetworkRequest req(endpointUrl());
+    prepareRequest(req);
+    req.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    req.setRawHeader("x-api-key", apiKey.toUtf8());
+    req.setRawHeader("anthropic-version", "2023-06-01");
+
+    QJsonObject root;
+    root["model"] = model;
     
     if (!systemPrompt.isEmpty()) {
         root["system"] = systemPrompt;
     }
-    root["messages"] = anthropicMessages;
     root["stream"] = stream;
     root["max_tokens"] = 4096;
     
@@ -54,72 +86,96 @@ void ClaudeProvider::sendChatRequest(const QJsonArray &messages, bool stream, co
         // root["tools"] = tools; 
     }
 
-    auto reply = nam.post(req, QJsonDocument(root).toJson());
+    TraceSpan serializeSpan("provider.serialize", "provider");
+    const QByteArray body = buildRequestBody(root, messagesJson);
+    context->markRequestBuilt();
+    serializeSpan.setArg("bytes", body.size());
+    serializeSpan.end();
+    auto reply = nam.post(req, body);
+
+    const RequestId id = beginRequest(reply, context);
 
     if (stream) {
-        connect(reply, &QNetworkReply::readyRead, this, [this, reply]() {
+        connect(reply, &QNetworkReply::readyRead, this, [this, reply, context]() {
+            if (context->cancelled) return;
             if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() >= 400) return;
 
-            QByteArray buffer = reply->readAll();
-            QList<QByteArray> lines = buffer.split('\n');
-            bool sseFound = false;
-
-            for (QByteArray line : lines) {
-                line = line.trimmed();
-                if (line.isEmpty()) continue;
-
-                if (line.startsWith("data: ")) {
-                    sseFound = true;
-                    QByteArray data = line.mid(6);
-                    QJsonDocument doc = QJsonDocument::fromJson(data);
-                    QJsonObject obj = doc.object();
-                    QString type = obj["type"].toString();
-                    
-                    if (type == "content_block_delta") {
-                        QJsonObject delta = obj["delta"].toObject();
-                        if (delta["type"] == "text_delta") {
-                            emit partialResponse(delta["text"].toString());
-                        }
-                    } else if (type == "message_stop") {
-                        emit streamFinished();
-                    }
-                }
-            }
-
-            if (!sseFound && !buffer.isEmpty()) {
-                if (buffer.contains("error")) {
-                     emit partialResponse("\n**System Notification:** " + QString::fromUtf8(buffer).trimmed() + "\n");
-                }
+            TraceSpan span("provider.readChunk", "provider");
+            context->markFirstByte();
+            const auto events = context->decoder.feed(reply->readAll());
+            for (const auto &event : events) {
+                handleStreamEvent(*context, event);
             }
+            reportUnrecognizedStreamData(*context);
         });
     }
 
-    connect(reply, &QNetworkReply::finished, this, [this, reply, stream]{
+    connect(reply, &QNetworkReply::finished, this, [this, reply, stream, context]{
+        if (context->cancelled) {
+            endRequest(*context);
+            reply->deleteLater();
+            return;
+        }
+
         if (reply->error() != QNetworkReply::NoError) {
             QByteArray errorData = reply->readAll();
             QString errorMsg = reply->errorString();
             if (!errorData.isEmpty()) {
                 errorMsg += " - " + QString::fromUtf8(errorData);
             }
-            emit errorOccurred(errorMsg);
+            emit errorOccurred(errorMsg, context->id);
+            endRequest(*context, false);
             reply->deleteLater();
             return;
         }
 
+        if (stream) {
+            auto events = context->decoder.feed(reply->readAll());
+            events += context->decoder.finish();
+            for (const auto &event : events) {
+                handleStreamEvent(*context, event);
+            }
+            reportUnrecognizedStreamData(*context);
+        }
+
         if (!stream) {
+            context->markFirstByte();
             const auto data = reply->readAll();
             const auto doc = QJsonDocument::fromJson(data);
             const auto obj = doc.object();
             const auto content = obj["content"].toArray();
+            context->setReportedCompletionTokens(obj["usage"].toObject()["output_tokens"].toInt());
             if (!content.isEmpty()) {
                 const auto textObj = content[0].toObject();
-                emit responseReady(textObj["text"].toString());
+                emit responseReady(textObj["text"].toString(), context->id);
             } else {
-                emit errorOccurred("Empty Claude response");
+                emit errorOccurred("Empty Claude response", context->id);
             }
         } else {
-            emit streamFinished();
+            emit streamFinished(context->id);
         }
+        endRequest(*context);
         reply->deleteLater();
     });
+
+    return id;
+}
+
+void ClaudeProvider::handleStreamEvent(RequestContext &context, const StreamDecoder::Event &event)
+{
+    QJsonDocument doc = QJsonDocument::fromJson(event.data);
+    QJsonObject obj = doc.object();
+    QString type = obj["type"].toString();
+
+    // "message_stop" needs no handling, streamFinished is emitted once the reply finishes.
+    if (type == "content_block_delta") {
+        QJsonObject delta = obj["delta"].toObject();
+        if (delta["type"] == "text_delta") {
+            const QString text = delta["text"].toString();
+            context.appendContent(text);
+            emit partialResponse(text, context.id);
+        }
+    } else if (type == "message_delta") {
+        context.setReportedCompletionTokens(obj["usage"].toObject()["output_tokens"].toInt());
+    }
 }
@@ -3,6 +3,7 @@
 
 #include <QNetworkAccessManager>
 #include "src/providers/base/llmprovider.h"
+#include "src/providers/base/requestcontext.h"
 
 class ClaudeProvider : public LLMProvider
 {
@@ -16,9 +17,16 @@ public:
     void setModel(const QString &model);
     void setApiKey(const QString &key);
 
-    void sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) override;
+    RequestId sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) override;
+    RequestId sendConversation(const ConversationHistory &history, bool stream = true, const QJsonArray &tools = QJsonArray()) override;
+    void warmUp() override;
 
 private:
+    QUrl endpointUrl() const;
+    RequestId postChatRequest(const QByteArray &messagesJson, const QString &systemPrompt, bool stream,
+                              const QJsonArray &tools);
+    void handleStreamEvent(RequestContext &context, const StreamDecoder::Event &event);
+
     QNetworkAccessManager nam;
     QString baseUrl = "https://api.anthropic.com/v1";
     QString model = "claude-3-5-sonnet-20240620";
@@ -6,7 +6,11 @@
 #include <QJsonObject>
 #include <QJsonArray>
 
+#include <memory>
+
 #include "src/settings/llmsettings.h"
+#include "src/core/conversationhistory.h"
+#include "src/core/tracer.h"
 
 OllamaProvider::OllamaProvider(QObject *parent)
     : LLMProvider(parent)
@@ -26,10 +30,15 @@ void OllamaProvider::setModel(const QString &m)
     model = m;
 }
 
-void OllamaProvider::sendChatRequest(const QJsonArray &messages, bool stream, const QJsonArray &tools)
+void OllamaProvider::warmUp()
+{
+    warmUpConnection(nam, endpointUrl());
+}
+
+QUrl OllamaProvider::endpointUrl() const
 {
     QString fullUrl = baseUrl;
-    
+
     // Check if user missed /v1 or /api/chat
     if (!fullUrl.contains("/v1") && !fullUrl.contains("/api/chat")) {
         if (!fullUrl.endsWith("/")) fullUrl += "/";
@@ -41,68 +50,70 @@ void OllamaProvider::sendChatRequest(const QJsonArray &messages, bool stream, co
         if (!fullUrl.endsWith("/")) fullUrl += "/";
         fullUrl += "chat/completions";
     }
-    QUrl url(fullUrl);
+    return QUrl(fullUrl);
+}
+
+LLMProvider::RequestId OllamaProvider::sendChatRequest(const QJsonArray &messages, bool stream, const QJsonArray &tools)
+{
+    return postChatRequest(QJsonDocument(messages).toJson(QJsonDocument::Compact), stream, tools);
+}
+
+LLMProvider::RequestId OllamaProvider::sendConversation(const ConversationHistory &history, bool stream, const QJsonArray &tools)
+{
+    return postChatRequest(history.toJsonBytes(), stream, tools);
+}
+
+LLMProvider::RequestId OllamaProvider::postChatRequest(const QByteArray &messagesJson, bool stream, const QJsonArray &tools)
+{
+    const QUrl url = endpointUrl();
+    // The native /api/chat endpoint streams NDJSON, the OpenAI-compatible one SSE.
+    const auto format = url.path().endsWith("/api/chat") ? StreamDecoder::NewlineDelimitedJson
+                                                         : StreamDecoder::ServerSentEvents;
+    auto context = std::make_shared<RequestContext>(format);
+
     QNetworkRequest req(url);
+    prepareRequest(req);
     req.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
     QJsonObject root;
     root["model"] = model;
-    root["messages"] = messages;
     root["stream"] = stream;
     
     if (!tools.isEmpty()) {
         root["tools"] = tools;
     }
 
-    auto reply = nam.post(req, QJsonDocument(root).toJson());
+    TraceSpan serializeSpan("provider.serialize", "provider");
+    const QByteArray body = buildRequestBody(root, messagesJson);
+    context->markRequestBuilt();
+    serializeSpan.setArg("bytes", body.size());
+    serializeSpan.end();
+    auto reply = nam.post(req, body);
+
+    const RequestId id = beginRequest(reply, context);
 
     if (stream) {
-        connect(reply, &QNetworkReply::readyRead, this, [this, reply]() {
+        connect(reply, &QNetworkReply::readyRead, this, [this, reply, context]() {
+            if (context->cancelled) return;
             if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() >= 400) return;
-            
-            bool sseFound = false;
-            QByteArray buffer = reply->readAll();
-            QList<QByteArray> lines = buffer.split('\n');
-
-            for (QByteArray line : lines) {
-                line = line.trimmed();
-                if (line.isEmpty()) continue;
-
-                if (line.startsWith("data: ")) {
-                    sseFound = true;
-                    QByteArray data = line.mid(6).trimmed();
-                    if (data == "[DONE]") {
-                        emit streamFinished();
-                        return;
-                    }
-
-                    QJsonDocument doc = QJsonDocument::fromJson(data);
-                    if (doc.isNull()) {
-                        if (!data.isEmpty()) {
-                            emit partialResponse("\n**System Notification:** " + QString::fromUtf8(data) + "\n");
-                        }
-                        continue;
-                    }
-                    QJsonObject obj = doc.object();
-                    QJsonArray choices = obj["choices"].toArray();
-                    if (!choices.isEmpty()) {
-                        QJsonObject delta = choices[0].toObject()["delta"].toObject();
-                        if (delta.contains("content")) {
-                            emit partialResponse(delta["content"].toString());
-                        }
-                    }
-                }
-            }
 
-            if (!sseFound && !buffer.isEmpty()) {
-                if (buffer.contains("Unexpected endpoint") || buffer.contains("error")) {
-                     emit partialResponse("\n**System Notification:** " + QString::fromUtf8(buffer).trimmed() + "\n");
-                }
+            TraceSpan span("provider.readChunk", "provider");
+            context->markFirstByte();
+            const auto events = context->decoder.feed(reply->readAll());
+            for (const auto &event : events) {
+                handleStreamEvent(*context, event);
             }
+            reportUnrecognizedStreamData(*context);
         });
     }
 
-    connect(reply, &QNetworkReply::finished, this, [this, reply, stream]{
+    connect(reply, &QNetworkReply::finished, this, [this, reply, stream, context]{
+        if (context->cancelled) {
+            endRequest(*context);
+            reply->deleteLater();
+            return;
+        }
+
         if (reply->error() != QNetworkReply::NoError)
         {
             QByteArray errorData = reply->readAll();
@@ -110,31 +121,92 @@ void OllamaProvider::sendChatRequest(const QJsonArray &messages, bool stream, co
             if (!errorData.isEmpty()) {
                 errorMsg += " - " + QString::fromUtf8(errorData);
             }
-            emit errorOccurred(errorMsg);
+            emit errorOccurred(errorMsg, context->id);
+            endRequest(*context, false);
             reply->deleteLater();
             return;
         }
 
+        if (stream) {
+            auto events = context->decoder.feed(reply->readAll());
+            events += context->decoder.finish();
+            for (const auto &event : events) {
+                handleStreamEvent(*context, event);
+            }
+            reportUnrecognizedStreamData(*context);
+        }
+
         if (!stream) {
+            context->markFirstByte();
             const auto data = reply->readAll();
             const auto doc = QJsonDocument::fromJson(data);
             const auto obj = doc.object();
             const auto choices = obj["choices"].toArray();
+            context->setReportedCompletionTokens(obj.contains("eval_count")
+                                                     ? obj["eval_count"].toInt()
+                                                     : obj["usage"].toObject()["completion_tokens"].toInt());
             if (!choices.isEmpty())
             {
                 const auto msgObj = choices[0].toObject()["message"].toObject();
-                emit responseReady(msgObj["content"].toString());
+                emit responseReady(msgObj["content"].toString(), context->id);
+            }
+            else if (obj.contains("message"))
+            {
+                emit responseReady(obj["message"].toObject()["content"].toString(), context->id);
             }
             else
             {
-                emit errorOccurred("Empty LLM response");
+                emit errorOccurred("Empty LLM response", context->id);
             }
         } else {
-            emit streamFinished();
+            emit streamFinished(context->id);
         }
 
+        endRequest(*context);
         reply->deleteLater();
     });
+
+    return id;
+}
+
+void OllamaProvider::handleStreamEvent(RequestContext &context, const StreamDecoder::Event &event)
+{
+    const QByteArray data = event.data.trimmed();
+    if (data.isEmpty() || data == "[DONE]") return;
+
+    QJsonDocument doc = QJsonDocument::fromJson(data);
+    if (doc.isNull()) {
+        emit partialResponse("\n**System Notification:** " + QString::fromUtf8(data) + "\n", context.id);
+        return;
+    }
+
+    QJsonObject obj = doc.object();
+    if (obj.contains("eval_count")) {
+        // Final native chunk
+        context.setReportedCompletionTokens(obj["eval_count"].toInt());
+    } else if (obj.contains("usage")) {
+        context.setReportedCompletionTokens(obj["usage"].toObject()["completion_tokens"].toInt());
+    }
+
+    if (obj.contains("message")) {
+        // Native /api/chat chunk
+        const QString content = obj["message"].toObject()["content"].toString();
+        if (!content.isEmpty()) {
+            context.appendContent(content);
+            emit partialResponse(content, context.id);
+        }
+        return;
+    }
+
+    QJsonArray choices = obj["choices"].toArray();
+    if (!choices.isEmpty()) {
+        QJsonObject delta = choices[0].toObject()["delta"].toObject();
+        if (delta.contains("content")) {
+            const QString content = delta["content"].toString();
+            context.appendContent(content);
+            emit partialResponse(content, context.id);
+        }
+    }
 }
 
 void OllamaProvider::sendPrompt(const QString &prompt)
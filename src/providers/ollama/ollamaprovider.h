@@ -5,6 +5,7 @@
 #include <QNetworkAccessManager>
 
 #include "src/providers/base/llmprovider.h"
+#include "src/providers/base/requestcontext.h"
 
 class OllamaProvider : public LLMProvider
 {
@@ -17,10 +18,16 @@ public:
     void setBaseUrl(const QString &url);
     void setModel(const QString &model);
 
-    void sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) override;
+    RequestId sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) override;
+    RequestId sendConversation(const ConversationHistory &history, bool stream = true, const QJsonArray &tools = QJsonArray()) override;
+    void warmUp() override;
     void sendPrompt(const QString &prompt) override;
 
 private:
+    QUrl endpointUrl() const;
+    RequestId postChatRequest(const QByteArray &messagesJson, bool stream, const QJsonArray &tools);
+    void handleStreamEvent(RequestContext &context, const StreamDecoder::Event &event);
+
     QNetworkAccessManager nam;
     QString baseUrl = "http://localhost:11434";
     QString model = "llama3";
@@ -5,6 +5,10 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include "src/settings/llmsettings.h"
+#include "src/core/conversationhistory.h"
+#include "src/core/tracer.h"
+
+#include <memory>
 
 OpenAIProvider::OpenAIProvider(QObject *parent)
     : LLMProvider(parent)
@@ -17,10 +21,15 @@ void OpenAIProvider::setBaseUrl(const QString &url) { baseUrl = url; }
 void OpenAIProvider::setModel(const QString &m) { model = m; }
 void OpenAIProvider::setApiKey(const QString &key) { apiKey = key; }
 
-void OpenAIProvider::sendChatRequest(const QJsonArray &messages, bool stream, const QJsonArray &tools)
+void OpenAIProvider::warmUp()
+{
+    warmUpConnection(nam, endpointUrl());
+}
+
+QUrl OpenAIProvider::endpointUrl() const
 {
     QString fullUrl = baseUrl;
-    
+
     // Most OpenAI-compatible providers expect /v1/chat/completions
     // If the user provided http://host:port, we should check if they missed /v1
     if (!fullUrl.contains("/v1") && !fullUrl.contains("/chat/completions")) {
@@ -32,8 +41,25 @@ void OpenAIProvider::sendChatRequest(const QJsonArray &messages, bool stream, co
         if (!fullUrl.endsWith("/")) fullUrl += "/";
         fullUrl += "chat/completions";
     }
-    QUrl url(fullUrl);
-    QNetworkRequest req(url);
+    return QUrl(fullUrl);
+}
+
+LLMProvider::RequestId OpenAIProvider::sendChatRequest(const QJsonArray &messages, bool stream, const QJsonArray &tools)
+{
+    return postChatRequest(QJsonDocument(messages).toJson(QJsonDocument::Compact), stream, tools);
+}
+
+LLMProvider::RequestId OpenAIProvider::sendConversation(const ConversationHistory &history, bool stream, const QJsonArray &tools)
+{
+    return postChatRequest(history.toJsonBytes(), stream, tools);
+}
+
+LLMProvider::RequestId OpenAIProvider::postChatRequest(const QByteArray &messagesJson, bool stream, const QJsonArray &tools)
+{
+    auto context = std::make_shared<RequestContext>(StreamDecoder::ServerSentEvents);
+
+    QNetworkRequest req(endpointUrl());
+    prepareRequest(req);
     req.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
     if (!apiKey.isEmpty()) {
         req.setRawHeader("Authorization", "Bearer " + apiKey.toUtf8());
@@ -41,150 +67,135 @@ void OpenAIProvider::sendChatRequest(const QJsonArray &messages, bool stream, co
 
     QJsonObject root;
     root["model"] = model;
-    root["messages"] = messages;
     root["stream"] = stream;
+    if (stream) {
+        // Final chunk reports the real completion token count
+        root["stream_options"] = QJsonObject{{"include_usage", true}};
+    }
     
     if (!tools.isEmpty()) {
         root["tools"] = tools;
     }
 
-    auto reply = nam.post(req, QJsonDocument(root).toJson());
+    TraceSpan serializeSpan("provider.serialize", "provider");
+    const QByteArray body = buildRequestBody(root, messagesJson);
+    context->markRequestBuilt();
+    serializeSpan.setArg("bytes", body.size());
+    serializeSpan.end();
+    auto reply = nam.post(req, body);
+
+    const RequestId id = beginRequest(reply, context);
 
     if (stream) {
-        connect(reply, &QNetworkReply::readyRead, this, [this, reply]() {
+        connect(reply, &QNetworkReply::readyRead, this, [this, reply, context]() {
+            if (context->cancelled) return;
             if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() >= 400) return;
 
-            bool sseFound = false;
-            QByteArray buffer = reply->readAll();
-            QList<QByteArray> lines = buffer.split('\n');
-            
-            for (QByteArray line : lines) {
-                line = line.trimmed();
-                if (line.isEmpty()) continue;
-
-                if (line.startsWith("data: ")) {
-                    sseFound = true;
-                    QByteArray data = line.mid(6).trimmed();
-                    if (data == "[DONE]") continue;
-
-                    QJsonDocument doc = QJsonDocument::fromJson(data);
-                    if (doc.isNull()) {
-                        if (!data.isEmpty()) {
-                            emit partialResponse("\n**System Notification:** " + QString::fromUtf8(data) + "\n");
-                        }
-                        continue;
-                    }
-
-                    QJsonObject obj = doc.object();
-                    QJsonArray choices = obj["choices"].toArray();
-                    if (!choices.isEmpty()) {
-                        QJsonObject delta = choices[0].toObject()["delta"].toObject();
-                        if (delta.contains("content")) {
-                            QString content = delta["content"].toString();
-                            if (!content.isEmpty()) {
-                                emit partialResponse(content);
-                            }
-                        }
-                        
-                        // Some providers use 'reasoning_content' field (e.g. DeepSeek)
-                        if (delta.contains("reasoning_content")) {
-                            QString reasoning = delta["reasoning_content"].toString();
-                            if (!reasoning.isEmpty()) {
-                                emit partialResponse("<thought>\n" + reasoning + "\n</thought>\n");
-                            }
-                        }
-
-                        if (delta.contains("tool_calls")) {
-                            QJsonArray toolCalls = delta["tool_calls"].toArray();
-                            for (const auto &tcVal : toolCalls) {
-                                QJsonObject tc = tcVal.toObject();
-                                int index = 0;
-                                if (tc.contains("index")) {
-                                    index = tc["index"].toInt();
-                                }
-                                
-                                if (!m_ongoingToolCalls.contains(index)) {
-                                    m_ongoingToolCalls[index] = tc;
-                                } else {
-                                    QJsonObject existing = m_ongoingToolCalls[index];
-                                    if (tc.contains("function")) {
-                                        QJsonObject existingFunc = existing["function"].toObject();
-                                        QJsonObject newFunc = tc["function"].toObject();
-                                        
-                                        if (newFunc.contains("arguments")) {
-                                            QString args = existingFunc["arguments"].toString();
-                                            args += newFunc["arguments"].toString();
-                                            existingFunc["arguments"] = args;
-                                        }
-                                        if (newFunc.contains("name")) {
-                                            QString name = existingFunc["name"].toString();
-                                            name += newFunc["name"].toString();
-                                            existingFunc["name"] = name;
-                                        }
-                                        existing["function"] = existingFunc;
-                                    }
-                                    if (tc.contains("id")) {
-                                        existing["id"] = tc["id"];
-                                    }
-                                    if (tc.contains("type")) {
-                                        existing["type"] = tc["type"];
-                                    }
-                                    m_ongoingToolCalls[index] = existing;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-
-            if (!sseFound && !buffer.isEmpty()) {
-                // If we got data but none of it looked like SSE, it might be a raw error message
-                // even if status code was 200.
-                if (buffer.contains("Unexpected endpoint") || buffer.contains("error")) {
-                     emit partialResponse("\n**System Notification:** " + QString::fromUtf8(buffer).trimmed() + "\n");
-                }
+            TraceSpan span("provider.readChunk", "provider");
+            context->markFirstByte();
+            const auto events = context->decoder.feed(reply->readAll());
+            for (const auto &event : events) {
+                handleStreamEvent(*context, event);
             }
+            reportUnrecognizedStreamData(*context);
         });
     }
 
-    connect(reply, &QNetworkReply::finished, this, [this, reply, stream]{
+    connect(reply, &QNetworkReply::finished, this, [this, reply, stream, context]{
+        if (context->cancelled) {
+            endRequest(*context);
+            reply->deleteLater();
+            return;
+        }
+
         if (reply->error() != QNetworkReply::NoError) {
             QByteArray errorData = reply->readAll();
             QString errorMsg = reply->errorString();
             if (!errorData.isEmpty()) {
                 errorMsg += " - " + QString::fromUtf8(errorData);
             }
-            emit errorOccurred(errorMsg);
-            m_ongoingToolCalls.clear();
+            emit errorOccurred(errorMsg, context->id);
+            endRequest(*context, false);
             reply->deleteLater();
             return;
         }
 
-        if (!m_ongoingToolCalls.isEmpty()) {
-            QJsonArray finalToolCalls;
-            QList<int> keys = m_ongoingToolCalls.keys();
-            std::sort(keys.begin(), keys.end());
-            for (int key : keys) {
-                finalToolCalls.append(m_ongoingToolCalls[key]);
+        if (stream) {
+            auto events = context->decoder.feed(reply->readAll());
+            events += context->decoder.finish();
+            for (const auto &event : events) {
+                handleStreamEvent(*context, event);
             }
-            emit toolCallsReceived(finalToolCalls);
-            m_ongoingToolCalls.clear();
+            reportUnrecognizedStreamData(*context);
+        }
+
+        if (context->hasToolCalls()) {
+            emit toolCallsReceived(context->takeToolCalls(), context->id);
         }
 
         if (!stream) {
+            context->markFirstByte();
             const auto data = reply->readAll();
             const auto doc = QJsonDocument::fromJson(data);
             const auto obj = doc.object();
             const auto choices = obj["choices"].toArray();
+            context->setReportedCompletionTokens(obj["usage"].toObject()["completion_tokens"].toInt());
             if (!choices.isEmpty()) {
                 const auto msgObj = choices[0].toObject()["message"].toObject();
-                emit responseReady(msgObj["content"].toString());
+                emit responseReady(msgObj["content"].toString(), context->id);
             } else {
-                emit errorOccurred("Empty OpenAI response");
+                emit errorOccurred("Empty OpenAI response", context->id);
             }
         } else {
-            emit streamFinished();
+            emit streamFinished(context->id);
         }
+        endRequest(*context);
         reply->deleteLater();
     });
+
+    return id;
+}
+
+void OpenAIProvider::handleStreamEvent(RequestContext &context, const StreamDecoder::Event &event)
+{
+    const QByteArray data = event.data.trimmed();
+    if (data.isEmpty() || data == "[DONE]") return;
+
+    QJsonDocument doc = QJsonDocument::fromJson(data);
+    if (doc.isNull()) {
+        emit partialResponse("\n**System Notification:** " + QString::fromUtf8(data) + "\n", context.id);
+        return;
+    }
+
+    QJsonObject obj = doc.object();
+    if (obj.contains("usage")) {
+        context.setReportedCompletionTokens(obj["usage"].toObject()["completion_tokens"].toInt());
+    }
+
+    QJsonArray choices = obj["choices"].toArray();
+    if (choices.isEmpty()) return;
+
+    QJsonObject delta = choices[0].toObject()["delta"].toObject();
+    if (delta.contains("content")) {
+        QString content = delta["content"].toString();
+        if (!content.isEmpty()) {
+            context.appendContent(content);
+            emit partialResponse(content, context.id);
+        }
+    }
+
+    // Some providers use 'reasoning_content' field (e.g. DeepSeek)
+    if (delta.contains("reasoning_content")) {
+        QString reasoning = delta["reasoning_content"].toString();
+        if (!reasoning.isEmpty()) {
+            emit partialResponse("<thought>\n" + reasoning + "\n</thought>\n", context.id);
+        }
+    }
+
+    if (delta.contains("tool_calls")) {
+        const QJsonArray toolCalls = delta["tool_calls"].toArray();
+        for (const auto &tcVal : toolCalls) {
+            context.mergeToolCallDelta(tcVal.toObject());
+        }
+    }
 }
@@ -2,8 +2,8 @@
 #define OPENAIPROVIDER_H
 
 #include <QNetworkAccessManager>
-#include <QMap>
 #include "src/providers/base/llmprovider.h"
+#include "src/providers/base/requestcontext.h"
 
 class OpenAIProvider : public LLMProvider
 {
@@ -17,14 +17,19 @@ public:
     void setModel(const QString &model);
     void setApiKey(const QString &key);
 
-    void sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) override;
+    RequestId sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) override;
+    RequestId sendConversation(const ConversationHistory &history, bool stream = true, const QJsonArray &tools = QJsonArray()) override;
+    void warmUp() override;
 
 private:
+    QUrl endpointUrl() const;
+    RequestId postChatRequest(const QByteArray &messagesJson, bool stream, const QJsonArray &tools);
+    void handleStreamEvent(RequestContext &context, const StreamDecoder::Event &event);
+
     QNetworkAccessManager nam;
     QString baseUrl = "https://api.openai.com/v1";
     QString model = "gpt-4o";
     QString apiKey;
-    QMap<int, QJsonObject> m_ongoingToolCalls;
 };
 
 #endif // OPENAIPROVIDER_H
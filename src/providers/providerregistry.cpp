@@ -0,0 +1,98 @@
+#include "providerregistry.h"
+
+#include "src/providers/claude/claudeprovider.h"
+#include "src/providers/ollama/ollamaprovider.h"
+#include "src/providers/openai/openaiprovider.h"
+#include "src/settings/llmsettings.h"
+
+ProviderRegistry::ProviderRegistry(QObject *parent)
+    : QObject(parent)
+{
+    connect(&LLMSettings::instance(), &LLMSettings::changed, this, &ProviderRegistry::onSettingsChanged);
+}
+
+ProviderRegistry::Profile ProviderRegistry::profileFromSettings()
+{
+    auto &s = LLMSettings::instance();
+    return {s.providerType(), s.baseUrl(), s.model(), s.apiKey()};
+}
+
+LLMProvider *ProviderRegistry::currentProvider()
+{
+    LLMProvider *p = provider(profileFromSettings());
+    if (p != m_current) {
+        m_current = p;
+        emit currentProviderChanged(p);
+    }
+    return p;
+}
+
+LLMProvider *ProviderRegistry::provider(const Profile &profile)
+{
+    Entry &entry = m_entries[profile.type];
+    if (!entry.provider) {
+        entry.provider = createProvider(profile.type, this);
+        applyProfile(entry.provider, profile);
+        entry.applied = profile;
+    } else if (entry.applied != profile) {
+        applyProfile(entry.provider, profile);
+        entry.applied = profile;
+    }
+    return entry.provider;
+}
+
+QList<LLMProvider *> ProviderRegistry::providers() const
+{
+    QList<LLMProvider *> result;
+    for (const auto &entry : m_entries) {
+        if (entry.provider)
+            result.append(entry.provider);
+    }
+    return result;
+}
+
+LLMProvider::ConnectionStats ProviderRegistry::connectionStats() const
+{
+    LLMProvider::ConnectionStats total;
+    for (const auto &entry : m_entries) {
+        if (!entry.provider)
+            continue;
+        const auto stats = entry.provider->connectionStats();
+        total.requests += stats.requests;
+        total.newConnections += stats.newConnections;
+        total.tlsHandshakes += stats.tlsHandshakes;
+    }
+    return total;
+}
+
+void ProviderRegistry::onSettingsChanged()
+{
+    // Only touches the instance whose settings differ; unchanged providers keep
+    // their connections.
+    currentProvider();
+}
+
+LLMProvider *ProviderRegistry::createProvider(const QString &type, QObject *parent)
+{
+    if (type == "OpenAI")
+        return new OpenAIProvider(parent);
+    if (type == "Claude")
+        return new ClaudeProvider(parent);
+    return new OllamaProvider(parent);
+}
+
+void ProviderRegistry::applyProfile(LLMProvider *provider, const Profile &profile)
+{
+    if (auto p = qobject_cast<OpenAIProvider *>(provider)) {
+        p->setBaseUrl(profile.baseUrl);
+        p->setModel(profile.model);
+        p->setApiKey(profile.apiKey);
+    } else if (auto p = qobject_cast<ClaudeProvider *>(provider)) {
+        p->setBaseUrl(profile.baseUrl);
+        p->setModel(profile.model);
+        p->setApiKey(profile.apiKey);
+    } else if (auto p = qobject_cast<OllamaProvider *>(provider)) {
+        p->setBaseUrl(profile.baseUrl);
+        p->setModel(profile.model);
+    }
+}
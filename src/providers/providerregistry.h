@@ -0,0 +1,61 @@
+#ifndef PROVIDERREGISTRY_H
+#define PROVIDERREGISTRY_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+
+#include "src/providers/base/llmprovider.h"
+
+// Owns one long-lived provider per configured profile, so that each provider's
+// QNetworkAccessManager (and with it keep-alive connections and TLS sessions)
+// survives across chat turns. Providers are reconfigured in place when
+// LLMSettings actually change.
+class ProviderRegistry : public QObject
+{
+    Q_OBJECT
+public:
+    struct Profile {
+        QString type;
+        QString baseUrl;
+        QString model;
+        QString apiKey;
+
+        bool operator==(const Profile &other) const {
+            return type == other.type && baseUrl == other.baseUrl
+                && model == other.model && apiKey == other.apiKey;
+        }
+        bool operator!=(const Profile &other) const { return !(*this == other); }
+    };
+
+    explicit ProviderRegistry(QObject *parent = nullptr);
+
+    static Profile profileFromSettings();
+
+    // Provider for the profile currently selected in LLMSettings.
+    LLMProvider *currentProvider();
+    LLMProvider *provider(const Profile &profile);
+
+    QList<LLMProvider *> providers() const;
+    // Summed over all providers the registry owns.
+    LLMProvider::ConnectionStats connectionStats() const;
+
+signals:
+    void currentProviderChanged(LLMProvider *provider);
+
+private:
+    struct Entry {
+        LLMProvider *provider = nullptr;
+        Profile applied;
+    };
+
+    void onSettingsChanged();
+    static LLMProvider *createProvider(const QString &type, QObject *parent);
+    static void applyProfile(LLMProvider *provider, const Profile &profile);
+
+    // Keyed by provider type, the only profile dimension that needs a new instance.
+    QHash<QString, Entry> m_entries;
+    LLMProvider *m_current = nullptr;
+};
+
+#endif // PROVIDERREGISTRY_H
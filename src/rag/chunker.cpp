@@ -0,0 +1,84 @@
+#include "chunker.h"
+
+#include <QSet>
+
+namespace {
+
+bool isBoundary(QStringView line)
+{
+    const QStringView trimmed = line.trimmed();
+    return trimmed.isEmpty() || line.startsWith(u'}');
+}
+
+} // namespace
+
+QList<Chunker::Chunk> Chunker::chunk(QStringView content, const Options &options)
+{
+    QList<QStringView> lines;
+    for (qsizetype start = 0; start <= content.size();) {
+        qsizetype end = content.indexOf(u'\n', start);
+        if (end < 0)
+            end = content.size();
+        QStringView line = content.sliced(start, end - start);
+        if (line.endsWith(u'\r'))
+            line.chop(1);
+        lines.append(line);
+        start = end + 1;
+    }
+    while (!lines.isEmpty() && lines.last().trimmed().isEmpty())
+        lines.removeLast();
+
+    const int maxLines = qMax(options.maxLines, 1);
+    const int overlap = qBound(0, options.overlapLines, maxLines / 2);
+    QList<Chunk> chunks;
+    int first = 0;
+    while (first < lines.size()) {
+        // As many lines as fit, at least one.
+        int last = first;
+        qsizetype chars = lines[first].size();
+        while (last + 1 < lines.size() && last + 1 - first < maxLines
+               && chars + lines[last + 1].size() + 1 <= options.maxChars) {
+            ++last;
+            chars += lines[last].size() + 1;
+        }
+        // Back off to a boundary in the last third of the window, unless this is the end.
+        if (last + 1 < lines.size()) {
+            const int minimum = first + (last - first) * 2 / 3;
+            for (int i = last; i > minimum; --i) {
+                if (isBoundary(lines[i])) {
+                    last = i;
+                    break;
+                }
+            }
+        }
+
+        QString text;
+        for (int i = first; i <= last; ++i) {
+            if (i > first)
+                text += u'\n';
+            text += lines[i];
+        }
+        text.truncate(options.maxChars);
+        if (!text.trimmed().isEmpty())
+            chunks.append(Chunk{first + 1, last + 1, text});
+
+        if (last + 1 >= lines.size())
+            break;
+        first = qMax(first + 1, last + 1 - overlap);
+    }
+    return chunks;
+}
+
+bool Chunker::isIndexable(const QString &fileName)
+{
+    static const QSet<QString> suffixes = {
+        "h", "hh", "hpp", "hxx", "c", "cc", "cpp", "cxx", "ipp", "inl", "tpp", "m", "mm",
+        "qml", "js", "ts", "py", "java", "kt", "rs", "go", "cs", "swift", "rb", "php", "lua", "sh",
+        "cmake", "pro", "pri", "qbs", "ui", "qrc", "json", "yaml", "yml", "toml", "xml",
+        "md", "txt", "rst"
+    };
+    if (fileName == "CMakeLists.txt" || fileName == "Makefile")
+        return true;
+    const qsizetype dot = fileName.lastIndexOf(u'.');
+    return dot >= 0 && suffixes.contains(fileName.mid(dot + 1).toLower());
+}
@@ -0,0 +1,31 @@
+#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+// Splits text files into overlapping windows of lines for embedding. Windows
+// prefer to end at a blank line or a closing brace in column 0, so chunks
+// tend to hold whole functions.
+class Chunker
+{
+public:
+    struct Options {
+        int maxLines = 60;
+        int overlapLines = 8;
+        int maxChars = 2000;
+    };
+
+    struct Chunk {
+        int startLine = 0;   // 1-based.
+        int endLine = 0;     // 1-based, inclusive.
+        QString text;
+    };
+
+    static QList<Chunk> chunk(QStringView content, const Options &options);
+    // Source, build and documentation files, by name.
+    static bool isIndexable(const QString &fileName);
+};
+
+#endif // CHUNKER_H
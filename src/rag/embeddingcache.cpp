@@ -0,0 +1,218 @@
+#include "embeddingcache.h"
+#include "src/core/contenthash.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFloat16>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVarLengthArray>
+
+#include <cstring>
+
+namespace {
+
+constexpr char Magic[8] = {'Q', 'L', 'P', 'E', 'M', 'B', '0', '1'};
+// Vectors are stored in host byte order, files from other hosts start over.
+constexpr quint32 ByteOrderMark = 0x01020304;
+constexpr qint64 HeaderSize = 16;
+// About a million 768-dimensional vectors. A full cache starts over.
+constexpr qint64 MaxFileSize = qint64(1536) * 1024 * 1024;
+constexpr qint64 CopyBlockSize = 1024 * 1024;
+
+struct Header {
+    char magic[8];
+    quint32 dimensions;
+    quint32 byteOrder;
+};
+static_assert(sizeof(Header) == HeaderSize);
+
+} // namespace
+
+EmbeddingCache::EmbeddingCache(const QString &directory, const QString &model)
+{
+    static const QRegularExpression unsafe("[^A-Za-z0-9._-]");
+    QString name = model;
+    name.replace(unsafe, "_");
+    QDir().mkpath(directory);
+    m_file.setFileName(directory + '/' + name + ".emb");
+    open();
+}
+
+EmbeddingCache::~EmbeddingCache() = default;
+
+QString EmbeddingCache::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/embeddings";
+}
+
+quint64 EmbeddingCache::key(const QString &text)
+{
+    return ContentHash::xxh64(text);
+}
+
+qint64 EmbeddingCache::recordSize() const
+{
+    return sizeof(quint64) + qint64(m_dimensions) * sizeof(qfloat16);
+}
+
+void EmbeddingCache::open()
+{
+    // Appends stay whole records when several instances share the file.
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+        qWarning() << "Embedding cache not available:" << m_file.errorString();
+        return;
+    }
+
+    Header header;
+    const qint64 size = m_file.size();
+    if (size < HeaderSize || size > MaxFileSize || !m_file.seek(0)
+        || m_file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header)
+        || std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.byteOrder != ByteOrderMark) {
+        reset(0);
+        return;
+    }
+    m_dimensions = int(header.dimensions);
+    if (m_dimensions == 0)
+        return;
+
+    // A record cut short by a crash is dropped.
+    const qint64 records = (size - HeaderSize) / recordSize();
+    const qint64 end = HeaderSize + records * recordSize();
+    if (end != size) {
+        replace(m_dimensions, end - HeaderSize);
+        if (!m_file.isOpen())
+            return;
+    }
+    if (records == 0)
+        return;
+
+    m_data = m_file.map(0, end);
+    if (!m_data) {
+        reset(m_dimensions);
+        return;
+    }
+    m_mappedSize = end;
+    m_offsets.reserve(records);
+    for (qint64 offset = HeaderSize; offset < end; offset += recordSize()) {
+        quint64 key;
+        std::memcpy(&key, m_data + offset, sizeof(key));
+        m_offsets.insert(key, offset + qint64(sizeof(key)));
+    }
+}
+
+void EmbeddingCache::reset(int dimensions)
+{
+    replace(dimensions, 0);
+}
+
+void EmbeddingCache::replace(int dimensions, qint64 keepBytes)
+{
+    // Other instances may have the file mapped: truncating it would make their
+    // next read of a mapped page fail with SIGBUS. A new file is renamed into
+    // place instead, they keep the old one until they open the cache again.
+    if (m_data)
+        m_file.unmap(const_cast<uchar *>(m_data));
+    m_data = nullptr;
+    m_mappedSize = 0;
+    m_offsets.clear();
+    m_dimensions = dimensions;
+    if (!m_file.isOpen())
+        return;
+
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.dimensions = quint32(dimensions);
+    header.byteOrder = ByteOrderMark;
+    QSaveFile file(m_file.fileName());
+    bool written = file.open(QIODevice::WriteOnly)
+                   && file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header)
+                   && m_file.seek(HeaderSize);
+    for (qint64 copied = 0; written && copied < keepBytes;) {
+        const QByteArray block = m_file.read(qMin(CopyBlockSize, keepBytes - copied));
+        written = !block.isEmpty() && file.write(block) == block.size();
+        copied += block.size();
+    }
+    m_file.close();
+    if (!written || !file.commit()) {
+        qWarning() << "Embedding cache not available:" << file.errorString();
+        m_dimensions = 0;
+        return;
+    }
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append))
+        qWarning() << "Embedding cache not available:" << m_file.errorString();
+}
+
+qsizetype EmbeddingCache::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_offsets.size();
+}
+
+EmbeddingCache::Stats EmbeddingCache::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+bool EmbeddingCache::find(quint64 key, QList<float> *vector)
+{
+    QMutexLocker locker(&m_mutex);
+    const auto offset = m_offsets.constFind(key);
+    if (offset == m_offsets.cend()) {
+        ++m_stats.misses;
+        return false;
+    }
+
+    QVarLengthArray<char, 2048> record;
+    const qfloat16 *data;
+    // The mapping is only read while the file is still as long: should it have
+    // been truncated after all, reading a page past its end would crash.
+    if (*offset < m_mappedSize && m_file.size() >= m_mappedSize) {
+        data = reinterpret_cast<const qfloat16 *>(m_data + *offset);
+    } else {
+        // Added since the mapping. Another instance may have appended in
+        // between, so the key in front of the vector is checked.
+        record.resize(recordSize());
+        quint64 recordKey = 0;
+        const bool read = m_file.seek(*offset - qint64(sizeof(key)))
+                          && m_file.read(record.data(), record.size()) == record.size();
+        if (read)
+            std::memcpy(&recordKey, record.constData(), sizeof(recordKey));
+        if (!read || recordKey != key) {
+            ++m_stats.misses;
+            return false;
+        }
+        data = reinterpret_cast<const qfloat16 *>(record.constData() + sizeof(key));
+    }
+    vector->resize(m_dimensions);
+    qFloatFromFloat16(vector->data(), data, m_dimensions);
+    ++m_stats.hits;
+    return true;
+}
+
+void EmbeddingCache::insert(quint64 key, const QList<float> &vector)
+{
+    QMutexLocker locker(&m_mutex);
+    if (vector.isEmpty())
+        return;
+    if (m_dimensions != vector.size()) {
+        if (m_dimensions != 0)
+            qWarning() << "Embedding dimensions changed, starting the cache over:" << m_file.fileName();
+        reset(int(vector.size()));
+    } else if (m_offsets.contains(key)) {
+        return;
+    }
+    if (!m_file.isOpen())
+        return;
+    if (m_file.size() + recordSize() > MaxFileSize)
+        reset(m_dimensions);
+
+    QByteArray record(recordSize(), Qt::Uninitialized);
+    std::memcpy(record.data(), &key, sizeof(key));
+    qFloatToFloat16(reinterpret_cast<qfloat16 *>(record.data() + sizeof(key)), vector.constData(), m_dimensions);
+    const qint64 offset = m_file.size();
+    if (m_file.write(record) == record.size() && m_file.flush())
+        m_offsets.insert(key, offset + qint64(sizeof(key)));
+}
@@ -0,0 +1,63 @@
+#ifndef EMBEDDINGCACHE_H
+#define EMBEDDINGCACHE_H
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+// Embeddings by content hash (XXH64) of the embedded text, shared by all
+// projects: chunks that did not change are not sent to the model again after a
+// branch switch, in another checkout or after a restart.
+//
+// One append-only file per model, vectors stored as half-precision floats.
+// Entries from earlier runs are read from a memory mapping of the file, the
+// ones added since from the file itself. Starting over replaces the file
+// rather than truncating it, other instances may have it mapped. Thread-safe.
+class EmbeddingCache
+{
+public:
+    struct Stats {
+        qint64 hits = 0;
+        qint64 misses = 0;
+        double hitRate() const { return hits + misses > 0 ? double(hits) / (hits + misses) : 0.0; }
+    };
+
+    EmbeddingCache(const QString &directory, const QString &model);
+    ~EmbeddingCache();
+
+    EmbeddingCache(const EmbeddingCache &) = delete;
+    EmbeddingCache &operator=(const EmbeddingCache &) = delete;
+
+    // <cache location>/embeddings
+    static QString defaultDirectory();
+    static quint64 key(const QString &text);
+
+    QString filePath() const { return m_file.fileName(); }
+    qsizetype size() const;
+    Stats stats() const;
+
+    // Counts a hit or a miss.
+    bool find(quint64 key, QList<float> *vector);
+    // A vector of different dimensions than the cached ones starts the cache over.
+    void insert(quint64 key, const QList<float> &vector);
+
+private:
+    void open();
+    void reset(int dimensions);
+    // Writes a new file with the first keepBytes of records of the current one
+    // and renames it into place, the file is never truncated.
+    void replace(int dimensions, qint64 keepBytes);
+    qint64 recordSize() const;
+
+    mutable QMutex m_mutex;
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_mappedSize = 0;
+    int m_dimensions = 0;
+    QHash<quint64, qint64> m_offsets;   // Of the vectors in the file.
+    Stats m_stats;
+};
+
+#endif // EMBEDDINGCACHE_H
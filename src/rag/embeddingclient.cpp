@@ -0,0 +1,81 @@
+#include "embeddingclient.h"
+#include "src/core/tracer.h"
+
+#include <QEventLoop>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+
+EmbeddingClient::EmbeddingClient(const QUrl &baseUrl, const QString &model)
+    : m_model(model)
+{
+    m_url = baseUrl.adjusted(QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment);
+    m_url.setPath("/api/embed");
+}
+
+bool EmbeddingClient::embed(const QStringList &texts, QList<QList<float>> *vectors, QString *errorString)
+{
+    vectors->clear();
+    vectors->reserve(texts.size());
+    for (qsizetype start = 0; start < texts.size(); start += m_batchSize) {
+        if (!embedBatch(texts.mid(start, m_batchSize), vectors, errorString))
+            return false;
+    }
+    return true;
+}
+
+bool EmbeddingClient::embedBatch(const QStringList &texts, QList<QList<float>> *vectors, QString *errorString)
+{
+    TraceSpan span("embedding.request", "rag");
+    span.setArg("texts", texts.size());
+
+    QNetworkRequest request(m_url);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    request.setTransferTimeout(m_timeoutMs);
+
+    QJsonObject root;
+    root["model"] = m_model;
+    root["input"] = QJsonArray::fromStringList(texts);
+    // Long chunks are cut to the model's context instead of failing the batch.
+    root["truncate"] = true;
+
+    QNetworkReply *reply = m_nam.post(request, QJsonDocument(root).toJson(QJsonDocument::Compact));
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    if (!reply->isFinished())
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+
+    const QByteArray data = reply->readAll();
+    const bool failed = reply->error() != QNetworkReply::NoError;
+    const QString networkError = reply->errorString();
+    reply->deleteLater();
+
+    const QJsonObject response = QJsonDocument::fromJson(data).object();
+    if (failed) {
+        const QString message = response.value("error").toString();
+        *errorString = message.isEmpty() ? networkError : message;
+        return false;
+    }
+
+    const QJsonArray embeddings = response.value("embeddings").toArray();
+    if (embeddings.size() != texts.size()) {
+        *errorString = QString("Expected %1 embeddings from %2, got %3")
+                           .arg(texts.size()).arg(m_url.toString()).arg(embeddings.size());
+        return false;
+    }
+    for (const QJsonValue &embedding : embeddings) {
+        const QJsonArray values = embedding.toArray();
+        if (values.isEmpty() || (!vectors->isEmpty() && values.size() != vectors->first().size())) {
+            *errorString = "Embeddings of inconsistent dimensions";
+            return false;
+        }
+        QList<float> vector;
+        vector.reserve(values.size());
+        for (const QJsonValue &value : values)
+            vector.append(float(value.toDouble()));
+        vectors->append(std::move(vector));
+    }
+    return true;
+}
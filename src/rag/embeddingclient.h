@@ -0,0 +1,34 @@
+#ifndef EMBEDDINGCLIENT_H
+#define EMBEDDINGCLIENT_H
+
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+
+// Blocking client for Ollama's /api/embed endpoint, meant for worker threads.
+// Create and use it in the same thread: it runs a local event loop per request.
+class EmbeddingClient
+{
+public:
+    EmbeddingClient(const QUrl &baseUrl, const QString &model);
+
+    QString model() const { return m_model; }
+    void setBatchSize(int size) { m_batchSize = qMax(size, 1); }
+    void setTimeoutMs(int ms) { m_timeoutMs = ms; }
+
+    // One vector per text, in order. Sends batchSize texts per request.
+    bool embed(const QStringList &texts, QList<QList<float>> *vectors, QString *errorString);
+
+private:
+    bool embedBatch(const QStringList &texts, QList<QList<float>> *vectors, QString *errorString);
+
+    QNetworkAccessManager m_nam;
+    QUrl m_url;
+    QString m_model;
+    int m_batchSize = 32;
+    int m_timeoutMs = 120 * 1000;
+};
+
+#endif // EMBEDDINGCLIENT_H
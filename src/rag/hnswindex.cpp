@@ -0,0 +1,463 @@
+#include "hnswindex.h"
+#include "vectorkernels.h"
+
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+
+namespace {
+
+constexpr char Magic[8] = {'Q', 'L', 'P', 'H', 'N', 'S', 'W', '1'};
+constexpr quint32 FormatVersion = 2;
+// Vectors and links are stored in host byte order, files from other hosts are rejected.
+constexpr quint32 ByteOrderMark = 0x01020304;
+constexpr qint64 HeaderSize = 64;
+constexpr int MaxLevel = 15;
+constexpr quint32 NoEntryPoint = 0xffffffff;
+
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    quint32 dimensions;
+    quint32 m;
+    quint32 efConstruction;
+    quint32 efSearch;
+    quint32 count;
+    quint32 removedCount;
+    quint32 entryPoint;
+    qint32 maxLevel;
+    quint32 upperSize;
+    quint32 quantized;
+};
+static_assert(sizeof(Header) <= HeaderSize);
+
+qint64 align(qint64 offset)
+{
+    return (offset + 7) & ~qint64(7);
+}
+
+// Section offsets, each section 8-byte aligned. The codes and scales are empty
+// without quantization.
+struct Layout {
+    qint64 vectors, codes, scales, labels, levels, removed, level0, upperOffsets, upper, end;
+
+    Layout(quint32 dimensions, quint32 m, quint32 count, quint32 upperSize, bool quantized)
+    {
+        const quint32 coded = quantized ? count : 0;
+        vectors = HeaderSize;
+        codes = align(vectors + qint64(count) * dimensions * sizeof(float));
+        scales = align(codes + qint64(coded) * dimensions);
+        labels = align(scales + qint64(coded) * sizeof(float));
+        levels = align(labels + qint64(count) * sizeof(quint64));
+        removed = align(levels + count);
+        level0 = align(removed + count);
+        upperOffsets = align(level0 + qint64(count) * (1 + 2 * m) * sizeof(quint32));
+        upper = align(upperOffsets + qint64(count) * sizeof(quint32));
+        end = upper + qint64(upperSize) * sizeof(quint32);
+    }
+};
+
+void normalize(const float *vector, int dimensions, float *out)
+{
+    double norm = 0;
+    for (int i = 0; i < dimensions; ++i)
+        norm += double(vector[i]) * vector[i];
+    const float scale = norm > 0 ? float(1.0 / std::sqrt(norm)) : 0.0f;
+    for (int i = 0; i < dimensions; ++i)
+        out[i] = vector[i] * scale;
+}
+
+} // namespace
+
+HnswIndex::HnswIndex(int dimensions, const Options &options)
+    : m_dimensions(dimensions)
+    , m_options(options)
+    , m_levelFactor(1.0 / std::log(double(qMax(options.m, 2))))
+{
+}
+
+HnswIndex::~HnswIndex() = default;
+
+float HnswIndex::distance(const float *query, quint32 node) const
+{
+    if (m_options.quantize)
+        return 1.0f - m_scaleData[node] * VectorKernels::dotInt8(query, codes(node), m_dimensions);
+    return 1.0f - VectorKernels::dot(query, vector(node), m_dimensions);
+}
+
+const quint32 *HnswIndex::links(quint32 node, int level) const
+{
+    if (level == 0)
+        return m_level0Data + size_t(node) * (1 + 2 * m_options.m);
+    return m_upperData + m_upperOffsetData[node] + size_t(level - 1) * (1 + m_options.m);
+}
+
+quint32 *HnswIndex::mutableLinks(quint32 node, int level)
+{
+    if (level == 0)
+        return m_level0.data() + size_t(node) * (1 + 2 * m_options.m);
+    return m_upper.data() + m_upperOffsets[node] + size_t(level - 1) * (1 + m_options.m);
+}
+
+int HnswIndex::randomLevel()
+{
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const double value = std::max(uniform(m_random), 1e-12);
+    return std::min(int(-std::log(value) * m_levelFactor), MaxLevel);
+}
+
+void HnswIndex::updatePointers()
+{
+    m_vectorData = m_vectors.data();
+    m_codeData = m_codes.data();
+    m_scaleData = m_scales.data();
+    m_labelData = m_labels.data();
+    m_levelData = m_levels.data();
+    m_removedData = m_removed.data();
+    m_level0Data = m_level0.data();
+    m_upperOffsetData = m_upperOffsets.data();
+    m_upperData = m_upper.data();
+    m_upperSize = quint32(m_upper.size());
+}
+
+void HnswIndex::detach()
+{
+    if (!m_file.isOpen())
+        return;
+    m_vectors.assign(m_vectorData, m_vectorData + size_t(m_count) * m_dimensions);
+    if (m_options.quantize) {
+        m_codes.assign(m_codeData, m_codeData + size_t(m_count) * m_dimensions);
+        m_scales.assign(m_scaleData, m_scaleData + m_count);
+    }
+    m_labels.assign(m_labelData, m_labelData + m_count);
+    m_levels.assign(m_levelData, m_levelData + m_count);
+    m_removed.assign(m_removedData, m_removedData + m_count);
+    m_level0.assign(m_level0Data, m_level0Data + size_t(m_count) * (1 + 2 * m_options.m));
+    m_upperOffsets.assign(m_upperOffsetData, m_upperOffsetData + m_count);
+    m_upper.assign(m_upperData, m_upperData + m_upperSize);
+    m_file.close();   // Unmaps.
+    updatePointers();
+}
+
+quint32 HnswIndex::greedyClosest(const float *query, quint32 entry, int level) const
+{
+    quint32 current = entry;
+    float best = distance(query, current);
+    for (bool changed = true; changed;) {
+        changed = false;
+        const quint32 *list = links(current, level);
+        for (quint32 i = 0; i < list[0]; ++i) {
+            const float d = distance(query, list[1 + i]);
+            if (d < best) {
+                best = d;
+                current = list[1 + i];
+                changed = true;
+            }
+        }
+    }
+    return current;
+}
+
+std::vector<HnswIndex::Candidate> HnswIndex::searchLayer(const float *query, quint32 entry, int ef, int level) const
+{
+    std::vector<bool> visited(m_count);
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> candidates;   // Closest on top.
+    std::priority_queue<Candidate> results;                                             // Farthest on top.
+
+    const Candidate start{distance(query, entry), entry};
+    candidates.push(start);
+    results.push(start);
+    visited[entry] = true;
+
+    while (!candidates.empty()) {
+        const Candidate current = candidates.top();
+        if (current.distance > results.top().distance && results.size() >= size_t(ef))
+            break;
+        candidates.pop();
+
+        const quint32 *list = links(current.node, level);
+        for (quint32 i = 0; i < list[0]; ++i) {
+            const quint32 neighbor = list[1 + i];
+            if (visited[neighbor])
+                continue;
+            visited[neighbor] = true;
+            const float d = distance(query, neighbor);
+            if (results.size() < size_t(ef) || d < results.top().distance) {
+                candidates.push({d, neighbor});
+                results.push({d, neighbor});
+                if (results.size() > size_t(ef))
+                    results.pop();
+            }
+        }
+    }
+
+    std::vector<Candidate> found(results.size());
+    for (size_t i = found.size(); i > 0; --i) {
+        found[i - 1] = results.top();
+        results.pop();
+    }
+    return found;
+}
+
+// The heuristic of the HNSW paper: a candidate is kept only if it is closer to
+// the base than to every neighbor kept so far, which spreads links out.
+std::vector<quint32> HnswIndex::selectNeighbors(std::vector<Candidate> candidates, int count) const
+{
+    std::sort(candidates.begin(), candidates.end());
+    std::vector<quint32> selected;
+    selected.reserve(count);
+    for (const Candidate &candidate : candidates) {
+        if (int(selected.size()) >= count)
+            break;
+        bool keep = true;
+        for (const quint32 other : selected) {
+            if (distance(vector(candidate.node), other) < candidate.distance) {
+                keep = false;
+                break;
+            }
+        }
+        if (keep)
+            selected.push_back(candidate.node);
+    }
+    return selected;
+}
+
+void HnswIndex::link(quint32 node, quint32 neighbor, int level)
+{
+    quint32 *list = mutableLinks(node, level);
+    const quint32 count = list[0];
+    if (std::find(list + 1, list + 1 + count, neighbor) != list + 1 + count)
+        return;
+    const int capacity = maxLinks(level);
+    if (int(count) < capacity) {
+        list[1 + count] = neighbor;
+        ++list[0];
+        return;
+    }
+
+    // Full: keep the best spread of the old links and the new one.
+    std::vector<Candidate> candidates;
+    candidates.reserve(count + 1);
+    for (quint32 i = 0; i < count; ++i)
+        candidates.push_back({distance(vector(node), list[1 + i]), list[1 + i]});
+    candidates.push_back({distance(vector(node), neighbor), neighbor});
+    const std::vector<quint32> selected = selectNeighbors(std::move(candidates), capacity);
+    list[0] = quint32(selected.size());
+    std::copy(selected.begin(), selected.end(), list + 1);
+}
+
+void HnswIndex::add(quint64 label, const float *vector)
+{
+    detach();
+    if (m_nodes.contains(label))
+        remove(label);
+
+    const quint32 node = m_count;
+    const int level = randomLevel();
+    m_vectors.resize(m_vectors.size() + m_dimensions);
+    normalize(vector, m_dimensions, m_vectors.data() + size_t(node) * m_dimensions);
+    if (m_options.quantize) {
+        m_codes.resize(m_codes.size() + m_dimensions);
+        m_scales.push_back(0);
+        VectorKernels::quantize(m_vectors.data() + size_t(node) * m_dimensions, m_dimensions,
+                                m_codes.data() + size_t(node) * m_dimensions, &m_scales.back());
+    }
+    m_labels.push_back(label);
+    m_levels.push_back(quint8(level));
+    m_removed.push_back(0);
+    m_level0.resize(m_level0.size() + 1 + 2 * m_options.m, 0);
+    m_upperOffsets.push_back(quint32(m_upper.size()));
+    m_upper.resize(m_upper.size() + size_t(level) * (1 + m_options.m), 0);
+    ++m_count;
+    updatePointers();
+    m_nodes.insert(label, node);
+
+    if (m_entryPoint < 0) {
+        m_entryPoint = node;
+        m_maxLevel = level;
+        return;
+    }
+
+    const float *query = this->vector(node);
+    quint32 entry = quint32(m_entryPoint);
+    for (int l = m_maxLevel; l > level; --l)
+        entry = greedyClosest(query, entry, l);
+    for (int l = std::min(level, m_maxLevel); l >= 0; --l) {
+        const std::vector<Candidate> candidates = searchLayer(query, entry, m_options.efConstruction, l);
+        for (const quint32 neighbor : selectNeighbors(candidates, m_options.m)) {
+            link(node, neighbor, l);
+            link(neighbor, node, l);
+        }
+        entry = candidates.front().node;
+    }
+    if (level > m_maxLevel) {
+        m_maxLevel = level;
+        m_entryPoint = node;
+    }
+}
+
+void HnswIndex::remove(quint64 label)
+{
+    const auto it = m_nodes.constFind(label);
+    if (it == m_nodes.cend())
+        return;
+    detach();
+    m_removed[it.value()] = 1;
+    ++m_removedCount;
+    m_nodes.erase(it);
+}
+
+QList<HnswIndex::Hit> HnswIndex::search(const float *query, int k, int ef) const
+{
+    if (m_entryPoint < 0 || k <= 0)
+        return {};
+
+    std::vector<float> normalized(m_dimensions);
+    normalize(query, m_dimensions, normalized.data());
+
+    quint32 entry = quint32(m_entryPoint);
+    for (int l = m_maxLevel; l > 0; --l)
+        entry = greedyClosest(normalized.data(), entry, l);
+    ef = std::max(ef > 0 ? ef : m_options.efSearch, k);
+
+    std::vector<Candidate> candidates = searchLayer(normalized.data(), entry, ef, 0);
+    if (m_options.quantize) {
+        // The codes find the neighbourhood, the floats decide the order within it.
+        for (Candidate &candidate : candidates)
+            candidate.distance = 1.0f - VectorKernels::dot(normalized.data(), vector(candidate.node), m_dimensions);
+        std::sort(candidates.begin(), candidates.end());
+    }
+
+    QList<Hit> hits;
+    for (const Candidate &candidate : candidates) {
+        if (m_removedData[candidate.node])
+            continue;
+        hits.append(Hit{m_labelData[candidate.node], 1.0f - candidate.distance});
+        if (hits.size() == k)
+            break;
+    }
+    return hits;
+}
+
+std::unique_ptr<HnswIndex> HnswIndex::compacted() const
+{
+    auto index = std::make_unique<HnswIndex>(m_dimensions, m_options);
+    for (quint32 node = 0; node < m_count; ++node) {
+        if (!m_removedData[node])
+            index->add(m_labelData[node], vector(node));
+    }
+    return index;
+}
+
+bool HnswIndex::save(const QString &filePath, QString *errorString) const
+{
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.byteOrder = ByteOrderMark;
+    header.dimensions = quint32(m_dimensions);
+    header.m = quint32(m_options.m);
+    header.efConstruction = quint32(m_options.efConstruction);
+    header.efSearch = quint32(m_options.efSearch);
+    header.count = m_count;
+    header.removedCount = quint32(m_removedCount);
+    header.entryPoint = m_entryPoint < 0 ? NoEntryPoint : quint32(m_entryPoint);
+    header.maxLevel = m_maxLevel;
+    header.upperSize = m_upperSize;
+    header.quantized = m_options.quantize ? 1 : 0;
+
+    const Layout layout(header.dimensions, header.m, m_count, m_upperSize, m_options.quantize);
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+    const auto writeAt = [&file](qint64 offset, const void *data, qint64 size) {
+        const QByteArray padding(offset - file.pos(), '\0');
+        file.write(padding);
+        if (size > 0)
+            file.write(static_cast<const char *>(data), size);
+    };
+    writeAt(0, &header, sizeof(header));
+    writeAt(layout.vectors, m_vectorData, qint64(m_count) * m_dimensions * sizeof(float));
+    if (m_options.quantize) {
+        writeAt(layout.codes, m_codeData, qint64(m_count) * m_dimensions);
+        writeAt(layout.scales, m_scaleData, qint64(m_count) * sizeof(float));
+    }
+    writeAt(layout.labels, m_labelData, qint64(m_count) * sizeof(quint64));
+    writeAt(layout.levels, m_levelData, m_count);
+    writeAt(layout.removed, m_removedData, m_count);
+    writeAt(layout.level0, m_level0Data, qint64(m_count) * (1 + 2 * m_options.m) * sizeof(quint32));
+    writeAt(layout.upperOffsets, m_upperOffsetData, qint64(m_count) * sizeof(quint32));
+    writeAt(layout.upper, m_upperData, qint64(m_upperSize) * sizeof(quint32));
+    if (!file.commit()) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<HnswIndex> HnswIndex::load(const QString &filePath, QString *errorString)
+{
+    const auto fail = [errorString](const QString &message) {
+        if (errorString)
+            *errorString = message;
+        return nullptr;
+    };
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(file.errorString());
+    const qint64 size = file.size();
+    Header header;
+    if (size < HeaderSize || file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header))
+        return fail("Truncated index file");
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != FormatVersion
+        || header.byteOrder != ByteOrderMark || header.dimensions == 0 || header.m < 2 || header.quantized > 1)
+        return fail("Not an index file of this version");
+    const Layout layout(header.dimensions, header.m, header.count, header.upperSize, header.quantized);
+    if (layout.end > size || (header.count > 0 && header.entryPoint >= header.count))
+        return fail("Truncated index file");
+    file.close();
+
+    Options options;
+    options.m = int(header.m);
+    options.efConstruction = int(header.efConstruction);
+    options.efSearch = int(header.efSearch);
+    options.quantize = header.quantized;
+    auto index = std::make_unique<HnswIndex>(int(header.dimensions), options);
+
+    // The mapping lives as long as the index keeps the file open.
+    index->m_file.setFileName(filePath);
+    const uchar *data = index->m_file.open(QIODevice::ReadOnly) ? index->m_file.map(0, size) : nullptr;
+    if (!data)
+        return fail(index->m_file.errorString());
+
+    index->m_count = header.count;
+    index->m_removedCount = header.removedCount;
+    index->m_entryPoint = header.entryPoint == NoEntryPoint ? -1 : qint64(header.entryPoint);
+    index->m_maxLevel = header.maxLevel;
+    index->m_vectorData = reinterpret_cast<const float *>(data + layout.vectors);
+    index->m_codeData = reinterpret_cast<const qint8 *>(data + layout.codes);
+    index->m_scaleData = reinterpret_cast<const float *>(data + layout.scales);
+    index->m_labelData = reinterpret_cast<const quint64 *>(data + layout.labels);
+    index->m_levelData = data + layout.levels;
+    index->m_removedData = data + layout.removed;
+    index->m_level0Data = reinterpret_cast<const quint32 *>(data + layout.level0);
+    index->m_upperOffsetData = reinterpret_cast<const quint32 *>(data + layout.upperOffsets);
+    index->m_upperData = reinterpret_cast<const quint32 *>(data + layout.upper);
+    index->m_upperSize = header.upperSize;
+
+    index->m_nodes.reserve(header.count);
+    for (quint32 node = 0; node < header.count; ++node) {
+        if (!index->m_removedData[node])
+            index->m_nodes.insert(index->m_labelData[node], node);
+    }
+    return index;
+}
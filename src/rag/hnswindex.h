@@ -0,0 +1,129 @@
+#ifndef HNSWINDEX_H
+#define HNSWINDEX_H
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+// Hierarchical navigable small world graph (Malkov & Yashunin) for approximate
+// nearest neighbour search by cosine similarity.
+//
+// Vectors are normalized when added. With Options::quantize the graph is walked
+// with int8 codes of the vectors, a quarter of their size, and the candidates
+// are re-ranked with the float vectors. Removed vectors stay in the graph as
+// waypoints and are left out of the results. save() writes the graph to a file
+// that load() memory-maps, a loaded index is searched straight from the
+// mapping and copied into memory by the first change. Mapped, only the codes
+// and links of the visited nodes and the floats of the candidates are paged in.
+//
+// Not thread-safe: concurrent search() calls are fine, changes need exclusive access.
+class HnswIndex
+{
+public:
+    struct Options {
+        int m = 16;                // Links per node, twice that on the bottom layer.
+        int efConstruction = 100;
+        int efSearch = 64;
+        bool quantize = true;
+    };
+
+    struct Hit {
+        quint64 label = 0;
+        float score = 0;   // Cosine similarity.
+    };
+
+    HnswIndex(int dimensions, const Options &options);
+    ~HnswIndex();
+
+    HnswIndex(const HnswIndex &) = delete;
+    HnswIndex &operator=(const HnswIndex &) = delete;
+
+    int dimensions() const { return m_dimensions; }
+    // Vectors that can be found, without the removed ones.
+    qsizetype size() const { return qsizetype(m_count) - m_removedCount; }
+    qsizetype removedCount() const { return m_removedCount; }
+    bool contains(quint64 label) const { return m_nodes.contains(label); }
+    bool isMapped() const { return m_file.isOpen(); }
+
+    // Adds a vector of dimensions() floats. Replaces the vector of an existing label.
+    void add(quint64 label, const float *vector);
+    void remove(quint64 label);
+
+    // The k labels closest to the query, best first. ef <= 0 uses Options::efSearch.
+    QList<Hit> search(const float *query, int k, int ef = 0) const;
+
+    // A new graph of the vectors that were not removed.
+    std::unique_ptr<HnswIndex> compacted() const;
+
+    bool save(const QString &filePath, QString *errorString) const;
+    static std::unique_ptr<HnswIndex> load(const QString &filePath, QString *errorString);
+
+private:
+    struct Candidate {
+        float distance;
+        quint32 node;
+        bool operator<(const Candidate &other) const { return distance < other.distance; }
+        bool operator>(const Candidate &other) const { return distance > other.distance; }
+    };
+
+    // Between a normalized query and a node, from its codes when quantized.
+    float distance(const float *query, quint32 node) const;
+    const float *vector(quint32 node) const { return m_vectorData + size_t(node) * m_dimensions; }
+    const qint8 *codes(quint32 node) const { return m_codeData + size_t(node) * m_dimensions; }
+    // Link count followed by the links of a node on a layer.
+    const quint32 *links(quint32 node, int level) const;
+    quint32 *mutableLinks(quint32 node, int level);
+    int maxLinks(int level) const { return level == 0 ? 2 * m_options.m : m_options.m; }
+
+    quint32 greedyClosest(const float *query, quint32 entry, int level) const;
+    std::vector<Candidate> searchLayer(const float *query, quint32 entry, int ef, int level) const;
+    std::vector<quint32> selectNeighbors(std::vector<Candidate> candidates, int count) const;
+    void link(quint32 node, quint32 neighbor, int level);
+    int randomLevel();
+
+    // Copies a memory-mapped index into the vectors below before the first change.
+    void detach();
+    void updatePointers();
+
+    int m_dimensions;
+    Options m_options;
+    double m_levelFactor;
+    std::mt19937 m_random{42};
+
+    quint32 m_count = 0;
+    qsizetype m_removedCount = 0;
+    qint64 m_entryPoint = -1;
+    int m_maxLevel = -1;
+    QHash<quint64, quint32> m_nodes;   // Label -> node.
+
+    // Owned storage, empty while the index is memory-mapped.
+    std::vector<float> m_vectors;
+    std::vector<qint8> m_codes;
+    std::vector<float> m_scales;   // Per node: code to vector component.
+    std::vector<quint64> m_labels;
+    std::vector<quint8> m_levels;
+    std::vector<quint8> m_removed;
+    std::vector<quint32> m_level0;         // Per node: count, 2m links.
+    std::vector<quint32> m_upperOffsets;   // Per node: offset of its upper layers in m_upper.
+    std::vector<quint32> m_upper;          // Per node and upper layer: count, m links.
+
+    // The storage in use, owned or mapped.
+    QFile m_file;
+    const float *m_vectorData = nullptr;
+    const qint8 *m_codeData = nullptr;
+    const float *m_scaleData = nullptr;
+    const quint64 *m_labelData = nullptr;
+    const quint8 *m_levelData = nullptr;
+    const quint8 *m_removedData = nullptr;
+    const quint32 *m_level0Data = nullptr;
+    const quint32 *m_upperOffsetData = nullptr;
+    const quint32 *m_upperData = nullptr;
+    quint32 m_upperSize = 0;
+};
+
+#endif // HNSWINDEX_H
@@ -0,0 +1,668 @@
+#include "semanticindexer.h"
+#include "embeddingclient.h"
+#include "src/core/codesearch.h"
+#include "src/core/filecontentcache.h"
+#include "src/core/gitignore.h"
+#include "src/core/tracer.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QThread>
+
+#include <algorithm>
+
+namespace {
+
+constexpr quint32 ChunksMagic = 0x514c5043;   // "QLPC"
+constexpr quint32 ChunksVersion = 1;
+// Larger files are mostly generated or data, not worth a slot in the index.
+constexpr qint64 MaxFileSize = 1024 * 1024;
+// Files embedded per batch before the chunks are added and the thread pauses.
+constexpr int FilesPerBatch = 16;
+constexpr qint64 SaveIntervalMs = 60 * 1000;
+// Removed chunks stay in the graph as waypoints until they make up this share.
+constexpr double MaxRemovedShare = 0.25;
+
+const Chunker::Options ChunkOptions;
+
+QString chunksFilePath(const QString &indexFilePath)
+{
+    return indexFilePath.chopped(QLatin1StringView(".hnsw").size()) + ".chunks";
+}
+
+// The text of the file, or nullopt for binary and unreadable files. Search
+// results are read through the content cache; indexing reads every file once
+// and would only push the files that tools look at out of it.
+std::optional<QString> readTextFile(const QString &filePath, bool cached = false)
+{
+    QByteArray content;
+    if (!cached || !FileContentCache::instance().read(filePath, &content)) {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly) || file.size() > MaxFileSize)
+            return std::nullopt;
+        content = file.readAll();
+    }
+    if (content.size() > MaxFileSize)
+        return std::nullopt;
+    if (CodeSearch::isBinary(content))
+        return std::nullopt;
+    return QString::fromUtf8(content);
+}
+
+QString lineRange(const QString &content, int startLine, int endLine)
+{
+    const QStringList lines = content.split(u'\n');
+    return lines.mid(startLine - 1, endLine - startLine + 1).join(u'\n');
+}
+
+} // namespace
+
+SemanticIndexer::SemanticIndexer(QObject *parent)
+    : QObject(parent)
+{
+    // One background thread, so builds and updates of a project are ordered.
+    m_pool.setMaxThreadCount(1);
+    m_pool.setThreadPriority(QThread::LowPriority);
+    m_cacheDirectory = EmbeddingCache::defaultDirectory();
+}
+
+SemanticIndexer::~SemanticIndexer()
+{
+    ++m_generation;
+    m_pool.waitForDone();
+}
+
+QString SemanticIndexer::indexFilePath(const QString &projectPath, const QString &model)
+{
+    static const QRegularExpression unsafe("[^A-Za-z0-9._-]");
+    QString name = model;
+    name.replace(unsafe, "_");
+    return projectPath + "/.qtagent/semantic-" + name + ".hnsw";
+}
+
+void SemanticIndexer::setEmbeddingModel(const QUrl &baseUrl, const QString &model)
+{
+    {
+        QWriteLocker locker(&m_lock);
+        if (baseUrl == m_baseUrl && model == m_model)
+            return;
+        m_baseUrl = baseUrl;
+        m_model = model;
+    }
+    restart();
+}
+
+void SemanticIndexer::setProjectPath(const QString &projectPath)
+{
+    const QString root = projectPath.isEmpty() ? QString() : QDir::cleanPath(projectPath);
+    {
+        QWriteLocker locker(&m_lock);
+        if (root == m_root)
+            return;
+        m_root = root;
+    }
+    restart();
+}
+
+QString SemanticIndexer::projectPath() const
+{
+    QReadLocker locker(&m_lock);
+    return m_root;
+}
+
+void SemanticIndexer::setCpuLimit(double fraction)
+{
+    m_cpuLimit = qBound(0.05, fraction, 1.0);
+}
+
+void SemanticIndexer::setCacheDirectory(const QString &directory)
+{
+    QWriteLocker locker(&m_lock);
+    m_cacheDirectory = directory;
+}
+
+bool SemanticIndexer::isEnabled() const
+{
+    QReadLocker locker(&m_lock);
+    return !m_model.isEmpty();
+}
+
+bool SemanticIndexer::isReady() const
+{
+    QReadLocker locker(&m_lock);
+    return m_ready;
+}
+
+bool SemanticIndexer::isIndexing() const
+{
+    QReadLocker locker(&m_lock);
+    return m_indexing;
+}
+
+QString SemanticIndexer::errorString() const
+{
+    QReadLocker locker(&m_lock);
+    return m_errorString;
+}
+
+qsizetype SemanticIndexer::chunkCount() const
+{
+    QReadLocker locker(&m_lock);
+    return m_chunks.size();
+}
+
+EmbeddingCache::Stats SemanticIndexer::cacheStats() const
+{
+    QReadLocker locker(&m_lock);
+    return m_cache ? m_cache->stats() : EmbeddingCache::Stats();
+}
+
+SemanticIndexer::Config SemanticIndexer::config() const
+{
+    QReadLocker locker(&m_lock);
+    return Config{m_generation.load(), m_root, m_baseUrl, m_model, m_cacheDirectory};
+}
+
+void SemanticIndexer::restart()
+{
+    const quint64 generation = ++m_generation;
+    Config config;
+    {
+        QWriteLocker locker(&m_lock);
+        m_ready = false;
+        m_dirty = false;
+        m_errorString.clear();
+        m_index.reset();
+        m_files.clear();
+        m_chunks.clear();
+        m_nextLabel = 1;
+        m_cache.reset();
+        m_indexing = !m_root.isEmpty() && !m_model.isEmpty();
+        if (!m_indexing)
+            return;
+        config = Config{generation, m_root, m_baseUrl, m_model, m_cacheDirectory};
+    }
+    m_pool.start([this, config]() { build(config); });
+}
+
+void SemanticIndexer::build(const Config &config)
+{
+    TraceSpan span("semantic.build", "rag");
+    bool empty;
+    bool hasCache;
+    {
+        QReadLocker locker(&m_lock);
+        empty = !m_index && m_files.isEmpty();
+        hasCache = m_cache != nullptr;
+    }
+    if (!hasCache && !config.cacheDirectory.isEmpty()) {
+        auto cache = std::make_shared<EmbeddingCache>(config.cacheDirectory, config.model);
+        QWriteLocker locker(&m_lock);
+        if (isStale(config.generation))
+            return;
+        m_cache = std::move(cache);
+    }
+    if (empty)
+        load(config);
+
+    // What is on disk now, against what the index was built from.
+    QMutex mutex;
+    QHash<QString, FileState> present;
+    CodeSearch::Options options;
+    options.maxFileSize = MaxFileSize;
+    CodeSearch::forEachFile(config.root, options, [&](const QFileInfo &info, const QString &relativePath) {
+        if (isStale(config.generation))
+            return false;
+        if (!Chunker::isIndexable(info.fileName()))
+            return true;
+        QMutexLocker locker(&mutex);
+        present.insert(relativePath, FileState{relativePath, info.size(),
+                                               info.lastModified().toMSecsSinceEpoch()});
+        return true;
+    });
+    if (isStale(config.generation))
+        return;
+
+    QList<FileState> changed;
+    QStringList removed;
+    {
+        QReadLocker locker(&m_lock);
+        for (auto it = m_files.cbegin(); it != m_files.cend(); ++it) {
+            if (!present.contains(it.key()))
+                removed.append(it.key());
+        }
+        for (const FileState &file : std::as_const(present)) {
+            const auto entry = m_files.constFind(file.relativePath);
+            if (entry == m_files.cend() || entry->size != file.size || entry->modified != file.modified)
+                changed.append(file);
+        }
+    }
+    std::sort(changed.begin(), changed.end(), [](const FileState &a, const FileState &b) {
+        return a.relativePath < b.relativePath;
+    });
+    span.setArg("changedFiles", changed.size());
+    span.setArg("removedFiles", removed.size());
+
+    {
+        QWriteLocker locker(&m_lock);
+        if (isStale(config.generation))
+            return;
+        for (const QString &relativePath : std::as_const(removed))
+            removeFile(relativePath);
+    }
+
+    EmbeddingClient client(config.baseUrl, config.model);
+    const bool succeeded = indexFiles(config, client, changed);
+    if (isStale(config.generation))
+        return;
+    if (save(config))
+        remap(config);
+
+    const EmbeddingCache::Stats stats = cacheStats();
+    span.setArg("cacheHits", stats.hits);
+    span.setArg("cacheMisses", stats.misses);
+    span.setArg("cacheHitRate", stats.hitRate());
+    if (stats.hits + stats.misses > 0) {
+        qInfo().noquote() << QString("Semantic index of %1: %2 of %3 chunks from the embedding cache (%4%)")
+                                 .arg(config.root)
+                                 .arg(stats.hits)
+                                 .arg(stats.hits + stats.misses)
+                                 .arg(qRound(stats.hitRate() * 100));
+    }
+
+    {
+        QWriteLocker locker(&m_lock);
+        if (isStale(config.generation))
+            return;
+        m_indexing = false;
+        m_ready = succeeded;
+    }
+    QMetaObject::invokeMethod(this, &SemanticIndexer::updated, Qt::QueuedConnection);
+}
+
+void SemanticIndexer::load(const Config &config)
+{
+    const QString indexPath = indexFilePath(config.root, config.model);
+    QFile chunksFile(chunksFilePath(indexPath));
+    if (!chunksFile.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&chunksFile);
+    quint32 magic = 0, version = 0;
+    QString model;
+    quint64 nextLabel = 0;
+    qint64 vectorCount = 0;
+    qint32 fileCount = 0;
+    stream >> magic >> version >> model >> nextLabel >> vectorCount >> fileCount;
+    if (magic != ChunksMagic || version != ChunksVersion || model != config.model)
+        return;
+
+    QHash<QString, FileEntry> files;
+    QHash<quint64, ChunkRef> chunks;
+    for (qint32 i = 0; i < fileCount && stream.status() == QDataStream::Ok; ++i) {
+        QString relativePath;
+        FileEntry entry;
+        qint32 chunkCount = 0;
+        stream >> relativePath >> entry.size >> entry.modified >> chunkCount;
+        for (qint32 j = 0; j < chunkCount && stream.status() == QDataStream::Ok; ++j) {
+            quint64 label = 0;
+            qint32 startLine = 0, endLine = 0;
+            stream >> label >> startLine >> endLine;
+            entry.labels.append(label);
+            chunks.insert(label, ChunkRef{relativePath, startLine, endLine});
+        }
+        files.insert(relativePath, std::move(entry));
+    }
+    if (stream.status() != QDataStream::Ok)
+        return;
+
+    // The graph is saved first, a crash in between leaves the two out of step.
+    QString errorString;
+    std::unique_ptr<HnswIndex> index;
+    if (vectorCount > 0) {
+        index = HnswIndex::load(indexPath, &errorString);
+        if (!index || index->size() != vectorCount || chunks.size() != vectorCount)
+            return;
+        for (auto it = chunks.cbegin(); it != chunks.cend(); ++it) {
+            if (!index->contains(it.key()))
+                return;
+        }
+    }
+
+    QWriteLocker locker(&m_lock);
+    if (isStale(config.generation))
+        return;
+    m_index = std::move(index);
+    m_files = std::move(files);
+    m_chunks = std::move(chunks);
+    m_nextLabel = nextLabel;
+}
+
+bool SemanticIndexer::save(const Config &config)
+{
+    TraceSpan span("semantic.save", "rag");
+    QReadLocker locker(&m_lock);
+    if (isStale(config.generation) || !m_dirty)
+        return true;
+
+    const QString indexPath = indexFilePath(config.root, config.model);
+    QDir().mkpath(QFileInfo(indexPath).absolutePath());
+    QString errorString;
+    if (m_index && !m_index->save(indexPath, &errorString)) {
+        qWarning() << "Could not save the semantic index:" << errorString;
+        return false;
+    }
+
+    QSaveFile file(chunksFilePath(indexPath));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream stream(&file);
+    stream << ChunksMagic << ChunksVersion << config.model << m_nextLabel
+           << qint64(m_index ? m_index->size() : 0) << qint32(m_files.size());
+    for (auto it = m_files.cbegin(); it != m_files.cend(); ++it) {
+        stream << it.key() << it->size << it->modified << qint32(it->labels.size());
+        for (const quint64 label : it->labels) {
+            const ChunkRef &chunk = m_chunks[label];
+            stream << label << qint32(chunk.startLine) << qint32(chunk.endLine);
+        }
+    }
+    if (!file.commit())
+        return false;
+
+    m_dirty = false;
+    return true;
+}
+
+void SemanticIndexer::remap(const Config &config)
+{
+    {
+        QReadLocker locker(&m_lock);
+        if (!m_index || m_index->isMapped())
+            return;
+    }
+    QString errorString;
+    std::unique_ptr<HnswIndex> index = HnswIndex::load(indexFilePath(config.root, config.model), &errorString);
+    if (!index)
+        return;
+
+    QWriteLocker locker(&m_lock);
+    // Nothing may have changed since the save.
+    if (isStale(config.generation) || m_dirty || !m_index || index->size() != m_index->size())
+        return;
+    m_index = std::move(index);
+}
+
+bool SemanticIndexer::indexFiles(const Config &config, EmbeddingClient &client, const QList<FileState> &files)
+{
+    QElapsedTimer sinceSave;
+    sinceSave.start();
+    for (qsizetype start = 0; start < files.size(); start += FilesPerBatch) {
+        QElapsedTimer work;
+        work.start();
+
+        struct Pending {
+            FileState file;
+            QList<Chunker::Chunk> chunks;
+        };
+        QList<Pending> pending;
+        QStringList texts;
+        for (qsizetype i = start; i < qMin(start + FilesPerBatch, files.size()); ++i) {
+            Pending entry{files[i], {}};
+            if (const auto content = readTextFile(config.root + '/' + files[i].relativePath)) {
+                entry.chunks = Chunker::chunk(*content, ChunkOptions);
+                // The path tells the model what the chunk belongs to.
+                for (const Chunker::Chunk &chunk : std::as_const(entry.chunks))
+                    texts.append("File: " + files[i].relativePath + '\n' + chunk.text);
+            }
+            pending.append(std::move(entry));
+        }
+
+        std::shared_ptr<EmbeddingCache> cache;
+        {
+            QReadLocker locker(&m_lock);
+            cache = m_cache;
+        }
+        QList<QList<float>> vectors;
+        QString errorString;
+        if (!texts.isEmpty() && !embedCached(client, cache.get(), texts, &vectors, &errorString)) {
+            setFailed(config.generation, errorString);
+            return false;
+        }
+
+        {
+            QWriteLocker locker(&m_lock);
+            if (isStale(config.generation))
+                return false;
+            const qsizetype dimensions = m_index ? m_index->dimensions() : vectors.value(0).size();
+            const auto mismatch = std::find_if(vectors.cbegin(), vectors.cend(), [dimensions](const QList<float> &vector) {
+                return vector.size() != dimensions;
+            });
+            if (mismatch != vectors.cend()) {
+                const QString message = QString("The embedding model returned %1 dimensions instead of %2")
+                                            .arg(mismatch->size()).arg(dimensions);
+                locker.unlock();
+                setFailed(config.generation, message);
+                return false;
+            }
+            if (!vectors.isEmpty() && !m_index)
+                m_index = std::make_unique<HnswIndex>(int(vectors.first().size()), HnswIndex::Options());
+
+            qsizetype vector = 0;
+            for (const Pending &entry : std::as_const(pending)) {
+                removeFile(entry.file.relativePath);
+                FileEntry fileEntry{entry.file.size, entry.file.modified, {}};
+                for (const Chunker::Chunk &chunk : entry.chunks) {
+                    const quint64 label = m_nextLabel++;
+                    m_index->add(label, vectors[vector++].constData());
+                    m_chunks.insert(label, ChunkRef{entry.file.relativePath, chunk.startLine, chunk.endLine});
+                    fileEntry.labels.append(label);
+                }
+                m_files.insert(entry.file.relativePath, std::move(fileEntry));
+            }
+            m_dirty = true;
+
+            if (m_index && m_index->removedCount() > MaxRemovedShare * (m_index->size() + m_index->removedCount()))
+                m_index = m_index->compacted();
+        }
+
+        const int done = int(qMin(start + FilesPerBatch, files.size()));
+        QMetaObject::invokeMethod(this, [this, done, total = int(files.size())]() {
+            emit progress(done, total);
+        }, Qt::QueuedConnection);
+
+        if (sinceSave.elapsed() > SaveIntervalMs) {
+            save(config);
+            sinceSave.restart();
+        }
+        if (!throttle(config.generation, work.elapsed()))
+            return false;
+    }
+    return true;
+}
+
+bool SemanticIndexer::embedCached(EmbeddingClient &client, EmbeddingCache *cache, const QStringList &texts,
+                                  QList<QList<float>> *vectors, QString *errorString)
+{
+    if (!cache)
+        return client.embed(texts, vectors, errorString);
+
+    vectors->resize(texts.size());
+    QList<quint64> keys;
+    QList<qsizetype> missing;
+    QStringList missingTexts;
+    for (qsizetype i = 0; i < texts.size(); ++i) {
+        keys.append(EmbeddingCache::key(texts[i]));
+        if (!cache->find(keys[i], &(*vectors)[i])) {
+            missing.append(i);
+            missingTexts.append(texts[i]);
+        }
+    }
+    if (missing.isEmpty())
+        return true;
+
+    QList<QList<float>> embedded;
+    if (!client.embed(missingTexts, &embedded, errorString))
+        return false;
+    for (qsizetype i = 0; i < missing.size(); ++i) {
+        cache->insert(keys[missing[i]], embedded[i]);
+        (*vectors)[missing[i]] = std::move(embedded[i]);
+    }
+    return true;
+}
+
+void SemanticIndexer::removeFile(const QString &relativePath)
+{
+    const auto it = m_files.constFind(relativePath);
+    if (it == m_files.cend())
+        return;
+    for (const quint64 label : it->labels) {
+        m_chunks.remove(label);
+        if (m_index)
+            m_index->remove(label);
+    }
+    m_files.erase(it);
+    m_dirty = true;
+}
+
+bool SemanticIndexer::throttle(quint64 generation, qint64 workMs)
+{
+    // Work for workMs, then rest long enough that the work is cpuLimit of the total.
+    const double limit = m_cpuLimit;
+    qint64 restMs = qint64(workMs * (1.0 - limit) / limit);
+    while (restMs > 0) {
+        if (isStale(generation))
+            return false;
+        const qint64 slice = qMin<qint64>(restMs, 50);
+        QThread::msleep(slice);
+        restMs -= slice;
+    }
+    return !isStale(generation);
+}
+
+void SemanticIndexer::setFailed(quint64 generation, const QString &errorString)
+{
+    {
+        QWriteLocker locker(&m_lock);
+        if (isStale(generation))
+            return;
+        m_errorString = errorString;
+        m_indexing = false;
+    }
+    QMetaObject::invokeMethod(this, &SemanticIndexer::updated, Qt::QueuedConnection);
+}
+
+void SemanticIndexer::updateFiles(const QStringList &filePaths)
+{
+    const Config config = this->config();
+    if (config.root.isEmpty() || config.model.isEmpty())
+        return;
+
+    QList<FileState> files;
+    const QDir rootDir(config.root);
+    for (const QString &filePath : filePaths) {
+        const auto relativePath = CodeSearch::relativeTreePath(rootDir, filePath);
+        if (relativePath && Chunker::isIndexable(QFileInfo(*relativePath).fileName()))
+            files.append(FileState{*relativePath, 0, 0});
+    }
+    if (files.isEmpty())
+        return;
+
+    ++m_queuedUpdates;
+    m_pool.start([this, config, files]() {
+        QList<FileState> changed;
+        for (FileState file : files) {
+            const auto ignore = GitIgnore::forTree(config.root, CodeSearch::parentDirectory(file.relativePath));
+            if (ignore && ignore->isIgnored(file.relativePath, false))
+                continue;
+            const QFileInfo info(config.root + '/' + file.relativePath);
+            if (!info.isFile()) {
+                QWriteLocker locker(&m_lock);
+                if (!isStale(config.generation))
+                    removeFile(file.relativePath);
+                continue;
+            }
+            file.size = info.size();
+            file.modified = info.lastModified().toMSecsSinceEpoch();
+            changed.append(file);
+        }
+        if (!changed.isEmpty() && !isStale(config.generation)) {
+            EmbeddingClient client(config.baseUrl, config.model);
+            indexFiles(config, client, changed);
+        }
+        // Adding to a mapped index copies it into memory. Once a burst of
+        // updates is through, the index goes back to a mapping of the file.
+        if (--m_queuedUpdates == 0 && !isStale(config.generation) && save(config))
+            remap(config);
+    });
+}
+
+QList<SemanticIndexer::Result> SemanticIndexer::search(const QString &query, int maxResults, QString *errorString)
+{
+    TraceSpan span("semantic.search", "rag");
+    const Config config = this->config();
+    if (config.model.isEmpty()) {
+        *errorString = "Semantic search is disabled: no embedding model is configured";
+        return {};
+    }
+    if (config.root.isEmpty()) {
+        *errorString = "No project is open";
+        return {};
+    }
+
+    {
+        QWriteLocker locker(&m_lock);
+        if (!m_indexing && !m_errorString.isEmpty() && !isStale(config.generation)) {
+            // Indexing failed, e.g. because the server was down. Try again.
+            *errorString = "Indexing failed: " + m_errorString + ". Retrying in the background.";
+            m_errorString.clear();
+            m_indexing = true;
+            m_pool.start([this, config]() { build(config); });
+            if (m_chunks.isEmpty())
+                return {};
+        } else if (m_chunks.isEmpty()) {
+            *errorString = m_indexing ? "The semantic index is still being built, try again later"
+                                      : "The semantic index is empty";
+            return {};
+        }
+    }
+
+    EmbeddingClient client(config.baseUrl, config.model);
+    QList<QList<float>> vectors;
+    if (!client.embed({query}, &vectors, errorString))
+        return {};
+
+    QList<Result> results;
+    {
+        QReadLocker locker(&m_lock);
+        if (isStale(config.generation) || !m_index)
+            return {};
+        if (m_index->dimensions() != vectors.first().size()) {
+            *errorString = "The query embedding does not match the dimensions of the index";
+            return {};
+        }
+        for (const HnswIndex::Hit &hit : m_index->search(vectors.first().constData(), maxResults)) {
+            const ChunkRef chunk = m_chunks.value(hit.label);
+            results.append(Result{chunk.relativePath, chunk.startLine, chunk.endLine, hit.score, {}});
+        }
+    }
+    span.setArg("results", results.size());
+
+    // Chunk text comes from the files, each read once.
+    QHash<QString, QString> contents;
+    for (Result &result : results) {
+        auto content = contents.find(result.filePath);
+        if (content == contents.end())
+            content = contents.insert(result.filePath, readTextFile(config.root + '/' + result.filePath, true).value_or(QString()));
+        result.text = lineRange(*content, result.startLine, result.endLine);
+        result.filePath = config.root + '/' + result.filePath;
+    }
+    errorString->clear();
+    return results;
+}
@@ -0,0 +1,147 @@
+#ifndef SEMANTICINDEXER_H
+#define SEMANTICINDEXER_H
+
+#include "chunker.h"
+#include "embeddingcache.h"
+#include "hnswindex.h"
+
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QStringList>
+#include <QThreadPool>
+#include <QUrl>
+
+#include <atomic>
+#include <memory>
+
+class EmbeddingClient;
+
+// Embedding index over the text files of a project, for the semantic_search tool.
+//
+// Files are cut into overlapping chunks of lines, embedded through a local
+// Ollama server (unless the EmbeddingCache knows the chunk) and stored in an
+// HnswIndex. Only the vectors and the line ranges
+// are kept, chunk text is read from the files when a search returns it. The
+// graph and the chunk table live in <project>/.qtagent/semantic-<model>.* and
+// are refreshed against the files' sizes and modification times when loaded.
+//
+// Indexing runs on one low-priority background thread that pauses between
+// batches so it uses at most the configured share of a core.
+class SemanticIndexer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Result {
+        QString filePath;   // Absolute.
+        int startLine = 0;  // 1-based.
+        int endLine = 0;    // 1-based, inclusive.
+        float score = 0;    // Cosine similarity.
+        QString text;
+    };
+
+    explicit SemanticIndexer(QObject *parent = nullptr);
+    ~SemanticIndexer() override;
+
+    // The Ollama server and its embedding model. An empty model disables the index.
+    void setEmbeddingModel(const QUrl &baseUrl, const QString &model);
+    // Loads or builds the index of the project in the background. Empty to unload.
+    void setProjectPath(const QString &projectPath);
+    QString projectPath() const;
+    // Share of one core that background indexing may use, from 0.05 to 1.
+    void setCpuLimit(double fraction);
+    // Where the embedding cache lives, EmbeddingCache::defaultDirectory() by
+    // default. Empty disables the cache. Takes effect with the next project or model.
+    void setCacheDirectory(const QString &directory);
+
+    bool isEnabled() const;
+    // True once the project has been indexed completely, searches work before that.
+    bool isReady() const;
+    bool isIndexing() const;
+    // Why indexing stopped, empty unless it failed.
+    QString errorString() const;
+    qsizetype chunkCount() const;
+    // Cache hits and misses of the chunks embedded for the current project and model.
+    EmbeddingCache::Stats cacheStats() const;
+
+    // The chunks closest in meaning to the query, best first. Embeds the query,
+    // so it blocks for a request to the embedding server. Thread-safe.
+    QList<Result> search(const QString &query, int maxResults, QString *errorString);
+
+    // Re-indexes the given files (absolute paths) in the background. Thread-safe.
+    void updateFiles(const QStringList &filePaths);
+
+    static QString indexFilePath(const QString &projectPath, const QString &model);
+
+signals:
+    // Emitted on the indexer's thread while files are embedded.
+    void progress(int filesDone, int filesTotal);
+    // Emitted on the indexer's thread when indexing finished or failed.
+    void updated();
+
+private:
+    struct Config {
+        quint64 generation = 0;
+        QString root;
+        QUrl baseUrl;
+        QString model;
+        QString cacheDirectory;
+    };
+    struct FileEntry {
+        qint64 size = 0;
+        qint64 modified = 0;
+        QList<quint64> labels;
+    };
+    struct ChunkRef {
+        QString relativePath;
+        int startLine = 0;
+        int endLine = 0;
+    };
+    struct FileState {
+        QString relativePath;
+        qint64 size = 0;
+        qint64 modified = 0;
+    };
+
+    void restart();
+    void build(const Config &config);
+    void load(const Config &config);
+    bool save(const Config &config);
+    // Swaps the index built in memory for a mapping of the saved file, which
+    // keeps only the pages that searches touch resident.
+    void remap(const Config &config);
+    bool indexFiles(const Config &config, EmbeddingClient &client, const QList<FileState> &files);
+    // Only the texts that are not in the cache are sent to the server.
+    static bool embedCached(EmbeddingClient &client, EmbeddingCache *cache, const QStringList &texts,
+                            QList<QList<float>> *vectors, QString *errorString);
+    void removeFile(const QString &relativePath);
+    // Sleeps for the share of the work time that keeps the CPU limit, false when stale.
+    bool throttle(quint64 generation, qint64 workMs);
+    void setFailed(quint64 generation, const QString &errorString);
+    bool isStale(quint64 generation) const { return generation != m_generation.load(); }
+    Config config() const;
+
+    mutable QReadWriteLock m_lock;
+    QString m_root;
+    QUrl m_baseUrl;
+    QString m_model;
+    QString m_cacheDirectory;
+    std::shared_ptr<EmbeddingCache> m_cache;   // Opened by the first build.
+    bool m_ready = false;
+    bool m_indexing = false;
+    QString m_errorString;
+    std::unique_ptr<HnswIndex> m_index;
+    QHash<QString, FileEntry> m_files;   // By relative path.
+    QHash<quint64, ChunkRef> m_chunks;   // By label.
+    quint64 m_nextLabel = 1;
+
+    // Changes not saved yet. Only the indexing thread changes the index.
+    std::atomic<bool> m_dirty = false;
+    // updateFiles() tasks not run yet, the last one saves.
+    std::atomic<int> m_queuedUpdates = 0;
+    std::atomic<double> m_cpuLimit = 0.25;
+    std::atomic<quint64> m_generation = 0;
+    QThreadPool m_pool;
+};
+
+#endif // SEMANTICINDEXER_H
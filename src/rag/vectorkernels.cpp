@@ -0,0 +1,274 @@
+#include "vectorkernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define QLP_VECTOR_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile the AVX2 and SSE4.1 functions for their target only,
+// the rest of the file keeps the baseline. MSVC accepts the intrinsics anyway.
+#if defined(__GNUC__) || defined(__clang__)
+#define QLP_TARGET(features) __attribute__((target(features)))
+#else
+#define QLP_TARGET(features)
+#endif
+
+namespace {
+
+using DotFunction = float (*)(const float *, const float *, int);
+using DotInt8Function = float (*)(const float *, const qint8 *, int);
+
+struct Kernels {
+    VectorKernels::InstructionSet set;
+    DotFunction dot;
+    DotInt8Function dotInt8;
+};
+
+float dotScalar(const float *a, const float *b, int dimensions)
+{
+    // Four accumulators let the compiler vectorize without reassociating.
+    float sum[4] = {0, 0, 0, 0};
+    int i = 0;
+    for (; i + 4 <= dimensions; i += 4) {
+        sum[0] += a[i] * b[i];
+        sum[1] += a[i + 1] * b[i + 1];
+        sum[2] += a[i + 2] * b[i + 2];
+        sum[3] += a[i + 3] * b[i + 3];
+    }
+    for (; i < dimensions; ++i)
+        sum[0] += a[i] * b[i];
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+float dotInt8Scalar(const float *query, const qint8 *codes, int dimensions)
+{
+    float sum[4] = {0, 0, 0, 0};
+    int i = 0;
+    for (; i + 4 <= dimensions; i += 4) {
+        sum[0] += query[i] * codes[i];
+        sum[1] += query[i + 1] * codes[i + 1];
+        sum[2] += query[i + 2] * codes[i + 2];
+        sum[3] += query[i + 3] * codes[i + 3];
+    }
+    for (; i < dimensions; ++i)
+        sum[0] += query[i] * codes[i];
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+#ifdef QLP_VECTOR_X86
+
+QLP_TARGET("sse4.1")
+float horizontalSum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+QLP_TARGET("sse4.1")
+float dotSse41(const float *a, const float *b, int dimensions)
+{
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= dimensions; i += 8) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float sum = horizontalSum(_mm_add_ps(sum0, sum1));
+    for (; i < dimensions; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+QLP_TARGET("sse4.1")
+float dotInt8Sse41(const float *query, const qint8 *codes, int dimensions)
+{
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= dimensions; i += 8) {
+        const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(codes + i));
+        const __m128 low = _mm_cvtepi32_ps(_mm_cvtepi8_epi32(bytes));
+        const __m128 high = _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_srli_si128(bytes, 4)));
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(query + i), low));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(query + i + 4), high));
+    }
+    float sum = horizontalSum(_mm_add_ps(sum0, sum1));
+    for (; i < dimensions; ++i)
+        sum += query[i] * codes[i];
+    return sum;
+}
+
+QLP_TARGET("avx2,fma")
+float horizontalSum256(__m256 v)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+QLP_TARGET("avx2,fma")
+float dotAvx2(const float *a, const float *b, int dimensions)
+{
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= dimensions; i += 16) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+    }
+    for (; i + 8 <= dimensions; i += 8)
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+    float sum = horizontalSum256(_mm256_add_ps(sum0, sum1));
+    for (; i < dimensions; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+QLP_TARGET("avx2,fma")
+float dotInt8Avx2(const float *query, const qint8 *codes, int dimensions)
+{
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= dimensions; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(codes + i));
+        const __m256 low = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes));
+        const __m256 high = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(bytes, 8)));
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i), low, sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(query + i + 8), high, sum1);
+    }
+    float sum = horizontalSum256(_mm256_add_ps(sum0, sum1));
+    for (; i < dimensions; ++i)
+        sum += query[i] * codes[i];
+    return sum;
+}
+
+struct CpuFeatures {
+    bool sse41 = false;
+    bool avx2 = false;
+};
+
+CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    features.sse41 = info[2] & (1 << 19);
+    const bool fma = info[2] & (1 << 12);
+    // The OS must save the AVX registers on context switches.
+    const bool osAvx = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+    if (maxLeaf >= 7 && fma && osAvx) {
+        __cpuidex(info, 7, 0);
+        features.avx2 = info[1] & (1 << 5);
+    }
+#else
+    __builtin_cpu_init();
+    features.sse41 = __builtin_cpu_supports("sse4.1");
+    features.avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    return features;
+}
+
+#endif // QLP_VECTOR_X86
+
+const Kernels ScalarKernels{VectorKernels::Scalar, dotScalar, dotInt8Scalar};
+#ifdef QLP_VECTOR_X86
+const Kernels Sse41Kernels{VectorKernels::Sse41, dotSse41, dotInt8Sse41};
+const Kernels Avx2Kernels{VectorKernels::Avx2, dotAvx2, dotInt8Avx2};
+#endif
+
+const Kernels *kernelsFor(VectorKernels::InstructionSet set)
+{
+#ifdef QLP_VECTOR_X86
+    static const CpuFeatures features = detectCpuFeatures();
+    if (set == VectorKernels::Avx2)
+        return features.avx2 ? &Avx2Kernels : nullptr;
+    if (set == VectorKernels::Sse41)
+        return features.sse41 ? &Sse41Kernels : nullptr;
+#endif
+    return set == VectorKernels::Scalar ? &ScalarKernels : nullptr;
+}
+
+const Kernels *bestKernels()
+{
+    for (const auto set : {VectorKernels::Avx2, VectorKernels::Sse41}) {
+        if (const Kernels *kernels = kernelsFor(set))
+            return kernels;
+    }
+    return &ScalarKernels;
+}
+
+std::atomic<const Kernels *> &activeKernels()
+{
+    static std::atomic<const Kernels *> kernels{bestKernels()};
+    return kernels;
+}
+
+} // namespace
+
+namespace VectorKernels {
+
+float dot(const float *a, const float *b, int dimensions)
+{
+    return activeKernels().load(std::memory_order_relaxed)->dot(a, b, dimensions);
+}
+
+float dotInt8(const float *query, const qint8 *codes, int dimensions)
+{
+    return activeKernels().load(std::memory_order_relaxed)->dotInt8(query, codes, dimensions);
+}
+
+void quantize(const float *vector, int dimensions, qint8 *codes, float *scale)
+{
+    float maximum = 0;
+    for (int i = 0; i < dimensions; ++i)
+        maximum = std::max(maximum, std::abs(vector[i]));
+    *scale = maximum > 0 ? maximum / 127.0f : 1.0f;
+    const float inverse = 1.0f / *scale;
+    for (int i = 0; i < dimensions; ++i)
+        codes[i] = qint8(std::lround(std::clamp(vector[i] * inverse, -127.0f, 127.0f)));
+}
+
+InstructionSet instructionSet()
+{
+    return activeKernels().load(std::memory_order_relaxed)->set;
+}
+
+bool setInstructionSet(InstructionSet set)
+{
+    const Kernels *kernels = kernelsFor(set);
+    if (!kernels)
+        return false;
+    activeKernels().store(kernels);
+    return true;
+}
+
+bool isSupported(InstructionSet set)
+{
+    return kernelsFor(set) != nullptr;
+}
+
+QString name(InstructionSet set)
+{
+    switch (set) {
+    case Scalar: return "scalar";
+    case Sse41: return "sse4.1";
+    case Avx2: return "avx2";
+    }
+    return {};
+}
+
+} // namespace VectorKernels
@@ -0,0 +1,32 @@
+#ifndef VECTORKERNELS_H
+#define VECTORKERNELS_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Distance kernels for the embedding index, with AVX2/FMA and SSE4.1 versions
+// picked at runtime on x86 and a scalar fallback everywhere else.
+namespace VectorKernels {
+
+enum InstructionSet {
+    Scalar,
+    Sse41,
+    Avx2
+};
+
+float dot(const float *a, const float *b, int dimensions);
+// Dot product of a float query with int8 codes, to be multiplied by the codes' scale.
+float dotInt8(const float *query, const qint8 *codes, int dimensions);
+// Symmetric per-vector int8 quantization: vector[i] ~= codes[i] * scale.
+void quantize(const float *vector, int dimensions, qint8 *codes, float *scale);
+
+// The best set the CPU supports, unless changed.
+InstructionSet instructionSet();
+// For tests and benchmarks. False when the CPU does not support the set.
+bool setInstructionSet(InstructionSet set);
+bool isSupported(InstructionSet set);
+QString name(InstructionSet set);
+
+} // namespace VectorKernels
+
+#endif // VECTORKERNELS_H
@@ -28,6 +28,9 @@ void LLMSettings::load()
     baseUrl_      = s.value("LLM/baseUrl", defaultUrl).toString();
     model_        = s.value("LLM/model", "llama3").toString();
     apiKey_       = s.value("LLM/apiKey", "").toString();
+    tokenizerPath_ = s.value("LLM/tokenizerPath", "").toString();
+    embeddingUrl_ = s.value("LLM/embeddingUrl", "http://localhost:11434").toString();
+    embeddingModel_ = s.value("LLM/embeddingModel", "nomic-embed-text").toString();
 }
 
 void LLMSettings::save()
@@ -37,14 +40,24 @@ void LLMSettings::save()
     s.setValue("LLM/model", model_);
     s.setValue("LLM/apiKey", apiKey_);
     s.setValue("LLM/providerType", providerType_);
+    s.setValue("LLM/tokenizerPath", tokenizerPath_);
+    s.setValue("LLM/embeddingUrl", embeddingUrl_);
+    s.setValue("LLM/embeddingModel", embeddingModel_);
+    emit changed();
 }
 
 QString LLMSettings::baseUrl() const { return baseUrl_; }
 QString LLMSettings::model() const { return model_; }
 QString LLMSettings::apiKey() const { return apiKey_; }
 QString LLMSettings::providerType() const { return providerType_; }
+QString LLMSettings::tokenizerPath() const { return tokenizerPath_; }
+QString LLMSettings::embeddingUrl() const { return embeddingUrl_; }
+QString LLMSettings::embeddingModel() const { return embeddingModel_; }
 
 void LLMSettings::setBaseUrl(const QString &v) { baseUrl_ = v; }
 void LLMSettings::setModel(const QString &v) { model_ = v; }
 void LLMSettings::setApiKey(const QString &v) { apiKey_ = v; }
 void LLMSettings::setProviderType(const QString &v) { providerType_ = v; }
+void LLMSettings::setTokenizerPath(const QString &v) { tokenizerPath_ = v; }
+void LLMSettings::setEmbeddingUrl(const QString &v) { embeddingUrl_ = v; }
+void LLMSettings::setEmbeddingModel(const QString &v) { embeddingModel_ = v; }
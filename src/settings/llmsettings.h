@@ -15,20 +15,34 @@ public:
     QString model() const;
     QString apiKey() const;
     QString providerType() const;
+    // Tokenizer vocabulary (.tiktoken or SentencePiece .vocab), empty for the estimate.
+    QString tokenizerPath() const;
+    // Ollama server and model for the semantic_search index, an empty model disables it.
+    QString embeddingUrl() const;
+    QString embeddingModel() const;
 
     void setBaseUrl(const QString &v);
     void setModel(const QString &v);
     void setApiKey(const QString &v);
     void setProviderType(const QString &v);
+    void setTokenizerPath(const QString &v);
+    void setEmbeddingUrl(const QString &v);
+    void setEmbeddingModel(const QString &v);
 
     void load();
     void save();
 
+signals:
+    void changed();
+
 private:
     LLMSettings();
     QString baseUrl_;
     QString model_;
     QString apiKey_;
     QString providerType_;
+    QString tokenizerPath_;
+    QString embeddingUrl_;
+    QString embeddingModel_;
 };
 #endif // LLMSETTINGS_H
@@ -1,10 +1,7 @@
 #include "chatdockwidget.h"
 
 #include "chatmessagewidget.h"
-#include "src/providers/ollama/ollamaprovider.h"
-#include "src/providers/openai/openaiprovider.h"
-#include "src/providers/claude/claudeprovider.h"
-#include "src/settings/llmsettings.h"
+#include "src/providers/providerregistry.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -17,8 +14,12 @@
 #include <QClipboard>
 #include <QApplication>
 #include <QKeyEvent>
+#include <QLabel>
+#include <QDebug>
 
 #include "src/core/codeeditormanager.h"
+#include "src/core/tokenizer.h"
+#include "src/settings/llmsettings.h"
 #include "src/mcp/mcpserver.h"
 
 ChatDockWidget::ChatDockWidget(QWidget *parent)
@@ -43,13 +44,21 @@ ChatDockWidget::ChatDockWidget(QWidget *parent)
     input->installEventFilter(this);
 
     sendButton = new QPushButton("Send");
+    stopButton = new QPushButton("Stop");
+    stopButton->setVisible(false);
 
     auto bottomLayout = new QHBoxLayout;
     bottomLayout->addWidget(input);
     bottomLayout->addWidget(sendButton);
+    bottomLayout->addWidget(stopButton);
+
+    statsLabel = new QLabel;
+    statsLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    statsLabel->setVisible(false);
 
     auto mainLayout = new QVBoxLayout(root);
     mainLayout->addWidget(scroll);
+    mainLayout->addWidget(statsLabel);
     mainLayout->addLayout(bottomLayout);
 
     setWidget(root);
@@ -57,15 +66,38 @@ ChatDockWidget::ChatDockWidget(QWidget *parent)
     connect(sendButton, &QPushButton::clicked, this, &ChatDockWidget::onSendClicked);
 
     llmManager = new LLMManager(this);
+
+    connect(stopButton, &QPushButton::clicked, llmManager, &LLMManager::cancel);
+    connect(llmManager, &LLMManager::busyChanged, this, [this](bool busy){
+        sendButton->setVisible(!busy);
+        stopButton->setVisible(busy);
+    });
+    connect(llmManager, &LLMManager::metricsAvailable, this, &ChatDockWidget::updateStats);
+    connect(llmManager, &LLMManager::generationCancelled, this, [this](){
+        stopTypingAnimation();
+        currentAssistantBubble = nullptr;
+    });
     
-    auto editorManager = new CodeEditorManager(this);
+    // The server owns the editor manager: its tool threads use it until the
+    // server has waited for them.
+    auto editorManager = new CodeEditorManager;
     auto mcpServer = new MCPServer(editorManager, this);
+    editorManager->setParent(mcpServer);
     llmManager->setMCPServer(mcpServer);
 
+    // The semantic_search index follows the embedding settings.
+    auto configureSemanticIndex = [mcpServer]() {
+        const auto &settings = LLMSettings::instance();
+        mcpServer->semanticIndexer()->setEmbeddingModel(QUrl(settings.embeddingUrl()), settings.embeddingModel());
+    };
+    configureSemanticIndex();
+    connect(&LLMSettings::instance(), &LLMSettings::changed, mcpServer, configureSemanticIndex);
+
     // New conversation button
     auto clearButton = new QPushButton("New Chat");
     bottomLayout->insertWidget(0, clearButton);
     connect(clearButton, &QPushButton::clicked, this, [this](){
+        // Stops any running generation before dropping the history
         llmManager->clearHistory();
         
         // Remove all bubbles from UI
@@ -90,6 +122,12 @@ ChatDockWidget::ChatDockWidget(QWidget *parent)
 
     initProvider();
 
+    // Get DNS/TCP/TLS out of the way while the user is still typing.
+    connect(this, &QDockWidget::visibilityChanged, this, [this](bool visible){
+        if (visible) llmManager->warmUp();
+    });
+    connect(input, &QTextEdit::textChanged, llmManager, &LLMManager::warmUp);
+
     connect(llmManager, &LLMManager::responseReady, this, [this](const QString &t){
         stopTypingAnimation();
         if (currentAssistantBubble) {
@@ -141,30 +179,54 @@ ChatDockWidget::ChatDockWidget(QWidget *parent)
 
 void ChatDockWidget::initProvider()
 {
-    auto &s = LLMSettings::instance();
-    QString type = s.providerType();
-    
-    LLMProvider *provider = nullptr;
-    if (type == "OpenAI") {
-        auto p = new OpenAIProvider(this);
-        p->setBaseUrl(s.baseUrl());
-        p->setModel(s.model());
-        p->setApiKey(s.apiKey());
-        provider = p;
-    } else if (type == "Claude") {
-        auto p = new ClaudeProvider(this);
-        p->setBaseUrl(s.baseUrl());
-        p->setModel(s.model());
-        p->setApiKey(s.apiKey());
-        provider = p;
-    } else {
-        auto p = new OllamaProvider(this);
-        p->setBaseUrl(s.baseUrl());
-        p->setModel(s.model());
-        provider = p;
+    providerRegistry = new ProviderRegistry(this);
+    connect(providerRegistry, &ProviderRegistry::currentProviderChanged, llmManager, &LLMManager::setProvider);
+    llmManager->setProvider(providerRegistry->currentProvider());
+
+    loadTokenizer();
+    connect(&LLMSettings::instance(), &LLMSettings::changed, this, &ChatDockWidget::loadTokenizer);
+}
+
+void ChatDockWidget::loadTokenizer()
+{
+    const QString path = LLMSettings::instance().tokenizerPath();
+    if (path == tokenizerPath)
+        return;
+    tokenizerPath = path;
+
+    std::shared_ptr<Tokenizer> tokenizer;
+    if (!path.isEmpty()) {
+        tokenizer = std::make_shared<Tokenizer>();
+        QString error;
+        if (!tokenizer->load(path, &error)) {
+            qWarning() << "Tokenizer not loaded, using the character estimate:" << error;
+            tokenizer.reset();
+        }
     }
-    
-    llmManager->setProvider(provider);
+    llmManager->setTokenizer(tokenizer);
+}
+
+void ChatDockWidget::updateStats(const RequestMetrics &m)
+{
+    auto ms = [](qint64 v) { return v >= 0 ? QString("%1 ms").arg(v) : QString("–"); };
+
+    QStringList parts;
+    parts << m.provider;
+    parts << "TTFT " + ms(m.firstTokenMs);
+    parts << QString("%1 tok%2").arg(m.completionTokens).arg(m.tokensReportedByServer ? "" : " (est.)");
+    parts << QString("%1 tok/s").arg(m.tokensPerSecond, 0, 'f', 1);
+    parts << "total " + ms(m.totalMs);
+    if (m.toolCallAssemblyMs >= 0)
+        parts << "tool calls " + ms(m.toolCallAssemblyMs);
+
+    const auto conn = providerRegistry->connectionStats();
+    parts << QString("conn reused %1/%2").arg(conn.reusedConnections()).arg(conn.requests);
+
+    statsLabel->setText(parts.join(" · "));
+    statsLabel->setToolTip(QString("Request build: %1\nFirst byte: %2\nFirst token: %3\nTotal: %4\nTLS handshakes: %5")
+                               .arg(ms(m.buildMs), ms(m.firstByteMs), ms(m.firstTokenMs), ms(m.totalMs))
+                               .arg(conn.tlsHandshakes));
+    statsLabel->setVisible(true);
 }
 
 bool ChatDockWidget::eventFilter(QObject *obj, QEvent *event)
@@ -185,14 +247,11 @@ bool ChatDockWidget::eventFilter(QObject *obj, QEvent *event)
 void ChatDockWidget::onSendClicked()
 {
     const QString text = input->toPlainText().trimmed();
-    if (text.isEmpty()) return;
+    if (text.isEmpty() || llmManager->isBusy()) return;
 
     input->clear();
     addUserMessage(text);
-    
-    // Check if provider settings changed
-    initProvider(); 
-    
+
     llmManager->sendChatRequest(text);
     startTypingAnimation();
 }
@@ -8,8 +8,10 @@
 #include "src/ui/typingindicatorwidget.h"
 #include "src/ui/chatmessagewidget.h"
 
+class QLabel;
 class QTextEdit;
 class QPushButton;
+class ProviderRegistry;
 
 class ChatDockWidget : public QDockWidget
 {
@@ -30,16 +32,22 @@ private:
     void startTypingAnimation();
     void stopTypingAnimation();
     void initProvider();
+    void loadTokenizer();
+    void updateStats(const RequestMetrics &metrics);
 
 private:
     QVBoxLayout *chatLayout;
     QTextEdit *input;
     QPushButton *sendButton;
+    QPushButton *stopButton;
+    QLabel *statsLabel;
 
     TypingIndicatorWidget *typingIndicator_ = nullptr;
     ChatMessageWidget *currentAssistantBubble = nullptr;
 
     LLMManager *llmManager;
+    ProviderRegistry *providerRegistry = nullptr;
+    QString tokenizerPath;
 };
 
 #endif // CHATDOCKWIDGET_H
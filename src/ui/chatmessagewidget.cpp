@@ -5,6 +5,8 @@
 #include <QTextBrowser>
 #include <QPushButton>
 
+#include "src/core/tracer.h"
+
 ChatMessageWidget::ChatMessageWidget(Role role, const QString &text, QWidget *parent)
     : QFrame(parent), messageText(text)
 {
@@ -68,6 +70,9 @@ void ChatMessageWidget::setText(const QString &text)
 
 void ChatMessageWidget::updateDisplay()
 {
+    TraceSpan span("ui.renderMessage", "ui");
+    span.setArg("chars", messageText.size());
+
     // Simple markdown-to-html-ish conversion for code blocks
     // In a real app we'd use a proper library.
     QString html = messageText;
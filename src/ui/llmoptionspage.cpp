@@ -35,12 +35,20 @@ QWidget *LLMOptionsPage::widget()
     modelEdit = new QLineEdit(s.model());
     apiKeyEdit = new QLineEdit(s.apiKey());
     apiKeyEdit->setEchoMode(QLineEdit::Password);
+    tokenizerPathEdit = new QLineEdit(s.tokenizerPath());
+    tokenizerPathEdit->setPlaceholderText("e.g. cl100k_base.tiktoken or tokenizer.vocab");
+    embeddingUrlEdit = new QLineEdit(s.embeddingUrl());
+    embeddingModelEdit = new QLineEdit(s.embeddingModel());
+    embeddingModelEdit->setPlaceholderText("Ollama embedding model, empty to disable semantic search");
 
     auto layout = new QFormLayout(widget_);
     layout->addRow("Provider:", providerCombo);
     layout->addRow("Base URL:", baseUrlEdit);
     layout->addRow("Model:", modelEdit);
     layout->addRow("API Key:", apiKeyEdit);
+    layout->addRow("Tokenizer:", tokenizerPathEdit);
+    layout->addRow("Embedding URL:", embeddingUrlEdit);
+    layout->addRow("Embedding model:", embeddingModelEdit);
 
     return widget_;
 }
@@ -52,6 +60,9 @@ void LLMOptionsPage::apply()
     s.setBaseUrl(baseUrlEdit->text());
     s.setModel(modelEdit->text());
     s.setApiKey(apiKeyEdit->text());
+    s.setTokenizerPath(tokenizerPathEdit->text().trimmed());
+    s.setEmbeddingUrl(embeddingUrlEdit->text().trimmed());
+    s.setEmbeddingModel(embeddingModelEdit->text().trimmed());
     s.save();
 }
 
@@ -25,6 +25,9 @@ private:
     QLineEdit *baseUrlEdit;
     QLineEdit *modelEdit;
     QLineEdit *apiKeyEdit;
+    QLineEdit *tokenizerPathEdit;
+    QLineEdit *embeddingUrlEdit;
+    QLineEdit *embeddingModelEdit;
     QWidget *widget_ = nullptr;
 };
 
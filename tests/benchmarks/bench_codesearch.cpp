@@ -0,0 +1,120 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include "src/core/codesearch.h"
+#include "src/core/trigramindex.h"
+
+// search_code latency on a generated tree.
+//
+// Set QLP_SEARCH_ROOT to a real checkout for representative numbers, otherwise
+// a tree of QLP_SEARCH_FILES (default 10000) source files is generated from this
+// repository's sources, with an ignored build directory of the same size.
+class CodeSearchBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        m_root = qEnvironmentVariable("QLP_SEARCH_ROOT");
+        if (!m_root.isEmpty())
+            return;
+
+        QVERIFY(m_dir.isValid());
+        m_root = m_dir.path();
+
+        QFile source(QFINDTESTDATA("../../src/core/codesearch.cpp"));
+        QVERIFY(source.open(QIODevice::ReadOnly));
+        const QByteArray code = source.readAll();
+
+        const int fileCount = qEnvironmentVariableIntValue("QLP_SEARCH_FILES") > 0
+                                  ? qEnvironmentVariableIntValue("QLP_SEARCH_FILES")
+                                  : 10000;
+        QFile gitignore(m_root + "/.gitignore");
+        QVERIFY(gitignore.open(QIODevice::WriteOnly));
+        gitignore.write("build/\n");
+        gitignore.close();
+
+        for (int i = 0; i < fileCount; ++i) {
+            for (const QString &top : {QString("src"), QString("build")}) {
+                const QString dir = QString("%1/%2/module%3").arg(m_root, top).arg(i / 100);
+                QDir().mkpath(dir);
+                QFile file(QString("%1/file%2.cpp").arg(dir).arg(i));
+                QVERIFY(file.open(QIODevice::WriteOnly));
+                file.write(code);
+                // A handful of files contain the rare identifier.
+                if (i % 1000 == 0)
+                    file.write("\nint rareNeedleIdentifier = 0;\n");
+            }
+        }
+    }
+
+    void literal()
+    {
+        run("rareNeedleIdentifier", false);
+    }
+
+    void common()
+    {
+        run("state", false);
+    }
+
+    void regex()
+    {
+        run("rare\\w+Identifier", true);
+    }
+
+    void indexed()
+    {
+        QElapsedTimer timer;
+        timer.start();
+        TrigramIndex index;
+        index.setProjectPath(m_root);
+        QTRY_VERIFY_WITH_TIMEOUT(index.isReady(), 600000);
+        qInfo().noquote() << QString("index build or load: %1 ms, %2 bytes on disk")
+                                 .arg(timer.elapsed())
+                                 .arg(QFileInfo(TrigramIndex::indexFilePath(m_root)).size());
+
+        for (const QString &pattern : {QString("rareNeedleIdentifier"), QString("state")}) {
+            CodeSearch::Options options;
+            options.pattern = pattern;
+            timer.restart();
+            const auto candidates = index.candidates(pattern, false);
+            const CodeSearch::Result result = CodeSearch::search(m_root, options, candidates);
+            qInfo().noquote() << QString("indexed %1: %2 ms, %3 candidates, %4 matches")
+                                     .arg(pattern)
+                                     .arg(timer.elapsed())
+                                     .arg(candidates ? candidates->size() : -1)
+                                     .arg(result.totalMatches);
+        }
+    }
+
+private:
+    void run(const QString &pattern, bool regex)
+    {
+        CodeSearch::Options options;
+        options.pattern = pattern;
+        options.regex = regex;
+
+        // The first run warms the page cache.
+        CodeSearch::search(m_root, options);
+
+        QElapsedTimer timer;
+        timer.start();
+        const CodeSearch::Result result = CodeSearch::search(m_root, options);
+        const qint64 ms = timer.elapsed();
+        qInfo().noquote() << QString("%1: %2 ms, %3 files searched, %4 matches%5")
+                                 .arg(pattern)
+                                 .arg(ms)
+                                 .arg(result.filesSearched)
+                                 .arg(result.totalMatches)
+                                 .arg(result.truncated ? " (truncated)" : "");
+        QVERIFY(result.errorString.isEmpty());
+    }
+
+    QTemporaryDir m_dir;
+    QString m_root;
+};
+
+QTEST_MAIN(CodeSearchBenchmark)
+#include "bench_codesearch.moc"
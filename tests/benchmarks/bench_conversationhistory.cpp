@@ -0,0 +1,67 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include "src/core/conversationhistory.h"
+#include "src/providers/base/llmprovider.h"
+
+// Request body build time per tool-loop turn: one message is appended and the
+// whole history is sent again. Compares re-encoding the QJsonArray every turn
+// with concatenating the cached bytes of each message.
+class ConversationHistoryBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void buildBody_data()
+    {
+        QTest::addColumn<int>("messages");
+        QTest::newRow("10") << 10;
+        QTest::newRow("100") << 100;
+        QTest::newRow("500") << 500;
+        QTest::newRow("2000") << 2000;
+    }
+
+    void buildBody()
+    {
+        QFETCH(int, messages);
+
+        // Tool results of ~2 KB are typical for read_file / list_directory.
+        const QString content = QString("line of source code with \"quotes\" and \\ escapes\n").repeated(40);
+        const QJsonObject fields{{"model", "qwen2.5-coder"}, {"stream", true}};
+
+        ConversationHistory history;
+        history.addMessage(Message::System, content);
+        for (int i = 1; i < messages; ++i)
+            history.addMessage(i % 2 ? Message::User : Message::Tool, content, QString("call_%1").arg(i));
+
+        const int turns = 20;
+        qint64 legacyNs = 0;
+        qint64 cachedNs = 0;
+        qint64 bytes = 0;
+        QElapsedTimer timer;
+        for (int turn = 0; turn < turns; ++turn) {
+            history.addMessage(Message::Tool, content, QString("turn_%1").arg(turn));
+
+            timer.start();
+            QJsonObject root = fields;
+            root["messages"] = history.toJsonArray();
+            const QByteArray legacy = QJsonDocument(root).toJson();
+            legacyNs += timer.nsecsElapsed();
+
+            timer.start();
+            const QByteArray cached = LLMProvider::buildRequestBody(fields, history.toJsonBytes());
+            cachedNs += timer.nsecsElapsed();
+
+            QVERIFY(!legacy.isEmpty() && !cached.isEmpty());
+            bytes = cached.size();
+        }
+
+        qInfo().noquote() << QString("%1 messages (%2 KB): toJsonArray+toJson %3 us/turn, cached bytes %4 us/turn")
+                                 .arg(messages)
+                                 .arg(bytes / 1024)
+                                 .arg(legacyNs / turns / 1000)
+                                 .arg(cachedNs / turns / 1000);
+    }
+};
+
+QTEST_MAIN(ConversationHistoryBenchmark)
+#include "bench_conversationhistory.moc"
@@ -0,0 +1,223 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include "src/rag/hnswindex.h"
+#include "src/rag/vectorkernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// semantic_search query latency and recall@10 on a memory-mapped HnswIndex.
+//
+// QLP_HNSW_VECTORS (default 100000) vectors of QLP_HNSW_DIMENSIONS (default 768,
+// nomic-embed-text) are generated around a thousand cluster centres, which is
+// closer to real embeddings than uniform noise. The index is built with float
+// and with int8 vectors, saved, loaded through a mapping and queried with
+// vectors from the same distribution.
+class HnswBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        m_count = qEnvironmentVariableIntValue("QLP_HNSW_VECTORS") > 0
+                      ? qEnvironmentVariableIntValue("QLP_HNSW_VECTORS")
+                      : 100000;
+        m_dimensions = qEnvironmentVariableIntValue("QLP_HNSW_DIMENSIONS") > 0
+                           ? qEnvironmentVariableIntValue("QLP_HNSW_DIMENSIONS")
+                           : 768;
+        m_vectors = generate(m_count, 1);
+        m_queries = generate(QueryCount, 2);
+        qInfo().noquote() << "kernels:" << VectorKernels::name(VectorKernels::instructionSet());
+
+        QVERIFY(m_dir.isValid());
+        for (const bool quantize : {false, true}) {
+            QElapsedTimer timer;
+            timer.start();
+            HnswIndex::Options options;
+            options.quantize = quantize;
+            HnswIndex index(m_dimensions, options);
+            for (int i = 0; i < m_count; ++i)
+                index.add(quint64(i), m_vectors.data() + size_t(i) * m_dimensions);
+
+            QString error;
+            QVERIFY2(index.save(path(quantize), &error), qPrintable(error));
+            // What a search walks over: the vectors or codes of the graph, the links.
+            // The floats of an int8 index are read for the ef candidates only.
+            const qint64 size = QFileInfo(path(quantize)).size();
+            const qint64 floats = qint64(m_count) * m_dimensions * sizeof(float);
+            const qint64 walked = quantize ? size - floats : size;
+            qInfo().noquote() << QString("%1: built in %2 s, file %3 MB, %4 MB walked by searches (%5 bytes per vector)")
+                                     .arg(quantize ? "int8" : "float")
+                                     .arg(timer.elapsed() / 1000.0, 0, 'f', 1)
+                                     .arg(size / (1024.0 * 1024.0), 0, 'f', 1)
+                                     .arg(walked / (1024.0 * 1024.0), 0, 'f', 1)
+                                     .arg(walked / m_count);
+        }
+
+        // Exact neighbours of the recall queries, normalized dot products by brute force.
+        std::vector<float> vectors = m_vectors;
+        normalize(&vectors);
+        std::vector<float> queries(m_queries.begin(), m_queries.begin() + size_t(RecallQueries) * m_dimensions);
+        normalize(&queries);
+        for (int q = 0; q < RecallQueries; ++q) {
+            std::vector<std::pair<float, quint64>> scored(m_count);
+            for (int i = 0; i < m_count; ++i) {
+                float dot = 0;
+                for (int d = 0; d < m_dimensions; ++d)
+                    dot += vectors[size_t(i) * m_dimensions + d] * queries[size_t(q) * m_dimensions + d];
+                scored[i] = {-dot, quint64(i)};
+            }
+            std::partial_sort(scored.begin(), scored.begin() + 10, scored.end());
+            QList<quint64> labels;
+            for (int i = 0; i < 10; ++i)
+                labels.append(scored[i].second);
+            m_exact.append(labels);
+        }
+    }
+
+    void query_data()
+    {
+        QTest::addColumn<bool>("quantize");
+        QTest::addColumn<int>("ef");
+        for (const bool quantize : {false, true}) {
+            for (const int ef : {32, 64, 128})
+                QTest::addRow("%s ef=%d", quantize ? "int8" : "float", ef) << quantize << ef;
+        }
+    }
+
+    void query()
+    {
+        QFETCH(bool, quantize);
+        QFETCH(int, ef);
+        QString error;
+        const auto index = HnswIndex::load(path(quantize), &error);
+        QVERIFY2(index, qPrintable(error));
+
+        // Warms the page cache, as a long-running session would have.
+        for (int q = 0; q < QueryCount; ++q)
+            index->search(m_queries.data() + size_t(q) * m_dimensions, 10, ef);
+
+        std::vector<qint64> latencies;
+        QElapsedTimer timer;
+        for (int q = 0; q < QueryCount; ++q) {
+            timer.start();
+            index->search(m_queries.data() + size_t(q) * m_dimensions, 10, ef);
+            latencies.push_back(timer.nsecsElapsed());
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        int found = 0;
+        for (int q = 0; q < RecallQueries; ++q) {
+            for (const auto &hit : index->search(m_queries.data() + size_t(q) * m_dimensions, 10, ef))
+                found += m_exact[q].contains(hit.label);
+        }
+
+        const double p50 = latencies[latencies.size() / 2] / 1e6;
+        const double p99 = latencies[latencies.size() * 99 / 100] / 1e6;
+        qInfo().noquote() << QString("%1 ef %2: p50 %3 ms, p99 %4 ms, recall@10 %5")
+                                 .arg(quantize ? "int8" : "float")
+                                 .arg(ef)
+                                 .arg(p50, 0, 'f', 3)
+                                 .arg(p99, 0, 'f', 3)
+                                 .arg(double(found) / (RecallQueries * 10), 0, 'f', 3);
+        if (m_count <= 100000)
+            QVERIFY2(p50 < 10.0, "top-10 over 100k vectors should take under 10 ms");
+    }
+
+    // The distance kernels on their own, every instruction set the CPU has.
+    void kernels_data()
+    {
+        QTest::addColumn<int>("set");
+        for (const auto set : {VectorKernels::Scalar, VectorKernels::Sse41, VectorKernels::Avx2}) {
+            if (VectorKernels::isSupported(set))
+                QTest::newRow(qPrintable(VectorKernels::name(set))) << int(set);
+        }
+    }
+
+    void kernels()
+    {
+        QFETCH(int, set);
+        const VectorKernels::InstructionSet previous = VectorKernels::instructionSet();
+        QVERIFY(VectorKernels::setInstructionSet(VectorKernels::InstructionSet(set)));
+
+        const int count = std::min(m_count, 10000);
+        std::vector<qint8> codes(size_t(count) * m_dimensions);
+        std::vector<float> scales(count);
+        for (int i = 0; i < count; ++i)
+            VectorKernels::quantize(m_vectors.data() + size_t(i) * m_dimensions, m_dimensions,
+                                    codes.data() + size_t(i) * m_dimensions, &scales[i]);
+
+        float sink = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < count; ++i)
+            sink += VectorKernels::dot(m_queries.data(), m_vectors.data() + size_t(i) * m_dimensions, m_dimensions);
+        const qint64 floatNs = timer.nsecsElapsed();
+        timer.start();
+        for (int i = 0; i < count; ++i)
+            sink += scales[i] * VectorKernels::dotInt8(m_queries.data(), codes.data() + size_t(i) * m_dimensions, m_dimensions);
+        const qint64 int8Ns = timer.nsecsElapsed();
+        VectorKernels::setInstructionSet(previous);
+        QVERIFY(std::isfinite(sink));   // Keeps the loops from being optimized away.
+
+        qInfo().noquote() << QString("%1: float %2 ns, int8 %3 ns per distance")
+                                 .arg(VectorKernels::name(VectorKernels::InstructionSet(set)))
+                                 .arg(double(floatNs) / count, 0, 'f', 1)
+                                 .arg(double(int8Ns) / count, 0, 'f', 1);
+    }
+
+private:
+    static constexpr int QueryCount = 1000;
+    static constexpr int RecallQueries = 100;
+    static constexpr int Clusters = 1000;
+
+    QString path(bool quantize) const
+    {
+        return m_dir.filePath(quantize ? "int8.hnsw" : "float.hnsw");
+    }
+
+    std::vector<float> generate(int count, unsigned seed) const
+    {
+        // The same centres for vectors and queries, different noise.
+        std::mt19937 centreRandom(42);
+        std::normal_distribution<float> normal;
+        std::vector<float> centres(size_t(Clusters) * m_dimensions);
+        for (float &value : centres)
+            value = normal(centreRandom);
+
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<int> cluster(0, Clusters - 1);
+        std::vector<float> vectors(size_t(count) * m_dimensions);
+        for (int i = 0; i < count; ++i) {
+            const float *centre = centres.data() + size_t(cluster(random)) * m_dimensions;
+            for (int d = 0; d < m_dimensions; ++d)
+                vectors[size_t(i) * m_dimensions + d] = centre[d] + 0.5f * normal(random);
+        }
+        return vectors;
+    }
+
+    void normalize(std::vector<float> *vectors) const
+    {
+        for (size_t offset = 0; offset < vectors->size(); offset += m_dimensions) {
+            double norm = 0;
+            for (int d = 0; d < m_dimensions; ++d)
+                norm += double((*vectors)[offset + d]) * (*vectors)[offset + d];
+            const float scale = float(1.0 / std::sqrt(norm));
+            for (int d = 0; d < m_dimensions; ++d)
+                (*vectors)[offset + d] *= scale;
+        }
+    }
+
+    int m_count = 0;
+    int m_dimensions = 0;
+    std::vector<float> m_vectors;
+    std::vector<float> m_queries;
+    QList<QList<quint64>> m_exact;
+    QTemporaryDir m_dir;
+};
+
+QTEST_MAIN(HnswBenchmark)
+#include "bench_hnsw.moc"
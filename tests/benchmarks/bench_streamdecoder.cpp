@@ -0,0 +1,59 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include "src/providers/base/streamdecoder.h"
+
+// Measures StreamDecoder throughput on a synthetic OpenAI-style stream that is
+// delivered in chunks of the size a local server typically produces.
+class StreamDecoderBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        const QByteArray event =
+            "data: {\"id\":\"chatcmpl-1\",\"object\":\"chat.completion.chunk\",\"choices\":"
+            "[{\"index\":0,\"delta\":{\"content\":\"token \\u00e9\\u4e2d\"}}]}\n\n";
+        while (m_stream.size() < 16 * 1024 * 1024)
+            m_stream += event;
+    }
+
+    void throughput_data()
+    {
+        QTest::addColumn<int>("chunkSize");
+        QTest::newRow("64B") << 64;
+        QTest::newRow("1KiB") << 1024;
+        QTest::newRow("16KiB") << 16 * 1024;
+    }
+
+    void throughput()
+    {
+        QFETCH(int, chunkSize);
+
+        QList<QByteArray> chunks;
+        for (qsizetype i = 0; i < m_stream.size(); i += chunkSize)
+            chunks.append(m_stream.mid(i, chunkSize));
+
+        qint64 events = 0;
+        QElapsedTimer timer;
+        timer.start();
+        StreamDecoder decoder;
+        for (const auto &chunk : std::as_const(chunks))
+            events += decoder.feed(chunk).size();
+        events += decoder.finish().size();
+        const qint64 ns = timer.nsecsElapsed();
+
+        const double mbPerSec = (m_stream.size() / (1024.0 * 1024.0)) / (ns / 1e9);
+        qInfo().noquote() << QString("chunk %1 B: %2 MB/s, %3 events")
+                                 .arg(chunkSize)
+                                 .arg(mbPerSec, 0, 'f', 1)
+                                 .arg(events);
+        QVERIFY(events > 0);
+    }
+
+private:
+    QByteArray m_stream;
+};
+
+QTEST_MAIN(StreamDecoderBenchmark)
+#include "bench_streamdecoder.moc"
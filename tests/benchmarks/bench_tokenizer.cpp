@@ -0,0 +1,93 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include "src/core/tokenizer.h"
+
+// Tokenizer throughput in tokens/sec on source code.
+//
+// Set QLP_TOKENIZER_FILE to a real vocabulary (e.g. cl100k_base.tiktoken) for
+// representative numbers. Without it, a vocabulary is derived from the corpus:
+// every byte plus the 2-4 byte prefixes of every pre-tokenized piece, so longer
+// identifiers still go through the merge loop.
+class TokenizerBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QFile source(QFINDTESTDATA("../../src/core/tokenizer.cpp"));
+        QVERIFY(source.open(QIODevice::ReadOnly));
+        const QString code = QString::fromUtf8(source.readAll());
+        while (m_corpus.size() < 2 * 1024 * 1024)
+            m_corpus += code;
+
+        const QString vocabFile = qEnvironmentVariable("QLP_TOKENIZER_FILE");
+        if (!vocabFile.isEmpty()) {
+            QString error;
+            QVERIFY2(m_tokenizer.load(vocabFile, &error), qPrintable(error));
+            return;
+        }
+
+        QSet<QByteArray> prefixes;
+        const QByteArray utf8 = code.toUtf8();
+        for (const QByteArrayView piece : Tokenizer::preTokenize(utf8)) {
+            for (qsizetype length = 2; length <= qMin<qsizetype>(piece.size(), 4); ++length)
+                prefixes.insert(piece.first(length).toByteArray());
+        }
+        QList<QByteArray> sorted(prefixes.cbegin(), prefixes.cend());
+        // Shorter tokens merge first, so every prefix is reachable.
+        std::sort(sorted.begin(), sorted.end(), [](const QByteArray &a, const QByteArray &b) {
+            return a.size() != b.size() ? a.size() < b.size() : a < b;
+        });
+
+        QByteArray vocab;
+        int rank = 0;
+        for (int b = 0; b < 256; ++b)
+            vocab += QByteArray(1, char(b)).toBase64() + ' ' + QByteArray::number(rank++) + '\n';
+        for (const auto &token : std::as_const(sorted))
+            vocab += token.toBase64() + ' ' + QByteArray::number(rank++) + '\n';
+        QVERIFY(m_tokenizer.loadTiktoken(vocab));
+    }
+
+    void preTokenize()
+    {
+        const QByteArray utf8 = m_corpus.toUtf8();
+        QElapsedTimer timer;
+        timer.start();
+        const qsizetype pieces = Tokenizer::preTokenize(utf8).size();
+        const qint64 ns = timer.nsecsElapsed();
+        qInfo().noquote() << QString("pre-tokenize: %1 MB/s, %2 pieces")
+                                 .arg((utf8.size() / (1024.0 * 1024.0)) / (ns / 1e9), 0, 'f', 1)
+                                 .arg(pieces);
+    }
+
+    void countTokens()
+    {
+        QElapsedTimer timer;
+        timer.start();
+        const int tokens = m_tokenizer.countTokens(m_corpus);
+        const qint64 ns = timer.nsecsElapsed();
+        qInfo().noquote() << QString("countTokens: %1 tokens/s (%2 tokens, %3 chars/token)")
+                                 .arg(qint64(tokens / (ns / 1e9)))
+                                 .arg(tokens)
+                                 .arg(double(m_corpus.size()) / tokens, 0, 'f', 2);
+        QVERIFY(tokens > 0);
+    }
+
+    void encode()
+    {
+        QElapsedTimer timer;
+        timer.start();
+        const QList<int> ids = m_tokenizer.encode(m_corpus);
+        const qint64 ns = timer.nsecsElapsed();
+        qInfo().noquote() << QString("encode: %1 tokens/s").arg(qint64(ids.size() / (ns / 1e9)));
+        QCOMPARE(QString::fromUtf8(m_tokenizer.decode(ids)), m_corpus);
+    }
+
+private:
+    QString m_corpus;
+    Tokenizer m_tokenizer;
+};
+
+QTEST_MAIN(TokenizerBenchmark)
+#include "bench_tokenizer.moc"
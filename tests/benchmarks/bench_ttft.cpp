@@ -0,0 +1,115 @@
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QHttpServer>
+#include <QHttpServerResponse>
+#include <QProcess>
+#include <QSslCertificate>
+#include <QSslConfiguration>
+#include <QSslKey>
+#include <QSslServer>
+#include <QTemporaryDir>
+#include "src/providers/openai/openaiprovider.h"
+
+// Time-to-first-token against a local TLS stand-in for a remote endpoint, with a
+// cold provider versus one that was warmed up while the user was "typing".
+class TtftBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        // A throwaway self-signed certificate, so no private key lives in the repository.
+        QVERIFY(m_certDir.isValid());
+        const QString certPath = m_certDir.filePath("localhost.crt");
+        const QString keyPath = m_certDir.filePath("localhost.key");
+        QProcess openssl;
+        openssl.start("openssl", {"req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "1",
+                                  "-subj", "/CN=localhost", "-addext", "subjectAltName=DNS:localhost",
+                                  "-keyout", keyPath, "-out", certPath});
+        if (!openssl.waitForStarted())
+            QSKIP("openssl is needed to create the server certificate");
+        QVERIFY(openssl.waitForFinished(30000));
+        QCOMPARE(openssl.exitCode(), 0);
+
+        QFile certFile(certPath);
+        QFile keyFile(keyPath);
+        QVERIFY(certFile.open(QIODevice::ReadOnly));
+        QVERIFY(keyFile.open(QIODevice::ReadOnly));
+        const QSslCertificate cert(&certFile, QSsl::Pem);
+        const QSslKey key(&keyFile, QSsl::Rsa, QSsl::Pem);
+
+        QSslConfiguration serverConfig = QSslConfiguration::defaultConfiguration();
+        serverConfig.setLocalCertificate(cert);
+        serverConfig.setPrivateKey(key);
+        serverConfig.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP2, QSslConfiguration::NextProtocolHttp1_1});
+        m_sslServer.setSslConfiguration(serverConfig);
+
+        // Clients trust the self-signed certificate.
+        QSslConfiguration clientConfig = QSslConfiguration::defaultConfiguration();
+        clientConfig.addCaCertificate(cert);
+        QSslConfiguration::setDefaultConfiguration(clientConfig);
+
+        m_httpServer.route("/v1/chat/completions", []() {
+            return QHttpServerResponse("data: {\"choices\":[{\"delta\":{\"content\":\"Hi\"}}]}\n\ndata: [DONE]\n\n",
+                                       QHttpServerResponse::StatusCode::Ok);
+        });
+        QVERIFY(m_sslServer.listen(QHostAddress::LocalHost));
+        QVERIFY(m_httpServer.bind(&m_sslServer));
+        m_baseUrl = QString("https://localhost:%1/v1").arg(m_sslServer.serverPort());
+    }
+
+    void timeToFirstToken_data()
+    {
+        QTest::addColumn<bool>("warmUp");
+        QTest::newRow("cold") << false;
+        QTest::newRow("pre-connected") << true;
+    }
+
+    void timeToFirstToken()
+    {
+        QFETCH(bool, warmUp);
+
+        const int runs = 10;
+        QList<qint64> samples;
+        for (int i = 0; i < runs; ++i) {
+            // A fresh provider has a fresh QNetworkAccessManager, i.e. no cached connection.
+            OpenAIProvider provider;
+            provider.setBaseUrl(m_baseUrl);
+            if (warmUp) {
+                provider.warmUp();
+                QTest::qWait(200); // The user is still typing.
+            }
+
+            qint64 ttftUs = -1;
+            bool finished = false;
+            QElapsedTimer timer;
+            connect(&provider, &OpenAIProvider::partialResponse, this, [&](const QString &) {
+                if (ttftUs < 0) ttftUs = timer.nsecsElapsed() / 1000;
+            });
+            connect(&provider, &OpenAIProvider::requestFinished, this, [&]() { finished = true; });
+
+            timer.start();
+            provider.sendChatRequest(QJsonArray{QJsonObject{{"role", "user"}, {"content", "hi"}}}, true);
+            QTRY_VERIFY_WITH_TIMEOUT(finished, 5000);
+            QVERIFY(ttftUs >= 0);
+            samples.append(ttftUs);
+        }
+
+        std::sort(samples.begin(), samples.end());
+        qInfo().noquote() << QString("%1: median TTFT %2 us (min %3 us, max %4 us)")
+                                 .arg(QTest::currentDataTag())
+                                 .arg(samples[runs / 2])
+                                 .arg(samples.first())
+                                 .arg(samples.last());
+    }
+
+private:
+    QTemporaryDir m_certDir;
+    QSslServer m_sslServer;
+    QHttpServer m_httpServer;
+    QString m_baseUrl;
+};
+
+QTEST_MAIN(TtftBenchmark)
+#include "bench_ttft.moc"
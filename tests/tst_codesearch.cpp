@@ -0,0 +1,186 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "../src/core/codesearch.h"
+#include "../src/core/gitignore.h"
+
+class TestCodeSearch : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void writeFile(const QString &path, const QByteArray &content) {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(content);
+    }
+
+    static QStringList matchedFiles(const QString &root, const CodeSearch::Result &result) {
+        QStringList files;
+        for (const auto &match : result.matches) {
+            const QString relative = QDir(root).relativeFilePath(match.filePath);
+            if (!files.contains(relative))
+                files << relative;
+        }
+        files.sort();
+        return files;
+    }
+
+private slots:
+    void testGlobMatch_data() {
+        QTest::addColumn<QString>("pattern");
+        QTest::addColumn<QString>("path");
+        QTest::addColumn<bool>("matches");
+
+        QTest::newRow("star") << "*.o" << "main.o" << true;
+        QTest::newRow("star stops at slash") << "src/*.o" << "src/a/main.o" << false;
+        QTest::newRow("question mark") << "file?.txt" << "file1.txt" << true;
+        QTest::newRow("class") << "file[0-9].txt" << "filex.txt" << false;
+        QTest::newRow("negated class") << "file[!0-9].txt" << "filex.txt" << true;
+        QTest::newRow("leading double star") << "**/build" << "a/b/build" << true;
+        QTest::newRow("double star at root") << "**/build" << "build" << true;
+        QTest::newRow("middle double star") << "a/**/b" << "a/x/y/b" << true;
+        QTest::newRow("middle double star empty") << "a/**/b" << "a/b" << true;
+        QTest::newRow("trailing double star") << "logs/**" << "logs/a/b.txt" << true;
+        QTest::newRow("escaped") << "\\*.txt" << "*.txt" << true;
+    }
+
+    void testGlobMatch() {
+        QFETCH(QString, pattern);
+        QFETCH(QString, path);
+        QFETCH(bool, matches);
+        QCOMPARE(GitIgnore::globMatch(pattern, path), matches);
+    }
+
+    void testGitIgnoreRules() {
+        auto root = std::make_shared<GitIgnore>();
+        root->addPatterns("# comment\n*.log\nbuild/\n/only-root.txt\n!keep.log\n");
+        QVERIFY(root->isIgnored("a.log", false));
+        QVERIFY(root->isIgnored("deep/dir/a.log", false));
+        QVERIFY(!root->isIgnored("keep.log", false));
+        QVERIFY(root->isIgnored("build", true));
+        QVERIFY(!root->isIgnored("build", false));
+        QVERIFY(root->isIgnored("only-root.txt", false));
+        QVERIFY(!root->isIgnored("sub/only-root.txt", false));
+
+        // A nested file overrides its parents for paths below it.
+        GitIgnore nested(root, "sub");
+        nested.addPatterns("!*.log\n");
+        QVERIFY(!nested.isIgnored("sub/a.log", false));
+        QVERIFY(nested.isIgnored("other/a.log", false));
+    }
+
+    void testSubstringMatcher() {
+        const QByteArray text = "The quick brown Fox jumps over the lazy fox";
+        SubstringMatcher sensitive("fox", true);
+        QCOMPARE(sensitive.indexIn(text), text.lastIndexOf("fox"));
+        SubstringMatcher insensitive("FOX", false);
+        QCOMPARE(insensitive.indexIn(text), text.indexOf("Fox"));
+        QCOMPARE(insensitive.indexIn(text, text.indexOf("Fox") + 1), text.lastIndexOf("fox"));
+        QCOMPARE(SubstringMatcher("cat", false).indexIn(text), -1);
+        QCOMPARE(SubstringMatcher("x", true).indexIn("x"), 0);
+    }
+
+    void testTreePaths() {
+        const QDir root("/project");
+        QCOMPARE(CodeSearch::relativeTreePath(root, "/project/src/./a.cpp").value_or(QString()), QString("src/a.cpp"));
+        QVERIFY(!CodeSearch::relativeTreePath(root, "/other/a.cpp"));
+        QVERIFY(!CodeSearch::relativeTreePath(root, "/project/.git/config"));
+        QCOMPARE(CodeSearch::parentDirectory("src/core/a.cpp"), QString("src/core"));
+        QCOMPARE(CodeSearch::parentDirectory("a.cpp"), QString());
+
+        QVERIFY(!CodeSearch::isBinary(QByteArrayView("text\n")));
+        QVERIFY(CodeSearch::isBinary(QByteArray("a\0b", 3)));
+        QVERIFY(!CodeSearch::isBinary(QByteArray(CodeSearch::BinaryProbeSize, 'x') + '\0'));
+    }
+
+    void testSearchHonorsIgnoresAndBinaries() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString root = dir.path();
+        writeFile(root + "/.gitignore", "build/\n*.gen.cpp\n");
+        writeFile(root + "/src/main.cpp", "int main() { return needle(); }\n");
+        writeFile(root + "/src/util.gen.cpp", "needle\n");
+        writeFile(root + "/build/out.cpp", "needle\n");
+        writeFile(root + "/.git/config", "needle\n");
+        writeFile(root + "/data.bin", QByteArray("needle\0\1\2", 9));
+        writeFile(root + "/lib/.gitignore", "!*.gen.cpp\n");
+        writeFile(root + "/lib/keep.gen.cpp", "void needle();\n");
+
+        CodeSearch::Options options;
+        options.pattern = "needle";
+        const CodeSearch::Result result = CodeSearch::search(root, options);
+        QVERIFY(result.errorString.isEmpty());
+        QCOMPARE(matchedFiles(root, result), QStringList({"lib/keep.gen.cpp", "src/main.cpp"}));
+        QCOMPARE(result.totalMatches, 2);
+    }
+
+    void testSearchLinesAndContext() {
+        QTemporaryDir dir;
+        const QString root = dir.path();
+        writeFile(root + "/a.cpp", "one\r\ntwo\r\nthree Target\r\nfour\r\nfive\r\nsix\r\n");
+
+        CodeSearch::Options options;
+        options.pattern = "target";
+        options.contextLines = 2;
+        CodeSearch::Result result = CodeSearch::search(root, options);
+        QCOMPARE(result.matches.size(), 1);
+        const CodeSearch::Match &match = result.matches.first();
+        QCOMPARE(match.line, 3);
+        QCOMPARE(match.column, 7);
+        QCOMPARE(match.text, QString("three Target"));
+        QCOMPARE(match.before, QStringList({"one", "two"}));
+        QCOMPARE(match.after, QStringList({"four", "five"}));
+
+        options.caseSensitive = true;
+        QCOMPARE(CodeSearch::search(root, options).totalMatches, 0);
+    }
+
+    void testRegexSearch() {
+        QTemporaryDir dir;
+        const QString root = dir.path();
+        writeFile(root + "/a.cpp", "int foo1;\nint bar;\nint foo22;\n");
+
+        CodeSearch::Options options;
+        options.pattern = "foo\\d+";
+        options.regex = true;
+        CodeSearch::Result result = CodeSearch::search(root, options);
+        QCOMPARE(result.totalMatches, 2);
+        QList<int> lines;
+        for (const auto &match : result.matches)
+            lines << match.line;
+        std::sort(lines.begin(), lines.end());
+        QCOMPARE(lines, QList<int>({1, 3}));
+
+        options.pattern = "foo(";
+        QVERIFY(!CodeSearch::search(root, options).errorString.isEmpty());
+    }
+
+    void testRankingAndCap() {
+        QTemporaryDir dir;
+        const QString root = dir.path();
+        QByteArray uses;
+        for (int i = 0; i < 30; ++i)
+            uses += "auto w" + QByteArray::number(i) + " = new Widgetish();\n";
+        writeFile(root + "/uses.cpp", uses);
+        writeFile(root + "/widget.h", "class Widget\n{\n};\n");
+
+        CodeSearch::Options options;
+        options.pattern = "Widget";
+        options.maxResults = 5;
+        options.fileGlob = "*.h";
+        CodeSearch::Result result = CodeSearch::search(root, options);
+        QCOMPARE(result.totalMatches, 1);
+
+        options.fileGlob.clear();
+        result = CodeSearch::search(root, options);
+        QCOMPARE(result.matches.size(), 5);
+        QCOMPARE(result.totalMatches, 31);
+        // The whole-word definition in widget.h ranks above the partial uses.
+        QCOMPARE(QFileInfo(result.matches.first().filePath).fileName(), QString("widget.h"));
+        QCOMPARE(result.matches.first().line, 1);
+    }
+};
+
+QTEST_MAIN(TestCodeSearch)
+#include "tst_codesearch.moc"
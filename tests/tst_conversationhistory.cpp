@@ -25,6 +25,31 @@ private slots:
         QCOMPARE(arr[1].toObject()["role"].toString(), QString("user"));
     }
 
+    void testToJsonBytes() {
+        ConversationHistory history;
+        QCOMPARE(history.toJsonBytes(), QByteArray("[]"));
+
+        history.addMessage(Message::System, "System prompt");
+        history.addMessage(Message::User, "Quote \" and ü");
+        QCOMPARE(history.toJsonBytes(), QJsonDocument(history.toJsonArray()).toJson(QJsonDocument::Compact));
+
+        // Appended messages extend the cached bytes.
+        QJsonArray toolCalls{QJsonObject{{"id", "call_1"}, {"type", "function"}}};
+        history.addMessage(Message::Assistant, QString(), QString(), toolCalls);
+        history.addMessage(Message::Tool, "{\"files\":[]}", "call_1");
+        QCOMPARE(history.toJsonBytes(), QJsonDocument(history.toJsonArray()).toJson(QJsonDocument::Compact));
+
+        const QJsonArray withoutSystem = QJsonDocument::fromJson(history.toJsonBytes(false)).array();
+        QCOMPARE(withoutSystem.size(), 3);
+        QCOMPARE(withoutSystem[0].toObject()["role"].toString(), QString("user"));
+
+        // Removing messages rebuilds the cache.
+        history.trim(25);
+        QCOMPARE(history.toJsonBytes(), QJsonDocument(history.toJsonArray()).toJson(QJsonDocument::Compact));
+        history.clear();
+        QCOMPARE(history.toJsonBytes(false), QByteArray("[]"));
+    }
+
     void testEstimateTokenCount() {
         ConversationHistory history;
         history.addMessage(Message::User, "12345678"); // 8 chars -> ~2 tokens + 10 overhead = 12
@@ -46,6 +71,130 @@ private slots:
         QCOMPARE(history.messages()[0].role, Message::System);
         QCOMPARE(history.messages()[1].content, QString("User 2"));
     }
+
+    void testRunningTokenCount() {
+        ConversationHistory history;
+        int expected = 0;
+        for (int i = 0; i < 50; ++i) {
+            const QString content(i * 7, 'x');
+            history.addMessage(i % 3 ? Message::User : Message::Tool, content);
+            expected += content.length() / 4 + 10;
+        }
+        QCOMPARE(history.estimateTokenCount(), expected);
+
+        history.trim(expected / 2);
+        int recounted = 0;
+        for (const auto &msg : history.messages())
+            recounted += msg.estimatedTokens();
+        QCOMPARE(history.estimateTokenCount(), recounted);
+        QVERIFY(recounted <= expected / 2);
+
+        history.clear();
+        QCOMPARE(history.estimateTokenCount(), 0);
+    }
+
+    void testContainsToolResult() {
+        ConversationHistory history;
+        history.addMessage(Message::User, "Read it");
+        history.addMessage(Message::Tool, QString(100, 'x'), "call1");
+        history.addMessage(Message::User, "Again");
+        QVERIFY(history.containsToolResult("call1"));
+        QVERIFY(!history.containsToolResult("call2"));
+
+        history.trim(20);
+        QVERIFY(!history.containsToolResult("call1"));
+    }
+    void testTrimMatchesOneByOneEviction_data() {
+        QTest::addColumn<bool>("withSystem");
+        QTest::addColumn<int>("maxTokens");
+        QTest::newRow("system, loose") << true << 500;
+        QTest::newRow("system, tight") << true << 40;
+        QTest::newRow("system, too small") << true << 5;
+        QTest::newRow("no system") << false << 100;
+        QTest::newRow("no system, too small") << false << 1;
+    }
+
+    void testTrimMatchesOneByOneEviction() {
+        QFETCH(bool, withSystem);
+        QFETCH(int, maxTokens);
+
+        QList<Message> reference;
+        ConversationHistory history;
+        if (withSystem) {
+            history.addMessage(Message::System, QString(60, 's'));
+            reference.append(history.messages().last());
+        }
+        for (int i = 0; i < 20; ++i) {
+            history.addMessage(Message::User, QString("message %1 ").arg(i).repeated(i % 5 + 1));
+            reference.append(history.messages().last());
+        }
+
+        // The original algorithm: evict one message at a time.
+        auto estimate = [&reference]() {
+            int count = 0;
+            for (const auto &msg : reference) count += msg.estimatedTokens();
+            return count;
+        };
+        while (estimate() > maxTokens && reference.size() > 1) {
+            if (reference.first().role == Message::System && reference.size() > 2)
+                reference.removeAt(1);
+            else
+                reference.removeFirst();
+        }
+
+        history.trim(maxTokens);
+        QCOMPARE(history.messageCount(), reference.size());
+        for (int i = 0; i < reference.size(); ++i) {
+            QCOMPARE(history.messages()[i].role, reference[i].role);
+            QCOMPARE(history.messages()[i].content, reference[i].content);
+        }
+        QCOMPARE(history.estimateTokenCount(), estimate());
+    }
+
+    void testTokenCounter() {
+        ConversationHistory history;
+        history.addMessage(Message::System, "one two three");
+        history.addMessage(Message::User, "four five");
+        const int estimate = history.estimateTokenCount();
+
+        // A word counter stands in for a real tokenizer.
+        auto words = [](const QString &text) { return int(text.split(' ', Qt::SkipEmptyParts).size()); };
+        history.setTokenCounter(words);
+        QVERIFY(history.hasTokenCounter());
+        // 4 tokens of per-message overhead each.
+        QCOMPARE(history.estimateTokenCount(), 3 + 4 + 2 + 4);
+
+        history.addMessage(Message::User, "six");
+        QCOMPARE(history.estimateTokenCount(), 3 + 4 + 2 + 4 + 1 + 4);
+
+        history.trim(12);
+        QCOMPARE(history.messageCount(), 2);
+        QCOMPARE(history.messages()[1].content, QString("six"));
+        QCOMPARE(history.estimateTokenCount(), 3 + 4 + 1 + 4);
+
+        history.setTokenCounter({});
+        history.clear();
+        history.addMessage(Message::System, "one two three");
+        history.addMessage(Message::User, "four five");
+        QCOMPARE(history.estimateTokenCount(), estimate);
+    }
+
+    void testTrimLongSession() {
+        ConversationHistory history;
+        history.addMessage(Message::System, "System");
+        for (int i = 0; i < 100000; ++i)
+            history.addMessage(Message::Tool, QString("tool result %1").arg(i), QString::number(i));
+
+        QElapsedTimer timer;
+        timer.start();
+        history.trim(32000);
+        // Used to take minutes, one estimate pass per evicted message.
+        QVERIFY2(timer.elapsed() < 1000, qPrintable(QString::number(timer.elapsed())));
+
+        QCOMPARE(history.messages().first().role, Message::System);
+        QVERIFY(history.estimateTokenCount() <= 32000);
+        QCOMPARE(history.messages().last().content, QString("tool result 99999"));
+    }
 };
 
 QTEST_MAIN(TestConversationHistory)
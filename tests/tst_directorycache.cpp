@@ -0,0 +1,83 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "../src/core/directorycache.h"
+
+class TestDirectoryCache : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void writeFile(const QString &path, const QByteArray &content) {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(content);
+    }
+
+    static QStringList names(const DirectoryCache::Listing &listing) {
+        QStringList result;
+        for (const auto &entry : *listing)
+            result << entry.name;
+        return result;
+    }
+
+private slots:
+    void testListingIsCached() {
+        QTemporaryDir dir;
+        writeFile(dir.filePath("b.cpp"), "int b;\n");
+        writeFile(dir.filePath("a.cpp"), "int a;\n");
+        writeFile(dir.filePath(".gitignore"), "build/\n");
+        QDir().mkpath(dir.filePath("src"));
+
+        DirectoryCache cache;
+        const auto listing = cache.entries(dir.path());
+        QVERIFY(listing);
+        QCOMPARE(names(listing), QStringList({".gitignore", "a.cpp", "b.cpp", "src"}));
+        QCOMPARE(listing->at(1).size, qint64(7));
+        QVERIFY(listing->at(3).isDirectory);
+        QCOMPARE(cache.stats().misses, 1);
+
+        // The same listing, also when asked with another spelling of the path.
+        QCOMPARE(cache.entries(dir.path() + "/src/..").get(), listing.get());
+        QCOMPARE(cache.stats().hits, 1);
+        QVERIFY(!cache.entries(dir.filePath("missing")));
+    }
+
+    void testWatcherInvalidates() {
+        QTemporaryDir dir;
+        writeFile(dir.filePath("a.cpp"), "int a;\n");
+
+        DirectoryCache cache;
+        QCOMPARE(cache.entries(dir.path())->size(), 1);
+        QTest::qWait(50);   // The watch is added on the cache's thread.
+        QCOMPARE(cache.size(), 1);
+
+        writeFile(dir.filePath("b.cpp"), "int b;\n");
+        QTRY_COMPARE_WITH_TIMEOUT(cache.size(), 0, 5000);
+        QCOMPARE(names(cache.entries(dir.path())), QStringList({"a.cpp", "b.cpp"}));
+    }
+
+    void testInvalidate() {
+        QTemporaryDir dir;
+        writeFile(dir.filePath("src/a.cpp"), "int a;\n");
+
+        DirectoryCache cache;
+        cache.entries(dir.path());
+        cache.entries(dir.filePath("src"));
+        QCOMPARE(cache.size(), 2);
+
+        // A file drops the listing of its directory, a directory its own and its parent's.
+        cache.invalidate({dir.filePath("src/a.cpp")});
+        QCOMPARE(cache.size(), 1);
+        cache.entries(dir.filePath("src"));
+        cache.invalidate({dir.filePath("src")});
+        QCOMPARE(cache.size(), 0);
+
+        cache.entries(dir.path());
+        cache.clear();
+        QCOMPARE(cache.size(), 0);
+    }
+};
+
+QTEST_MAIN(TestDirectoryCache)
+#include "tst_directorycache.moc"
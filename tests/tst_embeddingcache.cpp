@@ -0,0 +1,122 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "../src/core/contenthash.h"
+#include "../src/rag/embeddingcache.h"
+
+class TestEmbeddingCache : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QList<float> vector(float base, int dimensions = 8) {
+        QList<float> result;
+        for (int i = 0; i < dimensions; ++i)
+            result.append(base + i * 0.25f);
+        return result;
+    }
+
+private slots:
+    void testXxh64() {
+        // Reference values of XXH64 with seed 0.
+        QCOMPARE(ContentHash::xxh64(QByteArrayView("")), Q_UINT64_C(0xef46db3751d8e999));
+        QCOMPARE(ContentHash::xxh64(QByteArrayView("a")), Q_UINT64_C(0xd24ec4f1a98c6e5b));
+        QCOMPARE(ContentHash::xxh64(QByteArrayView("abc")), Q_UINT64_C(0x44bc2cf5ad770999));
+        QCOMPARE(ContentHash::xxh64(QByteArrayView("Nobody inspects the spammish repetition")),
+                 Q_UINT64_C(0xfbcea83c8a378bf1));
+        QCOMPARE(ContentHash::xxh64(QString("abc")), ContentHash::xxh64(QByteArrayView("abc")));
+        QVERIFY(ContentHash::xxh64(QByteArrayView("abc"), 1) != ContentHash::xxh64(QByteArrayView("abc")));
+    }
+
+    void testFindAndInsert() {
+        QTemporaryDir dir;
+        EmbeddingCache cache(dir.path(), "nomic-embed-text:latest");
+        QVERIFY(cache.filePath().startsWith(dir.path()));
+
+        QList<float> found;
+        QVERIFY(!cache.find(1, &found));
+        cache.insert(1, vector(1));
+        cache.insert(2, vector(2));
+        QVERIFY(cache.find(1, &found));
+        QCOMPARE(found, vector(1));   // Exact in half precision.
+        QCOMPARE(cache.size(), 2);
+
+        const EmbeddingCache::Stats stats = cache.stats();
+        QCOMPARE(stats.hits, 1);
+        QCOMPARE(stats.misses, 1);
+        QCOMPARE(stats.hitRate(), 0.5);
+    }
+
+    void testPersistence() {
+        QTemporaryDir dir;
+        {
+            EmbeddingCache cache(dir.path(), "model");
+            for (int i = 0; i < 100; ++i)
+                cache.insert(quint64(i), vector(float(i)));
+        }
+        {
+            // Mapped from the file, and a second instance appending to it.
+            EmbeddingCache cache(dir.path(), "model");
+            EmbeddingCache other(dir.path(), "model");
+            QCOMPARE(cache.size(), 100);
+            QList<float> found;
+            QVERIFY(cache.find(42, &found));
+            QCOMPARE(found, vector(42));
+
+            other.insert(500, vector(5));
+            cache.insert(600, vector(6));
+            QVERIFY(cache.find(600, &found));
+            QCOMPARE(found, vector(6));
+            QVERIFY(!cache.find(500, &found));
+        }
+
+        // A record cut short is dropped, the others survive.
+        QFile file(dir.path() + "/model.emb");
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.resize(file.size() - 3));
+        file.close();
+        EmbeddingCache cache(dir.path(), "model");
+        QList<float> found;
+        QVERIFY(cache.find(500, &found));
+        QVERIFY(!cache.find(600, &found));
+        QCOMPARE(cache.size(), 101);
+    }
+
+    void testDimensionsChange() {
+        QTemporaryDir dir;
+        EmbeddingCache cache(dir.path(), "model");
+        cache.insert(1, vector(1, 8));
+        cache.insert(2, vector(2, 16));
+        QList<float> found;
+        QVERIFY(!cache.find(1, &found));
+        QVERIFY(cache.find(2, &found));
+        QCOMPARE(found.size(), 16);
+
+        // Models do not share entries.
+        EmbeddingCache other(dir.path(), "other-model");
+        QVERIFY(!other.find(2, &found));
+    }
+
+    void testStartingOverKeepsOtherMappings() {
+        QTemporaryDir dir;
+        {
+            EmbeddingCache cache(dir.path(), "model");
+            for (int i = 0; i < 100; ++i)
+                cache.insert(quint64(i), vector(float(i)));
+        }
+
+        // The file is replaced under the mapping of the first instance, not truncated.
+        EmbeddingCache mapped(dir.path(), "model");
+        EmbeddingCache other(dir.path(), "model");
+        other.insert(1000, vector(1, 16));
+        QList<float> found;
+        QVERIFY(mapped.find(42, &found));
+        QCOMPARE(found, vector(42));
+
+        EmbeddingCache reopened(dir.path(), "model");
+        QCOMPARE(reopened.size(), 1);
+        QVERIFY(reopened.find(1000, &found));
+    }
+};
+
+QTEST_MAIN(TestEmbeddingCache)
+#include "tst_embeddingcache.moc"
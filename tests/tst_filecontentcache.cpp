@@ -0,0 +1,103 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "../src/core/filecontentcache.h"
+
+class TestFileContentCache : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void writeFile(const QString &path, const QByteArray &content) {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(content);
+    }
+
+private slots:
+    void testHitsAndMisses() {
+        QTemporaryDir dir;
+        writeFile(dir.filePath("a.cpp"), "int a;\n");
+
+        FileContentCache cache;
+        QByteArray content;
+        QVERIFY(cache.read(dir.filePath("a.cpp"), &content));
+        QCOMPARE(content, QByteArray("int a;\n"));
+        QVERIFY(cache.read(dir.path() + "/./a.cpp", &content));
+        QCOMPARE(content, QByteArray("int a;\n"));
+        QCOMPARE(cache.stats().misses, 1);
+        QCOMPARE(cache.stats().hits, 1);
+        QCOMPARE(cache.stats().files, 1);
+        QCOMPARE(cache.stats().bytes, 7);
+
+        QVERIFY(!cache.read(dir.filePath("missing.cpp"), &content));
+        QVERIFY(!cache.read(dir.path(), &content));
+    }
+
+    void testChangedFileIsReadAgain() {
+        QTemporaryDir dir;
+        writeFile(dir.filePath("a.cpp"), "int a;\n");
+
+        FileContentCache cache;
+        QByteArray content;
+        QVERIFY(cache.read(dir.filePath("a.cpp"), &content));
+
+        // Another size is enough, whether or not the watcher reported it yet.
+        writeFile(dir.filePath("a.cpp"), "int a = 1;\n");
+        QVERIFY(cache.read(dir.filePath("a.cpp"), &content));
+        QCOMPARE(content, QByteArray("int a = 1;\n"));
+        QCOMPARE(cache.stats().misses, 2);
+
+        cache.invalidate({dir.filePath("a.cpp")});
+        QCOMPARE(cache.stats().files, 0);
+    }
+
+    void testWatcherInvalidates() {
+        QTemporaryDir dir;
+        writeFile(dir.filePath("a.cpp"), "int a;\n");
+
+        FileContentCache cache;
+        QByteArray content;
+        QVERIFY(cache.read(dir.filePath("a.cpp"), &content));
+        QTest::qWait(50);   // The watch is added on the cache's thread.
+        QCOMPARE(cache.stats().files, 1);
+
+        // Same size and possibly the same modification time: only the watcher can tell.
+        writeFile(dir.filePath("a.cpp"), "int b;\n");
+        QTRY_COMPARE_WITH_TIMEOUT(cache.stats().files, 0, 5000);
+        QVERIFY(cache.read(dir.filePath("a.cpp"), &content));
+        QCOMPARE(content, QByteArray("int b;\n"));
+    }
+
+    void testLeastRecentlyUsedGoFirst() {
+        QTemporaryDir dir;
+        const QByteArray content(300, 'x');
+        const QStringList names{"a", "b", "c", "d", "e", "f", "g", "h", "i"};
+        for (const QString &name : names)
+            writeFile(dir.filePath(name), content);
+        writeFile(dir.filePath("large"), QByteArray(301, 'x'));
+
+        // Room for eight files of 300 bytes, larger files are not kept at all.
+        FileContentCache cache(8 * 300);
+        QCOMPARE(cache.maxFileBytes(), qint64(300));
+        QByteArray read;
+        QVERIFY(!cache.read(dir.filePath("large"), &read));
+        for (const QString &name : names.first(8))
+            QVERIFY(cache.read(dir.filePath(name), &read));
+        QVERIFY(cache.read(dir.filePath("a"), &read));   // Now b is the least recently used.
+        QCOMPARE(cache.stats().hits, 1);
+        QCOMPARE(cache.stats().files, 8);
+
+        QVERIFY(cache.read(dir.filePath("i"), &read));
+        QCOMPARE(cache.stats().files, 8);
+        QCOMPARE(cache.stats().evictions, 1);
+        QCOMPARE(cache.stats().bytes, 8 * 300);
+        QVERIFY(cache.read(dir.filePath("a"), &read));
+        QCOMPARE(cache.stats().hits, 2);
+        QVERIFY(cache.read(dir.filePath("b"), &read));
+        QCOMPARE(cache.stats().hits, 2);
+        QCOMPARE(cache.stats().misses, 10);
+    }
+};
+
+QTEST_MAIN(TestFileContentCache)
+#include "tst_filecontentcache.moc"
@@ -0,0 +1,198 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "../src/rag/hnswindex.h"
+
+#include <algorithm>
+#include <random>
+
+class TestHnswIndex : public QObject
+{
+    Q_OBJECT
+
+private:
+    static constexpr int Dimensions = 32;
+
+    static std::vector<float> randomVectors(int count, unsigned seed) {
+        std::mt19937 random(seed);
+        std::normal_distribution<float> normal;
+        std::vector<float> vectors(size_t(count) * Dimensions);
+        for (float &value : vectors)
+            value = normal(random);
+        return vectors;
+    }
+
+    // The k labels closest to the query by cosine similarity, by brute force.
+    static QList<quint64> exactNeighbors(const std::vector<float> &vectors, const float *query, int k) {
+        QList<QPair<float, quint64>> scored;
+        const int count = int(vectors.size() / Dimensions);
+        for (int i = 0; i < count; ++i) {
+            const float *vector = vectors.data() + size_t(i) * Dimensions;
+            float dot = 0, norm = 0, queryNorm = 0;
+            for (int d = 0; d < Dimensions; ++d) {
+                dot += vector[d] * query[d];
+                norm += vector[d] * vector[d];
+                queryNorm += query[d] * query[d];
+            }
+            scored.append({-dot / std::sqrt(norm * queryNorm), quint64(i)});
+        }
+        std::sort(scored.begin(), scored.end());
+        QList<quint64> labels;
+        for (int i = 0; i < k; ++i)
+            labels.append(scored[i].second);
+        return labels;
+    }
+
+    static double recall(const HnswIndex &index, const std::vector<float> &vectors,
+                         const std::vector<float> &queries, int k) {
+        int found = 0, total = 0;
+        for (size_t q = 0; q < queries.size() / Dimensions; ++q) {
+            const float *query = queries.data() + q * Dimensions;
+            const QList<quint64> exact = exactNeighbors(vectors, query, k);
+            for (const auto &hit : index.search(query, k))
+                found += exact.contains(hit.label);
+            total += k;
+        }
+        return double(found) / total;
+    }
+
+private slots:
+    void testEmpty() {
+        HnswIndex index(Dimensions, HnswIndex::Options());
+        const std::vector<float> query = randomVectors(1, 1);
+        QVERIFY(index.search(query.data(), 10).isEmpty());
+        QCOMPARE(index.size(), 0);
+    }
+
+    void testRecall_data() {
+        QTest::addColumn<bool>("quantize");
+        QTest::newRow("int8") << true;
+        QTest::newRow("float") << false;
+    }
+
+    void testRecall() {
+        QFETCH(bool, quantize);
+        HnswIndex::Options options;
+        options.quantize = quantize;
+        const std::vector<float> vectors = randomVectors(2000, 1);
+        HnswIndex index(Dimensions, options);
+        for (int i = 0; i < 2000; ++i)
+            index.add(quint64(i), vectors.data() + size_t(i) * Dimensions);
+        QCOMPARE(index.size(), 2000);
+
+        const std::vector<float> queries = randomVectors(50, 2);
+        const double value = recall(index, vectors, queries, 10);
+        QVERIFY2(value >= 0.9, qPrintable(QString("recall@10 %1").arg(value)));
+
+        // The vector itself is its closest neighbour, with a similarity of 1.
+        const auto hits = index.search(vectors.data() + 123 * Dimensions, 1);
+        QCOMPARE(hits.size(), 1);
+        QCOMPARE(hits[0].label, quint64(123));
+        QVERIFY(qAbs(hits[0].score - 1.0f) < 1e-4f);
+    }
+
+    void testQuantizedScoresAreExact() {
+        // Re-ranking reports the float similarity, not the one of the codes.
+        const std::vector<float> vectors = randomVectors(300, 6);
+        HnswIndex index(Dimensions, HnswIndex::Options());
+        for (int i = 0; i < 300; ++i)
+            index.add(quint64(i), vectors.data() + size_t(i) * Dimensions);
+
+        const std::vector<float> query = randomVectors(1, 7);
+        const auto hits = index.search(query.data(), 5, 300);
+        QCOMPARE(hits.size(), 5);
+        QCOMPARE(QList<quint64>({hits[0].label, hits[1].label, hits[2].label, hits[3].label, hits[4].label}),
+                 exactNeighbors(vectors, query.data(), 5));
+        for (const auto &hit : hits) {
+            const float *vector = vectors.data() + size_t(hit.label) * Dimensions;
+            float dot = 0, norm = 0, queryNorm = 0;
+            for (int d = 0; d < Dimensions; ++d) {
+                dot += vector[d] * query[d];
+                norm += vector[d] * vector[d];
+                queryNorm += query[d] * query[d];
+            }
+            QVERIFY(qAbs(hit.score - dot / std::sqrt(norm * queryNorm)) < 1e-4f);
+        }
+    }
+
+    void testRemoveAndReplace() {
+        const std::vector<float> vectors = randomVectors(500, 3);
+        HnswIndex index(Dimensions, HnswIndex::Options());
+        for (int i = 0; i < 500; ++i)
+            index.add(quint64(i), vectors.data() + size_t(i) * Dimensions);
+
+        index.remove(7);
+        QVERIFY(!index.contains(7));
+        QCOMPARE(index.size(), 499);
+        QCOMPARE(index.removedCount(), 1);
+        for (const auto &hit : index.search(vectors.data() + 7 * Dimensions, 20))
+            QVERIFY(hit.label != 7);
+
+        // Label 8 now holds the vector of 9.
+        index.add(8, vectors.data() + 9 * Dimensions);
+        QCOMPARE(index.size(), 499);
+        const auto hits = index.search(vectors.data() + 9 * Dimensions, 2);
+        QCOMPARE(hits.size(), 2);
+        QVERIFY(qAbs(hits[0].score - 1.0f) < 1e-4f && qAbs(hits[1].score - 1.0f) < 1e-4f);
+
+        const auto compacted = index.compacted();
+        QCOMPARE(compacted->size(), 499);
+        QCOMPARE(compacted->removedCount(), 0);
+        QVERIFY(compacted->contains(8));
+        QVERIFY(!compacted->contains(7));
+    }
+
+    void testSaveAndLoad() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString path = dir.filePath("index.hnsw");
+
+        const std::vector<float> vectors = randomVectors(1000, 4);
+        HnswIndex index(Dimensions, HnswIndex::Options());
+        for (int i = 0; i < 1000; ++i)
+            index.add(quint64(i) * 3, vectors.data() + size_t(i) * Dimensions);
+        index.remove(30);
+
+        QString error;
+        QVERIFY2(index.save(path, &error), qPrintable(error));
+
+        auto loaded = HnswIndex::load(path, &error);
+        QVERIFY2(loaded, qPrintable(error));
+        QCOMPARE(loaded->dimensions(), Dimensions);
+        QCOMPARE(loaded->size(), 999);
+        QVERIFY(!loaded->contains(30));
+        QVERIFY(loaded->isMapped());
+
+        // The mapped graph answers exactly like the one it was saved from.
+        const std::vector<float> queries = randomVectors(20, 5);
+        for (int q = 0; q < 20; ++q) {
+            const float *query = queries.data() + size_t(q) * Dimensions;
+            const auto expected = index.search(query, 10);
+            const auto actual = loaded->search(query, 10);
+            QCOMPARE(actual.size(), expected.size());
+            for (qsizetype i = 0; i < actual.size(); ++i)
+                QCOMPARE(actual[i].label, expected[i].label);
+        }
+
+        // Changes copy the mapping first.
+        loaded->add(5000, vectors.data());
+        QVERIFY(!loaded->isMapped());
+        QCOMPARE(loaded->size(), 1000);
+        QCOMPARE(loaded->search(vectors.data(), 2).size(), 2);
+    }
+
+    void testLoadRejectsInvalidFiles() {
+        QTemporaryDir dir;
+        QString error;
+        QVERIFY(!HnswIndex::load(dir.filePath("missing.hnsw"), &error));
+
+        QFile file(dir.filePath("garbage.hnsw"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(QByteArray(256, 'x'));
+        file.close();
+        QVERIFY(!HnswIndex::load(file.fileName(), &error));
+        QVERIFY(!error.isEmpty());
+    }
+};
+
+QTEST_MAIN(TestHnswIndex)
+#include "tst_hnswindex.moc"
@@ -4,10 +4,40 @@
 #include "../src/mcp/mcpserver.h"
 #include "../src/core/codeeditormanager.h"
 
-class MockProvider : public LLMProvider {
+// Answers the way a network provider does: after returning the request's id.
+class ScriptedProvider : public LLMProvider {
+protected:
+    RequestId answer(const QJsonArray &toolCalls, const QString &text = QString()) {
+        const RequestId id = ++m_lastId;
+        QMetaObject::invokeMethod(this, [this, id, toolCalls, text]() {
+            if (!toolCalls.isEmpty())
+                emit toolCallsReceived(toolCalls, id);
+            else
+                emit responseReady(text, id);
+            emit requestFinished(id);
+        }, Qt::QueuedConnection);
+        return id;
+    }
+
+private:
+    RequestId m_lastId = 0;
+};
+
+// Leaves the answering to the test.
+class ManualProvider : public LLMProvider {
+public:
+    QString name() const override { return "Manual"; }
+    RequestId sendChatRequest(const QJsonArray &, bool = true, const QJsonArray & = QJsonArray()) override {
+        return ++lastId;
+    }
+
+    RequestId lastId = 0;
+};
+
+class MockProvider : public ScriptedProvider {
 public:
     QString name() const override { return "Mock"; }
-    void sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) override {
+    RequestId sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) override {
         if (messages.last().toObject()["role"].toString() == "user") {
             // Simulate tool call
             QJsonArray toolCalls;
@@ -16,11 +46,12 @@ public:
             call["id"] = "123";
             call["arguments"] = QJsonObject();
             toolCalls.append(call);
-            emit toolCallsReceived(toolCalls);
+            return answer(toolCalls);
         } else if (messages.last().toObject()["role"].toString() == "tool") {
             // Final response after tool
-            emit responseReady("Tool worked");
+            return answer({}, "Tool worked");
         }
+        return 0;
     }
 };
 
@@ -30,6 +61,78 @@ public:
     // but MCPServer calls callTool which might use editor.
 };
 
+// Asks for several reads around one write, then answers once the results are in.
+class FanOutProvider : public ScriptedProvider {
+public:
+    QString name() const override { return "FanOut"; }
+    RequestId sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) override {
+        Q_UNUSED(stream) Q_UNUSED(tools)
+        if (messages.last().toObject()["role"].toString() == "user") {
+            QJsonArray toolCalls;
+            for (const QString &id : {"a", "b", "c", "d", "e"}) {
+                const QString name = id == "c" ? "write_file" : "read_file";
+                toolCalls.append(QJsonObject{{"id", id}, {"name", name},
+                                             {"arguments", QJsonObject{{"path", "/tmp/" + id}, {"content", "x"}}}});
+            }
+            return answer(toolCalls);
+        }
+        return answer({}, "done");
+    }
+};
+
+// Slow file access that records how many reads overlap.
+class SlowEditor : public CodeEditorManager {
+public:
+    bool readFile(const QString &filePath, QString &content) override {
+        const int running = ++concurrentReads;
+        int seen = maxConcurrentReads.loadRelaxed();
+        while (running > seen && !maxConcurrentReads.testAndSetRelaxed(seen, running))
+            seen = maxConcurrentReads.loadRelaxed();
+        QThread::msleep(200);
+        content = filePath;
+        --concurrentReads;
+        return true;
+    }
+    bool writeFile(const QString &, const QString &) override {
+        writeOverlappedRead = writeOverlappedRead || concurrentReads.loadRelaxed() != 0;
+        writeOffGuiThread = QThread::currentThread() != qApp->thread();
+        return true;
+    }
+
+    QAtomicInt concurrentReads;
+    QAtomicInt maxConcurrentReads;
+    bool writeOverlappedRead = false;
+    bool writeOffGuiThread = false;
+};
+
+// Reads a file twice, writes it, reads it again and then answers.
+class RepeatingProvider : public ScriptedProvider {
+public:
+    QString name() const override { return "Repeating"; }
+    RequestId sendChatRequest(const QJsonArray &messages, bool stream = true, const QJsonArray &tools = QJsonArray()) override {
+        Q_UNUSED(stream) Q_UNUSED(tools)
+        int results = 0;
+        for (const auto &message : messages)
+            results += message.toObject()["role"].toString() == "tool";
+        const QStringList calls{"read_file", "read_file", "write_file", "read_file"};
+        if (results < calls.size()) {
+            const QJsonObject call{{"id", QString("call%1").arg(results + 1)}, {"name", calls[results]},
+                                   {"arguments", QJsonObject{{"path", "/tmp/repeated.txt"}, {"content", "x"}}}};
+            return answer(QJsonArray{call});
+        }
+        return answer({}, "done");
+    }
+};
+
+class LargeFileEditor : public CodeEditorManager {
+public:
+    bool readFile(const QString &, QString &content) override {
+        content = QString(1000, 'x');
+        return true;
+    }
+    bool writeFile(const QString &, const QString &) override { return true; }
+};
+
 class TestLLMManager : public QObject
 {
     Q_OBJECT
@@ -54,6 +157,99 @@ private slots:
         QTRY_COMPARE_WITH_TIMEOUT(finalResponse, QString("Tool worked"), 2000);
         QVERIFY(manager.history().messageCount() >= 3); // User, ToolCall (Assistant), ToolResult, Final Assistant
     }
+
+    void testParallelReadOnlyTools() {
+        LLMManager manager;
+        FanOutProvider provider;
+        manager.setProvider(&provider);
+        SlowEditor editor;
+        MCPServer server(&editor);
+        manager.setMCPServer(&server);
+
+        QString finalResponse;
+        connect(&manager, &LLMManager::responseReady, [&](const QString &text) {
+            finalResponse = text;
+        });
+
+        manager.sendChatRequest("Explore");
+        QTRY_COMPARE_WITH_TIMEOUT(finalResponse, QString("done"), 5000);
+
+        // Two batches of two reads around the write, each batch at the same time.
+        QCOMPARE(editor.maxConcurrentReads.loadRelaxed(), 2);
+        QVERIFY(!editor.writeOverlappedRead);
+        QVERIFY(editor.writeOffGuiThread);
+
+        QStringList toolIds;
+        for (const auto &msg : manager.history().messages()) {
+            if (msg.role == Message::Tool)
+                toolIds << msg.toolCallId;
+        }
+        QCOMPARE(toolIds, QStringList({"a", "b", "c", "d", "e"}));
+        QVERIFY(!manager.isBusy());
+    }
+
+    void testRepeatedToolResultsAreReferenced() {
+        LLMManager manager;
+        RepeatingProvider provider;
+        manager.setProvider(&provider);
+        LargeFileEditor editor;
+        MCPServer server(&editor);
+        manager.setMCPServer(&server);
+
+        QString finalResponse;
+        connect(&manager, &LLMManager::responseReady, [&](const QString &text) {
+            finalResponse = text;
+        });
+        manager.sendChatRequest("Read it twice");
+        QTRY_COMPARE_WITH_TIMEOUT(finalResponse, QString("done"), 5000);
+
+        QStringList results;
+        for (const auto &msg : manager.history().messages()) {
+            if (msg.role == Message::Tool)
+                results << msg.content;
+        }
+        QCOMPARE(results.size(), 4);
+        QVERIFY(results[0].contains(QString(1000, 'x')));
+        // The repeat refers to the first call instead of carrying the file again.
+        QVERIFY(!results[1].contains(QString(1000, 'x')));
+        QVERIFY(results[1].contains("unchanged"));
+        QVERIFY(results[1].contains("#1 (id call1)"));
+        // After a write the file is sent again.
+        QVERIFY(results[3].contains(QString(1000, 'x')));
+        QVERIFY(manager.history().containsToolResult("call1"));
+        QVERIFY(!manager.history().containsToolResult("missing"));
+    }
+
+    void testSignalsOfOtherRequestsAreIgnored() {
+        LLMManager manager;
+        ManualProvider provider;
+        manager.setProvider(&provider);
+
+        QStringList deltas;
+        QStringList responses;
+        connect(&manager, &LLMManager::partialResponse, [&](const QString &delta) { deltas << delta; });
+        connect(&manager, &LLMManager::responseReady, [&](const QString &text) { responses << text; });
+
+        manager.sendChatRequest("first");
+        const LLMProvider::RequestId first = provider.lastId;
+        manager.cancel();
+        manager.sendChatRequest("second");
+        const LLMProvider::RequestId second = provider.lastId;
+        QVERIFY(first != second);
+
+        // The cancelled stream is still draining while the new one starts.
+        emit provider.partialResponse("old ", first);
+        emit provider.partialResponse("new", second);
+        emit provider.toolCallsReceived(QJsonArray{QJsonObject{{"id", "x"}, {"name", "read_file"}}}, first);
+        emit provider.streamFinished(first);
+        QVERIFY(responses.isEmpty());
+        emit provider.streamFinished(second);
+        emit provider.requestFinished(second);
+
+        QCOMPARE(deltas, QStringList({"new"}));
+        QCOMPARE(responses, QStringList({"new"}));
+        QVERIFY(!manager.isBusy());
+    }
 };
 
 QTEST_MAIN(TestLLMManager)
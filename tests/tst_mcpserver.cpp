@@ -1,4 +1,6 @@
 #include <QtTest>
+#include <QJsonDocument>
+#include <QTemporaryDir>
 #include "../src/mcp/mcpserver.h"
 #include "../src/core/codeeditormanager.h"
 
@@ -23,6 +25,63 @@ public:
     }
 };
 
+// File access that takes a while, to observe timeouts and queued calls.
+class SlowEditorManager : public CodeEditorManager {
+public:
+    bool readFile(const QString &, QString &content) override {
+        QThread::msleep(300);
+        content = "late";
+        return true;
+    }
+    bool writeFile(const QString &, const QString &) override {
+        QThread::msleep(200);
+        ++writes;
+        return true;
+    }
+
+    QAtomicInt writes;
+};
+
+// An editor with an enormous file open.
+class HugeEditorManager : public CodeEditorManager {
+public:
+    EditorContext getCurrentEditorContext() const override {
+        EditorContext ctx;
+        ctx.filePath = "generated.cpp";
+        ctx.content = QString(1024 * 1024, 'x');
+        ctx.isValid = true;
+        return ctx;
+    }
+};
+
+// A project on disk, for the tools that index it.
+class ProjectEditorManager : public CodeEditorManager {
+public:
+    explicit ProjectEditorManager(const QString &projectPath) : m_projectPath(projectPath) {}
+    QString getProjectPath() const override { return m_projectPath; }
+
+private:
+    QString m_projectPath;
+};
+
+// A project with one file open in an editor, which only the GUI thread may read.
+class OpenDocumentEditorManager : public ProjectEditorManager {
+public:
+    using ProjectEditorManager::ProjectEditorManager;
+    bool isOpen(const QString &filePath) const override { return filePath.endsWith("open.cpp"); }
+    bool readFileRange(const QString &filePath, const ReadRange &range, FileRange *result) override {
+        if (!isOpen(filePath))
+            return ProjectEditorManager::readFileRange(filePath, range, result);
+        if (QThread::currentThread() != thread())
+            ++offGuiThreadReads;
+        result->content = "unsaved\n";
+        result->startLine = result->endLine = result->totalLines = 1;
+        return true;
+    }
+
+    QAtomicInt offGuiThreadReads;
+};
+
 class TestMCPServer : public QObject
 {
     Q_OBJECT
@@ -52,6 +111,337 @@ private slots:
         QCOMPARE(result["content"].toString(), QString("void main() {}"));
     }
 
+    void testReadFileRange() {
+        QTemporaryDir dir;
+        QFile file(dir.filePath("big.cpp"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QByteArray expected;
+        for (int i = 1; i <= 5000; ++i) {
+            const QByteArray line = "int value" + QByteArray::number(i) + " = " + QByteArray::number(i) + ";\n";
+            file.write(line.chopped(1) + "\r\n");
+            expected += line;
+        }
+        file.close();
+
+        ProjectEditorManager editor(dir.path());
+        MCPServer server(&editor);
+        QJsonObject result = server.callTool("read_file", QJsonObject{{"path", "big.cpp"}, {"start_line", 10}, {"end_line", 12}});
+        QCOMPARE(result["content"].toString(), QString("int value10 = 10;\nint value11 = 11;\nint value12 = 12;\n"));
+        QCOMPARE(result["start_line"].toInt(), 10);
+        QCOMPARE(result["end_line"].toInt(), 12);
+        QCOMPARE(result["total_lines"].toInt(), 5000);
+        QVERIFY(!result.contains("next_cursor"));
+
+        // Paged through with the cursor, whole lines each time.
+        QByteArray content;
+        QJsonObject arguments{{"path", "big.cpp"}, {"max_bytes", 4096}};
+        int pages = 0;
+        for (;; ++pages) {
+            result = server.callTool("read_file", arguments);
+            QVERIFY2(!result.contains("error"), qPrintable(result["error"].toString()));
+            QVERIFY(result["content"].toString().endsWith('\n'));
+            QVERIFY(result["content"].toString().size() <= 4096);
+            content += result["content"].toString().toUtf8();
+            if (!result["truncated"].toBool())
+                break;
+            QCOMPARE(result["next_line"].toInt(), result["end_line"].toInt() + 1);
+            arguments["cursor"] = result["next_cursor"];
+        }
+        QVERIFY(pages > 10);
+        QCOMPARE(content, expected);
+
+        // The default page of a large file is cut short as well.
+        result = server.callTool("read_file", QJsonObject{{"path", "big.cpp"}});
+        QVERIFY(result["truncated"].toBool());
+        QVERIFY(result["content"].toString().size() <= 65536);
+
+        QVERIFY(server.callTool("read_file", QJsonObject{{"path", "big.cpp"}, {"cursor", "abc"}}).contains("error"));
+
+        // Malformed UTF-8 right at the start: the cursor cannot move back before it.
+        QFile malformed(dir.filePath("malformed.txt"));
+        QVERIFY(malformed.open(QIODevice::WriteOnly));
+        malformed.write("\x80\x80text\n");
+        malformed.close();
+        for (const QString &cursor : {QString("0"), QString("1")}) {
+            result = server.callTool("read_file", QJsonObject{{"path", "malformed.txt"}, {"cursor", cursor}});
+            QVERIFY(result["content"].toString().endsWith("text\n"));
+            QCOMPARE(result["start_line"].toInt(), 1);
+        }
+
+        QFile binary(dir.filePath("image.png"));
+        QVERIFY(binary.open(QIODevice::WriteOnly));
+        binary.write(QByteArray("\x89PNG\r\n\x1a\n\0\0\0\rIHDR", 16));
+        binary.close();
+        QVERIFY(server.callTool("read_file", QJsonObject{{"path", "image.png"}})["error"].toString().contains("Not a text file"));
+    }
+
+    void testReadFiles() {
+        const auto jsonSize = [](const QJsonObject &object) {
+            return QJsonDocument(object).toJson(QJsonDocument::Compact).size();
+        };
+        QTemporaryDir dir;
+        const auto write = [&dir](const QString &name, int lines) {
+            QFile file(dir.filePath(name));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            for (int i = 1; i <= lines; ++i)
+                file.write("int value" + QByteArray::number(i) + " = " + QByteArray::number(i) + ";\n");
+        };
+        write("a.h", 3);
+        write("b.cpp", 200);   // About 4 KB.
+        write("c.cpp", 200);
+
+        ProjectEditorManager editor(dir.path());
+        MCPServer server(&editor);
+        const QJsonArray files{QJsonObject{{"path", "a.h"}},
+                               QJsonObject{{"path", "missing.h"}},
+                               QJsonObject{{"path", "b.cpp"}, {"start_line", 10}, {"end_line", 11}}};
+        QJsonObject result = server.callTool("read_files", QJsonObject{{"files", files}});
+        QJsonArray read = result["files"].toArray();
+        QCOMPARE(read.size(), 3);
+        QCOMPARE(read[0].toObject()["path"].toString(), QString("a.h"));
+        QCOMPARE(read[0].toObject()["total_lines"].toInt(), 3);
+        QVERIFY(read[1].toObject()["error"].toString().contains("Failed to read file"));
+        QCOMPARE(read[2].toObject()["content"].toString(), QString("int value10 = 10;\nint value11 = 11;\n"));
+        QVERIFY(!result.contains("truncated"));
+
+        // One budget for all: b.cpp is whole, c.cpp is cut short at a line and a.h comes too late.
+        result = server.callTool("read_files", QJsonObject{{"files", QJsonArray{"b.cpp", "c.cpp", "a.h"}}, {"max_bytes", 6000}});
+        QVERIFY(result["truncated"].toBool());
+        read = result["files"].toArray();
+        QCOMPARE(read.size(), 3);
+        QVERIFY(!read[0].toObject().contains("truncated"));
+        const QJsonObject cut = read[1].toObject();
+        QVERIFY(cut["truncated"].toBool());
+        QVERIFY(cut["content"].toString().endsWith('\n'));
+        QVERIFY(jsonSize(read[0].toObject()) + jsonSize(cut) <= 6000);
+        QVERIFY(read[2].toObject()["skipped"].toBool());
+
+        // The budget counts the content as escaped JSON, quotes take two bytes.
+        QFile quotes(dir.filePath("quotes.txt"));
+        QVERIFY(quotes.open(QIODevice::WriteOnly));
+        for (int i = 0; i < 100; ++i)
+            quotes.write(QByteArray(40, '"') + '\n');
+        quotes.close();
+        result = server.callTool("read_files", QJsonObject{{"files", QJsonArray{"quotes.txt"}}, {"max_bytes", 3000}});
+        QVERIFY(result["truncated"].toBool());
+        QVERIFY(jsonSize(result["files"].toArray()[0].toObject()) <= 3000);
+
+        // The cursor continues the file that was cut short.
+        result = server.callTool("read_files", QJsonObject{{"files", QJsonArray{QJsonObject{{"path", "c.cpp"}, {"cursor", cut["next_cursor"]}}}}});
+        QCOMPARE(result["files"].toArray()[0].toObject()["start_line"].toInt(), cut["next_line"].toInt());
+        QCOMPARE(result["files"].toArray()[0].toObject()["end_line"].toInt(), 200);
+
+        QVERIFY(server.callTool("read_files", QJsonObject()).contains("error"));
+    }
+
+    void testReadFilesWithOpenDocument() {
+        QTemporaryDir dir;
+        QFile file(dir.filePath("closed.cpp"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("int closed;\n");
+        file.close();
+
+        OpenDocumentEditorManager editor(dir.path());
+        MCPServer server(&editor);
+        const QJsonObject result = server.callTool("read_files", QJsonObject{{"files", QJsonArray{"open.cpp", "closed.cpp"}}});
+        const QJsonArray read = result["files"].toArray();
+        QCOMPARE(read.size(), 2);
+        QCOMPARE(read[0].toObject()["content"].toString(), QString("unsaved\n"));
+        QCOMPARE(read[1].toObject()["content"].toString(), QString("int closed;\n"));
+        // Read on the calling (GUI) thread, not from a worker waiting for it.
+        QCOMPARE(editor.offGuiThreadReads.loadRelaxed(), 0);
+    }
+
+    void testListDirectoryRecursive() {
+        QTemporaryDir dir;
+        const auto write = [&dir](const QString &relativePath) {
+            QDir().mkpath(QFileInfo(dir.filePath(relativePath)).absolutePath());
+            QFile file(dir.filePath(relativePath));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("x\n");
+        };
+        write(".gitignore");
+        write("src/core/a.cpp");
+        write("src/core/a.h");
+        write("src/ui/.gitignore");
+        write("src/ui/form.ui");
+        write("src/ui/form.cpp");
+        write("build/out.o");
+        write("docs/readme.md");
+        {
+            QFile ignore(dir.filePath(".gitignore"));
+            QVERIFY(ignore.open(QIODevice::WriteOnly));
+            ignore.write("build/\n");
+            QFile nested(dir.filePath("src/ui/.gitignore"));
+            QVERIFY(nested.open(QIODevice::WriteOnly));
+            nested.write("*.ui\n");
+        }
+
+        ProjectEditorManager editor(dir.path());
+        MCPServer server(&editor);
+        const auto names = [](const QJsonObject &result) {
+            QStringList names;
+            for (const auto &file : result["files"].toArray())
+                names << file.toObject()["name"].toString();
+            return names;
+        };
+
+        // One level by default, as before.
+        QJsonObject result = server.callTool("list_directory", QJsonObject());
+        QCOMPARE(names(result), QStringList({".gitignore", "docs", "src"}));
+
+        result = server.callTool("list_directory", QJsonObject{{"max_depth", 5}, {"include", "*.cpp, *.h"}});
+        QCOMPARE(names(result), QStringList({"src/core/a.cpp", "src/core/a.h", "src/ui/form.cpp"}));
+
+        result = server.callTool("list_directory", QJsonObject{{"path", "src"}, {"max_depth", 3}, {"exclude", "core"}});
+        QCOMPARE(names(result), QStringList({"ui", "ui/.gitignore", "ui/form.cpp"}));
+
+        result = server.callTool("list_directory", QJsonObject{{"max_depth", 3}, {"respect_gitignore", false}, {"max_entries", 4}});
+        QCOMPARE(names(result).size(), 4);
+        QVERIFY(result["truncated"].toBool());
+        QVERIFY(names(result).contains("build"));
+
+        QVERIFY(server.callTool("list_directory", QJsonObject{{"path", "missing"}}).contains("error"));
+    }
+
+    void testEditFile() {
+        QTemporaryDir dir;
+        QFile file(dir.filePath("edit.cpp"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("int main()\n{\n    return 0;\n}\n");
+        file.close();
+        const auto content = [&file]() {
+            if (!file.open(QIODevice::ReadOnly))
+                return QByteArray();
+            const QByteArray data = file.readAll();
+            file.close();
+            return data;
+        };
+
+        ProjectEditorManager editor(dir.path());
+        MCPServer server(&editor);
+        QJsonObject result = server.callTool("edit_file", QJsonObject{{"path", "edit.cpp"}, {"search", "return 0;"}, {"replace", "return 1;"}});
+        QVERIFY2(result["success"].toBool(), qPrintable(result["error"].toString()));
+        QCOMPARE(result["applied"].toInt(), 1);
+        QCOMPARE(content(), QByteArray("int main()\n{\n    return 1;\n}\n"));
+
+        result = server.callTool("edit_file", QJsonObject{{"path", "edit.cpp"}, {"diff", "@@ -3 +3,2 @@\n-    return 1;\n+    puts(\"hi\");\n+    return 2;\n"}});
+        QVERIFY2(result["success"].toBool(), qPrintable(result["error"].toString()));
+        QCOMPARE(content(), QByteArray("int main()\n{\n    puts(\"hi\");\n    return 2;\n}\n"));
+
+        // A failing edit leaves the file as it was, the first edit included.
+        const QJsonArray edits{QJsonObject{{"search", "int main()"}, {"replace", "int main(int, char **)"}},
+                               QJsonObject{{"search", "return 3;"}, {"replace", "return 4;"}}};
+        result = server.callTool("edit_file", QJsonObject{{"path", "edit.cpp"}, {"edits", edits}});
+        QVERIFY(result["error"].toString().contains("Edit 2: the search text was not found"));
+        QCOMPARE(content(), QByteArray("int main()\n{\n    puts(\"hi\");\n    return 2;\n}\n"));
+
+        QVERIFY(server.callTool("edit_file", QJsonObject{{"path", "edit.cpp"}}).contains("error"));
+        QVERIFY(server.callTool("edit_file", QJsonObject{{"path", "missing.cpp"}, {"search", "a"}, {"replace", "b"}}).contains("error"));
+    }
+
+    void testResultSizeLimit() {
+        HugeEditorManager editor;
+        MCPServer server(&editor);
+        const QJsonObject result = server.callTool("get_editor_context", QJsonObject());
+        QVERIFY(!result.contains("context"));
+        QVERIFY(result["error"].toString().contains("limit"));
+    }
+
+    void testCallToolAsync() {
+        MockEditorManager mock;
+        MCPServer server(&mock);
+
+        QFuture<QJsonObject> future = server.callToolAsync("read_file", QJsonObject{{"path", "test.cpp"}});
+        QTRY_VERIFY_WITH_TIMEOUT(future.isFinished(), 2000);
+        QCOMPARE(future.result()["content"].toString(), QString("void main() {}"));
+
+        // Editor tools are run on the GUI thread once the event loop gets to them.
+        future = server.callToolAsync("get_editor_context", QJsonObject());
+        QVERIFY(!future.isFinished());
+        QTRY_VERIFY_WITH_TIMEOUT(future.isFinished(), 2000);
+        QCOMPARE(future.result()["context"].toObject()["filePath"].toString(), QString("test.cpp"));
+    }
+
+    void testCallToolAsyncTimeout() {
+        SlowEditorManager slow;
+        MCPServer server(&slow);
+
+        // The result is the timeout error, not the late content of the read.
+        QFuture<QJsonObject> future = server.callToolAsync("read_file", QJsonObject{{"path", "a.cpp"}}, 50);
+        QTRY_VERIFY_WITH_TIMEOUT(future.isFinished(), 2000);
+        QVERIFY(future.result()["error"].toString().contains("timed out"));
+    }
+
+    void testCallToolAsyncCancel() {
+        SlowEditorManager slow;
+        MCPServer server(&slow);
+
+        // Writes are serialized, the second one waits for the first.
+        QFuture<QJsonObject> first = server.callToolAsync("write_file", QJsonObject{{"path", "a.cpp"}, {"content", "a"}});
+        QFuture<QJsonObject> second = server.callToolAsync("write_file", QJsonObject{{"path", "b.cpp"}, {"content", "b"}});
+        second.cancel();
+
+        QTRY_VERIFY_WITH_TIMEOUT(first.isFinished(), 2000);
+        QVERIFY(first.result()["success"].toBool());
+        QTest::qWait(300);
+        QCOMPARE(slow.writes.loadRelaxed(), 1);
+        QVERIFY(second.isCanceled());
+    }
+
+    void testSymbolTools() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QDir().mkpath(dir.path() + "/src");
+        QFile header(dir.path() + "/src/shape.h");
+        QVERIFY(header.open(QIODevice::WriteOnly));
+        header.write("class Shape : public Base\n{\npublic:\n    double area() const;\n    int m_sides = 0;\n};\n");
+        header.close();
+        QFile source(dir.path() + "/src/shape.cpp");
+        QVERIFY(source.open(QIODevice::WriteOnly));
+        source.write("double Shape::area() const\n{\n    return m_sides * 2.0;\n}\n");
+        source.close();
+
+        ProjectEditorManager editor(dir.path());
+        MCPServer server(&editor);
+        QTRY_VERIFY_WITH_TIMEOUT(server.callTool("get_symbol_info", QJsonObject{{"name", "area"}}).contains("symbols"), 5000);
+
+        const QJsonArray symbols = server.callTool("get_symbol_info", QJsonObject{{"name", "Shape::area"}})["symbols"].toArray();
+        QCOMPARE(symbols.size(), 2);
+        const QJsonObject definition = symbols[0].toObject();
+        QCOMPARE(definition["path"].toString(), QString("src/shape.cpp"));
+        QCOMPARE(definition["line"].toInt(), 1);
+        QCOMPARE(definition["kind"].toString(), QString("method"));
+        QCOMPARE(definition["signature"].toString(), QString("double Shape::area() const"));
+        QVERIFY(symbols[1].toObject()["declaration"].toBool());
+
+        QVERIFY(server.callTool("get_symbol_info", QJsonObject{{"name", "area"}, {"kind", "field"}}).contains("error"));
+
+        const QJsonObject outline = server.callTool("get_class_outline", QJsonObject{{"name", "Shape"}});
+        QCOMPARE(outline["class"].toObject()["bases"].toArray(), QJsonArray({"Base"}));
+        QCOMPARE(outline["members"].toArray().size(), 2);
+
+        const QJsonObject usages = server.callTool("find_usages", QJsonObject{{"name", "m_sides"}});
+        QCOMPARE(usages["total_usages"].toInt(), 2);
+        const QJsonArray usageList = usages["usages"].toArray();
+        bool foundDefinition = false;
+        for (const auto &usage : usageList)
+            foundDefinition = foundDefinition || usage.toObject()["kind"].toString() == "definition";
+        QVERIFY(foundDefinition);
+    }
+
+    void testSemanticSearchWithoutModel() {
+        QTemporaryDir dir;
+        ProjectEditorManager editor(dir.path());
+        MCPServer server(&editor);
+        QVERIFY(MCPServer::isReadOnlyTool("semantic_search"));
+        QVERIFY(!server.semanticIndexer()->isEnabled());
+
+        const QJsonObject result = server.callTool("semantic_search", QJsonObject{{"query", "where is the config saved"}});
+        QVERIFY(result["error"].toString().contains("disabled"));
+        QVERIFY(server.callTool("semantic_search", QJsonObject{{"query", " "}}).contains("error"));
+    }
+
     void testHandleRequest() {
         MockEditorManager mock;
         MCPServer server(&mock);
@@ -1,7 +1,12 @@
 #include <QtTest>
 #include <QHttpServer>
 #include <QHttpServerResponse>
+#include <QHttpServerRequest>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
 #include "../src/providers/openai/openaiprovider.h"
+#include "../src/core/conversationhistory.h"
 
 class TestOpenAIProvider : public QObject
 {
@@ -71,6 +76,125 @@ private slots:
         QCOMPARE(receivedToolCalls.size(), 1);
         QCOMPARE(receivedToolCalls[0].toObject()["name"].toString(), QString("test_tool"));
     }
+
+    void testConcurrentToolCalls() {
+        QHttpServer server;
+        server.route("/chat/completions", [](const QHttpServerRequest &request) {
+            const QByteArray tool = request.body().contains("first") ? "tool_a" : "tool_b";
+            return QHttpServerResponse(
+                "data: {\"choices\":[{\"delta\":{\"tool_calls\":[{\"index\":0,\"id\":\"" + tool + "\",\"function\":{\"name\":\"" + tool + "\",\"arguments\":\"{\\\"a\\\":\"}}]}}]}\n\n"
+                "data: {\"choices\":[{\"delta\":{\"tool_calls\":[{\"index\":0,\"function\":{\"arguments\":\"1}\"}}]}}]}\n\n"
+                "data: [DONE]\n\n",
+                QHttpServerResponse::StatusCode::Ok);
+        });
+
+        quint16 port = server.listen(QHostAddress::LocalHost);
+        QVERIFY(port != 0);
+
+        OpenAIProvider provider;
+        provider.setBaseUrl(QString("http://localhost:%1").arg(port));
+
+        QList<QJsonArray> received;
+        int finished = 0;
+        connect(&provider, &OpenAIProvider::toolCallsReceived, [&](const QJsonArray &toolCalls) {
+            received.append(toolCalls);
+        });
+        connect(&provider, &OpenAIProvider::streamFinished, [&]() {
+            ++finished;
+        });
+
+        // Both requests are in flight on the same provider at the same time.
+        provider.sendChatRequest(QJsonArray{QJsonObject{{"role", "user"}, {"content", "first"}}}, true);
+        provider.sendChatRequest(QJsonArray{QJsonObject{{"role", "user"}, {"content", "second"}}}, true);
+
+        QTRY_COMPARE_WITH_TIMEOUT(finished, 2, 5000);
+        QCOMPARE(received.size(), 2);
+        QStringList names;
+        for (const auto &calls : received) {
+            QCOMPARE(calls.size(), 1);
+            const QJsonObject function = calls[0].toObject()["function"].toObject();
+            QCOMPARE(function["arguments"].toString(), QString("{\"a\":1}"));
+            names.append(function["name"].toString());
+        }
+        names.sort();
+        QCOMPARE(names, QStringList({"tool_a", "tool_b"}));
+    }
+
+    void testSendConversation() {
+        QHttpServer server;
+        QByteArray body;
+        server.route("/chat/completions", [&body](const QHttpServerRequest &request) {
+            body = request.body();
+            return QHttpServerResponse("data: [DONE]\n\n", QHttpServerResponse::StatusCode::Ok);
+        });
+
+        quint16 port = server.listen(QHostAddress::LocalHost);
+        QVERIFY(port != 0);
+
+        OpenAIProvider provider;
+        provider.setBaseUrl(QString("http://localhost:%1").arg(port));
+        provider.setModel("test-model");
+        QSignalSpy finishedSpy(&provider, &OpenAIProvider::requestFinished);
+
+        ConversationHistory history;
+        history.addMessage(Message::System, "System prompt");
+        history.addMessage(Message::User, "Hello \"world\"");
+        const QJsonArray tools{QJsonObject{{"type", "function"}}};
+        provider.sendConversation(history, true, tools);
+
+        QTRY_COMPARE_WITH_TIMEOUT(finishedSpy.count(), 1, 5000);
+        QJsonParseError error;
+        const QJsonObject root = QJsonDocument::fromJson(body, &error).object();
+        QCOMPARE(error.error, QJsonParseError::NoError);
+        QCOMPARE(root["messages"].toArray(), history.toJsonArray());
+        QCOMPARE(root["model"].toString(), QString("test-model"));
+        QCOMPARE(root["stream"].toBool(), true);
+        QCOMPARE(root["tools"].toArray(), tools);
+    }
+
+    void testBuildRequestBody() {
+        QCOMPARE(OpenAIProvider::buildRequestBody(QJsonObject(), "[]"), QByteArray("{\"messages\":[]}"));
+        QCOMPARE(OpenAIProvider::buildRequestBody(QJsonObject{{"a", 1}}, "[{}]"),
+                 QByteArray("{\"messages\":[{}],\"a\":1}"));
+    }
+
+    void testCancel() {
+        // A server that starts streaming and never finishes, like a busy local model.
+        QTcpServer server;
+        QVERIFY(server.listen(QHostAddress::LocalHost));
+        QPointer<QTcpSocket> serverSocket;
+        bool serverSawDisconnect = false;
+        connect(&server, &QTcpServer::newConnection, [&]() {
+            serverSocket = server.nextPendingConnection();
+            connect(serverSocket, &QTcpSocket::disconnected, [&]() { serverSawDisconnect = true; });
+            connect(serverSocket, &QTcpSocket::readyRead, [&]() {
+                serverSocket->readAll();
+                serverSocket->write("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n\r\n"
+                                    "data: {\"choices\":[{\"delta\":{\"content\":\"Hello\"}}]}\n\n");
+            });
+        });
+
+        OpenAIProvider provider;
+        provider.setBaseUrl(QString("http://localhost:%1").arg(server.serverPort()));
+
+        QSignalSpy partialSpy(&provider, &OpenAIProvider::partialResponse);
+        QSignalSpy finishedSpy(&provider, &OpenAIProvider::streamFinished);
+        QSignalSpy errorSpy(&provider, &OpenAIProvider::errorOccurred);
+        QSignalSpy requestFinishedSpy(&provider, &OpenAIProvider::requestFinished);
+
+        const auto id = provider.sendChatRequest(QJsonArray{QJsonObject{{"role", "user"}, {"content", "test"}}}, true);
+        QVERIFY(id != 0);
+        QVERIFY(provider.isActive(id));
+        QTRY_COMPARE_WITH_TIMEOUT(partialSpy.count(), 1, 5000);
+
+        provider.cancel(id);
+        QVERIFY(!provider.isActive(id));
+        QTRY_COMPARE_WITH_TIMEOUT(requestFinishedSpy.count(), 1, 5000);
+        QCOMPARE(requestFinishedSpy.first().at(0).value<LLMProvider::RequestId>(), id);
+        QTRY_VERIFY_WITH_TIMEOUT(serverSawDisconnect, 5000);
+        QCOMPARE(finishedSpy.count(), 0);
+        QCOMPARE(errorSpy.count(), 0);
+    }
 };
 
 QTEST_MAIN(TestOpenAIProvider)
@@ -0,0 +1,174 @@
+#include <QtTest>
+#include "../src/core/patchengine.h"
+
+class TestPatchEngine : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QString numberedLines(int count) {
+        QString text;
+        for (int i = 1; i <= count; ++i)
+            text += QString("line %1\n").arg(i);
+        return text;
+    }
+
+private slots:
+    void testExactEdit() {
+        const QString content = "int a = 1;\nint b = 2;\nint c = 3;\n";
+        const auto result = PatchEngine::applyEdits(content, {{"int b = 2;", "int b = 20;"}});
+        QVERIFY2(result.success, qPrintable(result.errorString));
+        QCOMPARE(result.content, QString("int a = 1;\nint b = 20;\nint c = 3;\n"));
+        QCOMPARE(result.applied, 1);
+        QVERIFY(result.notes.isEmpty());
+    }
+
+    void testEditsApplyInOrder() {
+        const auto result = PatchEngine::applyEdits("a\nb\nc\n", {{"a\n", "x\n"}, {"x\nb", "y"}});
+        QVERIFY2(result.success, qPrintable(result.errorString));
+        QCOMPARE(result.content, QString("y\nc\n"));
+        QCOMPARE(result.applied, 2);
+    }
+
+    void testAmbiguousEdit() {
+        const auto result = PatchEngine::applyEdits("x = 0;\ny = 1;\nx = 0;\n", {{"x = 0;", "x = 2;"}});
+        QVERIFY(!result.success);
+        QVERIFY(result.errorString.contains("occurs 2 times, at lines 1, 3"));
+    }
+
+    void testWhitespaceTolerantEdit() {
+        const QString content = "void f()\n{\n        if (a)   \n            g();\n}\n";
+
+        // Trailing whitespace the model left out.
+        auto result = PatchEngine::applyEdits(content, {{"        if (a)\n            g();", "        if (b)\n            g();"}});
+        QVERIFY2(result.success, qPrintable(result.errorString));
+        QCOMPARE(result.content, QString("void f()\n{\n        if (b)\n            g();\n}\n"));
+        QCOMPARE(result.notes.size(), 1);
+        QVERIFY(result.notes.first().contains("trailing whitespace"));
+
+        // Indented differently: the replacement follows the file's indentation.
+        result = PatchEngine::applyEdits(content, {{"if (a)\n    g();", "if (a) {\n    g();\n    h();\n}"}});
+        QVERIFY2(result.success, qPrintable(result.errorString));
+        QCOMPARE(result.content, QString("void f()\n{\n        if (a) {\n            g();\n            h();\n        }\n}\n"));
+        QVERIFY(result.notes.first().contains("lines 3-4 ignoring indentation"));
+    }
+
+    void testEditNotFound() {
+        const QString content = "int main()\n{\n    return 0;\n}\n";
+        const auto result = PatchEngine::applyEdits(content, {{"x", "y"}, {"int main()\n{\n    return 1;\n}", "int main() {}"}});
+        QVERIFY(!result.success);
+        QVERIFY(result.content.isEmpty());
+        QVERIFY(result.errorString.startsWith("Edit 1:"));
+
+        const auto second = PatchEngine::applyEdits(content, {{"int main()\n{\n    return 1;\n}", "int main() {}"}});
+        QVERIFY(second.errorString.contains("closest match is at lines 1-4, where 3 of 4 lines are equal"));
+        QVERIFY(second.errorString.contains("Line 3 is \"return 0;\", not \"return 1;\""));
+    }
+
+    void testEmptySearch() {
+        auto result = PatchEngine::applyEdits(QString(), {{QString(), "new file\n"}});
+        QVERIFY(result.success);
+        QCOMPARE(result.content, QString("new file\n"));
+
+        result = PatchEngine::applyEdits("old\n", {{QString(), "new\n"}});
+        QVERIFY(!result.success);
+    }
+
+    void testUnifiedDiff() {
+        const QString diff =
+            "--- a/file.txt\n"
+            "+++ b/file.txt\n"
+            "@@ -2,3 +2,3 @@\n"
+            " line 2\n"
+            "-line 3\n"
+            "+line three\n"
+            " line 4\n"
+            "@@ -8,3 +8,4 @@\n"
+            " line 8\n"
+            " line 9\n"
+            "+line 9.5\n"
+            " line 10\n";
+        const auto result = PatchEngine::applyUnifiedDiff(numberedLines(10), diff);
+        QVERIFY2(result.success, qPrintable(result.errorString));
+        QCOMPARE(result.applied, 2);
+        QVERIFY(result.notes.isEmpty());
+        QString expected = numberedLines(10);
+        expected.replace("line 3\n", "line three\n").replace("line 9\n", "line 9\nline 9.5\n");
+        QCOMPARE(result.content, expected);
+    }
+
+    void testDiffWithOffsetAndFuzz() {
+        // Two lines were added at the top since the diff was made, and one context line changed.
+        const QString content = "added 1\nadded 2\n" + numberedLines(10).replace("line 7\n", "line seven\n");
+        const QString diff =
+            "@@ -5,5 +5,5 @@\n"
+            " line 5\n"
+            " line 6\n"
+            "-line 7\n"
+            "+line 7 changed\n"
+            " line 8\n"
+            " line 9\n";
+        auto result = PatchEngine::applyUnifiedDiff(content, diff);
+        QVERIFY(!result.success);
+        QVERIFY(result.errorString.startsWith("Hunk 1 (at line 5) does not apply."));
+        QVERIFY(result.errorString.contains("Line 9 is \"line seven\", not \"line 7\""));
+
+        const QString fuzzy =
+            "@@ -5,5 +5,5 @@\n"
+            " line 5\n"
+            " line 6\n"
+            "-line 6.5\n"
+            "+line 6.5 changed\n"
+            " line 7\n"
+            " line 8\n";
+        QString changed = "added 1\nadded 2\n" + numberedLines(10);
+        changed.replace("line 5\n", "line five\n").replace("line 6\n", "line 6\nline 6.5\n");
+        result = PatchEngine::applyUnifiedDiff(changed, fuzzy);
+        QVERIFY2(result.success, qPrintable(result.errorString));
+        QVERIFY(result.content.contains("line 6\nline 6.5 changed\nline 7\n"));
+        QCOMPARE(result.notes.size(), 1);
+        QVERIFY(result.notes.first().contains("offset 2 lines"));
+        QVERIFY(result.notes.first().contains("fuzz 1"));
+    }
+
+    void testDiffClosestToLineNumber() {
+        // The same lines twice: the hunk goes to the occurrence its header names.
+        const QString content = "begin\nx\nend\nbegin\nx\nend\n";
+        const auto result = PatchEngine::applyUnifiedDiff(content, "@@ -4,3 +4,3 @@\n begin\n-x\n+y\n end\n");
+        QVERIFY2(result.success, qPrintable(result.errorString));
+        QCOMPARE(result.content, QString("begin\nx\nend\nbegin\ny\nend\n"));
+
+        const auto ambiguous = PatchEngine::applyUnifiedDiff(content, "@@\n begin\n-x\n+y\n end\n");
+        QVERIFY(!ambiguous.success);
+        QVERIFY(ambiguous.errorString.contains("matches 2 places"));
+    }
+
+    void testDiffInsertions() {
+        auto result = PatchEngine::applyUnifiedDiff(QString(), "--- /dev/null\n+++ b/new.txt\n@@ -0,0 +1,2 @@\n+one\n+two\n");
+        QVERIFY2(result.success, qPrintable(result.errorString));
+        QCOMPARE(result.content, QString("one\ntwo\n"));
+
+        result = PatchEngine::applyUnifiedDiff("a\nb\n", "@@ -1,0 +2 @@\n+between\n\\ No newline at end of file\n");
+        QVERIFY2(result.success, qPrintable(result.errorString));
+        QCOMPARE(result.content, QString("a\nbetween\nb\n"));
+    }
+
+    void testDiffErrors() {
+        auto result = PatchEngine::applyUnifiedDiff("a\n", "just some text\n");
+        QVERIFY(!result.success);
+        QVERIFY(result.errorString.contains("no hunks"));
+
+        result = PatchEngine::applyUnifiedDiff("a\n", "@@ -1 +1 @@\n-a\n+b\n--- a/other\n+++ b/other\n@@ -1 +1 @@\n-c\n+d\n");
+        QVERIFY(!result.success);
+        QVERIFY(result.errorString.contains("more than one file"));
+
+        // Nothing applies when a later hunk fails.
+        result = PatchEngine::applyUnifiedDiff(numberedLines(10), "@@ -1 +1 @@\n-line 1\n+line one\n@@ -5 +5 @@\n-line 50\n+line fifty\n");
+        QVERIFY(!result.success);
+        QVERIFY(result.content.isEmpty());
+        QVERIFY(result.errorString.startsWith("Hunk 2 (at line 5) does not apply."));
+    }
+};
+
+QTEST_MAIN(TestPatchEngine)
+#include "tst_patchengine.moc"
@@ -0,0 +1,37 @@
+#include <QtTest>
+#include "../src/providers/providerregistry.h"
+#include "../src/providers/openai/openaiprovider.h"
+#include "../src/providers/ollama/ollamaprovider.h"
+
+class TestProviderRegistry : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testReusesInstancePerProfile() {
+        ProviderRegistry registry;
+        ProviderRegistry::Profile profile{"OpenAI", "http://localhost:1234/v1", "model-a", ""};
+
+        LLMProvider *first = registry.provider(profile);
+        QVERIFY(qobject_cast<OpenAIProvider *>(first));
+        QCOMPARE(registry.provider(profile), first);
+
+        // A changed model reconfigures the same instance instead of creating a new one.
+        profile.model = "model-b";
+        QCOMPARE(registry.provider(profile), first);
+        QCOMPARE(registry.providers().size(), 1);
+    }
+
+    void testSeparateInstancePerType() {
+        ProviderRegistry registry;
+        LLMProvider *openai = registry.provider({"OpenAI", "http://localhost:1234/v1", "m", ""});
+        LLMProvider *ollama = registry.provider({"Ollama", "http://localhost:11434", "m", ""});
+        QVERIFY(qobject_cast<OllamaProvider *>(ollama));
+        QVERIFY(openai != ollama);
+        QCOMPARE(registry.provider({"OpenAI", "http://localhost:1234/v1", "m", ""}), openai);
+        QCOMPARE(registry.providers().size(), 2);
+    }
+};
+
+QTEST_MAIN(TestProviderRegistry)
+#include "tst_providerregistry.moc"
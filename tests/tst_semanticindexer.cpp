@@ -0,0 +1,259 @@
+#include <QtTest>
+#include <QHttpServer>
+#include <QHttpServerRequest>
+#include <QHttpServerResponse>
+#include <QTemporaryDir>
+#include "../src/rag/chunker.h"
+#include "../src/rag/semanticindexer.h"
+
+// Stands in for Ollama's /api/embed with bag-of-words vectors: texts that share
+// words are similar, texts that share none are orthogonal.
+class FakeEmbeddingServer
+{
+public:
+    static constexpr int Dimensions = 64;
+
+    FakeEmbeddingServer() {
+        m_server.route("/api/embed", [this](const QHttpServerRequest &request) {
+            const QJsonObject body = QJsonDocument::fromJson(request.body()).object();
+            QJsonArray embeddings;
+            for (const QJsonValue &input : body["input"].toArray()) {
+                ++texts;
+                embeddings.append(embed(input.toString()));
+            }
+            return QHttpServerResponse(QJsonObject{{"model", body["model"]}, {"embeddings", embeddings}});
+        });
+        port = m_server.listen(QHostAddress::LocalHost);
+    }
+
+    QUrl url() const { return QUrl(QString("http://localhost:%1").arg(port)); }
+
+    static QJsonArray embed(const QString &text) {
+        QList<double> vector(Dimensions, 0.0);
+        static const QRegularExpression word("[a-z]+");
+        for (auto it = word.globalMatch(text.toLower()); it.hasNext();)
+            vector[qHash(it.next().captured()) % Dimensions] += 1;
+        QJsonArray values;
+        for (double value : vector)
+            values.append(value);
+        return values;
+    }
+
+    quint16 port = 0;
+    int texts = 0;
+
+private:
+    QHttpServer m_server;
+};
+
+class TestSemanticIndexer : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void writeFile(const QString &path, const QByteArray &content) {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(content);
+    }
+
+    static void writeProject(const QString &root) {
+        writeFile(root + "/src/garden.cpp", "// apple banana cherry orchard\nint fruit() { return 1; }\n");
+        writeFile(root + "/src/vehicle.cpp", "// engine wheel brake gearbox\nint drive() { return 2; }\n");
+        writeFile(root + "/data.bin", QByteArray("engine\0wheel", 12));
+        writeFile(root + "/build/generated.cpp", "// engine wheel brake gearbox\n");
+        writeFile(root + "/.gitignore", "build/\n");
+    }
+
+private slots:
+    void testChunker() {
+        QString text;
+        for (int i = 1; i <= 150; ++i)
+            text += (i % 35 == 0 ? QString() : QString("line %1").arg(i)) + '\n';
+
+        Chunker::Options options;
+        options.maxLines = 40;
+        options.overlapLines = 5;
+        const auto chunks = Chunker::chunk(text, options);
+        QVERIFY(chunks.size() >= 4);
+        QCOMPARE(chunks.first().startLine, 1);
+        QCOMPARE(chunks.last().endLine, 150);   // Not the empty line after the last newline.
+        for (qsizetype i = 0; i < chunks.size(); ++i) {
+            QVERIFY(chunks[i].endLine - chunks[i].startLine < options.maxLines);
+            QCOMPARE(chunks[i].text.count('\n'), chunks[i].endLine - chunks[i].startLine);
+            if (i > 0) {
+                // Consecutive chunks overlap and leave no gap.
+                QVERIFY(chunks[i].startLine <= chunks[i - 1].endLine + 1);
+                QVERIFY(chunks[i].startLine > chunks[i - 1].startLine);
+            }
+        }
+        // The first window ends at the blank line 35 rather than in the middle of a block.
+        QCOMPARE(chunks.first().endLine, 35);
+    }
+
+    void testChunkerLimitsCharacters() {
+        const QString line(300, 'x');
+        QString text;
+        for (int i = 0; i < 20; ++i)
+            text += line + '\n';
+        Chunker::Options options;
+        options.maxChars = 1000;
+        for (const auto &chunk : Chunker::chunk(text, options))
+            QVERIFY(chunk.text.size() <= 1000);
+
+        QVERIFY(Chunker::chunk(QString("\n\n  \n"), options).isEmpty());
+        QVERIFY(Chunker::isIndexable("main.cpp"));
+        QVERIFY(Chunker::isIndexable("CMakeLists.txt"));
+        QVERIFY(!Chunker::isIndexable("image.png"));
+    }
+
+    void testIndexAndSearch() {
+        FakeEmbeddingServer server;
+        QVERIFY(server.port != 0);
+        QTemporaryDir dir;
+        writeProject(dir.path());
+
+        QTemporaryDir cacheDir;
+        SemanticIndexer indexer;
+        indexer.setCacheDirectory(cacheDir.path());
+        indexer.setCpuLimit(1.0);
+        indexer.setEmbeddingModel(server.url(), "test-embed");
+        indexer.setProjectPath(dir.path());
+        QTRY_VERIFY_WITH_TIMEOUT(indexer.isReady(), 10000);
+        QVERIFY(indexer.errorString().isEmpty());
+        // Binary and ignored files are left out.
+        QCOMPARE(indexer.chunkCount(), 2);
+        QVERIFY(QFile::exists(SemanticIndexer::indexFilePath(dir.path(), "test-embed")));
+
+        QString error;
+        const auto results = indexer.search("which code handles the brake and the wheel?", 2, &error);
+        QVERIFY2(error.isEmpty(), qPrintable(error));
+        QCOMPARE(results.size(), 2);
+        QCOMPARE(results[0].filePath, dir.path() + "/src/vehicle.cpp");
+        QCOMPARE(results[0].startLine, 1);
+        QCOMPARE(results[0].endLine, 2);
+        QVERIFY(results[0].text.contains("gearbox"));
+        QVERIFY(results[0].score > results[1].score);
+    }
+
+    void testReloadAndUpdate() {
+        FakeEmbeddingServer server;
+        QTemporaryDir dir;
+        QTemporaryDir cacheDir;
+        writeProject(dir.path());
+        {
+            SemanticIndexer indexer;
+            indexer.setCacheDirectory(cacheDir.path());
+            indexer.setCpuLimit(1.0);
+            indexer.setEmbeddingModel(server.url(), "test-embed");
+            indexer.setProjectPath(dir.path());
+            QTRY_VERIFY_WITH_TIMEOUT(indexer.isReady(), 10000);
+        }
+        QCOMPARE(server.texts, 2);
+
+        // Loaded from disk: nothing is embedded again, except a file that changed meanwhile.
+        writeFile(dir.path() + "/src/garden.cpp", "// apple pear plum\nint fruit() { return 3; }\n");
+        SemanticIndexer indexer;
+        indexer.setCacheDirectory(cacheDir.path());
+        indexer.setCpuLimit(1.0);
+        indexer.setEmbeddingModel(server.url(), "test-embed");
+        indexer.setProjectPath(dir.path());
+        QTRY_VERIFY_WITH_TIMEOUT(indexer.isReady(), 10000);
+        QCOMPARE(server.texts, 3);
+        QCOMPARE(indexer.chunkCount(), 2);
+
+        QString error;
+        auto results = indexer.search("plum", 1, &error);
+        QCOMPARE(results.size(), 1);
+        QVERIFY(results[0].text.contains("plum"));
+
+        // Reported by a tool.
+        writeFile(dir.path() + "/docs/notes.md", "The telescope mirror needs polishing.\n");
+        indexer.updateFiles({dir.path() + "/docs/notes.md"});
+        QTRY_COMPARE_WITH_TIMEOUT(indexer.chunkCount(), 3, 10000);
+        results = indexer.search("telescope mirror", 1, &error);
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results[0].filePath, dir.path() + "/docs/notes.md");
+
+        QFile::remove(dir.path() + "/docs/notes.md");
+        indexer.updateFiles({dir.path() + "/docs/notes.md"});
+        QTRY_COMPARE_WITH_TIMEOUT(indexer.chunkCount(), 2, 10000);
+    }
+
+    void testCacheAcrossProjects() {
+        FakeEmbeddingServer server;
+        QTemporaryDir cacheDir;
+        QTemporaryDir first;
+        QTemporaryDir second;
+        writeProject(first.path());
+        writeProject(second.path());
+        writeFile(second.path() + "/src/extra.cpp", "// submarine periscope\n");
+
+        SemanticIndexer indexer;
+        indexer.setCacheDirectory(cacheDir.path());
+        indexer.setCpuLimit(1.0);
+        indexer.setEmbeddingModel(server.url(), "test-embed");
+        indexer.setProjectPath(first.path());
+        QTRY_VERIFY_WITH_TIMEOUT(indexer.isReady(), 10000);
+        QCOMPARE(server.texts, 2);
+        QCOMPARE(indexer.cacheStats().misses, 2);
+
+        // Another checkout of the same files: only the new chunk goes to the server.
+        indexer.setProjectPath(second.path());
+        QTRY_VERIFY_WITH_TIMEOUT(indexer.isReady(), 10000);
+        QCOMPARE(indexer.chunkCount(), 3);
+        QCOMPARE(server.texts, 3);
+        QCOMPARE(indexer.cacheStats().hits, 2);
+        QCOMPARE(indexer.cacheStats().misses, 1);
+
+        // The index is gone, the cache file is not.
+        QVERIFY(QDir(first.path() + "/.qtagent").removeRecursively());
+        SemanticIndexer restarted;
+        restarted.setCacheDirectory(cacheDir.path());
+        restarted.setCpuLimit(1.0);
+        restarted.setEmbeddingModel(server.url(), "test-embed");
+        restarted.setProjectPath(first.path());
+        QTRY_VERIFY_WITH_TIMEOUT(restarted.isReady(), 10000);
+        QCOMPARE(server.texts, 3);
+        QCOMPARE(restarted.cacheStats().hitRate(), 1.0);
+
+        QString error;
+        const auto results = restarted.search("orchard cherry", 1, &error);
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results[0].filePath, first.path() + "/src/garden.cpp");
+    }
+
+    void testServerUnavailable() {
+        // A port nobody listens on.
+        quint16 port = 0;
+        {
+            FakeEmbeddingServer server;
+            port = server.port;
+        }
+        QTemporaryDir dir;
+        writeProject(dir.path());
+
+        QTemporaryDir cacheDir;
+        SemanticIndexer indexer;
+        indexer.setCacheDirectory(cacheDir.path());
+        indexer.setEmbeddingModel(QUrl(QString("http://localhost:%1").arg(port)), "test-embed");
+        indexer.setProjectPath(dir.path());
+        QTRY_VERIFY_WITH_TIMEOUT(!indexer.errorString().isEmpty(), 10000);
+        QVERIFY(!indexer.isIndexing());
+        QVERIFY(!indexer.isReady());
+
+        QString error;
+        QVERIFY(indexer.search("engine", 5, &error).isEmpty());
+        QVERIFY(error.contains("Retrying"));
+
+        // Disabled without a model.
+        indexer.setEmbeddingModel(QUrl(), QString());
+        QVERIFY(!indexer.isEnabled());
+        QVERIFY(indexer.search("engine", 5, &error).isEmpty());
+        QVERIFY(error.contains("disabled"));
+    }
+};
+
+QTEST_MAIN(TestSemanticIndexer)
+#include "tst_semanticindexer.moc"
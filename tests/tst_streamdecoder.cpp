@@ -0,0 +1,76 @@
+#include <QtTest>
+#include "../src/providers/base/streamdecoder.h"
+
+class TestStreamDecoder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testSingleChunk() {
+        StreamDecoder decoder;
+        auto events = decoder.feed("data: {\"a\":1}\n\ndata: {\"b\":2}\n\n");
+        QCOMPARE(events.size(), 2);
+        QCOMPARE(events[0].data, QByteArray("{\"a\":1}"));
+        QCOMPARE(events[1].data, QByteArray("{\"b\":2}"));
+        QVERIFY(decoder.hasSeenEvents());
+    }
+
+    void testEventSplitAcrossChunks() {
+        StreamDecoder decoder;
+        QVERIFY(decoder.feed("data: {\"con").isEmpty());
+        QVERIFY(decoder.feed("tent\":\"Hel").isEmpty());
+        auto events = decoder.feed("lo\"}\n\n");
+        QCOMPARE(events.size(), 1);
+        QCOMPARE(events[0].data, QByteArray("{\"content\":\"Hello\"}"));
+    }
+
+    void testUtf8SplitAcrossChunks() {
+        // "é" is 0xC3 0xA9, split between the two chunks.
+        const QByteArray payload = QString("data: café\n\n").toUtf8();
+        const qsizetype split = payload.indexOf('\xc3') + 1;
+
+        StreamDecoder decoder;
+        QVERIFY(decoder.feed(payload.left(split)).isEmpty());
+        auto events = decoder.feed(payload.mid(split));
+        QCOMPARE(events.size(), 1);
+        QCOMPARE(QString::fromUtf8(events[0].data), QString("café"));
+    }
+
+    void testEventNameAndMultiLineData() {
+        StreamDecoder decoder;
+        auto events = decoder.feed("event: content_block_delta\r\ndata: line1\r\ndata: line2\r\n\r\n");
+        QCOMPARE(events.size(), 1);
+        QCOMPARE(events[0].name, QByteArray("content_block_delta"));
+        QCOMPARE(events[0].data, QByteArray("line1\nline2"));
+    }
+
+    void testCommentsAndFinish() {
+        StreamDecoder decoder;
+        auto events = decoder.feed(": keep-alive\n\ndata: [DONE]");
+        QVERIFY(events.isEmpty());
+        events = decoder.finish();
+        QCOMPARE(events.size(), 1);
+        QCOMPARE(events[0].data, QByteArray("[DONE]"));
+    }
+
+    void testUnrecognized() {
+        StreamDecoder decoder;
+        auto events = decoder.feed("{\"error\": \"Unexpected endpoint\"}\n");
+        QVERIFY(events.isEmpty());
+        QVERIFY(!decoder.hasSeenEvents());
+        QCOMPARE(decoder.takeUnrecognized(), QByteArray("{\"error\": \"Unexpected endpoint\"}\n"));
+        QVERIFY(decoder.takeUnrecognized().isEmpty());
+    }
+
+    void testNdjson() {
+        StreamDecoder decoder(StreamDecoder::NewlineDelimitedJson);
+        auto events = decoder.feed("{\"message\":{\"content\":\"a\"}}\n{\"mess");
+        QCOMPARE(events.size(), 1);
+        events = decoder.feed("age\":{\"content\":\"b\"}}\n\n");
+        QCOMPARE(events.size(), 1);
+        QCOMPARE(events[0].data, QByteArray("{\"message\":{\"content\":\"b\"}}"));
+    }
+};
+
+QTEST_MAIN(TestStreamDecoder)
+#include "tst_streamdecoder.moc"
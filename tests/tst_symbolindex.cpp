@@ -0,0 +1,199 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "../src/core/symbolindex.h"
+
+class TestSymbolIndex : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void writeFile(const QString &path, const QByteArray &content) {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(content);
+    }
+
+    // "kind qualified_name line", sorted, with an 'd' suffix for declarations.
+    static QStringList describe(const QList<SymbolIndex::Symbol> &symbols) {
+        QStringList result;
+        for (const auto &symbol : symbols) {
+            result << QString("%1 %2 %3%4")
+                          .arg(SymbolIndex::kindName(symbol.kind), symbol.qualifiedName())
+                          .arg(symbol.line)
+                          .arg(symbol.isDefinition ? "" : "d");
+        }
+        result.sort();
+        return result;
+    }
+
+    static const SymbolIndex::Symbol *findSymbol(const QList<SymbolIndex::Symbol> &symbols, const QString &name) {
+        for (const auto &symbol : symbols) {
+            if (symbol.name == name)
+                return &symbol;
+        }
+        return nullptr;
+    }
+
+private slots:
+    void testScanClass() {
+        const QByteArray source =
+            "#ifndef WIDGET_H\n"                                           // 1
+            "#define WIDGET_H\n"                                           // 2
+            "#define MAX_ITEMS 10\n"                                       // 3
+            "namespace ui {\n"                                             // 4
+            "class QLP_EXPORT Widget : public QObject, private Base<int>\n" // 5
+            "{\n"                                                          // 6
+            "    Q_OBJECT\n"                                               // 7
+            "    Q_PROPERTY(int count READ count)\n"                       // 8
+            "public:\n"                                                    // 9
+            "    explicit Widget(QObject *parent = nullptr);\n"            // 10
+            "    ~Widget() override;\n"                                    // 11
+            "    int count() const { return m_count; }\n"                  // 12
+            "    bool operator==(const Widget &other) const;\n"            // 13
+            "    enum class Mode { A, B };\n"                              // 14
+            "signals:\n"                                                   // 15
+            "    void changed(int value);\n"                               // 16
+            "private:\n"                                                   // 17
+            "    int m_count = 0; // { not a brace\n"                      // 18
+            "    QHash<QString, int> m_names, m_ids;\n"                    // 19
+            "    std::function<void(int)> m_callback;\n"                   // 20
+            "    friend class Helper;\n"                                   // 21
+            "};\n"                                                         // 22
+            "using WidgetList = QList<Widget *>;\n"                        // 23
+            "typedef void (*Callback)(int);\n"                             // 24
+            "} // namespace ui\n"                                          // 25
+            "#endif\n";                                                    // 26
+
+        const auto symbols = SymbolIndex::scan(source);
+        QCOMPARE(describe(symbols), QStringList({
+            "class ui::Widget 5",
+            "enum ui::Widget::Mode 14",
+            "field ui::Widget::m_callback 20",
+            "field ui::Widget::m_count 18",
+            "field ui::Widget::m_ids 19",
+            "field ui::Widget::m_names 19",
+            "macro MAX_ITEMS 3",
+            "method ui::Widget::Widget 10d",
+            "method ui::Widget::changed 16d",
+            "method ui::Widget::count 12",
+            "method ui::Widget::operator== 13d",
+            "method ui::Widget::~Widget 11d",
+            "namespace ui 4",
+            "typedef ui::Callback 24",
+            "typedef ui::WidgetList 23",
+        }));
+
+        const auto *widget = findSymbol(symbols, "Widget");
+        QVERIFY(widget);
+        QCOMPARE(widget->kind, SymbolIndex::Class);
+        QCOMPARE(widget->bases, QStringList({"QObject", "Base<int>"}));
+    }
+
+    void testScanSource() {
+        const QByteArray source =
+            "#include \"widget.h\"\n"                                       // 1
+            "namespace {\n"                                                // 2
+            "const char *names[] = {\"a{\", \"b\"};\n"                     // 3
+            "int helper(int a) { if (a) { return 1; } return 0; }\n"       // 4
+            "}\n"                                                          // 5
+            "Widget::Widget(QObject *parent)\n"                            // 6
+            "    : QObject(parent)\n"                                      // 7
+            "    , m_names{}\n"                                            // 8
+            "{\n"                                                          // 9
+            "    auto f = [this]() { return m_count; };\n"                 // 10
+            "}\n"                                                          // 11
+            "template<typename T>\n"                                       // 12
+            "T *Registry<T>::create(const QString &name) const\n"          // 13
+            "{\n"                                                          // 14
+            "    return R\"(raw } string)\" ? nullptr : nullptr;\n"         // 15
+            "}\n"                                                          // 16
+            "TEST(Widget, Works)\n"                                        // 17
+            "{\n"                                                          // 18
+            "}\n"                                                          // 19
+            "static void freeFunction() noexcept {}\n"                     // 20
+            "extern \"C\" {\n"                                             // 21
+            "int c_api(void);\n"                                           // 22
+            "}\n";                                                         // 23
+
+        QCOMPARE(describe(SymbolIndex::scan(source)), QStringList({
+            "function c_api 22d",
+            "function freeFunction 20",
+            "function helper 4",
+            "method Registry::create 13",
+            "method Widget::Widget 6",
+            "variable names 3",
+        }));
+    }
+
+    void testFindAndOutline() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        writeFile(dir.path() + "/src/widget.h",
+                  "namespace ui {\n"
+                  "class Widget {\n"
+                  "public:\n"
+                  "    void show();\n"
+                  "    int m_size = 0;\n"
+                  "};\n"
+                  "}\n");
+        writeFile(dir.path() + "/src/widget.cpp",
+                  "#include \"widget.h\"\n"
+                  "namespace ui {\n"
+                  "void Widget::show()\n"
+                  "{\n"
+                  "}\n"
+                  "}\n");
+        writeFile(dir.path() + "/README.md", "class NotCode {};\n");
+
+        SymbolIndex index;
+        index.setProjectPath(dir.path());
+        QTRY_VERIFY_WITH_TIMEOUT(index.isReady(), 5000);
+
+        const auto show = index.find("show");
+        QCOMPARE(show.size(), 2);
+        // The definition comes first, with its signature and an absolute path.
+        QVERIFY(show[0].isDefinition);
+        QCOMPARE(show[0].filePath, dir.path() + "/src/widget.cpp");
+        QCOMPARE(show[0].signature, QString("void Widget::show()"));
+        QCOMPARE(show[1].signature, QString("void show()"));
+
+        QCOMPARE(index.find("ui::Widget::show").size(), 2);
+        QCOMPARE(index.find("Other::show").size(), 0);
+        QCOMPARE(index.find("NotCode").size(), 0);
+
+        SymbolIndex::Symbol widget;
+        const auto members = index.classOutline("Widget", &widget);
+        QCOMPARE(widget.qualifiedName(), QString("ui::Widget"));
+        QCOMPARE(widget.line, 2);
+        QCOMPARE(describe(members), QStringList({"field ui::Widget::m_size 5", "method ui::Widget::show 4d"}));
+    }
+
+    void testUpdates() {
+        QTemporaryDir dir;
+        writeFile(dir.path() + "/a.cpp", "int first() { return 1; }\n");
+
+        SymbolIndex index;
+        index.setProjectPath(dir.path());
+        QTRY_VERIFY_WITH_TIMEOUT(index.isReady(), 5000);
+        QCOMPARE(index.find("first").size(), 1);
+
+        // Reported by a tool.
+        writeFile(dir.path() + "/b.cpp", "int second() { return 2; }\n");
+        index.updateFiles({dir.path() + "/b.cpp"});
+        QTRY_COMPARE_WITH_TIMEOUT(index.find("second").size(), 1, 5000);
+
+        // Changed behind the index's back, noticed by the lookup.
+        QTest::qWait(20);
+        writeFile(dir.path() + "/a.cpp", "\nint first(int changed) { return changed; }\n");
+        const auto first = index.find("first");
+        QCOMPARE(first.size(), 1);
+        QCOMPARE(first[0].line, 2);
+
+        QFile::remove(dir.path() + "/b.cpp");
+        QCOMPARE(index.find("second").size(), 0);
+    }
+};
+
+QTEST_MAIN(TestSymbolIndex)
+#include "tst_symbolindex.moc"
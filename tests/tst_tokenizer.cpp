@@ -0,0 +1,107 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "../src/core/tokenizer.h"
+
+class TestTokenizer : public QObject
+{
+    Q_OBJECT
+
+private:
+    // All single bytes plus a few merges, in tiktoken's rank file format.
+    static QByteArray tiktokenVocab() {
+        QByteArray data;
+        for (int b = 0; b < 256; ++b)
+            data += QByteArray(1, char(b)).toBase64() + ' ' + QByteArray::number(b) + '\n';
+        data += QByteArray("he").toBase64() + " 256\n";
+        data += QByteArray("ll").toBase64() + " 257\n";
+        data += QByteArray("hell").toBase64() + " 258\n";
+        data += QByteArray(" world").toBase64() + " 259\n";
+        return data;
+    }
+
+    static QStringList pieces(const QString &text) {
+        const QByteArray utf8 = text.toUtf8();
+        QStringList result;
+        for (const QByteArrayView piece : Tokenizer::preTokenize(utf8))
+            result << QString::fromUtf8(piece);
+        return result;
+    }
+
+private slots:
+    void testPreTokenize_data() {
+        QTest::addColumn<QString>("text");
+        QTest::addColumn<QStringList>("expected");
+
+        QTest::newRow("words") << "Hello world" << QStringList{"Hello", " world"};
+        QTest::newRow("contraction") << "I'm here" << QStringList{"I", "'m", " here"};
+        QTest::newRow("numbers") << "x = 12345;" << QStringList{"x", " =", " ", "123", "45", ";"};
+        QTest::newRow("code") << "    return x;\n}\n"
+                              << QStringList{"   ", " return", " x", ";\n", "}\n"};
+        QTest::newRow("blank lines") << "a\n\n  b" << QStringList{"a", "\n\n", " ", " b"};
+        QTest::newRow("trailing spaces") << "x  " << QStringList{"x", "  "};
+        QTest::newRow("unicode") << "héllo wörld 中文" << QStringList{"héllo", " wörld", " 中文"};
+        QTest::newRow("punctuation prefix") << "obj.method()" << QStringList{"obj", ".method", "()"};
+    }
+
+    void testPreTokenize() {
+        QFETCH(QString, text);
+        QFETCH(QStringList, expected);
+        QCOMPARE(pieces(text), expected);
+        QCOMPARE(pieces(text).join(QString()), text);
+    }
+
+    void testTiktoken() {
+        Tokenizer tokenizer;
+        QString error;
+        QVERIFY2(tokenizer.loadTiktoken(tiktokenVocab(), &error), qPrintable(error));
+        QCOMPARE(tokenizer.format(), Tokenizer::Tiktoken);
+        QCOMPARE(tokenizer.vocabularySize(), 260);
+
+        // h e l l o -> he l l o -> he ll o -> hell o
+        QCOMPARE(tokenizer.encode("hello"), QList<int>({258, 'o'}));
+        QCOMPARE(tokenizer.encode("hello world"), QList<int>({258, 'o', 259}));
+        QCOMPARE(tokenizer.countTokens("hello world"), 3);
+        QCOMPARE(tokenizer.decode(tokenizer.encode("hello wörld")), QString("hello wörld").toUtf8());
+        QCOMPARE(tokenizer.countTokens(QString()), 0);
+    }
+
+    void testLoadFile() {
+        QTemporaryDir dir;
+        QFile file(dir.filePath("test.tiktoken"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(tiktokenVocab());
+        file.close();
+
+        Tokenizer tokenizer;
+        QVERIFY(tokenizer.load(file.fileName()));
+        QCOMPARE(tokenizer.format(), Tokenizer::Tiktoken);
+
+        QString error;
+        QVERIFY(!tokenizer.load(dir.filePath("missing.tiktoken"), &error));
+        QVERIFY(!error.isEmpty());
+        QVERIFY(!tokenizer.loadTiktoken("not base64!! x\n", &error));
+        QVERIFY(!tokenizer.isValid());
+    }
+
+    void testSentencePiece() {
+        const QByteArray vocab =
+            "<unk>\t0\n<s>\t0\n</s>\t0\n<0x0A>\t0\n"
+            "\xE2\x96\x81\t-1\nh\t-2\ne\t-2\nl\t-2\no\t-2\n"
+            "\xE2\x96\x81h\t-3\nhe\t-4\nll\t-2.5\nllo\t-1.2\n"
+            "\xE2\x96\x81he\t-1.5\n\xE2\x96\x81hello\t-0.5\n";
+
+        Tokenizer tokenizer;
+        QString error;
+        QVERIFY2(tokenizer.loadSentencePiece(vocab, &error), qPrintable(error));
+        QCOMPARE(tokenizer.format(), Tokenizer::SentencePiece);
+
+        // ▁ h e l l o -> ▁ h e ll o -> ▁ h e llo -> ▁h e llo -> ▁he llo -> ▁hello
+        QCOMPARE(tokenizer.encode("hello"), QList<int>({14}));
+        // The newline falls back to its byte token, "z" has neither and is unknown.
+        QCOMPARE(tokenizer.encode("hello\nz"), QList<int>({14, 3, 0}));
+        QCOMPARE(tokenizer.decode({14, 3}), QByteArray("hello\n"));
+    }
+};
+
+QTEST_MAIN(TestTokenizer)
+#include "tst_tokenizer.moc"
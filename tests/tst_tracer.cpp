@@ -0,0 +1,104 @@
+#include <QtTest>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+#include <QThread>
+#include "../src/core/tracer.h"
+
+class TestTracer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init() {
+        Tracer::instance().clear();
+    }
+
+    void cleanup() {
+        Tracer::instance().setOutputFile(QString());
+        Tracer::instance().clear();
+    }
+
+    void testDisabledRecordsNothing() {
+        Tracer::instance().setOutputFile(QString());
+        {
+            TraceSpan span("noop");
+            span.setArg("x", 1);
+        }
+        Tracer::instance().instant("noop", "test");
+        QVERIFY(Tracer::instance().events().isEmpty());
+        QVERIFY(!Tracer::instance().flush());
+    }
+
+    void testSpans() {
+        QTemporaryDir dir;
+        const QString path = dir.filePath("trace.json");
+        Tracer::instance().setOutputFile(path);
+
+        {
+            TraceSpan outer("outer", "test");
+            outer.setArg("messages", 3);
+            TraceSpan inner("inner", "test");
+            QTest::qSleep(2);
+        }
+        Tracer::instance().asyncBegin("request", "network", 7);
+        Tracer::instance().asyncEnd("request", "network", 7, {{"completionTokens", 12}});
+
+        QVERIFY(Tracer::instance().flush());
+
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QJsonArray events = QJsonDocument::fromJson(file.readAll()).object()["traceEvents"].toArray();
+
+        QJsonObject outer, inner, begin, end;
+        int threadNames = 0;
+        for (const auto &value : events) {
+            const QJsonObject event = value.toObject();
+            const QString name = event["name"].toString();
+            if (name == "outer") outer = event;
+            else if (name == "inner") inner = event;
+            else if (name == "thread_name") ++threadNames;
+            else if (event["ph"] == "b") begin = event;
+            else if (event["ph"] == "e") end = event;
+        }
+
+        QCOMPARE(threadNames, 1);
+        QCOMPARE(outer["ph"].toString(), QString("X"));
+        QCOMPARE(outer["args"].toObject()["messages"].toInt(), 3);
+        QCOMPARE(outer["tid"], inner["tid"]);
+        // The inner span is destroyed first and lies within the outer one.
+        QVERIFY(inner["ts"].toInteger() >= outer["ts"].toInteger());
+        QVERIFY(inner["ts"].toInteger() + inner["dur"].toInteger()
+                <= outer["ts"].toInteger() + outer["dur"].toInteger());
+        QVERIFY(inner["dur"].toInteger() >= 2000);
+
+        QCOMPARE(begin["id"], end["id"]);
+        QCOMPARE(end["args"].toObject()["completionTokens"].toInt(), 12);
+    }
+
+    void testThreads() {
+        Tracer::instance().setOutputFile(QDir::temp().filePath("unused.json"));
+
+        TraceSpan("main");
+        QThread *thread = QThread::create([]() { TraceSpan("worker"); });
+        thread->setObjectName("worker-thread");
+        thread->start();
+        QVERIFY(thread->wait(5000));
+        delete thread;
+
+        QSet<int> tids;
+        QStringList threadNames;
+        const QJsonArray events = Tracer::instance().events();
+        for (const auto &value : events) {
+            const QJsonObject event = value.toObject();
+            tids.insert(event["tid"].toInt());
+            if (event["name"] == "thread_name")
+                threadNames << event["args"].toObject()["name"].toString();
+        }
+        QCOMPARE(tids.size(), 2);
+        QVERIFY(threadNames.contains("main"));
+        QVERIFY(threadNames.contains("worker-thread"));
+    }
+};
+
+QTEST_MAIN(TestTracer)
+#include "tst_tracer.moc"
@@ -0,0 +1,169 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "../src/core/codesearch.h"
+#include "../src/core/trigramindex.h"
+
+class TestTrigramIndex : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void writeFile(const QString &path, const QByteArray &content) {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(content);
+    }
+
+    static QStringList candidateNames(TrigramIndex &index, const QString &pattern, bool regex = false) {
+        const auto files = index.candidates(pattern, regex);
+        if (!files)
+            return {"<none>"};
+        QStringList names;
+        for (const QString &file : *files)
+            names << QDir(index.projectPath()).relativeFilePath(file);
+        names.sort();
+        return names;
+    }
+
+    static std::vector<quint32> trigramsOf(const QStringList &literals) {
+        std::vector<quint32> result;
+        for (const QString &literal : literals) {
+            const auto trigrams = TrigramIndex::requiredTrigrams(literal, false);
+            result.insert(result.end(), trigrams.begin(), trigrams.end());
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    static void createProject(const QString &root) {
+        writeFile(root + "/.gitignore", "generated/\n");
+        writeFile(root + "/src/a.cpp", "int needleValue = 1;\n");
+        writeFile(root + "/src/b.cpp", "int other = 2;\n");
+        writeFile(root + "/generated/c.cpp", "int needleValue = 3;\n");
+    }
+
+private slots:
+    void testRequiredTrigrams() {
+        QCOMPARE(TrigramIndex::requiredTrigrams("abc", false).size(), size_t(1));
+        QVERIFY(TrigramIndex::requiredTrigrams("ab", false).empty());
+        QCOMPARE(TrigramIndex::requiredTrigrams("ABCD", false), trigramsOf({"abcd"}));
+
+        QCOMPARE(TrigramIndex::requiredTrigrams("rare\\w+Ident", true), trigramsOf({"rare", "ident"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("colou?r", true), trigramsOf({"colo"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("a{2}bcd", true), trigramsOf({"bcd"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("word{1,3}end", true), trigramsOf({"wor", "end"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("\\x41BCD", true), trigramsOf({"bcd"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("\\x{41}bcd", true), trigramsOf({"bcd"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("\\p{L}foo", true), trigramsOf({"foo"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("\\pLfoo", true), trigramsOf({"foo"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("\\Qa+b\\Eword", true), trigramsOf({"word"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("(abc)?define", true), trigramsOf({"define"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("std::vector<[a-z]+>", true), trigramsOf({"std::vector<"}));
+        QCOMPARE(TrigramIndex::requiredTrigrams("foo\\.bar", true), trigramsOf({"foo.bar"}));
+        QVERIFY(TrigramIndex::requiredTrigrams("foo|bar", true).empty());
+        QVERIFY(TrigramIndex::requiredTrigrams("a.*b", true).empty());
+    }
+
+    void testBuildAndQuery() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        createProject(dir.path());
+
+        TrigramIndex index;
+        index.setProjectPath(dir.path());
+        QTRY_VERIFY_WITH_TIMEOUT(index.isReady(), 5000);
+        QVERIFY(QFile::exists(TrigramIndex::indexFilePath(dir.path())));
+
+        QCOMPARE(candidateNames(index, "needleValue"), QStringList({"src/a.cpp"}));
+        QCOMPARE(candidateNames(index, "NEEDLEVALUE"), QStringList({"src/a.cpp"}));
+        QCOMPARE(candidateNames(index, "int\\s+needle", true), QStringList({"src/a.cpp"}));
+        QCOMPARE(candidateNames(index, "missing"), QStringList());
+        // Too short to narrow anything down.
+        QCOMPARE(candidateNames(index, "in"), QStringList({"<none>"}));
+
+        // Verifying the candidates gives the same matches as a full walk.
+        CodeSearch::Options options;
+        options.pattern = "needleValue";
+        const auto indexed = CodeSearch::search(dir.path(), options, index.candidates(options.pattern, false));
+        const auto walked = CodeSearch::search(dir.path(), options);
+        QCOMPARE(indexed.totalMatches, walked.totalMatches);
+        QCOMPARE(indexed.matches.first().filePath, walked.matches.first().filePath);
+    }
+
+    void testUpdateFiles() {
+        QTemporaryDir dir;
+        createProject(dir.path());
+
+        TrigramIndex index;
+        index.setProjectPath(dir.path());
+        QTRY_VERIFY_WITH_TIMEOUT(index.isReady(), 5000);
+
+        writeFile(dir.path() + "/src/b.cpp", "int needleValue = 2;\n");
+        QFile::remove(dir.path() + "/src/a.cpp");
+        index.updateFiles({dir.path() + "/src/a.cpp", dir.path() + "/src/b.cpp"});
+        QTRY_COMPARE_WITH_TIMEOUT(candidateNames(index, "needleValue"), QStringList({"src/b.cpp"}), 5000);
+
+        // Ignored files stay out of the index.
+        index.updateFiles({dir.path() + "/generated/c.cpp"});
+        QTest::qWait(200);
+        QCOMPARE(candidateNames(index, "needleValue"), QStringList({"src/b.cpp"}));
+    }
+
+    void testLoadCatchesUpWithChanges() {
+        QTemporaryDir dir;
+        createProject(dir.path());
+        {
+            TrigramIndex index;
+            index.setProjectPath(dir.path());
+            QTRY_VERIFY_WITH_TIMEOUT(index.isReady(), 5000);
+        }
+
+        // Changed while the index was not loaded.
+        writeFile(dir.path() + "/src/b.cpp", "int needleValue = 2; // longer than before\n");
+        writeFile(dir.path() + "/src/new.cpp", "int needleValue = 4;\n");
+
+        TrigramIndex index;
+        index.setProjectPath(dir.path());
+        QTRY_COMPARE_WITH_TIMEOUT(candidateNames(index, "needleValue"),
+                                  QStringList({"src/a.cpp", "src/b.cpp", "src/new.cpp"}), 5000);
+    }
+
+    void testWatcherPicksUpNewFiles() {
+        QTemporaryDir dir;
+        createProject(dir.path());
+
+        TrigramIndex index;
+        QSignalSpy updated(&index, &TrigramIndex::updated);
+        index.setProjectPath(dir.path());
+        QTRY_VERIFY_WITH_TIMEOUT(index.isReady() && updated.count() > 0, 5000);
+
+        writeFile(dir.path() + "/src/c.cpp", "int needleValue = 5;\n");
+        QTRY_COMPARE_WITH_TIMEOUT(candidateNames(index, "needleValue"),
+                                  QStringList({"src/a.cpp", "src/c.cpp"}), 5000);
+    }
+
+    void testFileChangedInPlaceIsFound() {
+        QTemporaryDir dir;
+        createProject(dir.path());
+
+        TrigramIndex index;
+        index.setProjectPath(dir.path());
+        QTRY_VERIFY_WITH_TIMEOUT(index.isReady(), 5000);
+
+        // Rewriting an existing file does not change its directory, no watch reports it.
+        writeFile(dir.path() + "/src/b.cpp", "int freshNeedle = 2;\n");
+        CodeSearch::Options options;
+        options.pattern = "freshNeedle";
+        const auto result = CodeSearch::search(dir.path(), options, index.candidates(options.pattern, false));
+        QCOMPARE(result.totalMatches, 1);
+        QCOMPARE(QDir(dir.path()).relativeFilePath(result.matches.first().filePath), QString("src/b.cpp"));
+
+        // Read again in the background, then found through its trigrams.
+        QTRY_COMPARE_WITH_TIMEOUT(candidateNames(index, "freshNeedle"), QStringList({"src/b.cpp"}), 5000);
+    }
+};
+
+QTEST_MAIN(TestTrigramIndex)
+#include "tst_trigramindex.moc"
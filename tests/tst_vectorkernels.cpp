@@ -0,0 +1,103 @@
+#include <QtTest>
+#include "../src/rag/vectorkernels.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+class TestVectorKernels : public QObject
+{
+    Q_OBJECT
+
+private:
+    static std::vector<float> randomVector(int dimensions, unsigned seed) {
+        std::mt19937 random(seed);
+        std::normal_distribution<float> normal;
+        std::vector<float> vector(dimensions);
+        for (float &value : vector)
+            value = normal(random);
+        return vector;
+    }
+
+private slots:
+    void init() {
+        m_default = VectorKernels::instructionSet();
+    }
+
+    void cleanup() {
+        VectorKernels::setInstructionSet(m_default);
+    }
+
+    void testScalarAlwaysSupported() {
+        QVERIFY(VectorKernels::isSupported(VectorKernels::Scalar));
+        QVERIFY(VectorKernels::isSupported(VectorKernels::instructionSet()));
+        QCOMPARE(VectorKernels::name(VectorKernels::Avx2), QString("avx2"));
+    }
+
+    void testKernelsAgree_data() {
+        QTest::addColumn<int>("set");
+        QTest::newRow("sse4.1") << int(VectorKernels::Sse41);
+        QTest::newRow("avx2") << int(VectorKernels::Avx2);
+    }
+
+    void testKernelsAgree() {
+        QFETCH(int, set);
+        const auto instructionSet = VectorKernels::InstructionSet(set);
+        if (!VectorKernels::isSupported(instructionSet))
+            QSKIP("Not supported by this CPU");
+
+        // Sizes around the vector widths, to cover the remainder loops.
+        for (int dimensions : {1, 3, 7, 8, 9, 15, 16, 17, 31, 33, 768, 1023}) {
+            const std::vector<float> a = randomVector(dimensions, 1);
+            const std::vector<float> b = randomVector(dimensions, 2);
+            std::vector<qint8> codes(dimensions);
+            float scale = 0;
+            VectorKernels::quantize(b.data(), dimensions, codes.data(), &scale);
+
+            QVERIFY(VectorKernels::setInstructionSet(VectorKernels::Scalar));
+            const float dot = VectorKernels::dot(a.data(), b.data(), dimensions);
+            const float dotInt8 = VectorKernels::dotInt8(a.data(), codes.data(), dimensions);
+
+            QVERIFY(VectorKernels::setInstructionSet(instructionSet));
+            QCOMPARE(VectorKernels::instructionSet(), instructionSet);
+            // Only the order of the additions differs.
+            const float tolerance = 1e-4f * dimensions;
+            QVERIFY(qAbs(VectorKernels::dot(a.data(), b.data(), dimensions) - dot) < tolerance);
+            QVERIFY(qAbs(VectorKernels::dotInt8(a.data(), codes.data(), dimensions) - dotInt8) < tolerance * 127);
+        }
+    }
+
+    void testQuantize() {
+        const int dimensions = 768;
+        std::vector<float> vector = randomVector(dimensions, 3);
+        std::vector<qint8> codes(dimensions);
+        float scale = 0;
+        VectorKernels::quantize(vector.data(), dimensions, codes.data(), &scale);
+
+        // Each component is off by at most half a step.
+        float maximum = 0;
+        for (int i = 0; i < dimensions; ++i) {
+            maximum = qMax(maximum, qAbs(vector[i]));
+            QVERIFY(qAbs(codes[i] * scale - vector[i]) <= scale / 2 + 1e-6f);
+        }
+        QVERIFY(qAbs(scale * 127 - maximum) < 1e-5f);
+
+        // The dot product through the codes stays close to the exact one.
+        const std::vector<float> query = randomVector(dimensions, 4);
+        const float exact = VectorKernels::dot(query.data(), vector.data(), dimensions);
+        const float quantized = scale * VectorKernels::dotInt8(query.data(), codes.data(), dimensions);
+        QVERIFY2(qAbs(exact - quantized) < 0.01f * std::sqrt(float(dimensions)) * maximum,
+                 qPrintable(QString("%1 against %2").arg(quantized).arg(exact)));
+
+        // All zeros stay zeros.
+        std::fill(vector.begin(), vector.end(), 0.0f);
+        VectorKernels::quantize(vector.data(), dimensions, codes.data(), &scale);
+        QVERIFY(std::all_of(codes.begin(), codes.end(), [](qint8 code) { return code == 0; }));
+    }
+
+private:
+    VectorKernels::InstructionSet m_default = VectorKernels::Scalar;
+};
+
+QTEST_MAIN(TestVectorKernels)
+#include "tst_vectorkernels.moc"